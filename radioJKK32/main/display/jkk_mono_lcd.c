@@ -239,7 +239,8 @@ static void JkkLcdShowObj(lv_obj_t *obj, bool show){
                         case JKK_ROLLER_MODE_STATION_LIST:{
                             if(JkkLcdPortLock(0)){
                                 char stationNameTmp[256] = {0};
-                                Utf8ToAsciiPL(jkkRadio->jkkRadioStations[jkkRadio->current_station].nameLong, stationNameTmp);
+                                char nameLong[JKK_RADIO_STATION_NAME_LEN];
+                                Utf8ToAsciiPL(JkkRadioGetStationName(jkkRadio->current_station, nameLong, sizeof(nameLong)) ? nameLong : "", stationNameTmp);
                                 lv_label_set_text(rolerLabel, stationNameTmp);
                                 JkkLcdPortUnlock();
                             }
@@ -287,7 +288,8 @@ static void RadioRollerHandler(lv_event_t * e){
                     if(indx >= 0 && indx < jkkRadio->station_count){
                         if(JkkLcdPortLock(0)){
                             char stationNameTmp[256] = {0};
-                            Utf8ToAsciiPL(jkkRadio->jkkRadioStations[indx].nameLong, stationNameTmp);
+                            char nameLong[JKK_RADIO_STATION_NAME_LEN];
+                            Utf8ToAsciiPL(JkkRadioGetStationName(indx, nameLong, sizeof(nameLong)) ? nameLong : "", stationNameTmp);
                             lv_label_set_text(rolerLabel, stationNameTmp);
                             JkkLcdPortUnlock();
                         }
@@ -331,7 +333,7 @@ static void RadioRollerHandler(lv_event_t * e){
             default:
             break;
         }
-        JkkLcdShowRoller(false, UINT8_MAX, JKK_ROLLER_MODE_HIDE);
+        JkkLcdShowRoller(false, UINT16_MAX, JKK_ROLLER_MODE_HIDE);
         JkkRadioSendMessageToMain(indx, command);
     }
 }
@@ -344,7 +346,7 @@ jkkRollerMode_t JkkLcdRollerMode(void){
     return rollerMode;
 }
 
-void JkkLcdShowRoller(bool show, uint8_t idx, jkkRollerMode_t mode){
+void JkkLcdShowRoller(bool show, uint16_t idx, jkkRollerMode_t mode){
     if(mode > JKK_ROLLER_MODE_HIDE && mode < JKK_ROLLER_MODE_UNKNOWN) rollerMode = mode;
     JkkLcdShowObj(roller, show);
     
@@ -356,7 +358,7 @@ void JkkLcdShowRoller(bool show, uint8_t idx, jkkRollerMode_t mode){
     }
 }
 
-void JkkLcdSetRollerOptions(char *options, uint8_t idx){
+void JkkLcdSetRollerOptions(char *options, uint16_t idx){
     Utf8ToAsciiPL(options, NULL);
     if(JkkLcdPortLock(0)){
         lv_roller_set_options(roller, options, LV_ROLLER_MODE_INFINITE);
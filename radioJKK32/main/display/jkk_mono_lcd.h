@@ -77,14 +77,14 @@ void JkkLcdButtonSet(int keyCode, int8_t pressed);
  * @param idx Selected item index
  * @param mode Roller mode (station list or equalizer list)
  */
-void JkkLcdShowRoller(bool show, uint8_t idx, jkkRollerMode_t mode);
+void JkkLcdShowRoller(bool show, uint16_t idx, jkkRollerMode_t mode);
 
 /**
  * @brief Set options for roller selection interface
  * @param options Newline-separated list of options
  * @param idx Currently selected index
  */
-void JkkLcdSetRollerOptions(char *options, uint8_t idx);
+void JkkLcdSetRollerOptions(char *options, uint16_t idx);
 
 /**
  * @brief Get current roller mode
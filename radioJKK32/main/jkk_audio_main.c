@@ -7,7 +7,9 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/timers.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "nvs_flash.h"
 #include "sdkconfig.h"
@@ -15,6 +17,7 @@
 #include "audio_pipeline.h"
 #include "audio_event_iface.h"
 #include "audio_common.h"
+#include "ringbuf.h"
 #include "http_stream.h"
 #include "fatfs_stream.h"
 #include "raw_stream.h"
@@ -27,13 +30,25 @@
 #include "display/jkk_mono_lcd.h"
 
 #include "jkk_audio_main.h"
+#include "jkk_pipeline_graph.h"
 
 static const char *TAG = "A_Main";
 
 #define NUMBER_BAND (10)
+#define JKK_AUDIO_I2S_DMA_FRAMES (3 * 312) // I2S_STREAM_CFG_DEFAULT: dma_desc_num * dma_frame_num
 
 static  JkkAudioMain_t audioMain = {0}; // EXT_RAM_BSS_ATTR
 
+typedef struct JkkAudioStallWd_s {
+    TimerHandle_t timer;
+    JkkAudioStallCb_t cb;
+    JkkAudioStallState_t state;
+} JkkAudioStallWd_t;
+
+static JkkAudioStallWd_t stallWd = {0};
+
+static JkkAudioRateState_t inRate = { .kbps = -1 };
+
 static int _http_stream_event_handle(http_stream_event_msg_t *msg){
     if (msg->event_id == HTTP_STREAM_RESOLVE_ALL_TRACKS) {
         return ESP_OK;
@@ -181,7 +196,8 @@ esp_err_t JkkAudioRestartStream(void) {
 }
 
 esp_err_t JkkAudioSetUrl(const char *url, bool out) {
-    if((((out ? audioMain.output_type : audioMain.input_type) != 3) && ((out ? audioMain.output_type : audioMain.input_type) != 2)) || (out ? audioMain.output : audioMain.input) == NULL) {
+    jkk_audio_io_e type = out ? audioMain.output_type : audioMain.input_type;
+    if((type != JKK_AUDIO_IO_HTTP && type != JKK_AUDIO_IO_FATFS) || (out ? audioMain.output : audioMain.input) == NULL) {
         ESP_LOGE(TAG, "HTTP/FATFS stream is not initialized or not of type HTTP/FATFS");
         return ESP_ERR_INVALID_STATE;
     }
@@ -193,7 +209,7 @@ esp_err_t JkkAudioSetUrl(const char *url, bool out) {
 }
 
 esp_err_t JkkAudioEqSetAll(const int *eqGainArray){
-    if(eqGainArray == NULL || audioMain.processing == NULL || audioMain.processing_type != 1) {
+    if(eqGainArray == NULL || audioMain.processing == NULL || audioMain.processing_type != JKK_AUDIO_PROC_EQUALIZER) {
         ESP_LOGE(TAG, "Equalizer processing element is not initialized or not of type EQUALIZER");
         return ESP_ERR_INVALID_STATE;
     }
@@ -209,7 +225,7 @@ esp_err_t JkkAudioEqSetAll(const int *eqGainArray){
 }
 
 esp_err_t JkkAudioEqSetInfo(int rate, int ch) {
-    if(audioMain.processing == NULL || audioMain.processing_type != 1) {
+    if(audioMain.processing == NULL || audioMain.processing_type != JKK_AUDIO_PROC_EQUALIZER) {
         ESP_LOGE(TAG, "Equalizer processing element is not initialized or not of type EQUALIZER");
         return ESP_ERR_INVALID_STATE;
     }
@@ -224,7 +240,7 @@ esp_err_t JkkAudioEqSetInfo(int rate, int ch) {
 }
 
 esp_err_t JkkAudioI2sSetClk(int rate, int bits, int ch, bool out) {
-    if((out ? audioMain.output_type : audioMain.input_type) != 1 || (out ? audioMain.output : audioMain.input) == NULL) {
+    if((out ? audioMain.output_type : audioMain.input_type) != JKK_AUDIO_IO_I2S || (out ? audioMain.output : audioMain.input) == NULL) {
         ESP_LOGE(TAG, "I2S stream is not initialized or not of type I2S");
         return ESP_ERR_INVALID_STATE;
     }
@@ -241,12 +257,13 @@ esp_err_t JkkAudioI2sSetClk(int rate, int bits, int ch, bool out) {
     return ret;
 }
 
-JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, int rawSplitNr) {
+JkkAudioMain_t *JkkAudioMain_init(jkk_audio_io_e inType, jkk_audio_io_e outType, jkk_audio_proc_e processingType, int rawSplitNr) {
 
-    char *inTypeStr[] = {"RAW", "I2S", "FATFS", "HTTP", "A2DP", "BT"};
-    char *outTypeStr[] = {"RAW", "I2S", "FATFS", "HTTP", "A2DP", "BT"};
-    char *processingTypeStr[] = {"NONE", "EQUALIZER"};
+    static const char *inTypeStr[] = {"RAW", "I2S", "FATFS", "HTTP", "A2DP", "BT"};
+    static const char *outTypeStr[] = {"RAW", "I2S", "FATFS", "HTTP", "A2DP", "BT"};
+    static const char *processingTypeStr[] = {"NONE", "EQUALIZER"};
 
+    int64_t t0 = esp_timer_get_time();
     ESP_LOGI(TAG, "[1.0] Create main pipeline");
     audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     audioMain.pipeline = audio_pipeline_init(&pipeline_cfg);
@@ -257,7 +274,7 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
     }
 
     switch (inType) {
-        case 0: {// RAW
+        case JKK_AUDIO_IO_RAW: {
             ESP_LOGI(TAG, "[1.1] Create raw stream to read data");
             raw_stream_cfg_t raw_cfg = RAW_STREAM_CFG_DEFAULT();
             raw_cfg.type = AUDIO_STREAM_READER;
@@ -269,7 +286,7 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
             }
         }
         break;
-        case 1: {// I2S
+        case JKK_AUDIO_IO_I2S: {
             ESP_LOGI(TAG, "[1.1] Create i2s stream to read data");
             i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
             i2s_cfg.stack_in_ext = true;
@@ -283,7 +300,7 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
             }
         }
         break;
-        case 2: {// FATFS
+        case JKK_AUDIO_IO_FATFS: {
             ESP_LOGI(TAG, "[1.1] Create fatfs stream to read data");
             fatfs_stream_cfg_t fatfs_cfg = FATFS_STREAM_CFG_DEFAULT();
             fatfs_cfg.type = AUDIO_STREAM_READER;
@@ -297,7 +314,7 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
             }
         }
         break;
-        case 3: {// HTTP
+        case JKK_AUDIO_IO_HTTP: {
             ESP_LOGI(TAG, "[1.1] Create http stream to read data");
             http_stream_cfg_t http_cfg = HTTP_STREAM_CFG_DEFAULT();
             http_cfg.event_handle = _http_stream_event_handle;
@@ -324,10 +341,8 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
     }
 
     audioMain.input_type = inType;
-    audio_pipeline_register(audioMain.pipeline, audioMain.input, inTypeStr[inType]);
-    ESP_LOGI(TAG, "[1.1] Register stream to audio pipeline with tag '%s'", inTypeStr[inType]);
 
-    if(inType == 2 || inType == 3) {
+    if(inType == JKK_AUDIO_IO_FATFS || inType == JKK_AUDIO_IO_HTTP) {
         ESP_LOGI(TAG, "[1.2] Create decoder to decode audio data");
         audio_decoder_t auto_decode[] = {
             DEFAULT_ESP_OGG_DECODER_CONFIG(),
@@ -352,8 +367,17 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
             ESP_LOGE(TAG, "Failed to create audio decoder");
             return NULL;
         }
-        audio_pipeline_register(audioMain.pipeline, audioMain.decoder, "DEC");
-        ESP_LOGI(TAG, "[1.2] Register decoder to audio pipeline with tag 'DEC'");
+#if defined(CONFIG_JKK_RADIO_RESTREAM)
+        ESP_LOGI(TAG, "[1.2] Create raw split to tap compressed input data");
+        raw_split_cfg_t rs_in_cfg = RAW_SPLIT_CFG_DEFAULT();
+        rs_in_cfg.multi_out_num = 1;
+        audioMain.inSplit = raw_split_init(&rs_in_cfg);
+        ESP_LOGI(TAG, "Pointer raw_split_in=%p", audioMain.inSplit);
+        if (audioMain.inSplit == NULL) {
+            ESP_LOGE(TAG, "Failed to create input raw split");
+            return NULL;
+        }
+#endif
     }
     else {
         audioMain.decoder = NULL;
@@ -370,15 +394,13 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
             ESP_LOGE(TAG, "Failed to create raw split");
             return NULL;
         }
-        audio_pipeline_register(audioMain.pipeline, audioMain.split, "RS");
-        ESP_LOGI(TAG, "[1.3] Register raw split to audio pipeline with tag 'RS'");
         audioMain.raw_split_nr = rawSplitNr;
     }
     else {
         audioMain.split = NULL;
     }
     
-    if(processingType == 1) {
+    if(processingType == JKK_AUDIO_PROC_EQUALIZER) {
         ESP_LOGI(TAG, "[1.4] Create equalizer to process audio data");
         equalizer_cfg_t eq_cfg = DEFAULT_EQUALIZER_CONFIG();
         eq_cfg.task_prio = 7;
@@ -398,24 +420,18 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
 
     audioMain.processing_type = processingType;
 
-    if( audioMain.processing != NULL){
-        audio_pipeline_register(audioMain.pipeline, audioMain.processing, processingTypeStr[audioMain.processing_type]);
-        ESP_LOGI(TAG, "[1.1] Register processing to audio pipeline with tag '%s'",  processingTypeStr[audioMain.processing_type]);
-    }
-
 #if defined(CONFIG_JKK_RADIO_USING_I2C_LCD)
     volume_meter_cfg_t vmcfg = V_METER_CFG_DEFAULT();
     vmcfg.update_rate_hz = 14;
     vmcfg.frame_size = 768;
     vmcfg.volume_callback = JkkLcdVolumeIndicatorCallback;
     audioMain.vmeter = volume_meter_init(&vmcfg);
-    audio_pipeline_register(audioMain.pipeline, audioMain.vmeter, "VM");
 #else
     audioMain.vmeter = NULL;
 #endif
 
     switch ( outType) {
-        case 0: {// RAW  
+        case JKK_AUDIO_IO_RAW: {  
             ESP_LOGI(TAG, "[1.5] Create raw stream to write data");
             raw_stream_cfg_t raw_out_cfg = RAW_STREAM_CFG_DEFAULT();
             raw_out_cfg.type = AUDIO_STREAM_WRITER;
@@ -427,7 +443,7 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
             }
         }
         break;
-        case 1: {// I2S
+        case JKK_AUDIO_IO_I2S: {
             ESP_LOGI(TAG, "[1.5] Create i2s stream to write data");
             i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
             i2s_cfg.stack_in_ext = true;
@@ -441,7 +457,7 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
             }
         }
         break;
-        case 2: {// FATFS
+        case JKK_AUDIO_IO_FATFS: {
             ESP_LOGI(TAG, "[1.5] Create fatfs stream to write data");
             fatfs_stream_cfg_t fatfs_cfg = FATFS_STREAM_CFG_DEFAULT();
             fatfs_cfg.type = AUDIO_STREAM_WRITER;
@@ -455,7 +471,7 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
             }
         }
         break;
-        case 3: {// HTTP
+        case JKK_AUDIO_IO_HTTP: {
             ESP_LOGI(TAG, "[1.5] Create http stream to write data");
             http_stream_cfg_t http_cfg = HTTP_STREAM_CFG_DEFAULT();
             http_cfg.type = AUDIO_STREAM_WRITER;
@@ -476,54 +492,27 @@ JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, i
     }
 
     audioMain.output_type = outType;
-    audio_pipeline_register(audioMain.pipeline, audioMain.output, outTypeStr[outType]);
-    ESP_LOGI(TAG, "[1.5] Register output to audio pipeline with tag '%s'", outTypeStr[outType]);
-
-    audioMain.linkElementsNoProcessing[0] = inTypeStr[inType];
-    audioMain.linkElementsAll[0] = inTypeStr[inType];
-
-    int link_idx_all = 1;
-    int link_idx_No_proc = 1;
-    if( audioMain.decoder != NULL) {
-        audioMain.linkElementsNoProcessing[link_idx_No_proc++] = "DEC";
-        audioMain.linkElementsAll[link_idx_all++] = "DEC";    
-    }
-    if( audioMain.split != NULL) {
-        audioMain.linkElementsNoProcessing[link_idx_No_proc++] = "RS";
-        audioMain.linkElementsAll[link_idx_all++] = "RS";
-    }
-    if( audioMain.processing != NULL) {
-        audioMain.linkElementsAll[link_idx_all++] = processingTypeStr[audioMain.processing_type];
+    ESP_LOGI(TAG, "[1.6] Register elements and link them in data flow order");
+    JkkGraphInit(&audioMain.graph, audioMain.pipeline);
+    esp_err_t ret = JkkGraphAdd(&audioMain.graph, inTypeStr[inType], audioMain.input, true);
+    ret |= JkkGraphAdd(&audioMain.graph, JKK_AUDIO_TAG_IN_SPLIT, audioMain.inSplit, true);
+    ret |= JkkGraphAdd(&audioMain.graph, JKK_AUDIO_TAG_DECODER, audioMain.decoder, true);
+    ret |= JkkGraphAdd(&audioMain.graph, JKK_AUDIO_TAG_SPLIT, audioMain.split, true);
+    if (audioMain.processing != NULL) {
+        ret |= JkkGraphAdd(&audioMain.graph, processingTypeStr[processingType], audioMain.processing, true);
     }
-    if( audioMain.vmeter != NULL) {
-        audioMain.linkElementsAll[link_idx_all++] = "VM";
+    ret |= JkkGraphAdd(&audioMain.graph, JKK_AUDIO_TAG_VMETER, audioMain.vmeter, true);
+    ret |= JkkGraphAdd(&audioMain.graph, outTypeStr[outType], audioMain.output, true);
+    ret |= JkkGraphLink(&audioMain.graph);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to build main pipeline");
+        return NULL;
     }
-
-    audioMain.linkElementsAllCount = link_idx_all + 1;
-
-    audioMain.linkElementsNoProcessing[link_idx_No_proc] = outTypeStr[outType]; 
-    audioMain.linkElementsAll[link_idx_all] = outTypeStr[outType]; 
-
-    ESP_LOGI(TAG, "Link tags: %s, %s, %s, %s, %s, %s, %s", audioMain.linkElementsAll[0], 
-             (link_idx_all > 0) ? audioMain.linkElementsAll[1] : "",
-             (link_idx_all > 1) ? audioMain.linkElementsAll[2] : "",
-             (link_idx_all > 2) ? audioMain.linkElementsAll[3] : "",
-             (link_idx_all > 3) ? audioMain.linkElementsAll[4] : "",
-             (link_idx_all > 4) ? audioMain.linkElementsAll[5] : "",
-             (link_idx_all > 5) ? audioMain.linkElementsAll[6] : "");
-
-    audio_pipeline_link(audioMain.pipeline, &audioMain.linkElementsAll[0], audioMain.linkElementsAllCount); 
-
-    ESP_LOGI(TAG, "Link tags short: %s, %s, %s, %s, %s, %s", audioMain.linkElementsNoProcessing[0], 
-             (link_idx_No_proc > 0) ? audioMain.linkElementsNoProcessing[1] : "",
-             (link_idx_No_proc > 1) ? audioMain.linkElementsNoProcessing[2] : "",
-             (link_idx_No_proc > 2) ? audioMain.linkElementsNoProcessing[3] : "",
-             (link_idx_No_proc > 3) ? audioMain.linkElementsNoProcessing[4] : "",
-             (link_idx_No_proc > 4) ? audioMain.linkElementsNoProcessing[5] : "");
-    
-    ESP_LOGI(TAG, "[1.6] Link elements together: %d", audioMain.linkElementsAllCount);
+    audioMain.processingTag = audioMain.processing ? processingTypeStr[processingType] : NULL;
 
     audioMain.lineWithProcess = true;
+    audioMain.buildUs = esp_timer_get_time() - t0;
+    ESP_LOGI(TAG, "Main pipeline built in %lld us", audioMain.buildUs);
 
     return &audioMain;
 }
@@ -533,60 +522,119 @@ esp_err_t JkkAudioMainOnOffProcessing(bool on, audio_event_iface_handle_t evt){
         ESP_LOGI(TAG, "Pipeline same state, no change");
         return ESP_OK;
     }
-    
-    esp_err_t ret = audio_pipeline_stop(audioMain.pipeline);
-    ret |= audio_pipeline_wait_for_stop(audioMain.pipeline);
-    ret |= audio_pipeline_reset_ringbuffer(audioMain.pipeline);
-    ret |= audio_pipeline_reset_elements(audioMain.pipeline);
-    ret |= audio_pipeline_reset_items_state(audioMain.pipeline);
+    if(audioMain.processingTag == NULL) {
+        ESP_LOGW(TAG, "No processing element in pipeline");
+        return ESP_ERR_INVALID_STATE;
+    }
+    bool procWas = JkkGraphIsEnabled(&audioMain.graph, audioMain.processingTag);
+    bool vmeterWas = JkkGraphIsEnabled(&audioMain.graph, JKK_AUDIO_TAG_VMETER);
+    // Volume meter shows processed signal, it is bypassed together with processing
+    JkkGraphSetEnabled(&audioMain.graph, audioMain.processingTag, on);
+    JkkGraphSetEnabled(&audioMain.graph, JKK_AUDIO_TAG_VMETER, on);
 
-    if(ret != ESP_OK) return ret;
+    esp_err_t ret = JkkGraphRelink(&audioMain.graph, evt);
+    if(ret != ESP_OK) {
+        ESP_LOGE(TAG, "Processing %s failed (%s), previous link restored", on ? "on" : "off", esp_err_to_name(ret));
+        JkkGraphSetEnabled(&audioMain.graph, audioMain.processingTag, procWas);
+        JkkGraphSetEnabled(&audioMain.graph, JKK_AUDIO_TAG_VMETER, vmeterWas);
+        JkkGraphRelink(&audioMain.graph, evt);
+        audio_pipeline_resume(audioMain.pipeline);
+        return ret;
+    }
+    audioMain.lineWithProcess = on; // Linked, buffers counted by JkkAudioMainBufferedUs follow the link
+    ESP_LOGI(TAG, "Processing %s: relink %lld us, full pipeline rebuild %lld us (without deinit)",
+             on ? "on" : "off", audioMain.graph.relinkUs, audioMain.buildUs);
 
-    ret = audio_pipeline_unlink(audioMain.pipeline);
+   // ret |= audio_pipeline_run(audioMain.pipeline);
+    ret = audio_pipeline_resume(audioMain.pipeline);
+    return ret;
+}
 
-    audio_pipeline_remove_listener(audioMain.pipeline);
+bool JkkAudioMainProcessState(void){
+    return audioMain.lineWithProcess;
+}
 
-    if(on) {
-        ret |= audio_pipeline_link(audioMain.pipeline, &audioMain.linkElementsAll[0], audioMain.linkElementsAllCount);
+static int JkkAudioRbFilled(audio_element_handle_t el) {
+    if (el == NULL) return 0;
+    ringbuf_handle_t rb = audio_element_get_output_ringbuf(el);
+    return rb ? rb_bytes_filled(rb) : 0;
+}
+
+int JkkAudioMainBufferedUs(bool withInput) {
+    if (audioMain.pipeline == NULL || audioMain.sample_rate <= 0 || audioMain.channels <= 0) {
+        return -1;
     }
-    else {
-        ret |= audio_pipeline_link(audioMain.pipeline, &audioMain.linkElementsNoProcessing[0], audioMain.linkElementsAllCount - 2);
+    int bits = audioMain.bits > 0 ? audioMain.bits : 16;
+    int64_t bytesPerSec = (int64_t)audioMain.sample_rate * audioMain.channels * bits / 8;
+    int64_t filled = 0;
+    if (withInput && audioMain.decoder == NULL) {
+        filled += JkkAudioRbFilled(audioMain.input); // PCM written directly into raw input
     }
+    filled += JkkAudioRbFilled(audioMain.split);
+    if (audioMain.lineWithProcess) {
+        filled += JkkAudioRbFilled(audioMain.processing);
+        filled += JkkAudioRbFilled(audioMain.vmeter);
+    }
+    return (int)(filled * 1000000 / bytesPerSec + (int64_t)JKK_AUDIO_I2S_DMA_FRAMES * 1000000 / audioMain.sample_rate);
+}
 
-    audio_pipeline_set_listener(audioMain.pipeline, evt);
+int JkkAudioMainInputKbps(void) {
+    return inRate.kbps;
+}
 
-   // ret |= audio_pipeline_run(audioMain.pipeline);
-    ret |= audio_pipeline_resume(audioMain.pipeline);
-    if(ret == ESP_OK) audioMain.lineWithProcess = on;
-    return ret;
+static void JkkAudioStallTimerHandle(TimerHandle_t xTimer) {
+    TickType_t now = xTaskGetTickCount();
+    if (audioMain.audio_state != JKK_AUDIO_STATE_PLAYING || audio_element_get_state(audioMain.input) != AEL_STATE_RUNNING) {
+        JkkAudioStallReset(&stallWd.state, now);
+        JkkAudioRateReset(&inRate);
+        return;
+    }
+    audio_element_info_t inInfo = {0};
+    audio_element_info_t outInfo = {0};
+    audio_element_getinfo(audioMain.input, &inInfo);
+    audio_element_getinfo(audioMain.output, &outInfo);
+
+    JkkAudioRateSample(&inRate, inInfo.byte_pos, now);
+    jkk_audio_stall_e stall = JkkAudioStallCheck(&stallWd.state, inInfo.byte_pos, outInfo.byte_pos, now);
+    if (stall != JKK_AUDIO_STALL_NONE) {
+        ESP_LOGW(TAG, "Stream stall (%s), in: %lld B, out: %lld B", stall == JKK_AUDIO_STALL_INPUT ? "input" : "decoder",
+                 inInfo.byte_pos, outInfo.byte_pos);
+        if (stallWd.cb) stallWd.cb(stall);
+    }
 }
 
-bool JkkAudioMainProcessState(void){
-    return audioMain.lineWithProcess;
+esp_err_t JkkAudioMainStallWatchdogStart(int timeoutMs, JkkAudioStallCb_t cb) {
+    if (audioMain.pipeline == NULL || audioMain.input_type != JKK_AUDIO_IO_HTTP) {
+        ESP_LOGE(TAG, "Stall watchdog needs HTTP input pipeline");
+        return ESP_ERR_INVALID_STATE;
+    }
+    stallWd.state.timeoutMs = timeoutMs;
+    stallWd.cb = cb;
+    JkkAudioStallReset(&stallWd.state, xTaskGetTickCount());
+    // Sampling at 1/4 of timeout keeps detection within 125% of it
+    stallWd.timer = xTimerCreate("stallWd", pdMS_TO_TICKS(timeoutMs / 4), pdTRUE, NULL, JkkAudioStallTimerHandle);
+    if (stallWd.timer == NULL || xTimerStart(stallWd.timer, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start stall watchdog timer");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Stall watchdog started, timeout %d ms", timeoutMs);
+    return ESP_OK;
 }
 
 void JkkAudioMain_deinit(void) {
+    if (stallWd.timer != NULL) {
+        xTimerDelete(stallWd.timer, 0);
+        stallWd.timer = NULL;
+    }
     if (audioMain.pipeline != NULL) {
         audio_pipeline_stop(audioMain.pipeline);
         audio_pipeline_wait_for_stop(audioMain.pipeline);
         audio_pipeline_terminate(audioMain.pipeline);
         ESP_LOGI(TAG, "[1.7] Unregister all elements from audio pipeline");
-
-        audio_pipeline_unregister(audioMain.pipeline, audioMain.input);
-
-        if (audioMain.decoder != NULL) {
-            audio_pipeline_unregister(audioMain.pipeline, audioMain.decoder);
-        }
-        if (audioMain.split != NULL) {
-            audio_pipeline_unregister(audioMain.pipeline, audioMain.split);
+        audio_pipeline_unlink(audioMain.pipeline);
+        while (audioMain.graph.count > 0) {
+            JkkGraphRemove(&audioMain.graph, audioMain.graph.nodes[audioMain.graph.count - 1].tag);
         }
-        if (audioMain.vmeter != NULL) {
-            audio_pipeline_unregister(audioMain.pipeline, audioMain.vmeter);
-        }
-        if (audioMain.processing != NULL) {     
-            audio_pipeline_unregister(audioMain.pipeline, audioMain.processing);
-        }
-        audio_pipeline_unregister(audioMain.pipeline, audioMain.output);
 
         audio_pipeline_remove_listener(audioMain.pipeline);
 
@@ -601,6 +649,10 @@ void JkkAudioMain_deinit(void) {
         audio_element_deinit(audioMain.input);
         audioMain.input = NULL;
     }
+    if (audioMain.inSplit != NULL) {
+        audio_element_deinit(audioMain.inSplit);
+        audioMain.inSplit = NULL;
+    }
     if (audioMain.decoder != NULL) {
         audio_element_deinit(audioMain.decoder);
         audioMain.decoder = NULL;   
@@ -622,8 +674,9 @@ void JkkAudioMain_deinit(void) {
         audioMain.output = NULL;
     }
 
-    audioMain.input_type = -1;
-    audioMain.output_type = -1;
-    audioMain.processing_type = -1;
+    audioMain.input_type = JKK_AUDIO_IO_NONE;
+    audioMain.output_type = JKK_AUDIO_IO_NONE;
+    audioMain.processing_type = JKK_AUDIO_PROC_NONE;
+    audioMain.processingTag = NULL;
     ESP_LOGI(TAG, "[1.9] Audio main deinitialized");
 }
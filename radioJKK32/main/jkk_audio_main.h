@@ -6,16 +6,35 @@
 #pragma once
 
 #include <string.h>
+#include "freertos/FreeRTOS.h"
 
 #include "audio_common.h"
 #include "audio_element.h"
 #include "audio_pipeline.h"
+#include "jkk_pipeline_graph.h"
+#include "jkk_audio_monitor.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define JKK_MAX_PIPELINE_ELEMENTS (8)
+#define JKK_AUDIO_TAG_IN_SPLIT "RSIN"
+#define JKK_AUDIO_TAG_DECODER "DEC"
+#define JKK_AUDIO_TAG_SPLIT "RS"
+#define JKK_AUDIO_TAG_VMETER "VM"
+
+typedef enum {
+    JKK_AUDIO_IO_NONE = -1,
+    JKK_AUDIO_IO_RAW = 0,
+    JKK_AUDIO_IO_I2S,
+    JKK_AUDIO_IO_FATFS,
+    JKK_AUDIO_IO_HTTP,
+} jkk_audio_io_e;
+
+typedef enum {
+    JKK_AUDIO_PROC_NONE = 0,
+    JKK_AUDIO_PROC_EQUALIZER,
+} jkk_audio_proc_e;
 
 typedef enum {
     JKK_AUDIO_STATE_STOPPED = 0,
@@ -24,21 +43,24 @@ typedef enum {
     JKK_AUDIO_STATE_ERROR
 } jkk_audio_state_t;
 
+typedef void (*JkkAudioStallCb_t)(jkk_audio_stall_e stall);
+
 typedef struct JkkAudioMain_s {
     audio_pipeline_handle_t pipeline;
     audio_element_handle_t input;
     audio_element_handle_t vmeter;
     audio_element_handle_t decoder;
     audio_element_handle_t split;
+    audio_element_handle_t inSplit; // Tap of compressed input data (before decoder) for re-streaming
     audio_element_handle_t processing;
     audio_element_handle_t output;
-    const char *linkElementsAll[JKK_MAX_PIPELINE_ELEMENTS];
-    const char *linkElementsNoProcessing[JKK_MAX_PIPELINE_ELEMENTS - 1];
-    int linkElementsAllCount;
+    JkkGraph_t graph; // Registered elements in data flow order
+    int64_t buildUs; // Create, register and link in JkkAudioMain_init: the rebuild a relink avoids
+    const char *processingTag;
     bool lineWithProcess;
-    int input_type; // 0 - raw, 1 - i2s, 2 - fatfs, 3 - http
-    int output_type; // 0 - raw, 1 - i2s, 2 - fatfs, 3 - http
-    int processing_type; // 0 - none, 1 - equalizer
+    jkk_audio_io_e input_type;
+    jkk_audio_io_e output_type;
+    jkk_audio_proc_e processing_type;
     int channels; // number of channels
     int sample_rate; // sample rate of audio stream
     int bits; // bits per sample
@@ -124,16 +146,17 @@ esp_err_t JkkAudioRestartStream(void);
 
 /**
  * @brief Initialize audio main pipeline
- * @param inType Input stream type (0 - RAW, 1 - I2S, 2 - FATFS, 3 - HTTP)
- * @param outType Output stream type (0 - RAW, 1 - I2S, 2 - FATFS, 3 - HTTP)
- * @param processingType Processing type (0 - NONE, 1 - EQUALIZER)
+ * @param inType Input stream type
+ * @param outType Output stream type
+ * @param processingType Processing type
  * @param rawSplitNr Number of raw split outputs
  * @return Pointer to initialized JkkAudioMain_t structure or NULL on failure
  */
-JkkAudioMain_t *JkkAudioMain_init(int inType, int outType, int processingType, int rawSplitNr);
+JkkAudioMain_t *JkkAudioMain_init(jkk_audio_io_e inType, jkk_audio_io_e outType, jkk_audio_proc_e processingType, int rawSplitNr);
 
 /**
  * @brief Enable or disable audio processing in the pipeline
+ * If the relink fails, the previous link is restored.
  * @param on true to enable processing, false to disable
  * @param evt Event interface handle for processing events
  * @return ESP_OK on success, error code on failure
@@ -146,6 +169,30 @@ esp_err_t JkkAudioMainOnOffProcessing(bool on, audio_event_iface_handle_t evt);
  */
 bool JkkAudioMainProcessState(void);
 
+/**
+ * @brief Estimate time until the newest PCM byte after raw split is heard
+ * Sum of ring buffers between split and I2S plus I2S DMA buffer, at current output format.
+ * @param withInput Also count raw input ring buffer (pipeline fed with PCM, no decoder)
+ * @return Latency in microseconds, -1 if format is not known yet
+ */
+int JkkAudioMainBufferedUs(bool withInput);
+
+/**
+ * @brief Start watchdog of input bytes and output PCM while playing
+ * Callback is called from timer task, when nothing moves for timeoutMs
+ * (JKK_AUDIO_STALL_START_FACTOR times longer until the first bytes after start).
+ * @param timeoutMs Stall timeout in milliseconds
+ * @param cb Stall callback
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkAudioMainStallWatchdogStart(int timeoutMs, JkkAudioStallCb_t cb);
+
+/**
+ * @brief Get input bitrate measured over the last seconds (sampled by stall watchdog)
+ * @return Bitrate in kbit/s, -1 if not playing or not measured yet
+ */
+int JkkAudioMainInputKbps(void);
+
 /**
  * @brief Deinitialize audio main pipeline and all elements 
  */
@@ -0,0 +1,94 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Stream stall, input bitrate and audio description decisions from element positions (no ADF calls, runs on host too)
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "jkk_audio_monitor.h"
+
+void JkkAudioStallReset(JkkAudioStallState_t *st, TickType_t now) {
+    st->gotData = false;
+    st->inTick = st->outTick = now;
+}
+
+jkk_audio_stall_e JkkAudioStallCheck(JkkAudioStallState_t *st, int64_t inPos, int64_t outPos, TickType_t now) {
+    if (inPos < st->inPos || outPos < st->outPos) { // Elements reset: station change or restart
+        JkkAudioStallReset(st, now);
+    }
+    if (inPos != st->inPos) {
+        if (!st->gotData && inPos > 0) {
+            st->outTick = now; // Decoder gets full timeout from the first bytes, not from start
+        }
+        st->inTick = now;
+        st->gotData = inPos > 0;
+    }
+    if (outPos != st->outPos) {
+        st->outTick = now;
+    }
+    st->inPos = inPos;
+    st->outPos = outPos;
+
+    // Before the first bytes connection and buffering take longer, http_stream reports open errors itself
+    TickType_t limit = pdMS_TO_TICKS(st->gotData ? st->timeoutMs : JKK_AUDIO_STALL_START_FACTOR * st->timeoutMs);
+    jkk_audio_stall_e stall = JKK_AUDIO_STALL_NONE;
+    if (now - st->inTick > limit) {
+        stall = JKK_AUDIO_STALL_INPUT;
+    }
+    else if (st->gotData && now - st->outTick > limit) {
+        stall = JKK_AUDIO_STALL_OUTPUT; // Data comes in but decoder produces nothing
+    }
+    if (stall != JKK_AUDIO_STALL_NONE) {
+        JkkAudioStallReset(st, now); // Give the reconnect full start time
+    }
+    return stall;
+}
+
+void JkkAudioRateReset(JkkAudioRateState_t *st) {
+    st->count = 0;
+    st->kbps = -1;
+}
+
+int JkkAudioRateSample(JkkAudioRateState_t *st, int64_t pos, TickType_t now) {
+    if (st->count > 0 && pos < st->pos[st->head]) { // Elements reset
+        JkkAudioRateReset(st);
+    }
+    if (st->count > 0 && now - st->tick[st->head] < pdMS_TO_TICKS(1000)) {
+        return st->kbps;
+    }
+    st->head = (st->head + 1) % JKK_AUDIO_RATE_SLOTS;
+    st->pos[st->head] = pos;
+    st->tick[st->head] = now;
+    if (st->count < JKK_AUDIO_RATE_SLOTS) st->count++;
+    if (st->count >= JKK_AUDIO_RATE_SLOTS / 2) { // Skip the burst of initial buffering
+        int oldest = (st->head + JKK_AUDIO_RATE_SLOTS - st->count + 1) % JKK_AUDIO_RATE_SLOTS;
+        uint32_t ms = pdTICKS_TO_MS(now - st->tick[oldest]);
+        if (ms > 0) {
+            st->kbps = (int)((pos - st->pos[oldest]) * 8 / ms); // bits per ms = kbit/s
+        }
+    }
+    return st->kbps;
+}
+
+int JkkAudioNominalKbps(int kbps) {
+    static const uint16_t nominal[] = {8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+    for (int i = 0; i < sizeof(nominal) / sizeof(nominal[0]); i++) {
+        if (abs(kbps - nominal[i]) * 100 <= nominal[i] * 6) return nominal[i]; // Within 6%, overhead of ICY metadata and headers
+    }
+    return kbps;
+}
+
+bool JkkAudioDesUpdate(JkkAudioDesState_t *st, char *des, const char *codec, int kbps, uint32_t sampleRate, int channels) {
+    char now[JKK_AUDIO_DES_LEN];
+    snprintf(now, sizeof(now), "%s %dk %luk%s", codec, JkkAudioNominalKbps(kbps), (unsigned long)(sampleRate / 1000),
+             channels == 1 ? " M" : "");
+    if (strcmp(now, st->pending)) {
+        strcpy(st->pending, now);
+        return false;
+    }
+    if (!strcmp(now, des)) return false;
+    strcpy(des, now);
+    return true;
+}
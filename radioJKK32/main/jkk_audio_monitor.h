@@ -0,0 +1,105 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Stream stall, input bitrate and audio description decisions from element positions (no ADF calls, runs on host too)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JKK_AUDIO_STALL_START_FACTOR (4) // Longer limit after (re)start, before first data
+#define JKK_AUDIO_RATE_SLOTS (9) // Rolling input bitrate window, one sample per second (8 s)
+#define JKK_AUDIO_DES_LEN (16) // As audioDes of JkkRadioStations_t
+
+typedef enum {
+    JKK_AUDIO_STALL_NONE = 0,
+    JKK_AUDIO_STALL_INPUT, // No bytes from station
+    JKK_AUDIO_STALL_OUTPUT, // Bytes come in, no PCM goes out
+} jkk_audio_stall_e;
+
+typedef struct JkkAudioStallState_s {
+    int timeoutMs;
+    int64_t inPos;
+    int64_t outPos;
+    TickType_t inTick; // Last time input advanced
+    TickType_t outTick; // Last time output advanced (or first data came)
+    bool gotData; // Input delivered data since (re)start
+} JkkAudioStallState_t;
+
+typedef struct JkkAudioRateState_s {
+    int64_t pos[JKK_AUDIO_RATE_SLOTS];
+    TickType_t tick[JKK_AUDIO_RATE_SLOTS];
+    int head;
+    int count;
+    volatile int kbps; // -1 until window holds enough samples, read from other tasks
+} JkkAudioRateState_t;
+
+typedef struct JkkAudioDesState_s {
+    char pending[JKK_AUDIO_DES_LEN]; // Description of previous poll
+} JkkAudioDesState_t;
+
+/**
+ * @brief Start stall timing again with start allowance (not playing, new stream)
+ * @param st Stall state
+ * @param now Current tick count
+ */
+void JkkAudioStallReset(JkkAudioStallState_t *st, TickType_t now);
+
+/**
+ * @brief Stall decision for one watchdog sample
+ * Positions going back mean elements were reset (station change, restart). After a stall
+ * is reported timing starts again with start allowance, for the reconnect.
+ * @param st Stall state, timeoutMs set by caller
+ * @param inPos Input element byte position
+ * @param outPos Output element byte position
+ * @param now Current tick count
+ * @return Detected stall or JKK_AUDIO_STALL_NONE
+ */
+jkk_audio_stall_e JkkAudioStallCheck(JkkAudioStallState_t *st, int64_t inPos, int64_t outPos, TickType_t now);
+
+/**
+ * @brief Forget bitrate samples (not playing, new stream)
+ * @param st Rate state
+ */
+void JkkAudioRateReset(JkkAudioRateState_t *st);
+
+/**
+ * @brief Input position sample for bitrate, taken at most once per second (more frequent calls are skipped)
+ * The first half of the window is not used: it holds the burst of initial buffering.
+ * Position going back means elements were reset, measurement starts again.
+ * @param st Rate state
+ * @param pos Input element byte position
+ * @param now Current tick count
+ * @return Bitrate in kbit/s, -1 if not measured yet
+ */
+int JkkAudioRateSample(JkkAudioRateState_t *st, int64_t pos, TickType_t now);
+
+/**
+ * @brief Nearest nominal bitrate (8 ... 320 kbit/s) within 6% (ICY metadata and container overhead)
+ * @param kbps Measured bitrate
+ * @return Nominal bitrate or kbps if none is near
+ */
+int JkkAudioNominalKbps(int kbps);
+
+/**
+ * @brief Build audio description ("MP3 128k 44k", " M" for mono) and decide if it replaces the current one
+ * New description is taken when two polls agree, so VBR streams do not change it each poll.
+ * @param st Description state
+ * @param des Current description, replaced when changed (JKK_AUDIO_DES_LEN bytes)
+ * @param codec Codec name
+ * @param kbps Measured bitrate (JkkAudioRateSample)
+ * @param sampleRate Sample rate in Hz
+ * @param channels Number of channels
+ * @return true if des was changed
+ */
+bool JkkAudioDesUpdate(JkkAudioDesState_t *st, char *des, const char *codec, int kbps, uint32_t sampleRate, int channels);
+
+#ifdef __cplusplus
+}
+#endif
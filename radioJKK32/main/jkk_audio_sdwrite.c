@@ -267,37 +267,16 @@ JkkAudioSdWrite_t *JkkAudioSdWrite_init(int encoder_type, int sample_rate, int c
     ESP_LOGI(TAG, "Pointer fatfs_stream_writer=%p", audioSd.fatfs_wr);
     ESP_LOGI(TAG, "[0.6] Register all elements to pipeline_save");
 
-    audio_pipeline_register(audioSd.pipeline, audioSd.raw_read, "RAW");
-
-    int elCount = 2; // Always: RAW and FILE
-    if(audioSd.resample) {
-        audio_pipeline_register(audioSd.pipeline, audioSd.resample, "RESMAPLE");
-        elCount++;
-    }
-    if(audioSd.encoder) {
-        audio_pipeline_register(audioSd.pipeline, audioSd.encoder, "ENCODE");
-        elCount++;
-    }
-    audio_pipeline_register(audioSd.pipeline, audioSd.fatfs_wr, "FILE");    
-
-    const char *link_tag[elCount]; 
-    link_tag[0] = "RAW";
-
-    int link_idx = 1;
-    if( audioSd.resample != NULL) {
-        link_tag[link_idx++] = "RESMAPLE";
-    }
-    if( audioSd.encoder != NULL) {
-        link_tag[link_idx++] = "ENCODE";
+    JkkGraphInit(&audioSd.graph, audioSd.pipeline);
+    esp_err_t ret = JkkGraphAdd(&audioSd.graph, "RAW", audioSd.raw_read, true);
+    ret |= JkkGraphAdd(&audioSd.graph, "RESAMPLE", audioSd.resample, true);
+    ret |= JkkGraphAdd(&audioSd.graph, "ENCODE", audioSd.encoder, true);
+    ret |= JkkGraphAdd(&audioSd.graph, "FILE", audioSd.fatfs_wr, true);
+    ret |= JkkGraphLink(&audioSd.graph);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to build SD write pipeline");
+        return NULL;
     }
-    link_tag[link_idx] = "FILE"; 
-
-    audio_pipeline_link(audioSd.pipeline, &link_tag[0], elCount);
-    ESP_LOGI(TAG, "Link tags: %s, %s, %s, %s", link_tag[0], 
-             (link_idx > 0) ? link_tag[1] : "",
-             (link_idx > 1) ? link_tag[2] : "",
-             (link_idx > 2) ? link_tag[3] : ""); 
-
 
     audioSd.recording_mutex = xSemaphoreCreateMutex();
     if (audioSd.recording_mutex == NULL) {
@@ -319,17 +298,9 @@ void JkkAudioSdWrite_deinit(void) {
         audio_pipeline_terminate(audioSd.pipeline);
         
         // Unregister elements
-        if(audioSd.raw_read) {
-            audio_pipeline_unregister(audioSd.pipeline, audioSd.raw_read);
-        }
-        if(audioSd.resample) {
-            audio_pipeline_unregister(audioSd.pipeline, audioSd.resample);
-        }
-        if(audioSd.encoder) {
-            audio_pipeline_unregister(audioSd.pipeline, audioSd.encoder);
-        }
-        if(audioSd.fatfs_wr) {
-            audio_pipeline_unregister(audioSd.pipeline, audioSd.fatfs_wr);
+        audio_pipeline_unlink(audioSd.pipeline);
+        while (audioSd.graph.count > 0) {
+            JkkGraphRemove(&audioSd.graph, audioSd.graph.nodes[audioSd.graph.count - 1].tag);
         }
         
         audio_pipeline_deinit(audioSd.pipeline);
@@ -10,6 +10,7 @@
 #include "audio_common.h"
 #include "audio_element.h"
 #include "audio_pipeline.h"
+#include "jkk_pipeline_graph.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,6 +18,7 @@ extern "C" {
 
 typedef struct JkkAudioSdWrite_s {
     audio_pipeline_handle_t pipeline;
+    JkkGraph_t graph;
     audio_element_handle_t raw_read;
     audio_element_handle_t resample;
     audio_element_handle_t encoder;
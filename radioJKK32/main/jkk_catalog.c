@@ -0,0 +1,179 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Read-only station catalog in flash partition (memory mapped)
+*/
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include "jkk_catalog.h"
+
+static const char *TAG = "JKK_CATALOG";
+
+typedef struct JkkCatalog_s {
+    const uint8_t *base;
+    esp_partition_mmap_handle_t mmapHandle;
+    const uint8_t *recs;
+    const uint8_t *index;
+    const char *strs;
+    uint32_t strSize;
+    int count;
+} JkkCatalog_t;
+
+static JkkCatalog_t catalog = {0};
+
+static uint32_t JkkCatalogU32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t JkkCatalogU16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint8_t JkkCatalogFold(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static const char *JkkCatalogStr(uint32_t off) {
+    return off < catalog.strSize ? catalog.strs + off : "";
+}
+
+static const char *JkkCatalogSortName(int id) {
+    const uint8_t *rec = catalog.recs + id * JKK_CATALOG_REC_SIZE;
+    const char *name = JkkCatalogStr(JkkCatalogU32(rec + 8));
+    return name[0] ? name : JkkCatalogStr(JkkCatalogU32(rec + 4));
+}
+
+/* <0, 0, >0 like strcmp, 0 also when name starts with prefix */
+static int JkkCatalogCmpPrefix(const char *name, const char *prefix) {
+    for (; *prefix; name++, prefix++) {
+        int d = JkkCatalogFold(*name) - JkkCatalogFold(*prefix);
+        if (d) return d;
+    }
+    return 0;
+}
+
+static esp_err_t JkkCatalogCheck(const uint8_t *base, size_t size) {
+    if (size < JKK_CATALOG_HEADER_SIZE || memcmp(base, JKK_CATALOG_MAGIC, 4)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (JkkCatalogU16(base + 4) != JKK_CATALOG_VERSION || JkkCatalogU16(base + 6) != JKK_CATALOG_REC_SIZE) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    uint32_t count = JkkCatalogU32(base + 8);
+    uint32_t recOff = JkkCatalogU32(base + 12);
+    uint32_t indexOff = JkkCatalogU32(base + 16);
+    uint32_t strOff = JkkCatalogU32(base + 20);
+    uint32_t strSize = JkkCatalogU32(base + 24);
+    if (count > JKK_CATALOG_MAX_COUNT
+        || recOff < JKK_CATALOG_HEADER_SIZE || recOff + count * JKK_CATALOG_REC_SIZE > size
+        || indexOff < JKK_CATALOG_HEADER_SIZE || indexOff + count * 2 > size
+        || strOff < JKK_CATALOG_HEADER_SIZE || strSize == 0 || strOff + strSize > size
+        || base[strOff + strSize - 1] != '\0') {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t end = strOff + strSize;
+    if (recOff + count * JKK_CATALOG_REC_SIZE > end) end = recOff + count * JKK_CATALOG_REC_SIZE;
+    if (indexOff + count * 2 > end) end = indexOff + count * 2;
+    if (esp_rom_crc32_le(0, base + JKK_CATALOG_HEADER_SIZE, end - JKK_CATALOG_HEADER_SIZE) != JkkCatalogU32(base + 28)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (JkkCatalogU16(base + indexOff + i * 2) >= count) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t JkkCatalogInit(const char *partName) {
+    if (catalog.base) {
+        return ESP_OK;
+    }
+    int64_t t0 = esp_timer_get_time();
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, JKK_CATALOG_PARTITION_SUBTYPE, partName);
+    if (part == NULL) {
+        ESP_LOGW(TAG, "No catalog partition '%s'", partName);
+        return ESP_ERR_NOT_FOUND;
+    }
+    const void *ptr = NULL;
+    esp_partition_mmap_handle_t mmapHandle;
+    esp_err_t ret = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &ptr, &mmapHandle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error (%s) mapping partition '%s'", esp_err_to_name(ret), partName);
+        return ret;
+    }
+    const uint8_t *base = ptr;
+    ret = JkkCatalogCheck(base, part->size);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Partition '%s' has no valid catalog (%s)", partName, esp_err_to_name(ret));
+        esp_partition_munmap(mmapHandle);
+        return ret;
+    }
+    catalog.recs = base + JkkCatalogU32(base + 12);
+    catalog.index = base + JkkCatalogU32(base + 16);
+    catalog.strs = (const char *)base + JkkCatalogU32(base + 20);
+    catalog.strSize = JkkCatalogU32(base + 24);
+    catalog.count = JkkCatalogU32(base + 8);
+    catalog.mmapHandle = mmapHandle;
+    catalog.base = base;
+    ESP_LOGI(TAG, "Catalog: %d stations, %lu bytes, mapped and checked in %lld us",
+             catalog.count, (unsigned long)part->size, esp_timer_get_time() - t0);
+    return ESP_OK;
+}
+
+void JkkCatalogDeinit(void) {
+    if (catalog.base) {
+        esp_partition_munmap(catalog.mmapHandle);
+    }
+    memset(&catalog, 0, sizeof(catalog));
+}
+
+int JkkCatalogCount(void) {
+    return catalog.count;
+}
+
+esp_err_t JkkCatalogGet(int id, JkkCatalogEntry_t *entry) {
+    if (id < 0 || id >= catalog.count || entry == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint8_t *rec = catalog.recs + id * JKK_CATALOG_REC_SIZE;
+    entry->uri = JkkCatalogStr(JkkCatalogU32(rec));
+    entry->nameShort = JkkCatalogStr(JkkCatalogU32(rec + 4));
+    entry->nameLong = JkkCatalogStr(JkkCatalogU32(rec + 8));
+    entry->audioDes = JkkCatalogStr(JkkCatalogU32(rec + 12));
+    entry->type = rec[16];
+    entry->is_favorite = rec[17] & 0x01;
+    return ESP_OK;
+}
+
+int JkkCatalogSorted(int pos) {
+    if (pos < 0 || pos >= catalog.count) {
+        return -1;
+    }
+    return JkkCatalogU16(catalog.index + pos * 2);
+}
+
+int JkkCatalogFind(const char *prefix, int *first) {
+    if (prefix == NULL) prefix = "";
+    // Lower bound: first name not below prefix
+    int lo = 0, hi = catalog.count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (JkkCatalogCmpPrefix(JkkCatalogSortName(JkkCatalogSorted(mid)), prefix) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    int start = lo;
+    // Upper bound: first name above prefix (not starting with it)
+    hi = catalog.count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (JkkCatalogCmpPrefix(JkkCatalogSortName(JkkCatalogSorted(mid)), prefix) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    if (first) *first = start;
+    return lo - start;
+}
@@ -0,0 +1,85 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Read-only station catalog in flash partition (memory mapped)
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*  Catalog image is built on host by tools/jkk_catalog.py from CSV in stations.txt format.
+    All numbers little endian. Header (32 bytes):
+    magic "JKKC", version (u16), record size (u16), count (u32), records offset, index offset,
+    strings offset, strings size (u32), CRC32 of everything after header (u32).
+    Record (JKK_CATALOG_REC_SIZE bytes): offsets of uri, nameShort, nameLong, audioDes in strings (u32 each,
+    texts end with '\0'), type (u8), flags (u8, bit 0 favorite), reserved (u16).
+    Index: record numbers (u16) sorted by long name (short name if long is empty), ASCII letters compared
+    without case, other bytes as they are. Nothing is copied to RAM, texts point into mapped flash. */
+
+#define JKK_CATALOG_MAGIC "JKKC"
+#define JKK_CATALOG_VERSION (1)
+#define JKK_CATALOG_HEADER_SIZE (32)
+#define JKK_CATALOG_REC_SIZE (20)
+#define JKK_CATALOG_MAX_COUNT (UINT16_MAX)
+#define JKK_CATALOG_PARTITION_SUBTYPE (0x40)
+
+typedef struct JkkCatalogEntry_s {
+    const char *uri;
+    const char *nameShort;
+    const char *nameLong;
+    const char *audioDes;
+    uint8_t type;
+    bool is_favorite;
+} JkkCatalogEntry_t;
+
+/**
+ * @brief Map catalog partition and check its header and CRC
+ * @param partName Partition label
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is no partition, ESP_ERR_INVALID_VERSION or
+ *         ESP_ERR_INVALID_CRC if partition does not hold a valid catalog
+ */
+esp_err_t JkkCatalogInit(const char *partName);
+
+/**
+ * @brief Unmap catalog, entries taken before must not be used after
+ */
+void JkkCatalogDeinit(void);
+
+/**
+ * @brief Get number of stations in catalog
+ * @return Station count, 0 if catalog is not mapped
+ */
+int JkkCatalogCount(void);
+
+/**
+ * @brief Get catalog station (texts point into flash)
+ * @param id Record number
+ * @param entry Output entry
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for wrong id
+ */
+esp_err_t JkkCatalogGet(int id, JkkCatalogEntry_t *entry);
+
+/**
+ * @brief Get record number at position in name order
+ * @param pos Position in sorted index
+ * @return Record number, -1 for wrong position
+ */
+int JkkCatalogSorted(int pos);
+
+/**
+ * @brief Find stations whose name starts with prefix (binary search in sorted index)
+ * @param prefix Name prefix, ASCII letters without case ("" - all stations)
+ * @param first Output position of first match in sorted index
+ * @return Number of matches (they follow each other in sorted index)
+ */
+int JkkCatalogFind(const char *prefix, int *first);
+
+#ifdef __cplusplus
+}
+#endif
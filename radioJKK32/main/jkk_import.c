@@ -0,0 +1,620 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Streaming import of large station lists from SD card
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "audio_common.h"
+
+#include "jkk_radio.h"
+#include "jkk_station_store.h"
+#include "jkk_mqtt.h"
+#include "jkk_import.h"
+
+static const char *TAG = "JKK_IMPORT";
+
+#define JKK_IMPORT_SEEN_SIZE (1024) // Hash set of URIs on the list, power of 2
+#define JKK_IMPORT_VALUE_MAX (JKK_RADIO_STATION_URI_LEN + 64) // Longer JSON values are cut (URI too long anyway)
+
+_Static_assert(JKK_IMPORT_SEEN_SIZE >= 2 * JKK_RADIO_MAX_STATIONS, "URI set too small");
+
+typedef struct JkkImportRec_s {
+    char uri[JKK_IMPORT_VALUE_MAX];
+    char nameShort[32];
+    char nameLong[JKK_RADIO_STATION_NAME_LEN];
+    char audioDes[16];
+    char codec[16];
+    char tags[96];
+    int bitrate;
+    int type; // -1 - from tags
+    bool is_favorite;
+} JkkImportRec_t;
+
+typedef struct JkkImportCtx_s {
+    FILE *fptr;
+    char readBuf[JKK_IMPORT_BUF_SIZE];
+    char line[JKK_IMPORT_LINE_MAX];
+    char value[JKK_IMPORT_VALUE_MAX];
+    JkkImportRec_t rec;
+    JkkRadioStations_t batch[JKK_IMPORT_BATCH];
+    int batchCount;
+    uint32_t seen[JKK_IMPORT_SEEN_SIZE]; // 0 - empty slot
+    int room; // Stations that can still be added
+    int64_t lastReport;
+    esp_err_t stepRet;
+} JkkImportCtx_t;
+
+typedef enum {
+    JKK_IMPORT_STEP_START = 0, // Take URIs on the list and room left
+    JKK_IMPORT_STEP_BATCH,
+    JKK_IMPORT_STEP_LAST, // Last batch (may be empty)
+} JkkImportStep_e;
+
+static JkkImportProgress_t progress = {0};
+static SemaphoreHandle_t progressLock = NULL;
+static SemaphoreHandle_t stepDone = NULL; // Given by main task after step
+static JkkImportCtx_t *stepCtx = NULL; // Import waiting for main task
+static char importPath[64] = {0};
+
+static void JkkImportSetProgress(const JkkImportProgress_t *p) {
+    xSemaphoreTake(progressLock, portMAX_DELAY);
+    progress = *p;
+    xSemaphoreGive(progressLock);
+}
+
+void JkkImportGetProgress(JkkImportProgress_t *p) {
+    if (progressLock == NULL) {
+        memset(p, 0, sizeof(JkkImportProgress_t));
+        return;
+    }
+    xSemaphoreTake(progressLock, portMAX_DELAY);
+    *p = progress;
+    xSemaphoreGive(progressLock);
+}
+
+int JkkImportProgressJson(char *buf, size_t len) {
+    static const char *stateName[] = {"idle", "running", "done", "failed"};
+    JkkImportProgress_t p;
+    JkkImportGetProgress(&p);
+    int percent = p.bytesTotal ? (int)((uint64_t)p.bytesRead * 100 / p.bytesTotal) : 0;
+    return snprintf(buf, len, "{\"state\":\"%s\",\"percent\":%d,\"records\":%d,\"added\":%d,\"duplicates\":%d,\"invalid\":%d,\"full\":%s}",
+                    stateName[p.state], percent, p.records, p.added, p.duplicates, p.invalid, p.full ? "true" : "false");
+}
+
+static void JkkImportReport(JkkImportCtx_t *ctx, JkkImportProgress_t *p, bool force) {
+    long pos = ftell(ctx->fptr);
+    if (pos >= 0) p->bytesRead = pos;
+    JkkImportSetProgress(p);
+    int64_t now = esp_timer_get_time();
+    if (force || now - ctx->lastReport >= JKK_IMPORT_REPORT_MS * 1000LL) {
+        char json[160];
+        JkkImportProgressJson(json, sizeof(json));
+        JkkMqttPublishImport(json);
+        ctx->lastReport = now;
+    }
+}
+
+/* false if hash was already there */
+static bool JkkImportSeenAdd(uint32_t *seen, uint32_t hash) {
+    if (hash == 0) hash = 1; // 0 marks empty slot
+    for (uint32_t slot = hash & (JKK_IMPORT_SEEN_SIZE - 1); ; slot = (slot + 1) & (JKK_IMPORT_SEEN_SIZE - 1)) {
+        if (seen[slot] == hash) return false;
+        if (seen[slot] == 0) {
+            seen[slot] = hash;
+            return true;
+        }
+    }
+}
+
+static inline char JkkImportLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+/* Control characters to spaces, spaces at both ends removed */
+static void JkkImportClean(char *txt) {
+    char *start = txt;
+    for (char *p = txt; *p; p++) {
+        if ((uint8_t)*p < 0x20) *p = ' ';
+    }
+    while (*start == ' ') start++;
+    size_t len = strlen(start);
+    while (len && start[len - 1] == ' ') len--;
+    memmove(txt, start, len);
+    txt[len] = '\0';
+}
+
+/* Copy at most size - 1 bytes, without half of UTF-8 character at the end */
+static void JkkImportCut(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (len >= size) {
+        len = size - 1;
+        while (len && ((uint8_t)src[len] & 0xC0) == 0x80) len--;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+/* Scheme and host in lower case. False if not http(s) or too long for station (cut URI would not work). */
+static bool JkkImportNormUri(char *uri) {
+    JkkImportClean(uri);
+    if (strncasecmp(uri, "http://", 7) && strncasecmp(uri, "https://", 8)) {
+        return false;
+    }
+    if (strlen(uri) >= JKK_RADIO_STATION_URI_LEN) {
+        return false;
+    }
+    char *host = strstr(uri, "://") + 3;
+    for (char *p = uri; *p && (p < host || *p != '/'); p++) {
+        *p = JkkImportLower(*p);
+    }
+    return host[0] != '\0' && host[0] != '/';
+}
+
+static int JkkImportType(const char *tags) {
+    static const struct {
+        const char *word;
+        int type;
+    } typeWords[] = {
+        {"news", JKK_RADIO_NEWS},
+        {"talk", JKK_RADIO_TALK},
+        {"sport", JKK_RADIO_SPORTS},
+        {"regional", JKK_RADIO_REGIONAL},
+        {"local", JKK_RADIO_REGIONAL},
+        {"international", JKK_RADIO_INTERNATIONAL},
+        {"world", JKK_RADIO_INTERNATIONAL},
+    };
+    char low[sizeof(((JkkImportRec_t *)0)->tags)];
+    size_t i = 0;
+    for (; tags[i] && i < sizeof(low) - 1; i++) low[i] = JkkImportLower(tags[i]);
+    low[i] = '\0';
+    for (size_t k = 0; k < sizeof(typeWords) / sizeof(typeWords[0]); k++) {
+        if (strstr(low, typeWords[k].word)) return typeWords[k].type;
+    }
+    return low[0] ? JKK_RADIO_MUSIC : JKK_RADIO_UNKNOWN;
+}
+
+/* Codec from codec field, or from URI extension. Returns name for audioDes, NULL if unknown. */
+static const char *JkkImportCodec(const char *codec, const char *uri, uint8_t *codecType) {
+    static const struct {
+        const char *key;
+        const char *name;
+        uint8_t type;
+    } codecs[] = {
+        {"mp3", "MP3", ESP_CODEC_TYPE_MP3},
+        {"mpeg", "MP3", ESP_CODEC_TYPE_MP3},
+        {"aac", "AAC", ESP_CODEC_TYPE_AAC},
+        {"m4a", "AAC", ESP_CODEC_TYPE_M4A},
+        {"ogg", "OGG", ESP_CODEC_TYPE_OGG},
+        {"vorbis", "OGG", ESP_CODEC_TYPE_OGG},
+        {"opus", "OPUS", ESP_CODEC_TYPE_OPUS},
+        {"flac", "FLAC", ESP_CODEC_TYPE_FLAC},
+    };
+    char key[16] = {0};
+    if (codec[0]) {
+        for (size_t i = 0; codec[i] && i < sizeof(key) - 1; i++) key[i] = JkkImportLower(codec[i]);
+    } else {
+        const char *slash = strrchr(uri, '/');
+        const char *dot = slash ? strrchr(slash, '.') : NULL;
+        if (dot == NULL) return NULL;
+        for (size_t i = 0; dot[i + 1] && dot[i + 1] != '?' && i < sizeof(key) - 1; i++) key[i] = JkkImportLower(dot[i + 1]);
+    }
+    for (size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+        if (strncmp(key, codecs[i].key, strlen(codecs[i].key)) == 0) {
+            *codecType = codecs[i].type;
+            return codecs[i].name;
+        }
+    }
+    return NULL;
+}
+
+void JkkImportStep(int step) {
+    JkkImportCtx_t *ctx = stepCtx;
+    if (ctx == NULL) {
+        return;
+    }
+    if (step == JKK_IMPORT_STEP_START) {
+        int count = JkkRadioGetStationCount();
+        for (int i = 0; i < count; i++) {
+            JkkImportSeenAdd(ctx->seen, JkkRadioGetStationUriHash(i));
+        }
+        ctx->room = JKK_RADIO_MAX_STATIONS - count;
+        if (ctx->room < 0) ctx->room = 0;
+        ctx->stepRet = ESP_OK;
+    } else {
+        ctx->stepRet = JkkRadioImportStations(ctx->batch, ctx->batchCount, step == JKK_IMPORT_STEP_LAST);
+    }
+    stepCtx = NULL;
+    xSemaphoreGive(stepDone);
+}
+
+/* Station list is read and changed on main task only, import task waits there */
+static esp_err_t JkkImportOnMain(JkkImportCtx_t *ctx, JkkImportStep_e step) {
+    stepCtx = ctx;
+    esp_err_t ret = JkkRadioSendMessageToMain(step, JKK_RADIO_CMD_IMPORT_STEP);
+    if (ret != ESP_OK) {
+        stepCtx = NULL;
+        return ret;
+    }
+    xSemaphoreTake(stepDone, portMAX_DELAY);
+    return ctx->stepRet;
+}
+
+static esp_err_t JkkImportFlush(JkkImportCtx_t *ctx, JkkImportProgress_t *p, bool last) {
+    esp_err_t ret = JkkImportOnMain(ctx, last ? JKK_IMPORT_STEP_LAST : JKK_IMPORT_STEP_BATCH);
+    if (ret == ESP_OK) {
+        p->added += ctx->batchCount;
+    } else {
+        for (int i = 0; i < ctx->batchCount; i++) free(ctx->batch[i].cold);
+    }
+    memset(ctx->batch, 0, sizeof(ctx->batch));
+    ctx->batchCount = 0;
+    return ret;
+}
+
+static esp_err_t JkkImportRecord(JkkImportCtx_t *ctx, JkkImportProgress_t *p) {
+    JkkImportRec_t *rec = &ctx->rec;
+    p->records++;
+    if (!JkkImportNormUri(rec->uri)) {
+        p->invalid++;
+        return ESP_OK;
+    }
+    if (!JkkImportSeenAdd(ctx->seen, JkkStationStoreHash(rec->uri, JKK_RADIO_STATION_URI_LEN - 1))) {
+        p->duplicates++;
+        return ESP_OK;
+    }
+    if (ctx->room == 0) {
+        p->full = true;
+        return ESP_ERR_NO_MEM;
+    }
+    JkkImportClean(rec->nameLong);
+    JkkImportClean(rec->nameShort);
+    JkkImportClean(rec->codec);
+    JkkImportClean(rec->audioDes);
+    JkkRadioStations_t *st = &ctx->batch[ctx->batchCount];
+    const char *host = strstr(rec->uri, "://") + 3;
+    const char *nameLong = rec->nameLong[0] ? rec->nameLong : (rec->nameShort[0] ? rec->nameShort : host);
+    JkkImportCut(st->nameShort, rec->nameShort[0] ? rec->nameShort : nameLong, sizeof(st->nameShort));
+    if (JkkStationStoreSetCold(st, rec->uri, nameLong) != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+    st->is_favorite = rec->is_favorite;
+    st->type = rec->type >= 0 ? rec->type : JkkImportType(rec->tags);
+    st->addFrom = JKK_RADIO_ADD_FROM_IMPORT;
+    const char *codecName = JkkImportCodec(rec->codec, rec->uri, &st->fmt.codec);
+    if (rec->audioDes[0]) {
+        JkkImportCut(st->audioDes, rec->audioDes, sizeof(st->audioDes));
+    } else if (codecName && rec->bitrate > 0) {
+        snprintf(st->audioDes, sizeof(st->audioDes), "%s %dk", codecName, rec->bitrate);
+    } else if (codecName) {
+        strcpy(st->audioDes, codecName);
+    }
+    ctx->room--;
+    if (++ctx->batchCount == JKK_IMPORT_BATCH) {
+        return JkkImportFlush(ctx, p, false);
+    }
+    return ESP_OK;
+}
+
+/* In place, fields in double quotes may hold separator, "" is a quote */
+static int JkkImportCsvSplit(char *line, char **fields, int max) {
+    char sep = strchr(line, ';') ? ';' : ',';
+    int n = 0;
+    char *p = line;
+    while (n < max) {
+        char *out = p;
+        fields[n++] = p;
+        if (*p == '"') {
+            p++;
+            while (*p) {
+                if (*p == '"' && p[1] == '"') {
+                    *out++ = '"';
+                    p += 2;
+                } else if (*p == '"') {
+                    p++;
+                    break;
+                } else {
+                    *out++ = *p++;
+                }
+            }
+        }
+        while (*p && *p != sep && *p != '\n' && *p != '\r') *out++ = *p++;
+        bool more = (*p == sep);
+        *out = '\0';
+        if (!more) break;
+        p++;
+    }
+    return n;
+}
+
+static esp_err_t JkkImportCsv(JkkImportCtx_t *ctx, JkkImportProgress_t *p) {
+    esp_err_t ret = ESP_OK;
+    while (ret == ESP_OK && fgets(ctx->line, sizeof(ctx->line), ctx->fptr)) {
+        size_t len = strlen(ctx->line);
+        if (len == sizeof(ctx->line) - 1 && ctx->line[len - 1] != '\n') {
+            int c;
+            while ((c = fgetc(ctx->fptr)) != EOF && c != '\n'); // Too long, rest of line skipped
+            p->records++;
+            p->invalid++;
+            continue;
+        }
+        if (ctx->line[0] == '#' || ctx->line[0] == '\n' || ctx->line[0] == '\r') continue;
+        char *f[6] = {0};
+        int n = JkkImportCsvSplit(ctx->line, f, 6);
+        JkkImportRec_t *rec = &ctx->rec;
+        memset(rec, 0, sizeof(JkkImportRec_t));
+        JkkImportCut(rec->uri, f[0], sizeof(rec->uri));
+        if (n > 1) JkkImportCut(rec->nameShort, f[1], sizeof(rec->nameShort));
+        if (n > 2) JkkImportCut(rec->nameLong, f[2], sizeof(rec->nameLong));
+        rec->is_favorite = n > 3 && strcmp(f[3], "1") == 0;
+        rec->type = (n > 4 && f[4][0] >= '0' && f[4][0] <= '9') ? atoi(f[4]) : -1;
+        if (rec->type > JKK_RADIO_OTHER) rec->type = JKK_RADIO_OTHER;
+        if (n > 5) JkkImportCut(rec->audioDes, f[5], sizeof(rec->audioDes));
+        ret = JkkImportRecord(ctx, p);
+        JkkImportReport(ctx, p, false);
+    }
+    return ret;
+}
+
+static void JkkImportUtf8(char *buf, size_t size, size_t *len, uint32_t cp) {
+    char tmp[4];
+    size_t n;
+    if (cp < 0x80) {
+        tmp[0] = cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        tmp[0] = 0xC0 | (cp >> 6);
+        tmp[1] = 0x80 | (cp & 0x3F);
+        n = 2;
+    } else if (cp < 0x10000) {
+        tmp[0] = 0xE0 | (cp >> 12);
+        tmp[1] = 0x80 | ((cp >> 6) & 0x3F);
+        tmp[2] = 0x80 | (cp & 0x3F);
+        n = 3;
+    } else {
+        tmp[0] = 0xF0 | (cp >> 18);
+        tmp[1] = 0x80 | ((cp >> 12) & 0x3F);
+        tmp[2] = 0x80 | ((cp >> 6) & 0x3F);
+        tmp[3] = 0x80 | (cp & 0x3F);
+        n = 4;
+    }
+    if (*len + n < size) {
+        memcpy(buf + *len, tmp, n);
+        *len += n;
+    }
+}
+
+static uint32_t JkkImportHex4(FILE *f) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = fgetc(f);
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= c - '0';
+        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+        else return 0xFFFD;
+    }
+    return v;
+}
+
+/* Next JSON token: one of {}[]:, , 's' string or 'l' literal (number, true, false, null) in buf, EOF at end */
+static int JkkImportJsonToken(FILE *f, char *buf, size_t size) {
+    int c;
+    do {
+        c = fgetc(f);
+    } while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+    if (c == EOF || strchr("{}[]:,", c)) {
+        return c;
+    }
+    size_t len = 0;
+    if (c != '"') {
+        while (c != EOF && !strchr("{}[]:, \t\r\n", c)) {
+            if (len < size - 1) buf[len++] = c;
+            c = fgetc(f);
+        }
+        if (c != EOF) ungetc(c, f);
+        buf[len] = '\0';
+        return 'l';
+    }
+    while ((c = fgetc(f)) != EOF && c != '"') {
+        if (c == '\\') {
+            c = fgetc(f);
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u': {
+                    uint32_t cp = JkkImportHex4(f);
+                    if (cp >= 0xD800 && cp < 0xDC00) {
+                        // Surrogate pair
+                        if (fgetc(f) == '\\' && fgetc(f) == 'u') {
+                            uint32_t lo = JkkImportHex4(f);
+                            cp = (lo >= 0xDC00 && lo < 0xE000) ? 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00) : 0xFFFD;
+                        } else {
+                            cp = 0xFFFD;
+                        }
+                    }
+                    JkkImportUtf8(buf, size, &len, cp);
+                    continue;
+                }
+                default: break; // '"', '\\', '/'
+            }
+        }
+        if (len < size - 1) buf[len++] = c;
+    }
+    buf[len] = '\0';
+    return 's';
+}
+
+static void JkkImportJsonMember(JkkImportRec_t *rec, const char *key, const char *value) {
+    if (!strcmp(key, "url_resolved") || (!rec->uri[0] && (!strcmp(key, "url") || !strcmp(key, "uri") || !strcmp(key, "stream")))) {
+        JkkImportCut(rec->uri, value, sizeof(rec->uri));
+    } else if (!strcmp(key, "name")) {
+        JkkImportCut(rec->nameLong, value, sizeof(rec->nameLong));
+    } else if (!strcmp(key, "nameShort")) {
+        JkkImportCut(rec->nameShort, value, sizeof(rec->nameShort));
+    } else if (!strcmp(key, "codec")) {
+        JkkImportCut(rec->codec, value, sizeof(rec->codec));
+    } else if (!strcmp(key, "bitrate")) {
+        rec->bitrate = atoi(value);
+    } else if (!strcmp(key, "tags") || !strcmp(key, "genre")) {
+        JkkImportCut(rec->tags, value, sizeof(rec->tags));
+    } else if (!strcmp(key, "favorite")) {
+        rec->is_favorite = !strcmp(value, "true") || !strcmp(value, "1");
+    }
+}
+
+/* Station is an object whose parent is an array ([{...}] or {"stations":[{...}]}), nested values are skipped */
+static esp_err_t JkkImportJson(JkkImportCtx_t *ctx, JkkImportProgress_t *p) {
+    esp_err_t ret = ESP_OK;
+    uint32_t arrays = 0; // Bit per depth: container is array
+    int depth = 0;
+    int recDepth = -1;
+    bool expectKey = false;
+    bool haveKey = false;
+    char key[24] = {0};
+    int tok;
+    while (ret == ESP_OK && (tok = JkkImportJsonToken(ctx->fptr, ctx->value, sizeof(ctx->value))) != EOF) {
+        switch (tok) {
+            case '{':
+            case '[':
+                if (tok == '{' && recDepth < 0 && depth > 0 && (arrays & (1u << depth))) {
+                    recDepth = depth + 1;
+                    memset(&ctx->rec, 0, sizeof(JkkImportRec_t));
+                    ctx->rec.type = -1;
+                }
+                depth++;
+                if (depth < 32) {
+                    if (tok == '[') arrays |= 1u << depth;
+                    else arrays &= ~(1u << depth);
+                }
+                expectKey = (tok == '{' && depth == recDepth);
+                haveKey = false;
+                break;
+            case '}':
+            case ']':
+                if (depth == recDepth) {
+                    recDepth = -1;
+                    ret = JkkImportRecord(ctx, p);
+                    JkkImportReport(ctx, p, false);
+                }
+                if (depth > 0) depth--;
+                haveKey = false;
+                break;
+            case ',':
+                expectKey = (depth == recDepth);
+                haveKey = false;
+                break;
+            case ':':
+                break;
+            default: // 's' or 'l'
+                if (depth != recDepth) break;
+                if (expectKey && tok == 's') {
+                    JkkImportCut(key, ctx->value, sizeof(key));
+                    expectKey = false;
+                    haveKey = true;
+                } else if (haveKey) {
+                    JkkImportJsonMember(&ctx->rec, key, ctx->value);
+                    haveKey = false;
+                }
+                break;
+        }
+    }
+    return ret;
+}
+
+static void JkkImportTask(void *arg) {
+    JkkImportCtx_t *ctx = arg;
+    JkkImportProgress_t p;
+    JkkImportGetProgress(&p); // Set to running with file size by JkkImportStart
+    int64_t t0 = esp_timer_get_time();
+
+    esp_err_t ret = JkkImportOnMain(ctx, JKK_IMPORT_STEP_START);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Main task not reached (%s)", esp_err_to_name(ret));
+        p.state = JKK_IMPORT_FAILED;
+        JkkImportReport(ctx, &p, true);
+        fclose(ctx->fptr);
+        free(ctx);
+        vTaskDelete(NULL);
+        return;
+    }
+    setvbuf(ctx->fptr, ctx->readBuf, _IOFBF, sizeof(ctx->readBuf));
+
+    int c;
+    do {
+        c = fgetc(ctx->fptr);
+    } while (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == 0xEF || c == 0xBB || c == 0xBF); // Also UTF-8 BOM
+    if (c != EOF) ungetc(c, ctx->fptr);
+    bool json = (c == '[' || c == '{');
+
+    ret = json ? JkkImportJson(ctx, &p) : JkkImportCsv(ctx, &p);
+    if (ret == ESP_ERR_NO_MEM && p.full) {
+        ESP_LOGW(TAG, "Station list is full (%d), rest of %s skipped", JKK_RADIO_MAX_STATIONS, importPath);
+        ret = ESP_OK;
+    }
+    esp_err_t flushRet = JkkImportFlush(ctx, &p, true); // Also when nothing is left in batch
+    if (ret == ESP_OK) ret = flushRet;
+    p.state = (ret == ESP_OK) ? JKK_IMPORT_DONE : JKK_IMPORT_FAILED;
+    JkkImportReport(ctx, &p, true);
+    fclose(ctx->fptr);
+
+    ESP_LOGI(TAG, "Imported %s (%s) in %lld ms: %d records, %d added, %d duplicates, %d invalid%s",
+             importPath, json ? "JSON" : "CSV", (esp_timer_get_time() - t0) / 1000,
+             p.records, p.added, p.duplicates, p.invalid, p.full ? ", list full" : "");
+    free(ctx);
+    vTaskDelete(NULL);
+}
+
+esp_err_t JkkImportStart(const char *fileName) {
+    if (progressLock == NULL) {
+        progressLock = xSemaphoreCreateMutex();
+        stepDone = xSemaphoreCreateBinary();
+    }
+    if (fileName == NULL || fileName[0] == '\0' || strchr(fileName, '/') || strstr(fileName, "..") ||
+        strlen(fileName) + sizeof("/sdcard/") > sizeof(importPath)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    JkkImportProgress_t p;
+    JkkImportGetProgress(&p);
+    if (p.state == JKK_IMPORT_RUNNING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    snprintf(importPath, sizeof(importPath), "/sdcard/%s", fileName);
+    struct stat st;
+    FILE *fptr = fopen(importPath, "r");
+    if (fptr == NULL) {
+        ESP_LOGE(TAG, "Can not open %s", importPath);
+        return ESP_ERR_NOT_FOUND;
+    }
+    JkkImportCtx_t *ctx = heap_caps_calloc(1, sizeof(JkkImportCtx_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ctx == NULL) {
+        fclose(fptr);
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->fptr = fptr;
+    memset(&p, 0, sizeof(p));
+    p.state = JKK_IMPORT_RUNNING;
+    p.bytesTotal = stat(importPath, &st) == 0 ? st.st_size : 0;
+    JkkImportSetProgress(&p);
+    // Internal RAM stack, file is read from SD card in this task
+    if (xTaskCreatePinnedToCore(JkkImportTask, "import", 4 * 1024, ctx, 3, NULL, 0) != pdPASS) {
+        fclose(fptr);
+        free(ctx);
+        p.state = JKK_IMPORT_FAILED;
+        JkkImportSetProgress(&p);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Import of %s (%lu bytes) started", importPath, (unsigned long)p.bytesTotal);
+    return ESP_OK;
+}
@@ -0,0 +1,81 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Streaming import of large station lists from SD card
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*  File is read through one JKK_IMPORT_BUF_SIZE buffer, record by record, it is never loaded whole.
+    CSV: stations.txt format (uri;nameShort;nameLong;favorite;type;audioDes), ',' accepted instead of ';',
+    fields may be in double quotes. Lines not starting with http:// or https:// (e.g. header) are skipped.
+    JSON: array of objects as exported by public directories (radio-browser), members used:
+    url_resolved or url/uri/stream, name, nameShort, codec, bitrate, tags/genre, favorite.
+    Texts are trimmed and cut to station fields (whole UTF-8 characters), scheme and host of URI are lower case.
+    Stations with URI already on the list (by hash) are skipped. Type comes from tags, codec from codec
+    field or URI extension. Stations are added in batches of JKK_IMPORT_BATCH, one NVS commit per batch.
+    Import task only reads the file: URIs already on the list are taken, and every batch is added, on main task
+    (JKK_RADIO_CMD_IMPORT_STEP), like all other changes of station list. Import task waits for each step. */
+
+#define JKK_IMPORT_BUF_SIZE (4096) // File read buffer
+#define JKK_IMPORT_BATCH (32) // Stations per NVS commit
+#define JKK_IMPORT_LINE_MAX (1024) // Longer CSV lines are skipped
+#define JKK_IMPORT_REPORT_MS (1000) // Progress published over MQTT not more often
+
+typedef enum {
+    JKK_IMPORT_IDLE = 0,
+    JKK_IMPORT_RUNNING,
+    JKK_IMPORT_DONE,
+    JKK_IMPORT_FAILED,
+} JkkImportState_e;
+
+typedef struct JkkImportProgress_s {
+    JkkImportState_e state;
+    uint32_t bytesRead;
+    uint32_t bytesTotal;
+    int records; // Lines (CSV) or objects (JSON) read
+    int added;
+    int duplicates;
+    int invalid;
+    bool full; // Station list reached JKK_RADIO_MAX_STATIONS, rest of file skipped
+} JkkImportProgress_t;
+
+/**
+ * @brief Start import of file from SD card in its own task
+ * @param fileName File name in /sdcard (no directories)
+ * @return ESP_OK when started, ESP_ERR_INVALID_STATE if import is running, ESP_ERR_INVALID_ARG for wrong name,
+ *         ESP_ERR_NOT_FOUND if file can not be opened
+ */
+esp_err_t JkkImportStart(const char *fileName);
+
+/**
+ * @brief Do step of import waiting for main task, called on JKK_RADIO_CMD_IMPORT_STEP
+ * @param step Step number from message
+ */
+void JkkImportStep(int step);
+
+/**
+ * @brief Get import progress
+ * @param progress Output copy of progress
+ */
+void JkkImportGetProgress(JkkImportProgress_t *progress);
+
+/**
+ * @brief Format progress as JSON (same text for web and MQTT)
+ * @param buf Output buffer
+ * @param len Size of buf
+ * @return Length as snprintf
+ */
+int JkkImportProgressJson(char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,217 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Zero-allocation JSON writer and tokenizer for web API
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "jkk_json.h"
+
+static void JkkJsonWRaw(JkkJsonW_t *w, const char *s, size_t n) {
+    if (w->pos < w->len - 1) {
+        size_t room = w->len - 1 - w->pos;
+        memcpy(w->buf + w->pos, s, n < room ? n : room);
+        w->buf[w->pos + (n < room ? n : room)] = '\0';
+    }
+    w->pos += n;
+}
+
+static void JkkJsonWChar(JkkJsonW_t *w, char c) {
+    JkkJsonWRaw(w, &c, 1);
+}
+
+static void JkkJsonWQuoted(JkkJsonW_t *w, const char *s) {
+    JkkJsonWChar(w, '"');
+    const char *run = s; // Chars not needing escape are copied in one go
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        JkkJsonWRaw(w, run, s - run);
+        char esc[8];
+        if (c == '"' || c == '\\') snprintf(esc, sizeof(esc), "\\%c", c);
+        else if (c == '\n') snprintf(esc, sizeof(esc), "\\n");
+        else snprintf(esc, sizeof(esc), "\\u%04x", c);
+        JkkJsonWRaw(w, esc, strlen(esc));
+        run = s + 1;
+    }
+    JkkJsonWRaw(w, run, s - run);
+    JkkJsonWChar(w, '"');
+}
+
+// Comma and "key": before value
+static void JkkJsonWKey(JkkJsonW_t *w, const char *key) {
+    if (w->comma) JkkJsonWChar(w, ',');
+    w->comma = true;
+    if (key) {
+        JkkJsonWQuoted(w, key);
+        JkkJsonWChar(w, ':');
+    }
+}
+
+void JkkJsonWInit(JkkJsonW_t *w, char *buf, size_t len) {
+    w->buf = buf;
+    w->len = len;
+    w->pos = 0;
+    w->comma = false;
+    if (len) buf[0] = '\0';
+}
+
+void JkkJsonWObj(JkkJsonW_t *w, const char *key) {
+    JkkJsonWKey(w, key);
+    JkkJsonWChar(w, '{');
+    w->comma = false;
+}
+
+void JkkJsonWObjEnd(JkkJsonW_t *w) {
+    JkkJsonWChar(w, '}');
+    w->comma = true;
+}
+
+void JkkJsonWArr(JkkJsonW_t *w, const char *key) {
+    JkkJsonWKey(w, key);
+    JkkJsonWChar(w, '[');
+    w->comma = false;
+}
+
+void JkkJsonWArrEnd(JkkJsonW_t *w) {
+    JkkJsonWChar(w, ']');
+    w->comma = true;
+}
+
+void JkkJsonWInt(JkkJsonW_t *w, const char *key, long value) {
+    char num[16];
+    int n = snprintf(num, sizeof(num), "%ld", value);
+    JkkJsonWKey(w, key);
+    JkkJsonWRaw(w, num, n);
+}
+
+void JkkJsonWBool(JkkJsonW_t *w, const char *key, bool value) {
+    JkkJsonWKey(w, key);
+    JkkJsonWRaw(w, value ? "true" : "false", value ? 4 : 5);
+}
+
+void JkkJsonWStr(JkkJsonW_t *w, const char *key, const char *value) {
+    JkkJsonWKey(w, key);
+    if (value) JkkJsonWQuoted(w, value);
+    else JkkJsonWRaw(w, "null", 4);
+}
+
+int JkkJsonWDone(JkkJsonW_t *w) {
+    return w->pos < w->len ? (int)w->pos : -1;
+}
+
+static int JkkJsonNew(JkkJsonTok_t *tok, int *n, int max, JkkJsonType_t type, size_t start) {
+    if (*n >= max || start > UINT16_MAX) return -1;
+    JkkJsonTok_t *t = &tok[*n];
+    t->type = type;
+    t->start = start;
+    t->end = start;
+    t->size = 0;
+    return (*n)++;
+}
+
+// What may come next in open object or array
+enum {
+    JKK_JSON_S_KEY, // Member name (or close of empty object)
+    JKK_JSON_S_COLON,
+    JKK_JSON_S_VALUE, // Member value or element (or close of empty array)
+    JKK_JSON_S_NEXT, // Comma or close
+};
+
+int JkkJsonParse(const char *js, size_t len, JkkJsonTok_t *tok, int max) {
+    int n = 0;
+    int stack[JKK_JSON_DEPTH]; // Open objects and arrays
+    uint8_t state[JKK_JSON_DEPTH];
+    int depth = 0;
+    bool done = false; // Top level value complete
+    if (len > UINT16_MAX) return -1;
+    for (size_t i = 0; i < len; i++) {
+        char c = js[i];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+        if (done) return -1; // Text after top level value
+        JkkJsonTok_t *parent = depth ? &tok[stack[depth - 1]] : NULL;
+        uint8_t *st = depth ? &state[depth - 1] : NULL;
+        if (c == ',') {
+            if (!st || *st != JKK_JSON_S_NEXT) return -1;
+            *st = parent->type == JKK_JSON_OBJ ? JKK_JSON_S_KEY : JKK_JSON_S_VALUE;
+            continue;
+        }
+        if (c == ':') {
+            if (!st || *st != JKK_JSON_S_COLON) return -1;
+            *st = JKK_JSON_S_VALUE;
+            continue;
+        }
+        if (c == '}' || c == ']') {
+            uint8_t type = c == '}' ? JKK_JSON_OBJ : JKK_JSON_ARR;
+            if (!parent || parent->type != type) return -1;
+            if (*st != JKK_JSON_S_NEXT && !(parent->size == 0 && *st == (type == JKK_JSON_OBJ ? JKK_JSON_S_KEY : JKK_JSON_S_VALUE))) return -1;
+            parent->end = i + 1;
+            if (--depth == 0) done = true;
+            else state[depth - 1] = JKK_JSON_S_NEXT;
+            continue;
+        }
+        bool isKey = st && *st == JKK_JSON_S_KEY;
+        if (st && !isKey && *st != JKK_JSON_S_VALUE) return -1;
+        if (isKey && c != '"') return -1;
+        if (parent && (isKey || parent->type == JKK_JSON_ARR)) parent->size++;
+        if (c == '{' || c == '[') {
+            if (depth >= JKK_JSON_DEPTH) return -1;
+            int t = JkkJsonNew(tok, &n, max, c == '{' ? JKK_JSON_OBJ : JKK_JSON_ARR, i);
+            if (t < 0) return -1;
+            state[depth] = c == '{' ? JKK_JSON_S_KEY : JKK_JSON_S_VALUE;
+            stack[depth++] = t;
+            continue;
+        }
+        if (c == '"') {
+            int t = JkkJsonNew(tok, &n, max, JKK_JSON_STR, i + 1);
+            if (t < 0) return -1;
+            for (i++; i < len && js[i] != '"'; i++) {
+                if (js[i] == '\\') i++;
+            }
+            if (i >= len) return -1;
+            tok[t].end = i;
+        } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+            int t = JkkJsonNew(tok, &n, max, JKK_JSON_PRIM, i);
+            if (t < 0) return -1;
+            while (i + 1 < len && strchr(" \t\r\n,:]}", js[i + 1]) == NULL) i++;
+            tok[t].end = i + 1;
+        } else {
+            return -1;
+        }
+        if (!st) done = true;
+        else *st = isKey ? JKK_JSON_S_COLON : JKK_JSON_S_NEXT;
+    }
+    return done ? n : -1;
+}
+
+int JkkJsonSkip(const JkkJsonTok_t *tok, int count, int i) {
+    int j = i + 1;
+    while (j < count && tok[j].start < tok[i].end) j++; // Members and elements lie inside parent
+    return j;
+}
+
+bool JkkJsonStrEq(const char *js, const JkkJsonTok_t *t, const char *s) {
+    size_t n = strlen(s);
+    return (t->type == JKK_JSON_STR || t->type == JKK_JSON_PRIM) && (size_t)(t->end - t->start) == n
+        && memcmp(js + t->start, s, n) == 0;
+}
+
+bool JkkJsonInt(const char *js, const JkkJsonTok_t *t, int *out) {
+    if (t->type != JKK_JSON_PRIM) return false;
+    if (JkkJsonStrEq(js, t, "true") || JkkJsonStrEq(js, t, "false")) {
+        *out = js[t->start] == 't';
+        return true;
+    }
+    char num[12];
+    size_t n = t->end - t->start;
+    if (n == 0 || n >= sizeof(num)) return false;
+    memcpy(num, js + t->start, n);
+    num[n] = '\0';
+    char *end;
+    long v = strtol(num, &end, 10);
+    if (*end != '\0') return false;
+    *out = (int)v;
+    return true;
+}
@@ -0,0 +1,129 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Zero-allocation JSON writer and tokenizer for web API
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*  Writer appends to caller's buffer (on stack), output longer than buffer is cut and JkkJsonWDone returns -1.
+    Tokenizer splits text into caller's token array (like jsmn), nothing is copied: tokens are offsets into
+    the text. Object size is number of members (key token followed by value subtree), array size is number
+    of elements. Strings are not unescaped, JkkJsonStrEq compares raw text. */
+
+#define JKK_JSON_DEPTH (8) // Nesting of objects and arrays
+
+typedef struct JkkJsonW_s {
+    char *buf;
+    size_t len;
+    size_t pos; // Bytes written, buffer is full when pos >= len - 1
+    bool comma; // Next member or element needs comma
+} JkkJsonW_t;
+
+typedef enum {
+    JKK_JSON_OBJ = 1,
+    JKK_JSON_ARR,
+    JKK_JSON_STR,
+    JKK_JSON_PRIM, // Number, true, false, null
+} JkkJsonType_t;
+
+typedef struct JkkJsonTok_s {
+    uint8_t type;  // JkkJsonType_t
+    uint16_t start; // Offset of first char (string: after quote)
+    uint16_t end;   // Offset after last char (string: of closing quote)
+    uint16_t size;  // Members or elements
+} JkkJsonTok_t;
+
+/**
+ * @brief Start writing to buffer
+ * @param w Writer
+ * @param buf Output buffer, always terminated
+ * @param len Size of buf
+ */
+void JkkJsonWInit(JkkJsonW_t *w, char *buf, size_t len);
+
+/**
+ * @brief Open object
+ * @param key Member name in parent object, NULL - top level or array element
+ */
+void JkkJsonWObj(JkkJsonW_t *w, const char *key);
+
+/**
+ * @brief Close object
+ */
+void JkkJsonWObjEnd(JkkJsonW_t *w);
+
+/**
+ * @brief Open array
+ * @param key Member name in parent object, NULL - top level or array element
+ */
+void JkkJsonWArr(JkkJsonW_t *w, const char *key);
+
+/**
+ * @brief Close array
+ */
+void JkkJsonWArrEnd(JkkJsonW_t *w);
+
+/**
+ * @brief Write integer
+ * @param key Member name, NULL in array
+ */
+void JkkJsonWInt(JkkJsonW_t *w, const char *key, long value);
+
+/**
+ * @brief Write true or false
+ * @param key Member name, NULL in array
+ */
+void JkkJsonWBool(JkkJsonW_t *w, const char *key, bool value);
+
+/**
+ * @brief Write string, quotes, backslash and control chars escaped
+ * @param key Member name, NULL in array
+ * @param value Text, NULL writes null
+ */
+void JkkJsonWStr(JkkJsonW_t *w, const char *key, const char *value);
+
+/**
+ * @brief Finish writing
+ * @return Length of output, -1 if it was cut
+ */
+int JkkJsonWDone(JkkJsonW_t *w);
+
+/**
+ * @brief Split JSON text into tokens
+ * @param js Text (need not be terminated)
+ * @param len Length of js
+ * @param tok Token array, tok[0] is top level value
+ * @param max Size of tok
+ * @return Number of tokens, -1 for invalid text or too many tokens
+ */
+int JkkJsonParse(const char *js, size_t len, JkkJsonTok_t *tok, int max);
+
+/**
+ * @brief Index of token after value at i with all its members or elements
+ */
+int JkkJsonSkip(const JkkJsonTok_t *tok, int count, int i);
+
+/**
+ * @brief Compare string or primitive token with text
+ * @return true if equal
+ */
+bool JkkJsonStrEq(const char *js, const JkkJsonTok_t *t, const char *s);
+
+/**
+ * @brief Read integer from primitive token (true - 1, false - 0)
+ * @param out Value
+ * @return true if token is integer or boolean
+ */
+bool JkkJsonInt(const char *js, const JkkJsonTok_t *t, int *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -20,6 +20,7 @@
 #include "jkk_mqtt.h"
 #include "jkk_radio.h"
 #include "jkk_nvs.h"
+#include "jkk_snapshot.h"
 
 #ifdef CONFIG_JKK_RADIO_USING_I2C_LCD
 #include "display/jkk_lcd_port.h"
@@ -33,9 +34,6 @@ static const char *TAG = "JKK_MQTT";
 #define MQTT_UID_PREFIX      "rjkk_"
 #define MQTT_DEFAULT_PORT    1883
 
-// NVS
-#define MQTT_NVS_NAMESPACE   JKK_RADIO_NVS_NAMESPACE
-
 // mDNS broker instance names, in priority order (first match wins)
 static const char *mdns_broker_priority[] = {
     "LuBASE", "lupanel", "homeassistant"
@@ -58,6 +56,8 @@ static char s_topic_set[48]   = ""; // "rjkk/AABBCCDDEEFF/set"
 static char s_topic_avty[48]  = ""; // "rjkk/AABBCCDDEEFF/avty"
 static char s_topic_media_cmd[48] = ""; // "rjkk/AABBCCDDEEFF/media_cmd"
 static char s_topic_vol_cmd[48]   = ""; // "rjkk/AABBCCDDEEFF/vol_cmd"
+static char s_topic_import[48]    = ""; // "rjkk/AABBCCDDEEFF/import"
+static char s_topic_nvs[48]       = ""; // "rjkk/AABBCCDDEEFF/nvs"
 
 /* ── Forward declarations ────────────────────────────────── */
 
@@ -86,6 +86,8 @@ static void build_identifiers(void)
     snprintf(s_topic_avty,  sizeof(s_topic_avty),  "%s/%s/avty",  MQTT_TOPIC_PREFIX, s_mac_id);
     snprintf(s_topic_media_cmd, sizeof(s_topic_media_cmd), "%s/%s/media_cmd", MQTT_TOPIC_PREFIX, s_mac_id);
     snprintf(s_topic_vol_cmd,   sizeof(s_topic_vol_cmd),   "%s/%s/vol_cmd",   MQTT_TOPIC_PREFIX, s_mac_id);
+    snprintf(s_topic_import,    sizeof(s_topic_import),    "%s/%s/import",    MQTT_TOPIC_PREFIX, s_mac_id);
+    snprintf(s_topic_nvs,       sizeof(s_topic_nvs),       "%s/%s/nvs",       MQTT_TOPIC_PREFIX, s_mac_id);
 }
 
 /* ── mDNS broker discovery ───────────────────────────────── */
@@ -169,12 +171,8 @@ esp_err_t JkkMqttSetBrokerAddress(const char *address)
     } else {
         s_broker_addr[0] = '\0';
     }
-    /* Persist to NVS — call only from internal-RAM task (event handler) */
-    if (!address || strlen(address) == 0) {
-        return JkkNvsErase(JKK_MQTT_NVS_KEY_BROKER, MQTT_NVS_NAMESPACE);
-    }
-    return JkkNvsBlobSet(JKK_MQTT_NVS_KEY_BROKER, MQTT_NVS_NAMESPACE,
-                         address, strlen(address) + 1);
+    /* Persist in settings snapshot — call only from internal-RAM task (event handler) */
+    return JkkSnapshotSetMqtt(s_mqtt_enabled, s_broker_addr, s_mqtt_user, s_mqtt_pass);
 }
 
 esp_err_t JkkMqttGetBrokerAddress(char *address, size_t len)
@@ -202,18 +200,8 @@ esp_err_t JkkMqttSetCredentials(const char *user, const char *pass)
     else
         s_mqtt_pass[0] = '\0';
 
-    /* Persist to NVS */
-    if (s_mqtt_user[0])
-        JkkNvsBlobSet(JKK_MQTT_NVS_KEY_USER, MQTT_NVS_NAMESPACE, s_mqtt_user, strlen(s_mqtt_user) + 1);
-    else
-        JkkNvsErase(JKK_MQTT_NVS_KEY_USER, MQTT_NVS_NAMESPACE);
-
-    if (s_mqtt_pass[0])
-        JkkNvsBlobSet(JKK_MQTT_NVS_KEY_PASS, MQTT_NVS_NAMESPACE, s_mqtt_pass, strlen(s_mqtt_pass) + 1);
-    else
-        JkkNvsErase(JKK_MQTT_NVS_KEY_PASS, MQTT_NVS_NAMESPACE);
-
-    return ESP_OK;
+    /* Persist in settings snapshot */
+    return JkkSnapshotSetMqtt(s_mqtt_enabled, s_broker_addr, s_mqtt_user, s_mqtt_pass);
 }
 
 esp_err_t JkkMqttGetUsername(char *buf, size_t len)
@@ -281,8 +269,9 @@ static char *build_discovery_json(void)
         cJSON_AddStringToObject(st, "cmd_tpl", "{\"station_name\":{{ value | tojson }}}");
         cJSON *st_opts = cJSON_AddArrayToObject(st, "options");
         int st_count = JkkRadioGetStationCount();
+        char sname_buf[JKK_RADIO_STATION_NAME_LEN];
         for (int i = 0; i < st_count; i++) {
-            const char *sname = JkkRadioGetStationName(i);
+            const char *sname = JkkRadioGetStationName(i, sname_buf, sizeof(sname_buf));
             if (sname && strlen(sname) > 0) {
                 cJSON_AddItemToArray(st_opts, cJSON_CreateString(sname));
             }
@@ -412,8 +401,10 @@ static char *build_state_json(void)
     cJSON_AddNumberToObject(root, "vol", JkkRadioGetVolume());
     cJSON_AddNumberToObject(root, "station", JkkRadioGetStation());
 
-    const char *sname = JkkRadioGetStationName(JkkRadioGetStation());
+    char sname_buf[JKK_RADIO_STATION_NAME_LEN];
+    const char *sname = JkkRadioGetStationName(JkkRadioGetStation(), sname_buf, sizeof(sname_buf));
     cJSON_AddStringToObject(root, "station_name", sname ? sname : "");
+    cJSON_AddNumberToObject(root, "stalls", JkkRadioGetStationStalls(JkkRadioGetStation())); // Since boot
 
     cJSON_AddNumberToObject(root, "eq", JkkRadioGetEq());
 
@@ -485,14 +476,9 @@ static void mqtt_handle_command(const char *payload, int len)
     /* station_name: from select entity (lookup name → index) */
     cJSON *j_stn = cJSON_GetObjectItem(root, "station_name");
     if (j_stn && cJSON_IsString(j_stn)) {
-        const char *name = j_stn->valuestring;
-        int count = JkkRadioGetStationCount();
-        for (int i = 0; i < count; i++) {
-            const char *sname = JkkRadioGetStationName(i);
-            if (sname && strcmp(sname, name) == 0) {
-                JkkRadioSendMessageToMain(i, JKK_RADIO_CMD_SET_STATION);
-                break;
-            }
+        int i = JkkRadioFindStationByName(j_stn->valuestring);
+        if (i >= 0) {
+            JkkRadioSendMessageToMain(i, JKK_RADIO_CMD_SET_STATION);
         }
     }
 
@@ -706,6 +692,20 @@ void JkkMqttPublishState(void)
     free(json);
 }
 
+void JkkMqttPublishImport(const char *json)
+{
+    if (!s_mqtt_connected || !s_mqtt_client || !json) return;
+    esp_mqtt_client_publish(s_mqtt_client, s_topic_import, json, 0, 0, 1); // QoS 0, retain (last progress)
+}
+
+void JkkMqttPublishNvsStats(void)
+{
+    if (!s_mqtt_connected || !s_mqtt_client) return;
+    char json[200];
+    JkkNvsStatsJson(json, sizeof(json), false);
+    esp_mqtt_client_publish(s_mqtt_client, s_topic_nvs, json, 0, 0, 1); // QoS 0, retain (last save)
+}
+
 void JkkMqttPublishDiscovery(void)
 {
     if (!s_mqtt_connected || !s_mqtt_client) return;
@@ -718,9 +718,20 @@ void JkkMqttPublishDiscovery(void)
 esp_err_t JkkMqttSetEnabled(bool enabled)
 {
     s_mqtt_enabled = enabled;  /* Update RAM cache */
-    uint64_t val = enabled ? 1 : 0;
-    /* Persist to NVS — call only from internal-RAM task (event handler) */
-    return JkkNvs64_set(JKK_MQTT_NVS_KEY_ENABLED, MQTT_NVS_NAMESPACE, val);
+    /* Persist in settings snapshot — call only from internal-RAM task (event handler) */
+    return JkkSnapshotSetMqtt(s_mqtt_enabled, s_broker_addr, s_mqtt_user, s_mqtt_pass);
+}
+
+esp_err_t JkkMqttSaveConfig(bool enabled, const char *address, const char *user, const char *pass)
+{
+    /* Update RAM cache */
+    s_mqtt_enabled = enabled;
+    strlcpy(s_broker_addr, address ? address : "", sizeof(s_broker_addr));
+    strlcpy(s_mqtt_user, user ? user : "", sizeof(s_mqtt_user));
+    strlcpy(s_mqtt_pass, pass ? pass : "", sizeof(s_mqtt_pass));
+
+    /* Persist in settings snapshot — call only from internal-RAM task (event handler), one NVS write */
+    return JkkSnapshotSetMqtt(s_mqtt_enabled, s_broker_addr, s_mqtt_user, s_mqtt_pass);
 }
 
 bool JkkMqttIsEnabled(void)
@@ -731,35 +742,14 @@ bool JkkMqttIsEnabled(void)
 
 esp_err_t JkkMqttInit(void)
 {
-    /* Load NVS values into RAM cache (safe here — internal-RAM task stack) */
+    /* Load settings snapshot into RAM cache */
     {
-        uint64_t en = 1;
-        JkkNvs64_get(JKK_MQTT_NVS_KEY_ENABLED, MQTT_NVS_NAMESPACE, &en);
-        s_mqtt_enabled = (en != 0);
-
-        size_t rlen = sizeof(s_broker_addr);
-        if (JkkNvsBlobGet(JKK_MQTT_NVS_KEY_BROKER, MQTT_NVS_NAMESPACE,
-                          s_broker_addr, &rlen) == ESP_OK && rlen > 0) {
-            s_broker_addr[rlen - 1] = '\0';
-        } else {
-            s_broker_addr[0] = '\0';
-        }
-
-        /* Load credentials */
-        size_t ulen = sizeof(s_mqtt_user);
-        if (JkkNvsBlobGet(JKK_MQTT_NVS_KEY_USER, MQTT_NVS_NAMESPACE,
-                          s_mqtt_user, &ulen) == ESP_OK && ulen > 0) {
-            s_mqtt_user[ulen - 1] = '\0';
-        } else {
-            s_mqtt_user[0] = '\0';
-        }
-        size_t plen = sizeof(s_mqtt_pass);
-        if (JkkNvsBlobGet(JKK_MQTT_NVS_KEY_PASS, MQTT_NVS_NAMESPACE,
-                          s_mqtt_pass, &plen) == ESP_OK && plen > 0) {
-            s_mqtt_pass[plen - 1] = '\0';
-        } else {
-            s_mqtt_pass[0] = '\0';
-        }
+        JkkSnapshot_t snap;
+        JkkSnapshotGet(&snap);
+        s_mqtt_enabled = snap.mqttEnabled;
+        strlcpy(s_broker_addr, snap.mqttBroker, sizeof(s_broker_addr));
+        strlcpy(s_mqtt_user, snap.mqttUser, sizeof(s_mqtt_user));
+        strlcpy(s_mqtt_pass, snap.mqttPass, sizeof(s_mqtt_pass));
     }
 
     if (!s_mqtt_enabled) {
@@ -12,6 +12,7 @@ extern "C" {
 #include "esp_err.h"
 #include <stdbool.h>
 
+// Keys of older firmware, settings are kept in snapshot (jkk_snapshot) now
 #define JKK_MQTT_NVS_KEY_BROKER  "mqtt_broker"
 #define JKK_MQTT_NVS_KEY_ENABLED "mqtt_on"
 #define JKK_MQTT_NVS_KEY_USER    "mqtt_user"
@@ -53,6 +54,20 @@ void JkkMqttPublishState(void);
  */
 void JkkMqttPublishDiscovery(void);
 
+/**
+ * @brief Publish station import progress to rjkk/{id}/import (retained).
+ * Safe to call even if MQTT is not connected (will be silently ignored).
+ * @param json Progress JSON (JkkImportProgressJson)
+ */
+void JkkMqttPublishImport(const char *json);
+
+/**
+ * @brief Publish NVS write totals and flash lifetime estimate to rjkk/{id}/nvs (retained).
+ * Call from main task (JKK_RADIO_CMD_PUBLISH_NVS_STATS), publish may wait for MQTT client lock.
+ * Safe to call even if MQTT is not connected (will be silently ignored).
+ */
+void JkkMqttPublishNvsStats(void);
+
 /**
  * @brief Check if MQTT client is connected to broker.
  * @return true if connected
@@ -81,6 +96,13 @@ esp_err_t JkkMqttGetBrokerAddress(char *address, size_t len);
  */
 esp_err_t JkkMqttSetCredentials(const char *user, const char *pass);
 
+/**
+ * @brief Store whole MQTT configuration in NVS with one commit.
+ * Empty address, user or pass clears it.
+ * @return ESP_OK on success
+ */
+esp_err_t JkkMqttSaveConfig(bool enabled, const char *address, const char *user, const char *pass);
+
 /**
  * @brief Read MQTT username from RAM cache.
  */
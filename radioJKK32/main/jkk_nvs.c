@@ -13,7 +13,10 @@
 #include "stdio.h"
 #include "stdlib.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 
@@ -21,95 +24,254 @@
 
 static const char *TAG = "JKK_NVS";
 
-esp_err_t JkkNvsBlobSet(const char *key, const char *nameSpace, const void *value, size_t length){
-    nvs_handle nvsHandle;
-    esp_err_t ret = nvs_open(nameSpace, NVS_READWRITE, &nvsHandle);
+typedef struct JkkNvsCached_s {
+    char nameSpace[NVS_KEY_NAME_MAX_SIZE];
+    nvs_open_mode_t mode;
+    nvs_handle_t handle;
+} JkkNvsCached_t;
+
+static JkkNvsCached_t nvsCache[JKK_NVS_CACHED_HANDLES] = {0};
+static int nvsCacheCount = 0;
+static SemaphoreHandle_t nvsLock = NULL; // Handle cache and write counters
+
+static JkkNvsKeyStat_t nvsKeyStats[JKK_NVS_STAT_KEYS] = {0}; // Last one counts keys not fitting in the table
+static int nvsKeyStatCount = 0;
+static JkkNvsStats_t nvsTotals = {0};
+
+static void JkkNvsLock(void){
+    if (nvsLock == NULL) {
+        nvsLock = xSemaphoreCreateMutex(); // First call comes from boot, before other tasks use NVS
+    }
+    xSemaphoreTake(nvsLock, portMAX_DELAY);
+}
+
+static void JkkNvsUnlock(void){
+    xSemaphoreGive(nvsLock);
+}
+
+void JkkNvsAccount(const char *key, size_t length, uint32_t entries){
+    char name[sizeof(nvsKeyStats[0].key)];
+    strlcpy(name, key ? key : "*all", sizeof(name));
+    size_t n = strlen(name);
+    if (n > 1 && name[n - 1] >= '0' && name[n - 1] <= '9') {
+        while (n > 1 && name[n - 1] >= '0' && name[n - 1] <= '9') n--;
+        name[n] = '#'; // "stpk_12" and "stpk_3" are one counter "stpk_#"
+        name[n + 1] = '\0';
+    }
+    JkkNvsLock();
+    JkkNvsKeyStat_t *st = NULL;
+    for (int i = 0; i < nvsKeyStatCount; i++) {
+        if (strcmp(nvsKeyStats[i].key, name) == 0) {
+            st = &nvsKeyStats[i];
+            break;
+        }
+    }
+    if (st == NULL) {
+        if (nvsKeyStatCount < JKK_NVS_STAT_KEYS - 1) {
+            st = &nvsKeyStats[nvsKeyStatCount++];
+            strlcpy(st->key, name, sizeof(st->key));
+        } else {
+            st = &nvsKeyStats[JKK_NVS_STAT_KEYS - 1];
+            strlcpy(st->key, "*other", sizeof(st->key));
+        }
+    }
+    st->writes++;
+    st->bytes += length;
+    st->entries += entries;
+    nvsTotals.writes++;
+    nvsTotals.bytes += length;
+    nvsTotals.entries += entries;
+    JkkNvsUnlock();
+}
+
+void JkkNvsAccountCommit(void){
+    JkkNvsLock();
+    nvsTotals.commits++;
+    JkkNvsUnlock();
+}
+
+esp_err_t JkkNvsStatsGet(JkkNvsStats_t *stats){
+    JkkNvsLock();
+    *stats = nvsTotals;
+    JkkNvsUnlock();
+    stats->uptime = (uint32_t)(esp_timer_get_time() / 1000000);
+    stats->lifeYears = -1.0f;
+    nvs_stats_t nvsStats = {0};
+    esp_err_t ret = nvs_get_stats(NULL, &nvsStats);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!\n", esp_err_to_name(ret));
-        return ESP_ERR_NVS_INVALID_HANDLE;
-    } else {
-        ret = nvs_set_blob(nvsHandle, key, value, length);
-        ESP_LOGI(TAG, "Operation %s", (ret == ESP_OK) ? "Done" : "Failed");
-        if (ret != ESP_OK) {
-            goto exit;
+        return ret;
+    }
+    stats->usedEntries = nvsStats.used_entries;
+    stats->freeEntries = nvsStats.free_entries;
+    stats->totalEntries = nvsStats.total_entries;
+    if (stats->uptime >= JKK_NVS_LIFE_MIN_UPTIME_S && stats->entries > 0 && stats->totalEntries > 0) {
+        float freePart = (float)stats->freeEntries / stats->totalEntries; // Space reclaimed by one page erase
+        float entriesPerYear = (float)stats->entries * (365.0f * 24 * 3600) / stats->uptime;
+        float pages = (float)stats->totalEntries / JKK_NVS_PAGE_ENTRIES;
+        stats->lifeYears = pages * JKK_NVS_PAGE_CYCLES * JKK_NVS_PAGE_ENTRIES * freePart / entriesPerYear;
+    }
+    return ESP_OK;
+}
+
+uint32_t JkkNvsWriteCount(void){
+    return nvsTotals.writes; // 32 bit read, no lock
+}
+
+int JkkNvsStatsJson(char *buf, size_t len, bool keys){
+    JkkNvsStats_t st;
+    JkkNvsStatsGet(&st);
+    int n = snprintf(buf, len, "{\"writes\":%lu,\"bytes\":%lu,\"entries\":%lu,\"commits\":%lu,\"uptime\":%lu,"
+        "\"used\":%u,\"free\":%u,\"total\":%u,\"lifeYears\":%.0f",
+        (unsigned long)st.writes, (unsigned long)st.bytes, (unsigned long)st.entries, (unsigned long)st.commits, (unsigned long)st.uptime,
+        (unsigned)st.usedEntries, (unsigned)st.freeEntries, (unsigned)st.totalEntries, st.lifeYears < 0 ? -1.0f : st.lifeYears);
+    if (keys) {
+        bool first = true;
+        JkkNvsLock();
+        for (int i = 0; i < JKK_NVS_STAT_KEYS && n < (int)len; i++) {
+            if (nvsKeyStats[i].writes == 0) continue; // Free slots and unused "*other"
+            n += snprintf(buf + n, len - n, "%s{\"key\":\"%s\",\"writes\":%lu,\"bytes\":%lu,\"entries\":%lu}", first ? ",\"keys\":[" : ",",
+                nvsKeyStats[i].key, (unsigned long)nvsKeyStats[i].writes, (unsigned long)nvsKeyStats[i].bytes, (unsigned long)nvsKeyStats[i].entries);
+            first = false;
         }
-        ret = nvs_commit(nvsHandle);
-        ESP_LOGI(TAG, "Committing operation %s", (ret == ESP_OK) ? "Done" : "Failed");
+        JkkNvsUnlock();
+        if (!first && n < (int)len) n += snprintf(buf + n, len - n, "]");
     }
-exit:
-    nvs_close(nvsHandle);
-    return ret;
+    if (n < (int)len) n += snprintf(buf + n, len - n, "}");
+    return n < (int)len ? n : (int)len - 1;
 }
 
-esp_err_t JkkNvsBlobGet(const char *key, const char *nameSpace, void *value, size_t *length){
-    nvs_handle nvsHandle;
-    esp_err_t ret = nvs_open(nameSpace, NVS_READWRITE, &nvsHandle);
+esp_err_t JkkNvsOpen(const char *nameSpace, nvs_open_mode_t mode, nvs_handle_t *handle){
+    esp_err_t ret = ESP_OK;
+    JkkNvsLock();
+    for (int i = 0; i < nvsCacheCount; i++) {
+        if (nvsCache[i].mode == mode && strcmp(nvsCache[i].nameSpace, nameSpace) == 0) {
+            *handle = nvsCache[i].handle;
+            goto exit;
+        }
+    }
+    ret = nvs_open(nameSpace, mode, handle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!\n", esp_err_to_name(ret));
-        goto exit;
+        goto exit; // Read only open of namespace not written yet, tried again next time
+    }
+    if (nvsCacheCount < JKK_NVS_CACHED_HANDLES) {
+        strlcpy(nvsCache[nvsCacheCount].nameSpace, nameSpace, sizeof(nvsCache[nvsCacheCount].nameSpace));
+        nvsCache[nvsCacheCount].mode = mode;
+        nvsCache[nvsCacheCount].handle = *handle;
+        nvsCacheCount++;
     } else {
-        ESP_LOGI(TAG, "Read from NVS ... ");
-        size_t lenTmp = 0;
-        ret = nvs_get_blob(nvsHandle, key, NULL, &lenTmp);
-        if (length != NULL && *length > 0 && *length < lenTmp) {
-            ESP_LOGE(TAG, "Buffer too small: have %d, need %d", *length, lenTmp);
-            nvs_close(nvsHandle);
-            return ESP_ERR_NVS_INVALID_LENGTH;
-        }
-        ret = nvs_get_blob(nvsHandle, key, value, &lenTmp);
-        if (length != NULL) *length = lenTmp;
-        ESP_LOGI(TAG, "Operation %s", (ret == ESP_OK) ? "Done" : "Failed");
-        nvs_close(nvsHandle);
+        ESP_LOGW(TAG, "Handle cache full, %s not cached", nameSpace); // Leaks one handle, raise JKK_NVS_CACHED_HANDLES
     }
 exit:
+    JkkNvsUnlock();
     return ret;
 }
 
-esp_err_t JkkNvsErase(const char *key, const char *nameSpace){
-    nvs_handle nvsHandle = 0;
-    esp_err_t ret = nvs_open(nameSpace, NVS_READWRITE, &nvsHandle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!\n", esp_err_to_name(ret));
-        return ESP_ERR_NVS_INVALID_HANDLE;
+esp_err_t JkkNvsTxBegin(JkkNvsTx_t *tx, const char *nameSpace){
+    tx->ops = 0;
+    tx->err = JkkNvsOpen(nameSpace, NVS_READWRITE, &tx->handle);
+    if (tx->err != ESP_OK) {
+        ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!", esp_err_to_name(tx->err));
     }
-    if (!key) {
-        ret = nvs_erase_all(nvsHandle);
-    } else {
-        ret = nvs_erase_key(nvsHandle, key);
+    return tx->err;
+}
+
+esp_err_t JkkNvsTxBlobSet(JkkNvsTx_t *tx, const char *key, const void *value, size_t length){
+    if (tx->err != ESP_OK) {
+        return tx->err;
     }
-    nvs_commit(nvsHandle);
-    nvs_close(nvsHandle);
+    tx->err = nvs_set_blob(tx->handle, key, value, length);
+    tx->ops++;
+    JkkNvsAccount(key, length, JKK_NVS_BLOB_ENTRIES(length));
+    ESP_LOGD(TAG, "Set %s %s", key, (tx->err == ESP_OK) ? "Done" : "Failed");
+    return tx->err;
+}
 
+esp_err_t JkkNvsTx64Set(JkkNvsTx_t *tx, const char *key, uint64_t value){
+    if (tx->err != ESP_OK) {
+        return tx->err;
+    }
+    tx->err = nvs_set_u64(tx->handle, key, value);
+    tx->ops++;
+    JkkNvsAccount(key, sizeof(value), 1);
+    return tx->err;
+}
+
+esp_err_t JkkNvsTxErase(JkkNvsTx_t *tx, const char *key){
+    if (tx->err != ESP_OK) {
+        return tx->err;
+    }
+    esp_err_t ret = key ? nvs_erase_key(tx->handle, key) : nvs_erase_all(tx->handle);
+    tx->ops++;
+    if (ret == ESP_OK) JkkNvsAccount(key, 0, 0);
+    if (ret != ESP_ERR_NVS_NOT_FOUND) {
+        tx->err = ret;
+    }
     return ret;
 }
 
-esp_err_t JkkNvs64_set(const char *key, const char *nameSpace, uint64_t value){
-    esp_err_t ret = ESP_OK;
-    nvs_handle handle = 0;
+esp_err_t JkkNvsTxCommit(JkkNvsTx_t *tx){
+    if (tx->err == ESP_OK && tx->ops > 0) {
+        tx->err = nvs_commit(tx->handle);
+        JkkNvsAccountCommit();
+        ESP_LOGD(TAG, "Committing %u operations %s", tx->ops, (tx->err == ESP_OK) ? "Done" : "Failed");
+    }
+    tx->ops = 0;
+    return tx->err;
+}
 
-    ret = nvs_open(nameSpace, NVS_READWRITE, &handle);
+esp_err_t JkkNvsBlobSet(const char *key, const char *nameSpace, const void *value, size_t length){
+    JkkNvsTx_t tx;
+    if (JkkNvsTxBegin(&tx, nameSpace) != ESP_OK) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    JkkNvsTxBlobSet(&tx, key, value, length);
+    return JkkNvsTxCommit(&tx);
+}
+
+esp_err_t JkkNvsBlobGet(const char *key, const char *nameSpace, void *value, size_t *length){
+    nvs_handle_t nvsHandle;
+    esp_err_t ret = JkkNvsOpen(nameSpace, NVS_READONLY, &nvsHandle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!\n", esp_err_to_name(ret));
+        if (ret != ESP_ERR_NVS_NOT_FOUND) ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!\n", esp_err_to_name(ret)); // Not found: namespace not written yet
+        return ret;
+    }
+    size_t lenTmp = 0;
+    ret = nvs_get_blob(nvsHandle, key, NULL, &lenTmp);
+    if (length != NULL && *length > 0 && *length < lenTmp) {
+        ESP_LOGE(TAG, "Buffer too small: have %d, need %d", *length, lenTmp);
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    ret = nvs_get_blob(nvsHandle, key, value, &lenTmp);
+    if (length != NULL) *length = lenTmp;
+    ESP_LOGD(TAG, "Read %s %s", key, (ret == ESP_OK) ? "Done" : "Failed");
+    return ret;
+}
+
+esp_err_t JkkNvsErase(const char *key, const char *nameSpace){
+    JkkNvsTx_t tx;
+    if (JkkNvsTxBegin(&tx, nameSpace) != ESP_OK) {
         return ESP_ERR_NVS_INVALID_HANDLE;
     }
-    ret = nvs_set_u64(handle, key, value);
-    nvs_commit(handle);
-    nvs_close(handle);
+    esp_err_t ret = JkkNvsTxErase(&tx, key); // Not found is reported, there is nothing to commit then
+    esp_err_t commit = JkkNvsTxCommit(&tx);
+    return ret != ESP_OK ? ret : commit;
+}
 
-    return ESP_OK;
+esp_err_t JkkNvs64_set(const char *key, const char *nameSpace, uint64_t value){
+    JkkNvsTx_t tx;
+    if (JkkNvsTxBegin(&tx, nameSpace) != ESP_OK) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    JkkNvsTx64Set(&tx, key, value);
+    return JkkNvsTxCommit(&tx);
 }
 
 esp_err_t JkkNvs64_get(const char *key, const char *nameSpace, uint64_t *value){
-    esp_err_t ret = ESP_OK;
-    nvs_handle handle = 0;
-
-    ret = nvs_open(nameSpace, NVS_READWRITE, &handle);
+    nvs_handle_t handle = 0;
+    esp_err_t ret = JkkNvsOpen(nameSpace, NVS_READONLY, &handle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!\n", esp_err_to_name(ret));
+        if (ret != ESP_ERR_NVS_NOT_FOUND) ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!\n", esp_err_to_name(ret));
         return ESP_ERR_NVS_INVALID_HANDLE;
     }
-    ret = nvs_get_u64(handle, key, value);
-    nvs_close(handle);
-
-    return ret;
-}
\ No newline at end of file
+    return nvs_get_u64(handle, key, value);
+}
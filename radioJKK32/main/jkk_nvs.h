@@ -10,14 +10,142 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <esp_err.h>
 #include "esp_partition.h"
+#include "nvs.h"
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+#define JKK_NVS_CACHED_HANDLES (8) // Open handles kept for namespace and mode pairs
+#define JKK_NVS_STAT_KEYS (32) // Keys with own write counters, digits at the end of key are one counter ("stpk_#")
+#define JKK_NVS_PAGE_ENTRIES (126) // 32 byte entries in 4 KB NVS page
+#define JKK_NVS_PAGE_CYCLES (100000) // Flash sector erase cycles
+#define JKK_NVS_LIFE_MIN_UPTIME_S (3600) // Write rate of shorter uptime is mostly boot, no lifetime estimate
+#define JKK_NVS_BLOB_ENTRIES(len) (2 + ((len) + 31) / 32) // Blob index, data header and data entries
+
+/*  Handles are opened once per namespace and mode and kept open (reads use NVS_READONLY).
+    Transaction: begin, any number of set/erase, one commit. NVS writes each entry when it is set (there is
+    no rollback), commit makes the batch durable. After the first error following operations are skipped
+    and commit returns that error. */
+typedef struct JkkNvsTx_s {
+    nvs_handle_t handle;
+    esp_err_t err; // First error
+    uint16_t ops; // Sets and erases done
+} JkkNvsTx_t;
+
+/*  Write accounting since boot: every set and erase (also of station store, which writes with own handle) is
+    counted per key with bytes and NVS entries used. Written entries are later reclaimed by page erase, live
+    entries are copied first, so page erases grow with used part of NVS. Lifetime estimate:
+    pages * JKK_NVS_PAGE_CYCLES * JKK_NVS_PAGE_ENTRIES * free part / entries written per year. */
+typedef struct JkkNvsKeyStat_s {
+    char key[16];
+    uint32_t writes; // Sets and erases
+    uint32_t bytes;
+    uint32_t entries;
+} JkkNvsKeyStat_t;
+
+typedef struct JkkNvsStats_s {
+    uint32_t writes;
+    uint32_t bytes;
+    uint32_t entries;
+    uint32_t commits;
+    uint32_t uptime; // Seconds
+    size_t usedEntries; // nvs_get_stats of default partition
+    size_t freeEntries;
+    size_t totalEntries;
+    float lifeYears; // < 0 - not estimated yet
+} JkkNvsStats_t;
+
+/**
+ * @brief Count NVS write (called by set/erase functions here and by modules writing with own handle)
+ * @param key NVS key name
+ * @param length Bytes written (0 for erase)
+ * @param entries NVS entries used (JKK_NVS_BLOB_ENTRIES for blob, 1 for integer, 0 for erase)
+ */
+void JkkNvsAccount(const char *key, size_t length, uint32_t entries);
+
+/**
+ * @brief Count NVS commit
+ */
+void JkkNvsAccountCommit(void);
+
+/**
+ * @brief Get write totals, NVS usage and lifetime estimate
+ * @param stats Output
+ * @return ESP_OK on success, error of nvs_get_stats otherwise (totals are filled anyway)
+ */
+esp_err_t JkkNvsStatsGet(JkkNvsStats_t *stats);
+
+/**
+ * @brief Number of counted writes, cheap check if statistics changed (no NVS call)
+ * @return Sets and erases since boot
+ */
+uint32_t JkkNvsWriteCount(void);
+
+/**
+ * @brief Format write statistics as JSON
+ * @param buf Output buffer
+ * @param len Size of buf
+ * @param keys Add per key counters
+ * @return Length as snprintf (limited to len - 1)
+ */
+int JkkNvsStatsJson(char *buf, size_t len, bool keys);
+
+/**
+ * @brief Get cached NVS handle (do not close it)
+ * @param nameSpace NVS namespace
+ * @param mode NVS_READONLY or NVS_READWRITE
+ * @param handle Output handle
+ * @return ESP_OK on success, error of nvs_open otherwise
+ */
+esp_err_t JkkNvsOpen(const char *nameSpace, nvs_open_mode_t mode, nvs_handle_t *handle);
+
+/**
+ * @brief Begin transaction in namespace
+ * @param tx Transaction
+ * @param nameSpace NVS namespace
+ * @return ESP_OK on success
+ */
+esp_err_t JkkNvsTxBegin(JkkNvsTx_t *tx, const char *nameSpace);
+
+/**
+ * @brief Set binary data in transaction
+ * @param tx Transaction
+ * @param key NVS key name
+ * @param value Pointer to data to store
+ * @param length Size of data to store
+ * @return ESP_OK on success
+ */
+esp_err_t JkkNvsTxBlobSet(JkkNvsTx_t *tx, const char *key, const void *value, size_t length);
+
+/**
+ * @brief Set 64-bit unsigned integer value in transaction
+ * @param tx Transaction
+ * @param key NVS key name
+ * @param value 64-bit value to store
+ * @return ESP_OK on success
+ */
+esp_err_t JkkNvsTx64Set(JkkNvsTx_t *tx, const char *key, uint64_t value);
+
+/**
+ * @brief Erase key in transaction
+ * @param tx Transaction
+ * @param key NVS key name (NULL to erase entire namespace)
+ * @return ESP_OK on success, ESP_ERR_NVS_NOT_FOUND if there was no such key (not an error of transaction)
+ */
+esp_err_t JkkNvsTxErase(JkkNvsTx_t *tx, const char *key);
+
+/**
+ * @brief Commit transaction (one nvs_commit, nothing if there were no operations)
+ * @param tx Transaction
+ * @return ESP_OK on success, first error of transaction otherwise
+ */
+esp_err_t JkkNvsTxCommit(JkkNvsTx_t *tx);
+
 /**
  * @brief Get binary data from NVS
  * @param key NVS key name
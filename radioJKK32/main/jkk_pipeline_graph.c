@@ -0,0 +1,189 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Declarative description of pipeline elements and their order
+*/
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "jkk_pipeline_graph.h"
+
+static const char *TAG = "JKK_GRAPH";
+
+static int JkkGraphFind(const JkkGraph_t *graph, const char *tag) {
+    for (int i = 0; i < graph->count; i++) {
+        if (strcmp(graph->nodes[i].tag, tag) == 0) return i;
+    }
+    return -1;
+}
+
+static int JkkGraphTags(const JkkGraph_t *graph, const char **tags) {
+    int n = 0;
+    for (int i = 0; i < graph->count; i++) {
+        if (graph->nodes[i].enabled) tags[n++] = graph->nodes[i].tag;
+    }
+    return n;
+}
+
+static void JkkGraphLog(const JkkGraph_t *graph) {
+    char line[JKK_GRAPH_MAX_NODES * 12] = {0};
+    for (int i = 0; i < graph->count; i++) {
+        if (!graph->nodes[i].enabled) continue;
+        if (line[0]) strlcat(line, " -> ", sizeof(line));
+        strlcat(line, graph->nodes[i].tag, sizeof(line));
+    }
+    ESP_LOGI(TAG, "Link: %s", line);
+}
+
+esp_err_t JkkGraphInit(JkkGraph_t *graph, audio_pipeline_handle_t pipeline) {
+    if (graph == NULL || pipeline == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(graph, 0, sizeof(JkkGraph_t));
+    graph->pipeline = pipeline;
+    return ESP_OK;
+}
+
+esp_err_t JkkGraphAdd(JkkGraph_t *graph, const char *tag, audio_element_handle_t el, bool enabled) {
+    if (el == NULL) {
+        return ESP_OK; // Optional element not created
+    }
+    if (tag == NULL || graph->count >= JKK_GRAPH_MAX_NODES) {
+        ESP_LOGE(TAG, "Can not add '%s'", tag ? tag : "?");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (JkkGraphFind(graph, tag) >= 0) {
+        ESP_LOGE(TAG, "Tag '%s' already used", tag);
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = audio_pipeline_register(graph->pipeline, el, tag);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    graph->nodes[graph->count++] = (JkkGraphNode_t){ .tag = tag, .el = el, .enabled = enabled };
+    return ESP_OK;
+}
+
+esp_err_t JkkGraphInsertAfter(JkkGraph_t *graph, const char *afterTag, const char *tag, audio_element_handle_t el) {
+    int at = JkkGraphFind(graph, afterTag);
+    if (at < 0 || el == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t ret = JkkGraphAdd(graph, tag, el, true);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    JkkGraphNode_t node = graph->nodes[graph->count - 1];
+    memmove(&graph->nodes[at + 2], &graph->nodes[at + 1], (graph->count - at - 2) * sizeof(JkkGraphNode_t));
+    graph->nodes[at + 1] = node;
+    return ESP_OK;
+}
+
+audio_element_handle_t JkkGraphRemove(JkkGraph_t *graph, const char *tag) {
+    int at = JkkGraphFind(graph, tag);
+    if (at < 0) {
+        return NULL;
+    }
+    audio_element_handle_t el = graph->nodes[at].el;
+    audio_pipeline_unregister(graph->pipeline, el);
+    memmove(&graph->nodes[at], &graph->nodes[at + 1], (graph->count - at - 1) * sizeof(JkkGraphNode_t));
+    graph->count--;
+    return el;
+}
+
+audio_element_handle_t JkkGraphReplace(JkkGraph_t *graph, const char *tag, audio_element_handle_t el) {
+    int at = JkkGraphFind(graph, tag);
+    if (at < 0 || el == NULL) {
+        return NULL;
+    }
+    audio_element_handle_t old = graph->nodes[at].el;
+    audio_pipeline_unregister(graph->pipeline, old);
+    if (audio_pipeline_register(graph->pipeline, el, tag) != ESP_OK) {
+        audio_pipeline_register(graph->pipeline, old, tag);
+        return NULL;
+    }
+    graph->nodes[at].el = el;
+    return old;
+}
+
+esp_err_t JkkGraphSetEnabled(JkkGraph_t *graph, const char *tag, bool on) {
+    int at = JkkGraphFind(graph, tag);
+    if (at < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    graph->nodes[at].enabled = on;
+    return ESP_OK;
+}
+
+bool JkkGraphIsEnabled(const JkkGraph_t *graph, const char *tag) {
+    int at = JkkGraphFind(graph, tag);
+    return at >= 0 && graph->nodes[at].enabled;
+}
+
+esp_err_t JkkGraphValidate(const JkkGraph_t *graph) {
+    int enabled = 0;
+    for (int i = 0; i < graph->count; i++) {
+        if (graph->nodes[i].el == NULL || graph->nodes[i].tag == NULL) {
+            ESP_LOGE(TAG, "Empty node %d", i);
+            return ESP_ERR_INVALID_STATE;
+        }
+        for (int j = i + 1; j < graph->count; j++) {
+            if (strcmp(graph->nodes[i].tag, graph->nodes[j].tag) == 0) {
+                ESP_LOGE(TAG, "Tag '%s' used twice", graph->nodes[i].tag);
+                return ESP_ERR_INVALID_STATE;
+            }
+        }
+        if (graph->nodes[i].enabled) enabled++;
+    }
+    if (graph->count == 0 || !graph->nodes[0].enabled || !graph->nodes[graph->count - 1].enabled || enabled < 2) {
+        ESP_LOGE(TAG, "Source and sink have to be enabled");
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t JkkGraphLink(JkkGraph_t *graph) {
+    esp_err_t ret = JkkGraphValidate(graph);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    const char *tags[JKK_GRAPH_MAX_NODES];
+    int n = JkkGraphTags(graph, tags);
+    ret = audio_pipeline_link(graph->pipeline, tags, n);
+    graph->linked = (ret == ESP_OK);
+    JkkGraphLog(graph);
+    return ret;
+}
+
+esp_err_t JkkGraphRelink(JkkGraph_t *graph, audio_event_iface_handle_t evt) {
+    esp_err_t ret = JkkGraphValidate(graph);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    int64_t t0 = esp_timer_get_time();
+
+    ret = audio_pipeline_stop(graph->pipeline);
+    ret |= audio_pipeline_wait_for_stop(graph->pipeline);
+    ret |= audio_pipeline_reset_ringbuffer(graph->pipeline);
+    ret |= audio_pipeline_reset_elements(graph->pipeline);
+    ret |= audio_pipeline_reset_items_state(graph->pipeline);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    int64_t t1 = esp_timer_get_time();
+
+    if (graph->linked) {
+        audio_pipeline_unlink(graph->pipeline);
+    }
+    if (evt) {
+        audio_pipeline_remove_listener(graph->pipeline);
+    }
+    ret = JkkGraphLink(graph);
+    if (evt) {
+        audio_pipeline_set_listener(graph->pipeline, evt);
+    }
+    graph->relinkUs = esp_timer_get_time() - t0;
+    ESP_LOGI(TAG, "Reconfigured in %lld us (stop %lld us, relink %lld us)", graph->relinkUs, t1 - t0, esp_timer_get_time() - t1);
+    return ret;
+}
@@ -0,0 +1,122 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Declarative description of pipeline elements and their order
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "audio_element.h"
+#include "audio_pipeline.h"
+#include "audio_event_iface.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JKK_GRAPH_MAX_NODES (10)
+
+typedef struct JkkGraphNode_s {
+    const char *tag;
+    audio_element_handle_t el;
+    bool enabled; // Disabled nodes stay registered, but are bypassed when linking
+} JkkGraphNode_t;
+
+/* Chain of elements in data flow order. Extra outputs (raw split) are connected by caller. */
+typedef struct JkkGraph_s {
+    audio_pipeline_handle_t pipeline;
+    JkkGraphNode_t nodes[JKK_GRAPH_MAX_NODES];
+    int count;
+    bool linked;
+    int64_t relinkUs; // Duration of last JkkGraphRelink (stop and link)
+} JkkGraph_t;
+
+/**
+ * @brief Initialize empty graph for pipeline
+ * @param graph Graph to initialize
+ * @param pipeline Pipeline the elements are registered to
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkGraphInit(JkkGraph_t *graph, audio_pipeline_handle_t pipeline);
+
+/**
+ * @brief Register element and append it at the end of the chain
+ * @param graph Graph
+ * @param tag Unique tag of element (string has to stay valid)
+ * @param el Element, NULL is ignored (optional element not created)
+ * @param enabled Take part in linking
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkGraphAdd(JkkGraph_t *graph, const char *tag, audio_element_handle_t el, bool enabled);
+
+/**
+ * @brief Register element and insert it after given node (call JkkGraphRelink to apply)
+ * @param graph Graph
+ * @param afterTag Tag of node preceding the new one
+ * @param tag Unique tag of element
+ * @param el Element
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkGraphInsertAfter(JkkGraph_t *graph, const char *afterTag, const char *tag, audio_element_handle_t el);
+
+/**
+ * @brief Unregister element and remove it from the chain (call JkkGraphRelink to apply)
+ * @param graph Graph
+ * @param tag Tag of node
+ * @return Removed element (caller deinitializes it) or NULL if not found
+ */
+audio_element_handle_t JkkGraphRemove(JkkGraph_t *graph, const char *tag);
+
+/**
+ * @brief Put another element in place of node, e.g. swap input stream (call JkkGraphRelink to apply)
+ * @param graph Graph
+ * @param tag Tag of node, kept for the new element
+ * @param el New element
+ * @return Previous element (caller deinitializes it) or NULL if not found
+ */
+audio_element_handle_t JkkGraphReplace(JkkGraph_t *graph, const char *tag, audio_element_handle_t el);
+
+/**
+ * @brief Enable or bypass node (call JkkGraphRelink to apply)
+ * @param graph Graph
+ * @param tag Tag of node
+ * @param on true to take part in linking
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is no such node
+ */
+esp_err_t JkkGraphSetEnabled(JkkGraph_t *graph, const char *tag, bool on);
+
+/**
+ * @brief Check if node exists and is enabled
+ * @param graph Graph
+ * @param tag Tag of node
+ * @return true if node is linked
+ */
+bool JkkGraphIsEnabled(const JkkGraph_t *graph, const char *tag);
+
+/**
+ * @brief Check graph: at least source and sink enabled, unique tags, no empty nodes
+ * @param graph Graph
+ * @return ESP_OK if graph can be linked
+ */
+esp_err_t JkkGraphValidate(const JkkGraph_t *graph);
+
+/**
+ * @brief Link enabled nodes in chain order (first link after building)
+ * @param graph Graph
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkGraphLink(JkkGraph_t *graph);
+
+/**
+ * @brief Stop pipeline and link it again after changes, pipeline is left stopped
+ * Elements and their ring buffers are kept, only the changed connections are rebuilt.
+ * @param graph Graph
+ * @param evt Event interface to listen again on (NULL - none)
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkGraphRelink(JkkGraph_t *graph, audio_event_iface_handle_t evt);
+
+#ifdef __cplusplus
+}
+#endif
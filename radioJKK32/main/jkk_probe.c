@@ -0,0 +1,471 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Background station health probe
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_wifi.h"
+#include "sdkconfig.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#include "jkk_station_store.h"
+#include "jkk_probe.h"
+
+static const char *TAG = "JKK_PROBE";
+
+#ifndef CONFIG_JKK_RADIO_PROBE_PERIOD_S
+#define CONFIG_JKK_RADIO_PROBE_PERIOD_S (60)
+#endif
+#ifndef CONFIG_JKK_RADIO_PROBE_KBPS
+#define CONFIG_JKK_RADIO_PROBE_KBPS (128)
+#endif
+
+#define JKK_PROBE_TABLE_SIZE (1024) // Results by URI hash, power of 2
+#define JKK_PROBE_START_DELAY_MS (60 * 1000) // Let the station start after boot first
+#define JKK_PROBE_BUF_SIZE (1024) // Response headers and playlists must fit
+
+_Static_assert(JKK_PROBE_TABLE_SIZE >= 2 * JKK_RADIO_MAX_STATIONS, "Probe table too small");
+
+typedef struct JkkProbeUrl_s {
+    char host[64];
+    char path[JKK_RADIO_STATION_URI_LEN];
+    uint16_t port;
+    bool tls;
+} JkkProbeUrl_t;
+
+// Used by one probe at a time (runLock)
+typedef struct JkkProbeCtx_s {
+    char uri[JKK_RADIO_STATION_URI_LEN];
+    JkkProbeUrl_t url;
+    char buf[JKK_PROBE_BUF_SIZE];
+} JkkProbeCtx_t;
+
+static EXT_RAM_BSS_ATTR JkkProbeResult_t results[JKK_PROBE_TABLE_SIZE]; // uriHash 0 - empty slot
+static EXT_RAM_BSS_ATTR JkkProbeCtx_t ctx;
+static int resultCount = 0;
+static SemaphoreHandle_t resultLock = NULL;
+static SemaphoreHandle_t runLock = NULL;
+
+static inline uint16_t JkkProbeMs(int64_t since) {
+    int64_t ms = (esp_timer_get_time() - since) / 1000;
+    return ms > UINT16_MAX ? UINT16_MAX : (uint16_t)ms;
+}
+
+/* Slot of uriHash, NULL if not there and add is false. Table is cleared when 3/4 full (old URIs of edited stations). */
+static JkkProbeResult_t *JkkProbeSlot(uint32_t uriHash, bool add) {
+    if (uriHash == 0) uriHash = 1;
+    if (add && resultCount >= JKK_PROBE_TABLE_SIZE * 3 / 4) {
+        memset(results, 0, sizeof(results));
+        resultCount = 0;
+    }
+    for (uint32_t slot = uriHash & (JKK_PROBE_TABLE_SIZE - 1); ; slot = (slot + 1) & (JKK_PROBE_TABLE_SIZE - 1)) {
+        if (results[slot].uriHash == uriHash) return &results[slot];
+        if (results[slot].uriHash == 0) {
+            if (!add) return NULL;
+            resultCount++;
+            results[slot].uriHash = uriHash;
+            return &results[slot];
+        }
+    }
+}
+
+static bool JkkProbeParseUrl(const char *uri, JkkProbeUrl_t *u) {
+    memset(u, 0, sizeof(JkkProbeUrl_t));
+    if (strncasecmp(uri, "http://", 7) == 0) {
+        uri += 7;
+        u->port = 80;
+    } else if (strncasecmp(uri, "https://", 8) == 0) {
+        uri += 8;
+        u->port = 443;
+        u->tls = true;
+    } else {
+        return false;
+    }
+    const char *end = uri + strcspn(uri, "/?#");
+    const char *at = memchr(uri, '@', end - uri);
+    if (at) uri = at + 1; // User info is not sent
+    const char *colon = NULL;
+    const char *hostEnd = end;
+    if (*uri == '[') {
+        const char *close = memchr(uri, ']', end - uri);
+        if (close == NULL) return false;
+        uri++;
+        hostEnd = close;
+        if (close[1] == ':') colon = close + 1;
+    } else {
+        colon = memchr(uri, ':', end - uri);
+        if (colon) hostEnd = colon;
+    }
+    if (hostEnd == uri || (size_t)(hostEnd - uri) >= sizeof(u->host)) return false;
+    memcpy(u->host, uri, hostEnd - uri);
+    if (colon) {
+        int port = atoi(colon + 1);
+        if (port <= 0 || port > 65535) return false;
+        u->port = port;
+    }
+    snprintf(u->path, sizeof(u->path), "%s%s", *end == '/' ? "" : "/", end);
+    return true;
+}
+
+static int JkkProbeConnect(const JkkProbeUrl_t *u, JkkProbeResult_t *r, JkkProbeError_e *err) {
+    struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res = NULL;
+    char port[8];
+    snprintf(port, sizeof(port), "%u", u->port);
+    int64_t t0 = esp_timer_get_time();
+    if (getaddrinfo(u->host, port, &hints, &res) != 0 || res == NULL) {
+        *err = JKK_PROBE_ERR_DNS;
+        return -1;
+    }
+    r->dnsMs = JkkProbeMs(t0);
+
+    t0 = esp_timer_get_time();
+    int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock < 0) {
+        freeaddrinfo(res);
+        *err = JKK_PROBE_ERR_CONNECT;
+        return -1;
+    }
+    // Non blocking connect, lwip would wait much longer than JKK_PROBE_TIMEOUT_MS
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    int ret = connect(sock, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (ret != 0 && errno == EINPROGRESS) {
+        fd_set wfds;
+        FD_ZERO(&wfds);
+        FD_SET(sock, &wfds);
+        struct timeval tv = { .tv_sec = JKK_PROBE_TIMEOUT_MS / 1000, .tv_usec = (JKK_PROBE_TIMEOUT_MS % 1000) * 1000 };
+        ret = -1;
+        if (select(sock + 1, NULL, &wfds, NULL, &tv) > 0) {
+            int soErr = 0;
+            socklen_t len = sizeof(soErr);
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &soErr, &len);
+            ret = soErr ? -1 : 0;
+        }
+    }
+    if (ret != 0) {
+        close(sock);
+        *err = JKK_PROBE_ERR_CONNECT;
+        return -1;
+    }
+    fcntl(sock, F_SETFL, flags);
+    struct timeval tv = { .tv_sec = JKK_PROBE_TIMEOUT_MS / 1000, .tv_usec = (JKK_PROBE_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    r->connectMs = JkkProbeMs(t0);
+    return sock;
+}
+
+/* Value of header (case insensitive name) from header block, false if not there */
+static bool JkkProbeHeader(const char *headers, const char *name, char *out, size_t size) {
+    size_t nameLen = strlen(name);
+    for (const char *line = strstr(headers, "\r\n"); line; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (strncasecmp(line, name, nameLen) == 0 && line[nameLen] == ':') {
+            const char *v = line + nameLen + 1;
+            while (*v == ' ') v++;
+            size_t len = strcspn(v, "\r\n");
+            if (len >= size) len = size - 1;
+            memcpy(out, v, len);
+            out[len] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+/* First stream URI of m3u or pls playlist in text */
+static bool JkkProbePlaylistUri(const char *text, char *uri, size_t size) {
+    for (const char *line = text; *line; line += strcspn(line, "\n"), line += (*line == '\n')) {
+        while (*line == ' ' || *line == '\t') line++;
+        const char *v = line;
+        if (strncasecmp(v, "File", 4) == 0) {
+            v = strchr(v, '=');
+            v = v ? v + 1 : line;
+        }
+        if (strncasecmp(v, "http://", 7) == 0 || strncasecmp(v, "https://", 8) == 0) {
+            size_t len = strcspn(v, "\r\n");
+            if (len >= size) return false;
+            memcpy(uri, v, len);
+            uri[len] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool JkkProbeIsPlaylist(const char *contentType, const char *path) {
+    if (strstr(contentType, "mpegurl") || strstr(contentType, "scpls")) {
+        return true;
+    }
+    size_t len = strcspn(path, "?");
+    return (len > 4 && strncasecmp(path + len - 4, ".m3u", 4) == 0) ||
+           (len > 5 && strncasecmp(path + len - 5, ".m3u8", 5) == 0) ||
+           (len > 4 && strncasecmp(path + len - 4, ".pls", 4) == 0);
+}
+
+/* Stream data read not faster than CONFIG_JKK_RADIO_PROBE_KBPS, so the playing station keeps its bandwidth */
+static size_t JkkProbeReadStream(int sock, size_t got, uint16_t *kbps) {
+    int64_t t0 = esp_timer_get_time();
+    int64_t tFirst = 0; // After first chunk (server burst)
+    size_t gotFirst = 0;
+    while (got < JKK_PROBE_STREAM_BYTES) {
+        int n = recv(sock, ctx.buf, MIN(sizeof(ctx.buf), JKK_PROBE_STREAM_BYTES - got), 0);
+        if (n <= 0) break;
+        got += n;
+        int64_t now = esp_timer_get_time();
+        if (tFirst == 0) {
+            tFirst = now;
+            gotFirst = got;
+        }
+        int64_t due = t0 + (int64_t)got * 8000 / CONFIG_JKK_RADIO_PROBE_KBPS;
+        if (due > now) {
+            vTaskDelay(pdMS_TO_TICKS((due - now) / 1000) + 1);
+        }
+    }
+    int64_t us = esp_timer_get_time() - tFirst;
+    if (*kbps == 0 && tFirst && us > 0 && got > gotFirst) {
+        *kbps = MIN((int64_t)(got - gotFirst) * 8000 / us, UINT16_MAX);
+    }
+    return got;
+}
+
+/* One request: sock connected. JKK_PROBE_OK with next URI in ctx.uri if redirect or playlist (hops + 1). */
+static JkkProbeError_e JkkProbeRequest(int sock, const JkkProbeUrl_t *u, JkkProbeResult_t *r, bool *next) {
+    int len = snprintf(ctx.buf, sizeof(ctx.buf), "GET %s HTTP/1.0\r\nHost: %s\r\nUser-Agent: RadioJKK32\r\nIcy-MetaData: 0\r\nConnection: close\r\n\r\n",
+                       u->path, u->host);
+    if (len >= (int)sizeof(ctx.buf) || send(sock, ctx.buf, len, 0) != len) {
+        return JKK_PROBE_ERR_CONNECT;
+    }
+    int64_t t0 = esp_timer_get_time();
+    size_t got = 0;
+    char *body = NULL;
+    while (body == NULL && got < sizeof(ctx.buf) - 1) {
+        int n = recv(sock, ctx.buf + got, sizeof(ctx.buf) - 1 - got, 0);
+        if (n <= 0) return JKK_PROBE_ERR_TIMEOUT;
+        if (got == 0) r->firstByteMs = MAX(JkkProbeMs(t0), 1);
+        got += n;
+        ctx.buf[got] = '\0';
+        body = strstr(ctx.buf, "\r\n\r\n");
+    }
+    if (body == NULL) return JKK_PROBE_ERR_HTTP;
+    body[2] = '\0'; // Headers end with last "\r\n"
+    body += 4;
+    size_t bodyLen = got - (body - ctx.buf);
+
+    int status = 0;
+    char *space = strchr(ctx.buf, ' ');
+    if (space && (strncmp(ctx.buf, "HTTP/1.", 7) == 0 || strncmp(ctx.buf, "ICY ", 4) == 0)) {
+        status = atoi(space + 1);
+    }
+    char value[16] = {0};
+    if (status >= 301 && status <= 308 && status != 304) {
+        if (!JkkProbeHeader(ctx.buf, "Location", ctx.uri, sizeof(ctx.uri))) return JKK_PROBE_ERR_HTTP;
+        if (ctx.uri[0] == '/') {
+            // Relative location on the same server
+            char path[JKK_RADIO_STATION_URI_LEN];
+            strlcpy(path, ctx.uri, sizeof(path));
+            snprintf(ctx.uri, sizeof(ctx.uri), "%s://%s:%u%s", u->tls ? "https" : "http", u->host, u->port, path);
+        }
+        *next = true;
+        return JKK_PROBE_OK;
+    }
+    if (status != 200) return JKK_PROBE_ERR_HTTP;
+    if (JkkProbeHeader(ctx.buf, "icy-br", value, sizeof(value))) {
+        r->kbps = atoi(value);
+    }
+    char contentType[48] = {0};
+    JkkProbeHeader(ctx.buf, "Content-Type", contentType, sizeof(contentType));
+    for (char *c = contentType; *c; c++) *c = (*c >= 'A' && *c <= 'Z') ? *c + ('a' - 'A') : *c;
+
+    if (JkkProbeIsPlaylist(contentType, u->path)) {
+        memmove(ctx.buf, body, bodyLen);
+        got = bodyLen;
+        int n;
+        while (got < sizeof(ctx.buf) - 1 && (n = recv(sock, ctx.buf + got, sizeof(ctx.buf) - 1 - got, 0)) > 0) got += n;
+        ctx.buf[got] = '\0';
+        if (strstr(ctx.buf, "#EXT-X-")) {
+            return JKK_PROBE_OK; // HLS, segments are handled by player
+        }
+        if (!JkkProbePlaylistUri(ctx.buf, ctx.uri, sizeof(ctx.uri))) return JKK_PROBE_ERR_PLAYLIST;
+        *next = true;
+        return JKK_PROBE_OK;
+    }
+    return JkkProbeReadStream(sock, bodyLen, &r->kbps) > 0 ? JKK_PROBE_OK : JKK_PROBE_ERR_TIMEOUT;
+}
+
+JkkProbeError_e JkkProbeUri(const char *uri, JkkProbeResult_t *result) {
+    if (runLock == NULL) {
+        runLock = xSemaphoreCreateMutex(); // First call comes from probe task
+    }
+    xSemaphoreTake(runLock, portMAX_DELAY);
+    JkkProbeResult_t r = {0};
+    JkkProbeError_e err = JKK_PROBE_ERR_URI;
+    strlcpy(ctx.uri, uri ? uri : "", sizeof(ctx.uri));
+    for (int hop = 0; hop < JKK_PROBE_MAX_HOPS; hop++) {
+        err = JKK_PROBE_ERR_URI;
+        if (!JkkProbeParseUrl(ctx.uri, &ctx.url)) break;
+        int sock = JkkProbeConnect(&ctx.url, &r, &err);
+        if (sock < 0) break;
+        bool next = false;
+        err = ctx.url.tls ? JKK_PROBE_OK : JkkProbeRequest(sock, &ctx.url, &r, &next); // No TLS handshake for a probe
+        shutdown(sock, SHUT_RDWR);
+        close(sock);
+        if (err != JKK_PROBE_OK || !next) break;
+        r.hops++;
+        err = JKK_PROBE_ERR_HTTP; // Out of hops
+    }
+    xSemaphoreGive(runLock);
+    if (result) {
+        *result = r;
+    }
+    return err;
+}
+
+static void JkkProbeStation(int id) {
+    uint32_t uriHash = JkkRadioGetStationUriHash(id);
+    char uri[JKK_RADIO_STATION_URI_LEN];
+    if (JkkRadioGetStationUri(id, uri, sizeof(uri)) == NULL) uri[0] = '\0';
+    JkkProbeResult_t r;
+    JkkProbeError_e err = JkkProbeUri(uri, &r);
+
+    xSemaphoreTake(resultLock, portMAX_DELAY);
+    JkkProbeResult_t *slot = JkkProbeSlot(uriHash, true);
+    r.uriHash = slot->uriHash;
+    r.probes = slot->probes < UINT16_MAX ? slot->probes + 1 : slot->probes;
+    r.fails = slot->fails;
+    r.failsInRow = slot->failsInRow;
+    if (err != JKK_PROBE_OK) {
+        if (r.fails < UINT16_MAX) r.fails++;
+        if (r.failsInRow < UINT8_MAX) r.failsInRow++;
+        // Times of last working probe are kept
+        r.dnsMs = slot->dnsMs;
+        r.connectMs = slot->connectMs;
+        r.firstByteMs = slot->firstByteMs;
+        r.kbps = slot->kbps;
+    } else {
+        r.failsInRow = 0;
+    }
+    r.lastError = err;
+    r.lastProbe = esp_timer_get_time() / 1000000;
+    *slot = r;
+    xSemaphoreGive(resultLock);
+
+    if (err == JKK_PROBE_OK) {
+        ESP_LOGI(TAG, "Station %d: dns %u, connect %u, first byte %u ms, %u kbps, %u hops",
+                 id, r.dnsMs, r.connectMs, r.firstByteMs, r.kbps, r.hops);
+    } else {
+        ESP_LOGW(TAG, "Station %d: probe error %d, %u failed in row (%u of %u)%s",
+                 id, err, r.failsInRow, r.fails, r.probes, r.failsInRow >= JKK_PROBE_DEAD_FAILS ? ", dead" : "");
+    }
+}
+
+static bool JkkProbeOnline(void) {
+    wifi_ap_record_t ap;
+    return esp_wifi_sta_get_ap_info(&ap) == ESP_OK; // Offline probes would mark every station dead
+}
+
+static void JkkProbeTask(void *arg) {
+    int next = 0;
+    vTaskDelay(pdMS_TO_TICKS(JKK_PROBE_START_DELAY_MS));
+    for (;;) {
+        int count = JkkRadioGetStationCount();
+        if (next >= count) next = 0;
+        if (count > 0 && JkkProbeOnline() && !(next == JkkRadioGetStation() && JkkRadioIsPlaying())) {
+            JkkProbeStation(next);
+        }
+        next++;
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_JKK_RADIO_PROBE_PERIOD_S * 1000));
+    }
+}
+
+esp_err_t JkkProbeStart(void) {
+    if (resultLock == NULL) {
+        resultLock = xSemaphoreCreateMutex();
+    }
+    if (runLock == NULL) {
+        runLock = xSemaphoreCreateMutex();
+    }
+    if (resultLock == NULL || runLock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    // Lowest priority above idle, playing stream is never waiting for it
+    if (xTaskCreatePinnedToCore(JkkProbeTask, "probe", 4 * 1024, NULL, tskIDLE_PRIORITY + 1, NULL, 0) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Station probe every %d s, max %d kbps", CONFIG_JKK_RADIO_PROBE_PERIOD_S, CONFIG_JKK_RADIO_PROBE_KBPS);
+    return ESP_OK;
+}
+
+bool JkkProbeGet(uint32_t uriHash, JkkProbeResult_t *result) {
+    if (resultLock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(resultLock, portMAX_DELAY);
+    JkkProbeResult_t *slot = JkkProbeSlot(uriHash, false);
+    if (slot && result) {
+        *result = *slot;
+    }
+    xSemaphoreGive(resultLock);
+    return slot != NULL;
+}
+
+bool JkkProbeIsDead(uint32_t uriHash) {
+    JkkProbeResult_t r;
+    return JkkProbeGet(uriHash, &r) && r.failsInRow >= JKK_PROBE_DEAD_FAILS;
+}
+
+int JkkProbeBestMirror(JkkRadioStations_t *stations, int count, int id) {
+    if (stations == NULL || id < 0 || id >= count || resultLock == NULL) {
+        return id;
+    }
+    uint32_t nameHash = stations[id].nameHash;
+    if (nameHash == JkkStationStoreHash("", 0)) {
+        return id;
+    }
+    int best = id;
+    xSemaphoreTake(resultLock, portMAX_DELAY);
+    // Station not probed yet is played as it is
+    JkkProbeResult_t *own = JkkProbeSlot(stations[id].uriHash, false);
+    if (own) {
+        int bestMs = own->failsInRow ? INT_MAX : own->connectMs + own->firstByteMs;
+        for (int i = 0; i < count; i++) {
+            if (i == id || stations[i].nameHash != nameHash || stations[i].uriHash == stations[id].uriHash) continue;
+            JkkProbeResult_t *r = JkkProbeSlot(stations[i].uriHash, false);
+            if (r == NULL || r->failsInRow) continue;
+            int ms = r->connectMs + r->firstByteMs + JKK_PROBE_MIRROR_MARGIN_MS;
+            if (ms < bestMs) {
+                bestMs = ms;
+                best = i;
+            }
+        }
+    }
+    xSemaphoreGive(resultLock);
+    return best;
+}
+
+int JkkProbeLineForWWW(int id, uint32_t uriHash, char *buf, size_t len) {
+    JkkProbeResult_t r;
+    if (!JkkProbeGet(uriHash, &r) || r.probes == 0) {
+        return 0;
+    }
+    const char *state = r.failsInRow >= JKK_PROBE_DEAD_FAILS ? "dead" : (r.failsInRow ? "fail" : "ok");
+    return snprintf(buf, len, "%d;%s;%u;%u;%u;%u;%u;%u", id, state, r.dnsMs, r.connectMs, r.firstByteMs, r.kbps, r.probes, r.fails);
+}
@@ -0,0 +1,106 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Background station health probe
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#include "jkk_radio.h"
+
+/*  One low priority task probes stations one by one (never two at once), every CONFIG_JKK_RADIO_PROBE_PERIOD_S.
+    Probe: DNS, TCP connect, GET with first byte time, HTTP redirects and m3u/pls playlists followed, then up to
+    JKK_PROBE_STREAM_BYTES of stream read not faster than CONFIG_JKK_RADIO_PROBE_KBPS. HTTPS stations are checked
+    up to TCP connect. Currently played station is not probed while playing.
+    Results are kept in RAM by URI hash (follow station moves, reset by URI change). Stations with the same long
+    name are mirrors: station is played from the fastest working one. */
+
+#define JKK_PROBE_STREAM_BYTES (16 * 1024) // Stream data read by one probe
+#define JKK_PROBE_TIMEOUT_MS (5000) // Connect and read timeout
+#define JKK_PROBE_MAX_HOPS (4) // Redirects and playlists followed
+#define JKK_PROBE_DEAD_FAILS (3) // Failed probes in a row to mark station dead
+#define JKK_PROBE_MIRROR_MARGIN_MS (50) // Mirror must be faster by this to be used
+
+typedef enum {
+    JKK_PROBE_OK = 0,
+    JKK_PROBE_ERR_URI, // Not http(s) or too long
+    JKK_PROBE_ERR_DNS,
+    JKK_PROBE_ERR_CONNECT,
+    JKK_PROBE_ERR_TIMEOUT, // No answer or no stream data
+    JKK_PROBE_ERR_HTTP, // Status other than 200 (or too many redirects)
+    JKK_PROBE_ERR_PLAYLIST, // Playlist without stream URI
+} JkkProbeError_e;
+
+typedef struct JkkProbeResult_s {
+    uint32_t uriHash;
+    uint32_t lastProbe; // Seconds since boot
+    uint16_t dnsMs;
+    uint16_t connectMs;
+    uint16_t firstByteMs; // 0 - not measured (HTTPS)
+    uint16_t kbps; // icy-br or measured
+    uint16_t probes;
+    uint16_t fails;
+    uint8_t failsInRow;
+    uint8_t lastError; // JkkProbeError_e
+    uint8_t hops; // Redirects and playlists followed
+} JkkProbeResult_t;
+
+/**
+ * @brief Start probe task
+ * @return ESP_OK on success
+ */
+esp_err_t JkkProbeStart(void);
+
+/**
+ * @brief Probe one URI now (blocking, in caller task)
+ * @param uri Station URI
+ * @param result Output, times and bitrate (counters are not changed)
+ * @return JKK_PROBE_OK or error
+ */
+JkkProbeError_e JkkProbeUri(const char *uri, JkkProbeResult_t *result);
+
+/**
+ * @brief Get last result for station URI
+ * @param uriHash Hash of station URI
+ * @param result Output copy
+ * @return true if station was probed
+ */
+bool JkkProbeGet(uint32_t uriHash, JkkProbeResult_t *result);
+
+/**
+ * @brief Station is dead (JKK_PROBE_DEAD_FAILS failed probes in a row)
+ * @param uriHash Hash of station URI
+ * @return true if dead
+ */
+bool JkkProbeIsDead(uint32_t uriHash);
+
+/**
+ * @brief Choose station to play: fastest working mirror (station with the same long name)
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @param id Selected station
+ * @return Station index to take URI from, id if no better mirror
+ */
+int JkkProbeBestMirror(JkkRadioStations_t *stations, int count, int id);
+
+/**
+ * @brief Format result for web list: "id;state;dnsMs;connectMs;firstByteMs;kbps;probes;fails"
+ * @param id Station index
+ * @param uriHash Hash of station URI
+ * @param buf Output buffer
+ * @param len Size of buf
+ * @return Length as snprintf, 0 if station was not probed
+ */
+int JkkProbeLineForWWW(int id, uint32_t uriHash, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -31,12 +31,11 @@ extern "C" {
 
 #define JKK_RADIO_NVS_NAMESPACE "jkk_radio"
 #define JKK_RADIO_NVS_EQ_NAMESPACE "jkk_radio_EQ"
-#define JKK_RADIO_NVS_STATION_KEY "station%03X"
 #define JKK_RADIO_NVS_EQUALIZER_KEY "equalizer%03X"
 
 #define SD_RECORDS_PATH "/sdcard/rec"
 
-#define JKK_RADIO_MAX_STATIONS (50) // Maximum number of radio stations
+#define JKK_RADIO_MAX_STATIONS (500) // Maximum number of radio stations (packed records in NVS, see jkk_station_store.h)
 #define JKK_RADIO_MAX_EBMEDDED_STATIONS (4) // Maximum number of embedded radio stations
 
 #define JKK_RADIO_MAX_EQ_PRESETS (20) // Maximum number of equalizers preset
@@ -72,6 +71,11 @@ typedef enum  {
     JKK_RADIO_CMD_SAVE_TO_NVS_STATION  = 107,
     JKK_RADIO_CMD_ERASE_FROM_NVS_STATION  = 108,
     JKK_RADIO_CMD_SAVE_WIFI = 109,
+    JKK_RADIO_CMD_SYNC_FORMAT = 110, // Multi-room follower: leader PCM format, data packed by JkkSyncFormatPack
+    JKK_RADIO_CMD_STREAM_STALL = 111, // Stall watchdog, data is jkk_audio_stall_e
+    JKK_RADIO_CMD_IMPORT_STEP = 112, // Station import: step waiting in jkk_import (JkkImportStep), data is its number
+    JKK_RADIO_CMD_PUBLISH_NVS_STATS = 113, // NVS write counters changed, MQTT publish off the timer task
+    JKK_RADIO_CMD_EXPORT_STATIONS = 114, // Station list changed, /sdcard/stations.txt written off the timer task
     JKK_RADIO_CMD_SET_UNKNOW, 
 } customCmd_e;
 
@@ -83,9 +87,10 @@ typedef enum  {
     JKK_RADIO_TO_SAVE_PLAY  = 1 << 3,
     JKK_RADIO_TO_SAVE_STATION_LIST  = 1 << 4,
     JKK_RADIO_TO_SAVE_PROVISIONED  = 1 << 5, // Save WiFi provisioning state
-    JKK_RADIO_TO_SAVE_ALL_STATIONS  = 1 << 6, // Save all stations to NVS
+    JKK_RADIO_TO_SAVE_STATION_ORDER  = 1 << 6, // Save station order to NVS (stations keep their records)
     JKK_RADIO_TO_DO_LCD_OFF = 1 << 7, // Turn off LCD panel
-    JKK_RADIO_TO_SAVE_ALL = JKK_RADIO_TO_DO_LCD_OFF | JKK_RADIO_TO_SAVE_CURRENT_STATION | JKK_RADIO_TO_SAVE_EQ | JKK_RADIO_TO_SAVE_VOLUME | JKK_RADIO_TO_SAVE_PLAY | JKK_RADIO_TO_SAVE_STATION_LIST | JKK_RADIO_TO_SAVE_PROVISIONED | JKK_RADIO_TO_SAVE_ALL_STATIONS,
+    JKK_RADIO_TO_SAVE_STATION_FMT = 1 << 8, // Save last observed stream format of a station
+    JKK_RADIO_TO_SAVE_ALL = JKK_RADIO_TO_SAVE_STATION_FMT | JKK_RADIO_TO_DO_LCD_OFF | JKK_RADIO_TO_SAVE_CURRENT_STATION | JKK_RADIO_TO_SAVE_EQ | JKK_RADIO_TO_SAVE_VOLUME | JKK_RADIO_TO_SAVE_PLAY | JKK_RADIO_TO_SAVE_STATION_LIST | JKK_RADIO_TO_SAVE_PROVISIONED | JKK_RADIO_TO_SAVE_STATION_ORDER,
     JKK_RADIO_TO_SAVE_MAX = JKK_RADIO_TO_SAVE_ALL + 1,
 } toSave_e;
 
@@ -101,12 +106,23 @@ typedef struct JkkRadioEqualizer_s {
     int gain[10];
 } JkkRadioEqualizer_t;
 
+typedef struct JkkRadioStreamFmt_s {
+    uint32_t sample_rate; // Last observed sample rate, 0 if the station was never decoded
+    uint8_t channels; // Last observed number of channels
+    uint8_t bits; // Last observed bits per sample
+    uint8_t codec; // Last observed codec (esp_codec_type_t)
+    uint8_t reserved;
+} JkkRadioStreamFmt_t;
+
+#define JKK_RADIO_STATION_URI_LEN (256) // Including '\0'
+#define JKK_RADIO_STATION_NAME_LEN (128) // Long name, including '\0'
+
+/* Hot part of station, kept in dense array. URI and long name (cold part) are read through getters. */
 typedef struct JkkRadioStations_s {
-    char uri[256]; // URI of the radio station
     char nameShort[32]; // Name of the radio station
-    char nameLong[128]; // Description of the radio station
     char audioDes[16]; // Additional audio description of the station
     bool is_favorite; // Flag indicating if the station is marked as favorite
+    uint16_t storeId; // Stable NVS record id (1..), kept when station moves in list, 0 - not stored yet
     enum {
         JKK_RADIO_UNKNOWN = 0, // Unknown type of station
         JKK_RADIO_MUSIC, // Music station
@@ -122,7 +138,13 @@ typedef struct JkkRadioStations_s {
         JKK_RADIO_ADD_FROM_EMBEDDED, // Added from embedded list
         JKK_RADIO_ADD_FROM_WEB, // Added from web
         JKK_RADIO_ADD_FROM_UNKNOWN, // Unknown source
+        JKK_RADIO_ADD_FROM_IMPORT, // Imported from file on SD card (jkk_import)
     } addFrom;
+    JkkRadioStreamFmt_t fmt; // Cached stream format used to pre-configure the pipeline
+    uint32_t uriHash; // Hash of URI, compared instead of the text (cold part may be not loaded)
+    uint32_t nameHash; // Hash of nameLong
+    uint16_t stalls; // Stream stalls since boot, RAM only (not in NVS record), moves with the station
+    char *cold; // "uri\0nameLong\0" in PSRAM, NULL until first use (read from NVS on demand, see jkk_station_store.h)
 } JkkRadioStations_t;
 
 typedef struct JkkRadio_s {
@@ -143,6 +165,7 @@ typedef struct JkkRadio_s {
     bool is_playing; // Flag indicating if the radio is currently playing
     status_e statusStation; 
     toSave_e whatToDo;
+    int fmt_station; // Station index with stream format waiting for save (-1 none)
     JkkRadioStations_t *jkkRadioStations; // Pointer to the array of radio stations
     bool isProvisioned;
     bool runWebServer;
@@ -182,18 +205,6 @@ void JkkRadioDeleteStation(uint16_t station);
  */
 void JkkRadioEditStation(char *csvTxt);
 
-/**
- * @brief Update station list for web interface
- * Formats current station list and sends to web server
- */
-void JkkRadioListForWWW(void);
-
-/**
- * @brief Update equalizer list for web interface
- * Formats current equalizer list and sends to web server
- */
-void JkkRadioEqListForWWW(void);
-
 /**
  * @brief Reorder stations in the list
  * @param oldIndex Current position of the station
@@ -209,6 +220,25 @@ esp_err_t JkkRadioReorderStation(int oldIndex, int newIndex);
  */
 esp_err_t JkkRadioExportStations(const char *filename);
 
+#define JKK_RADIO_EXPORT_CHUNK (512) // Export is rendered into it, longest station line fits
+
+/**
+ * @brief Sink for station export, gets consecutive parts of CSV text
+ * @return ESP_OK to continue, error stops export
+ */
+typedef esp_err_t (*JkkRadioExportWrite_t)(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief Render station export (header and "uri;nameShort;nameLong;favorite;type;audioDes" lines) from station data,
+ *        in parts of up to JKK_RADIO_EXPORT_CHUNK bytes, nothing is allocated. Station list is locked
+ *        while a part is rendered (not while it is written), list changes from other tasks wait for it
+ * @param write Sink (file, HTTP chunks)
+ * @param ctx Passed to write
+ * @param count Exported stations, may be NULL
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if there are no stations (nothing written), error of write
+ */
+esp_err_t JkkRadioExportStationsCsv(JkkRadioExportWrite_t write, void *ctx, int *count);
+
 /**
  * @brief Start delayed save timer to batch NVS writes
  * @param toSave Bitmask of what data to save
@@ -293,11 +323,70 @@ int JkkRadioGetStation(void);
 int JkkRadioGetStationCount(void);
 
 /**
- * @brief Get station short name by index
+ * @brief Copy station long name by index
+ * @param idx Station index
+ * @param buf Output buffer (JKK_RADIO_STATION_NAME_LEN for whole name)
+ * @param len Size of buf
+ * @return buf, NULL for wrong index
+ */
+const char *JkkRadioGetStationName(int idx, char *buf, size_t len);
+
+/**
+ * @brief Copy station URI by index
+ * @param idx Station index
+ * @param buf Output buffer (JKK_RADIO_STATION_URI_LEN for whole URI)
+ * @param len Size of buf
+ * @return buf, NULL for wrong index
+ */
+const char *JkkRadioGetStationUri(int idx, char *buf, size_t len);
+
+/**
+ * @brief Find station by exact long name (hash index)
+ * @param name Long name
+ * @return Station index, -1 if not found
+ */
+int JkkRadioFindStationByName(const char *name);
+
+/**
+ * @brief Search stations by part of short or long name (case of ASCII letters ignored)
+ * @param query Text to search (1-2 letters: beginning of a word)
+ * @param ids Output station indexes, ascending
+ * @param max Size of ids
+ * @return Number of stations found
+ */
+int JkkRadioSearchStations(const char *query, int *ids, int max);
+
+/**
+ * @brief Format station as line of web station list ("id;nameShort;nameLong;uri", no new line)
+ * @param idx Station index
+ * @param buf Output buffer
+ * @param len Size of buf
+ * @return Length as snprintf, -1 for wrong index
+ */
+int JkkRadioStationLineForWWW(int idx, char *buf, size_t len);
+
+/**
+ * @brief Get number of stream stalls of station since boot
+ * @param idx Station index
+ * @return Stalls, 0 for wrong index
+ */
+int JkkRadioGetStationStalls(int idx);
+
+/**
+ * @brief Get hash of station URI (as JkkStationStoreHash)
  * @param idx Station index
- * @return Station name string (pointer to internal buffer, do not free)
+ * @return Hash, 0 for wrong index
+ */
+uint32_t JkkRadioGetStationUriHash(int idx);
+
+/**
+ * @brief Append imported stations to the list and save them (one NVS commit), main task only
+ * @param stations Stations with cold part set, owned by the list after success
+ * @param count Number of stations (0 - only finish)
+ * @param last Last batch: export list to stations.txt, refresh MQTT discovery
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if list would be too long, ESP_ERR_NO_MEM on allocation failure
  */
-const char *JkkRadioGetStationName(int idx);
+esp_err_t JkkRadioImportStations(JkkRadioStations_t *stations, int count, bool last);
 
 /**
  * @brief Get current equalizer preset index
@@ -0,0 +1,450 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * HTTP re-streaming of the currently played station to LAN clients
+ *
+ * Compressed input bytes (as received from the station) are copied once from
+ * the raw split tap into a shared ring. Every client only keeps its own read
+ * position in that ring and is sent directly from it, so adding clients does
+ * not add copies. A client which can not keep up is moved forward to live
+ * position (data dropped), and disconnected if it keeps lagging.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "lwip/sockets.h"
+#include "audio_element.h"
+#include "audio_common.h"
+#include "ringbuf.h"
+
+#include "jkk_restream.h"
+
+static const char *TAG = "JKK_RESTR";
+
+#ifndef CONFIG_JKK_RADIO_RESTREAM_PORT
+#define CONFIG_JKK_RADIO_RESTREAM_PORT (8000)
+#endif
+#ifndef CONFIG_JKK_RADIO_RESTREAM_MAX_CLIENTS
+#define CONFIG_JKK_RADIO_RESTREAM_MAX_CLIENTS (8)
+#endif
+
+#define JKK_RESTREAM_RING_SIZE (64 * 1024) // Must be power of 2
+#define JKK_RESTREAM_TAP_SIZE (16 * 1024) // Ring buffer filled by raw split
+#define JKK_RESTREAM_READ_CHUNK (2 * 1024)
+#define JKK_RESTREAM_PREBUFFER (16 * 1024) // Data sent at once to new client for quick start
+#define JKK_RESTREAM_MAX_DROPS (8) // Drops in a row before client is disconnected
+#define JKK_RESTREAM_STATS_PERIOD_US (30 * 1000 * 1000)
+#define JKK_RESTREAM_SLOTS (CONFIG_JKK_RADIO_RESTREAM_MAX_CLIENTS + 2) // Streams and connections still in request
+#define JKK_RESTREAM_MSG_SIZE (1024) // Request, then reply text or stream header
+#define JKK_RESTREAM_REQUEST_TIMEOUT_US (3 * 1000 * 1000) // Whole request and reply, then connection is closed
+
+/*  All sockets are non-blocking and served by select loop of the task which also drains the tap:
+    request is collected in client buffer until headers end, reply is sent from the same buffer
+    when socket is writable. A client sending slowly (or nothing) only holds its slot until timeout. */
+typedef enum {
+    JKK_RESTREAM_CL_REQUEST = 0, // Reading request headers
+    JKK_RESTREAM_CL_REPLY, // Sending stats or error, closed after
+    JKK_RESTREAM_CL_HEADER, // Sending stream response header
+    JKK_RESTREAM_CL_STREAM,
+} JkkRestreamClientState_t;
+
+typedef struct JkkRestreamClient_s {
+    int sock;
+    uint8_t state; // JkkRestreamClientState_t
+    uint32_t pos; // Absolute position of next byte to send
+    uint32_t sent;
+    uint16_t drops;
+    uint16_t dropsInRow;
+    int64_t sendUs; // Time spent on request and sending to this client
+    int64_t since;
+    char ip[16];
+    uint16_t msgLen;
+    uint16_t msgPos; // Reply bytes sent
+    char msg[JKK_RESTREAM_MSG_SIZE];
+} JkkRestreamClient_t;
+
+typedef struct JkkRestream_s {
+    ringbuf_handle_t tap;
+    uint8_t *ring;
+    uint32_t head; // Absolute position of next byte written to ring
+    uint32_t filled; // Valid bytes in ring (up to JKK_RESTREAM_RING_SIZE)
+    int listenSock;
+    TaskHandle_t task;
+    volatile int codec;
+    volatile bool codecChanged;
+    char name[64];
+    portMUX_TYPE nameMux;
+    int64_t loopUs; // Time spent in tap reading (shared cost)
+    int64_t statsTime;
+    int clientCount; // Streams, including ones still sending header
+    JkkRestreamClient_t clients[JKK_RESTREAM_SLOTS];
+} JkkRestream_t;
+
+static EXT_RAM_BSS_ATTR JkkRestream_t restream;
+
+static const char *JkkRestreamContentType(int codec) {
+    switch (codec) {
+        case ESP_CODEC_TYPE_MP3: return "audio/mpeg";
+        case ESP_CODEC_TYPE_AAC: return "audio/aac";
+        case ESP_CODEC_TYPE_OGG:
+        case ESP_CODEC_TYPE_OPUS: return "audio/ogg";
+        case ESP_CODEC_TYPE_FLAC: return "audio/flac";
+        case ESP_CODEC_TYPE_WAV: return "audio/wav";
+        case ESP_CODEC_TYPE_M4A: return "audio/mp4";
+        case ESP_CODEC_TYPE_TSAAC: return "video/mp2t";
+        default: return "application/octet-stream";
+    }
+}
+
+static bool JkkRestreamIsStream(const JkkRestreamClient_t *cl) {
+    return cl->state == JKK_RESTREAM_CL_HEADER || cl->state == JKK_RESTREAM_CL_STREAM;
+}
+
+static void JkkRestreamClientClose(int i, const char *reason) {
+    JkkRestreamClient_t *cl = &restream.clients[i];
+    if (cl->sock < 0) return;
+    if (JkkRestreamIsStream(cl)) {
+        int64_t alive = esp_timer_get_time() - cl->since;
+        ESP_LOGI(TAG, "Client %s closed (%s): sent %lu B, drops %u, send time %lld us (%lld us/s)",
+                 cl->ip, reason, (unsigned long)cl->sent, cl->drops, cl->sendUs,
+                 alive > 1000000 ? cl->sendUs * 1000000 / alive : cl->sendUs);
+        restream.clientCount--;
+    } else {
+        ESP_LOGD(TAG, "Connection %s closed (%s)", cl->ip, reason);
+    }
+    close(cl->sock);
+    cl->sock = -1;
+}
+
+static int JkkRestreamStats(char *buf, int len) {
+    int64_t now = esp_timer_get_time();
+    int n = snprintf(buf, len, "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n"
+                     "clients;%d\nhead;%lu\ntap_us;%lld\n", restream.clientCount, (unsigned long)restream.head, restream.loopUs);
+    for (int i = 0; i < JKK_RESTREAM_SLOTS && n < len; i++) {
+        JkkRestreamClient_t *cl = &restream.clients[i];
+        if (cl->sock < 0 || cl->state != JKK_RESTREAM_CL_STREAM) continue;
+        int64_t alive = now - cl->since;
+        n += snprintf(buf + n, len - n, "%d;%s;%lu;%u;%lld;%lld\n", i, cl->ip, (unsigned long)cl->sent, cl->drops,
+                      cl->sendUs, alive > 1000000 ? cl->sendUs * 1000000 / alive : cl->sendUs); // id;ip;bytes;drops;send_us;send_us_per_s
+    }
+    return MIN(n, len - 1);
+}
+
+static void JkkRestreamReply(JkkRestreamClient_t *cl, int state, int len) {
+    cl->state = state;
+    cl->msgLen = len;
+    cl->msgPos = 0;
+}
+
+// Request headers are complete, reply is prepared in client buffer
+static void JkkRestreamRoute(int i) {
+    JkkRestreamClient_t *cl = &restream.clients[i];
+    if (strncmp(cl->msg, "GET " JKK_RESTREAM_STATS_PATH, sizeof("GET " JKK_RESTREAM_STATS_PATH) - 1) == 0) {
+        JkkRestreamReply(cl, JKK_RESTREAM_CL_REPLY, JkkRestreamStats(cl->msg, sizeof(cl->msg)));
+        return;
+    }
+    if (strncmp(cl->msg, "GET " JKK_RESTREAM_PATH, sizeof("GET " JKK_RESTREAM_PATH) - 1) != 0) {
+        JkkRestreamReply(cl, JKK_RESTREAM_CL_REPLY, strlcpy(cl->msg, "HTTP/1.0 404 Not Found\r\nConnection: close\r\n\r\n", sizeof(cl->msg)));
+        return;
+    }
+    if (restream.clientCount >= CONFIG_JKK_RADIO_RESTREAM_MAX_CLIENTS) {
+        ESP_LOGW(TAG, "Too many clients, rejecting");
+        JkkRestreamReply(cl, JKK_RESTREAM_CL_REPLY, strlcpy(cl->msg, "HTTP/1.0 503 Service Unavailable\r\nConnection: close\r\n\r\n", sizeof(cl->msg)));
+        return;
+    }
+
+    char name[64];
+    portENTER_CRITICAL(&restream.nameMux);
+    strncpy(name, restream.name, sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    portEXIT_CRITICAL(&restream.nameMux);
+    for (char *c = name; *c; c++) {
+        if ((unsigned char)*c < 0x20 || *c == 0x7f) *c = ' '; // Name from web, import or SD: CR/LF would end the header line
+    }
+
+    int n = snprintf(cl->msg, sizeof(cl->msg), "HTTP/1.0 200 OK\r\nContent-Type: %s\r\nCache-Control: no-cache, no-store\r\n"
+                     "icy-name: %s\r\nConnection: close\r\n\r\n", JkkRestreamContentType(restream.codec), name);
+    JkkRestreamReply(cl, JKK_RESTREAM_CL_HEADER, MIN(n, (int)sizeof(cl->msg) - 1));
+    restream.clientCount++;
+    ESP_LOGI(TAG, "Client %s connected (%d/%d)", cl->ip, restream.clientCount, CONFIG_JKK_RADIO_RESTREAM_MAX_CLIENTS);
+}
+
+static void JkkRestreamAccept(void) {
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    int sock = accept(restream.listenSock, (struct sockaddr *)&addr, &addrLen);
+    if (sock < 0) return;
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+    int slot = -1;
+    for (int i = 0; i < JKK_RESTREAM_SLOTS; i++) {
+        if (restream.clients[i].sock < 0) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        ESP_LOGW(TAG, "Too many connections, rejecting");
+        static const char busy[] = "HTTP/1.0 503 Service Unavailable\r\nConnection: close\r\n\r\n";
+        send(sock, busy, sizeof(busy) - 1, MSG_DONTWAIT); // Send buffer of new socket is empty
+        close(sock);
+        return;
+    }
+
+    JkkRestreamClient_t *cl = &restream.clients[slot];
+    memset(cl, 0, sizeof(JkkRestreamClient_t));
+    cl->sock = sock;
+    cl->state = JKK_RESTREAM_CL_REQUEST;
+    cl->since = esp_timer_get_time();
+    inet_ntoa_r(addr.sin_addr, cl->ip, sizeof(cl->ip));
+}
+
+static void JkkRestreamReadRequest(int i) {
+    JkkRestreamClient_t *cl = &restream.clients[i];
+    int64_t start = esp_timer_get_time();
+    int r = recv(cl->sock, cl->msg + cl->msgLen, sizeof(cl->msg) - 1 - cl->msgLen, MSG_DONTWAIT);
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (r <= 0) {
+        JkkRestreamClientClose(i, "disconnected");
+        return;
+    }
+    cl->msgLen += r;
+    cl->msg[cl->msgLen] = '\0';
+    // Only request line is used, rest of headers which do not fit are not needed
+    if (cl->msgLen < sizeof(cl->msg) - 1 && strstr(cl->msg, "\r\n\r\n") == NULL && strstr(cl->msg, "\n\n") == NULL) return;
+    JkkRestreamRoute(i);
+    cl->sendUs += esp_timer_get_time() - start;
+}
+
+// Reply or stream header, then stream starts from live position with prebuffer
+static void JkkRestreamSendMsg(int i) {
+    JkkRestreamClient_t *cl = &restream.clients[i];
+    int64_t start = esp_timer_get_time();
+    int w = send(cl->sock, cl->msg + cl->msgPos, cl->msgLen - cl->msgPos, MSG_DONTWAIT);
+    cl->sendUs += esp_timer_get_time() - start;
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (w <= 0) {
+        JkkRestreamClientClose(i, "send error");
+        return;
+    }
+    cl->msgPos += w;
+    if (cl->msgPos < cl->msgLen) return;
+    if (cl->state == JKK_RESTREAM_CL_REPLY) {
+        JkkRestreamClientClose(i, "replied");
+        return;
+    }
+    int one = 1;
+    setsockopt(cl->sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    cl->state = JKK_RESTREAM_CL_STREAM;
+    cl->pos = restream.head - MIN(restream.filled, JKK_RESTREAM_PREBUFFER);
+}
+
+static void JkkRestreamReadTap(TickType_t wait) {
+    int64_t start = esp_timer_get_time();
+    uint32_t off = restream.head & (JKK_RESTREAM_RING_SIZE - 1);
+    int len = MIN(JKK_RESTREAM_READ_CHUNK, JKK_RESTREAM_RING_SIZE - off); // Contiguous space up to ring end
+
+    // Clients which would be overwritten by this read lose their oldest data
+    for (int i = 0; i < JKK_RESTREAM_SLOTS; i++) {
+        JkkRestreamClient_t *cl = &restream.clients[i];
+        if (cl->sock < 0 || cl->state != JKK_RESTREAM_CL_STREAM) continue;
+        if ((uint32_t)(restream.head - cl->pos) + len > JKK_RESTREAM_RING_SIZE) {
+            cl->pos = restream.head + len - JKK_RESTREAM_PREBUFFER;
+            cl->drops++;
+            if (++cl->dropsInRow > JKK_RESTREAM_MAX_DROPS) {
+                JkkRestreamClientClose(i, "too slow");
+            }
+        }
+    }
+
+    int r = rb_read(restream.tap, (char *)restream.ring + off, len, wait);
+    if (r > 0) {
+        restream.head += r;
+        restream.filled = MIN(restream.filled + r, JKK_RESTREAM_RING_SIZE);
+    } else if (r == RB_DONE || r == RB_ABORT) {
+        rb_reset(restream.tap); // Pipeline stopped, wait for new data
+    }
+    restream.loopUs += esp_timer_get_time() - start;
+}
+
+static void JkkRestreamSendClients(fd_set *wfds) {
+    for (int i = 0; i < JKK_RESTREAM_SLOTS; i++) {
+        JkkRestreamClient_t *cl = &restream.clients[i];
+        if (cl->sock < 0 || !FD_ISSET(cl->sock, wfds)) continue;
+        if (cl->state != JKK_RESTREAM_CL_STREAM) {
+            JkkRestreamSendMsg(i);
+            continue;
+        }
+        uint32_t pending = restream.head - cl->pos;
+        if (pending == 0) continue;
+        uint32_t off = cl->pos & (JKK_RESTREAM_RING_SIZE - 1);
+        int len = MIN(pending, JKK_RESTREAM_RING_SIZE - off);
+        int64_t start = esp_timer_get_time();
+        int w = send(cl->sock, restream.ring + off, len, MSG_DONTWAIT); // Straight from shared ring, no per-client copy
+        cl->sendUs += esp_timer_get_time() - start;
+        if (w > 0) {
+            cl->pos += w;
+            cl->sent += w;
+            cl->dropsInRow = 0;
+        } else if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            JkkRestreamClientClose(i, "send error");
+        }
+    }
+}
+
+static void JkkRestreamTask(void *arg) {
+    char discard[64];
+    while (1) {
+        if (restream.codecChanged) {
+            restream.codecChanged = false;
+            for (int i = 0; i < JKK_RESTREAM_SLOTS; i++) {
+                if (JkkRestreamIsStream(&restream.clients[i])) JkkRestreamClientClose(i, "codec changed");
+            }
+            restream.filled = 0;
+        }
+
+        JkkRestreamReadTap(restream.clientCount ? pdMS_TO_TICKS(5) : pdMS_TO_TICKS(50));
+
+        fd_set rfds, wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        FD_SET(restream.listenSock, &rfds);
+        int maxFd = restream.listenSock;
+        int64_t now = esp_timer_get_time();
+        for (int i = 0; i < JKK_RESTREAM_SLOTS; i++) {
+            JkkRestreamClient_t *cl = &restream.clients[i];
+            if (cl->sock < 0) continue;
+            if (cl->state == JKK_RESTREAM_CL_STREAM) {
+                FD_SET(cl->sock, &rfds); // Detects client disconnect
+                if (restream.head != cl->pos) FD_SET(cl->sock, &wfds);
+            } else if (now - cl->since > JKK_RESTREAM_REQUEST_TIMEOUT_US) {
+                JkkRestreamClientClose(i, "request timeout");
+                continue;
+            } else if (cl->state == JKK_RESTREAM_CL_REQUEST) {
+                FD_SET(cl->sock, &rfds);
+            } else {
+                FD_SET(cl->sock, &wfds);
+            }
+            maxFd = MAX(maxFd, cl->sock);
+        }
+        struct timeval tv = { .tv_sec = 0, .tv_usec = 0 };
+        if (select(maxFd + 1, &rfds, &wfds, NULL, &tv) <= 0) continue;
+
+        if (FD_ISSET(restream.listenSock, &rfds)) {
+            JkkRestreamAccept();
+        }
+        for (int i = 0; i < JKK_RESTREAM_SLOTS; i++) {
+            JkkRestreamClient_t *cl = &restream.clients[i];
+            if (cl->sock < 0 || !FD_ISSET(cl->sock, &rfds)) continue;
+            if (cl->state == JKK_RESTREAM_CL_REQUEST) {
+                JkkRestreamReadRequest(i);
+            } else if (recv(cl->sock, discard, sizeof(discard), MSG_DONTWAIT) == 0) {
+                JkkRestreamClientClose(i, "disconnected");
+            }
+        }
+        JkkRestreamSendClients(&wfds);
+
+        if (restream.clientCount && now - restream.statsTime > JKK_RESTREAM_STATS_PERIOD_US) {
+            restream.statsTime = now;
+            for (int i = 0; i < JKK_RESTREAM_SLOTS; i++) {
+                JkkRestreamClient_t *cl = &restream.clients[i];
+                if (cl->sock < 0 || cl->state != JKK_RESTREAM_CL_STREAM) continue;
+                int64_t alive = now - cl->since;
+                ESP_LOGI(TAG, "Client %s: %lu B, drops %u, send %lld us/s", cl->ip, (unsigned long)cl->sent,
+                         cl->drops, alive > 1000000 ? cl->sendUs * 1000000 / alive : cl->sendUs);
+            }
+        }
+    }
+}
+
+esp_err_t JkkRestreamInit(audio_element_handle_t inSplit) {
+    if (inSplit == NULL) {
+        ESP_LOGE(TAG, "Input split element is not initialized");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (restream.task) {
+        return ESP_OK;
+    }
+    restream.listenSock = -1;
+    portMUX_INITIALIZE(&restream.nameMux);
+    for (int i = 0; i < JKK_RESTREAM_SLOTS; i++) {
+        restream.clients[i].sock = -1;
+    }
+    restream.codec = ESP_CODEC_TYPE_UNKNOW;
+
+    restream.ring = heap_caps_malloc(JKK_RESTREAM_RING_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    restream.tap = rb_create(JKK_RESTREAM_TAP_SIZE, 1);
+    if (restream.ring == NULL || restream.tap == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate re-stream buffers");
+        goto fail;
+    }
+    audio_element_set_multi_output_ringbuf(inSplit, restream.tap, 0);
+
+    restream.listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (restream.listenSock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        goto fail;
+    }
+    int one = 1;
+    setsockopt(restream.listenSock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_JKK_RADIO_RESTREAM_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(restream.listenSock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(restream.listenSock, 2) != 0) {
+        ESP_LOGE(TAG, "Failed to listen on port %d: errno %d", CONFIG_JKK_RADIO_RESTREAM_PORT, errno);
+        goto fail;
+    }
+
+    if (xTaskCreatePinnedToCore(JkkRestreamTask, "restream", 4 * 1024, NULL, 5, &restream.task, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create re-stream task");
+        goto fail;
+    }
+    ESP_LOGI(TAG, "Re-streaming on port %d, path %s", CONFIG_JKK_RADIO_RESTREAM_PORT, JKK_RESTREAM_PATH);
+    return ESP_OK;
+
+fail:
+    if (restream.listenSock >= 0) {
+        close(restream.listenSock);
+        restream.listenSock = -1;
+    }
+    if (restream.tap) {
+        audio_element_set_multi_output_ringbuf(inSplit, NULL, 0);
+        rb_destroy(restream.tap);
+        restream.tap = NULL;
+    }
+    if (restream.ring) {
+        free(restream.ring);
+        restream.ring = NULL;
+    }
+    return ESP_FAIL;
+}
+
+void JkkRestreamSetCodec(int codec) {
+    if (codec == restream.codec) return;
+    if (restream.codec != ESP_CODEC_TYPE_UNKNOW) {
+        restream.codecChanged = true;
+    }
+    restream.codec = codec;
+}
+
+void JkkRestreamSetName(const char *name) {
+    if (name == NULL || restream.task == NULL) return;
+    portENTER_CRITICAL(&restream.nameMux);
+    strncpy(restream.name, name, sizeof(restream.name) - 1);
+    portEXIT_CRITICAL(&restream.nameMux);
+}
+
+int JkkRestreamClientCount(void) {
+    return restream.clientCount;
+}
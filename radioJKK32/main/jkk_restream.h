@@ -0,0 +1,50 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * HTTP re-streaming of the currently played station to LAN clients
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "audio_element.h"
+
+#define JKK_RESTREAM_PATH "/listen"
+#define JKK_RESTREAM_STATS_PATH "/stats"
+
+/**
+ * @brief Attach re-streamer to the input tap and start its server task
+ * Compressed bytes are taken from multi output 0 of the given raw split element
+ * (placed between input and decoder) and served on CONFIG_JKK_RADIO_RESTREAM_PORT.
+ * @param inSplit Raw split element with at least one multi output
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkRestreamInit(audio_element_handle_t inSplit);
+
+/**
+ * @brief Set codec of the stream being served (esp_codec_type_t)
+ * Connected clients are dropped when the codec changes, they can not decode the new one.
+ * @param codec Codec reported by the decoder
+ */
+void JkkRestreamSetCodec(int codec);
+
+/**
+ * @brief Set station name sent to clients in icy-name header
+ * @param name Station name
+ */
+void JkkRestreamSetName(const char *name);
+
+/**
+ * @brief Get number of currently connected clients
+ * @return Client count
+ */
+int JkkRestreamClientCount(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -12,13 +12,17 @@
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
+#include <sys/stat.h>
 #include "freertos/FreeRTOS.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 
 #include "jkk_radio.h"
 #include "jkk_nvs.h"
+#include "jkk_snapshot.h"
+#include "jkk_station_store.h"
 
 #include "display/jkk_mono_lcd.h"
 
@@ -26,8 +30,24 @@
 
 #define JKK_RADIO_WEB_SERVER_OFF "wwwoff"
 
+#define JKK_RADIO_NVS_SDSIG_STATIONS "sdsig_st"
+#define JKK_RADIO_NVS_SDSIG_EQ "sdsig_eq"
+#define JKK_RADIO_NVS_SDSIG_SETTINGS "sdsig_set"
+
+#define JKK_RADIO_SDSIG_WWW_OFF (1 << 0) // settings.txt: web server off
+
 static const char *TAG = "JKK_SETTI";
 
+/* Signature of SD card file kept in NVS, file is parsed again only when it changes */
+typedef struct JkkRadioSdFileSig_s {
+    uint32_t size;
+    uint32_t mtime;
+    uint32_t hash; // FNV-1a of content
+    uint32_t extra; // Data from file not kept elsewhere in NVS (JKK_RADIO_SDSIG_*)
+} JkkRadioSdFileSig_t;
+
+static uint32_t sdSyncWrites = 0; // NVS writes of settings, equalizers and signatures (stations are counted by store)
+
 extern const char stations_start[] asm("_binary_stations_txt_start"); 
 
 static const JkkRadioEqualizer_t eq_embedded[JKK_RADIO_MAX_EBMEDDED_EQ_PRESETS] = {
@@ -70,6 +90,66 @@ static void JkkLcdReloadRoller(JkkRadio_t *jkkRadio){
 }
 #endif
 
+#define JKK_RADIO_SDSIG_HASH_INIT (2166136261u) // FNV-1a offset basis
+
+static uint32_t JkkRadioSdHash(uint32_t hash, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* Same size and time - unchanged without reading. Otherwise file is parsed, its content hash is computed
+   while reading (JkkRadioSdFileGets) and stored with JkkRadioSdFileSigSave. */
+static bool JkkRadioSdFileUnchanged(const char *path, const char *key, JkkRadioSdFileSig_t *sig) {
+    JkkRadioSdFileSig_t old = {0};
+    size_t len = sizeof(old);
+    bool haveOld = JkkNvsBlobGet(key, JKK_RADIO_NVS_NAMESPACE, &old, &len) == ESP_OK && len == sizeof(old);
+
+    memset(sig, 0, sizeof(JkkRadioSdFileSig_t));
+    struct stat info;
+    if (stat(path, &info) == 0) {
+        sig->size = info.st_size;
+        sig->mtime = info.st_mtime;
+    }
+    sig->extra = old.extra;
+    if (haveOld && sig->size == old.size && sig->mtime == old.mtime) {
+        sig->hash = old.hash;
+        return true;
+    }
+    sig->hash = JKK_RADIO_SDSIG_HASH_INIT;
+    return false;
+}
+
+/* fgets adding read text to content hash, so the file is read once */
+static char *JkkRadioSdFileGets(char *str, int size, FILE *fptr, JkkRadioSdFileSig_t *sig) {
+    char *ret = fgets(str, size, fptr);
+    if (ret) {
+        sig->hash = JkkRadioSdHash(sig->hash, str, strlen(str));
+    }
+    return ret;
+}
+
+/* Rest of file not parsed (limit reached) */
+static void JkkRadioSdFileHashRest(FILE *fptr, JkkRadioSdFileSig_t *sig) {
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fptr)) > 0) {
+        sig->hash = JkkRadioSdHash(sig->hash, buf, n);
+    }
+}
+
+/* After parse: new time, next check without reading */
+static void JkkRadioSdFileSigSave(const char *key, const JkkRadioSdFileSig_t *sig) {
+    JkkRadioSdFileSig_t old = {0};
+    size_t len = sizeof(old);
+    if (JkkNvsBlobGet(key, JKK_RADIO_NVS_NAMESPACE, &old, &len) == ESP_OK && len == sizeof(old) && old.hash == sig->hash) {
+        ESP_LOGI(TAG, "%s: content unchanged, time only", key); // File copied again, parse found nothing to write
+    }
+    JkkNvsBlobSet(key, JKK_RADIO_NVS_NAMESPACE, sig, sizeof(JkkRadioSdFileSig_t));
+    sdSyncWrites++;
+}
+
 esp_err_t JkkRadioSettingsRead(JkkRadio_t *jkkRadio) {
     if (jkkRadio == NULL) {
         ESP_LOGE(TAG, "Invalid arguments: wifiSSID or wifiPassword is NULL");
@@ -77,8 +157,10 @@ esp_err_t JkkRadioSettingsRead(JkkRadio_t *jkkRadio) {
     }
     FILE *fptr;
 
-    JkkNvsBlobGet("wifi_ssid", JKK_RADIO_NVS_NAMESPACE, jkkRadio->wifiSSID, NULL); // &(size_t){sizeof(wifiSSID)}
-    JkkNvsBlobGet("wifi_password", JKK_RADIO_NVS_NAMESPACE, jkkRadio->wifiPassword, NULL); // &(size_t){sizeof(wifiPassword)}
+    JkkSnapshot_t snap;
+    JkkSnapshotGet(&snap);
+    strlcpy(jkkRadio->wifiSSID, snap.wifiSSID, sizeof(jkkRadio->wifiSSID));
+    strlcpy(jkkRadio->wifiPassword, snap.wifiPassword, sizeof(jkkRadio->wifiPassword));
 
     ESP_LOGI(TAG, "WiFi settings from NVS: SSID: %s, Password: %s", jkkRadio->wifiSSID, jkkRadio->wifiPassword);
 
@@ -89,17 +171,23 @@ esp_err_t JkkRadioSettingsRead(JkkRadio_t *jkkRadio) {
         ESP_LOGE(TAG, "Error opening file: /sdcard/settings.txt");
         return ESP_ERR_NOT_FOUND;
     }
-    char lineStr[256];
-    fgets(lineStr, sizeof(lineStr), fptr);
+    JkkRadioSdFileSig_t sig;
+    if (JkkRadioSdFileUnchanged("/sdcard/settings.txt", JKK_RADIO_NVS_SDSIG_SETTINGS, &sig)) {
+        fclose(fptr);
+        jkkRadio->runWebServer = !(sig.extra & JKK_RADIO_SDSIG_WWW_OFF);
+        ESP_LOGI(TAG, "/sdcard/settings.txt unchanged, skipped");
+        return ESP_OK;
+    }
+    char lineStr[256] = {0};
+    JkkRadioSdFileGets(lineStr, sizeof(lineStr), fptr, &sig);
+    JkkRadioSdFileHashRest(fptr, &sig);
     char *ssid = strtok(lineStr, ";\n");
     char *pass = strtok(NULL, ";\n");
     char *webServer = strtok(NULL, ";\n");
     if (ssid && pass) {
-        if(strcmp(ssid, jkkRadio->wifiSSID)){
-            JkkNvsBlobSet("wifi_ssid", JKK_RADIO_NVS_NAMESPACE, ssid, strlen(ssid) + 1);
-        }
-        if(strcmp(pass, jkkRadio->wifiPassword)){
-            JkkNvsBlobSet("wifi_password", JKK_RADIO_NVS_NAMESPACE, pass, strlen(pass) + 1);
+        if(strcmp(ssid, jkkRadio->wifiSSID) || strcmp(pass, jkkRadio->wifiPassword)){
+            JkkSnapshotSetWifi(ssid, pass);
+            sdSyncWrites++;
         }
         strcpy(jkkRadio->wifiSSID, ssid);
         strcpy(jkkRadio->wifiPassword, pass);
@@ -112,6 +200,8 @@ esp_err_t JkkRadioSettingsRead(JkkRadio_t *jkkRadio) {
         ESP_LOGI(TAG, "Read Web Server: %s", webServer);
     }
     fclose(fptr);
+    sig.extra = jkkRadio->runWebServer ? 0 : JKK_RADIO_SDSIG_WWW_OFF;
+    JkkRadioSdFileSigSave(JKK_RADIO_NVS_SDSIG_SETTINGS, &sig);
     ESP_LOGI(TAG, "WiFi settings: SSID: %s, Password: %s", jkkRadio->wifiSSID, jkkRadio->wifiPassword);
     return ESP_OK;
 }
@@ -157,13 +247,12 @@ static void JkkRadioStationEmbeddedRead(JkkRadio_t *jkkRadio, char const *statio
         if (jkkRadio->jkkRadioStations == NULL) {
             ESP_LOGE(TAG, "Failed to allocate memory for radio stations");
         }
-        strncpy(jkkRadio->jkkRadioStations[0].uri, "http://mp3.polskieradio.pl:8904/", sizeof(jkkRadio->jkkRadioStations[0].uri) - 1);
-        strncpy(jkkRadio->jkkRadioStations[0].nameLong, "Polskie Radio Program Trzeci", sizeof(jkkRadio->jkkRadioStations[0].nameLong) - 1);
+        JkkStationStoreSetCold(&jkkRadio->jkkRadioStations[0], "http://mp3.polskieradio.pl:8904/", "Polskie Radio Program Trzeci");
         strncpy(jkkRadio->jkkRadioStations[0].nameShort, "PR3", sizeof(jkkRadio->jkkRadioStations[0].nameShort) - 1);
         jkkRadio->jkkRadioStations[0].is_favorite = false; // Default to not favorite
         jkkRadio->jkkRadioStations[0].type = JKK_RADIO_MUSIC; // Default to unknown type
         jkkRadio->jkkRadioStations[0].audioDes[0] = '\0'; // Default to empty audio description
-        ESP_LOGI(TAG, "No stations provided, initialized with default station: %s", jkkRadio->jkkRadioStations[0].nameLong);
+        ESP_LOGI(TAG, "No stations provided, initialized with default station: %s", jkkRadio->jkkRadioStations[0].nameShort);
         jkkRadio->station_count = 1; // Set station count to 1 for the default station
 #if defined(CONFIG_JKK_RADIO_USING_I2C_LCD) 
         JkkLcdReloadRoller(jkkRadio);
@@ -171,8 +260,9 @@ static void JkkRadioStationEmbeddedRead(JkkRadio_t *jkkRadio, char const *statio
         return;
     }
     if(jkkRadio->jkkRadioStations) {
-        free(jkkRadio->jkkRadioStations);
+        JkkStationStoreFree(jkkRadio->jkkRadioStations, jkkRadio->station_count);
         jkkRadio->jkkRadioStations = NULL;
+        jkkRadio->station_count = 0;
     }
     char *stations = heap_caps_calloc(1, strlen(stationsEmbedded) + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
     if (stations == NULL) {
@@ -210,17 +300,12 @@ static void JkkRadioStationEmbeddedRead(JkkRadio_t *jkkRadio, char const *statio
         char *type = strtok(NULL, ";\n");
         char *audioDes = strtok(NULL, ";\n");       
         if (uri) {
-            strncpy(jkkRadio->jkkRadioStations[i].uri, uri, sizeof(jkkRadio->jkkRadioStations[i].uri) - 1);
+            JkkStationStoreSetCold(&jkkRadio->jkkRadioStations[i], uri, nameLong);
             if (nameShort) {
                 strncpy(jkkRadio->jkkRadioStations[i].nameShort, nameShort, sizeof(jkkRadio->jkkRadioStations[i].nameShort) - 1);
             } else {
                 jkkRadio->jkkRadioStations[i].nameShort[0] = '\0'; // Default to empty if not provided
             }
-            if(nameLong) {
-                strncpy(jkkRadio->jkkRadioStations[i].nameLong, nameLong, sizeof(jkkRadio->jkkRadioStations[i].nameLong) - 1);
-            } else {
-                jkkRadio->jkkRadioStations[i].nameLong[0] = '\0'; // Default to empty if not provided
-            }
             if(is_favorite) {
                 jkkRadio->jkkRadioStations[i].is_favorite = (strcmp(is_favorite, "1") == 0);
             } else {
@@ -240,86 +325,48 @@ static void JkkRadioStationEmbeddedRead(JkkRadio_t *jkkRadio, char const *statio
         }
     }
     for (int i = 0; i < index; i++) {
+        char logUri[JKK_RADIO_STATION_URI_LEN];
+        char logName[JKK_RADIO_STATION_NAME_LEN];
         ESP_LOGI(TAG, "Station %d: URI=%s, NameShort=%s, NameLong=%s, Favorite=%s, Type=%d, Audio desc.=%s",
-                 i, jkkRadio->jkkRadioStations[i].uri,
+                 i, JkkStationStoreUri(jkkRadio->jkkRadioStations, index, i, logUri, sizeof(logUri)),
                  jkkRadio->jkkRadioStations[i].nameShort,
-                 jkkRadio->jkkRadioStations[i].nameLong,
+                 JkkStationStoreNameLong(jkkRadio->jkkRadioStations, index, i, logName, sizeof(logName)),
                  jkkRadio->jkkRadioStations[i].is_favorite ? "true" : "false",
                  jkkRadio->jkkRadioStations[i].type,
                  jkkRadio->jkkRadioStations[i].audioDes);
-        
-        char key[16] = {0};
-        sprintf(key, JKK_RADIO_NVS_STATION_KEY, i);
-        JkkNvsBlobSet(key, JKK_RADIO_NVS_NAMESPACE, &jkkRadio->jkkRadioStations[i], sizeof(JkkRadioStations_t)); // Save each station to NVS
     }
     free(stations); // Free the temporary string buffer
     jkkRadio->station_count = index;
+    JkkStationStoreSaveAll(jkkRadio->jkkRadioStations, index);
 #if defined(CONFIG_JKK_RADIO_USING_I2C_LCD) 
     JkkLcdReloadRoller(jkkRadio);
 #endif
 }
 
-static int JkkRadioStationNvsCount(void){
-    nvs_handle_t nvsHandle;
-    nvs_type_t type = NVS_TYPE_ANY;
-    int stationCount = 0;
-
-    esp_err_t ret = nvs_open(JKK_RADIO_NVS_NAMESPACE, NVS_READONLY, &nvsHandle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!\n", esp_err_to_name(ret));
-        return 0;
-    }
-    for(uint8_t i = 0; i < JKK_RADIO_MAX_STATIONS; i++) {
-        char key[16] = {0};
-        sprintf(key, JKK_RADIO_NVS_STATION_KEY, i);
-        ret = nvs_find_key(nvsHandle, key, &type);
-        if(ret == ESP_OK && type == NVS_TYPE_BLOB) {
-            stationCount++;
-        } else if (ret == ESP_ERR_NVS_NOT_FOUND) {
-            continue; // No more stations found
-        }
-    }
-
-    nvs_close(nvsHandle);
-    ESP_LOGI(TAG, "Found %d stations in NVS", stationCount);
-    return stationCount;
-}
-
 esp_err_t JkkRadioStationSdRead(JkkRadio_t *jkkRadio) {
     FILE *fptr;
-    int nvsStationCount = JkkRadioStationNvsCount();
+    int nvsStationCount = 0;
     int sdStationCount = 0;
+    uint64_t dirty = 0; // Chunks of changed stations (JKK_STORE_CHUNK_BIT)
 
-    if(nvsStationCount > 0) {
+    int64_t t0 = esp_timer_get_time();
+    uint32_t writes = JkkStationStoreWrites() + sdSyncWrites;
+    JkkRadioStations_t *nvsStations = NULL;
+    if(JkkStationStoreLoad(&nvsStations, &nvsStationCount) == ESP_OK) {
         if(jkkRadio->jkkRadioStations) {
-            free(jkkRadio->jkkRadioStations);
-            jkkRadio->jkkRadioStations = NULL;
-        }
-        jkkRadio->jkkRadioStations = heap_caps_calloc(nvsStationCount, sizeof(JkkRadioStations_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (jkkRadio->jkkRadioStations == NULL) {
-            ESP_LOGE(TAG, "Memory allocation failed for jkkRadio->jkkRadioStations");
-            return ESP_ERR_NO_MEM;
+            JkkStationStoreFree(jkkRadio->jkkRadioStations, jkkRadio->station_count);
         }
-        nvsStationCount = 0; // Reset count to fill from NVS
-        for(uint8_t i = 0; i < JKK_RADIO_MAX_STATIONS; i++) {
-            char key[16] = {0};
-            sprintf(key, JKK_RADIO_NVS_STATION_KEY, i);
-            if(JkkNvsBlobGet(key, JKK_RADIO_NVS_NAMESPACE, &jkkRadio->jkkRadioStations[nvsStationCount], NULL) == ESP_OK) {
-                ESP_LOGI(TAG, "Station from NVS %d: URI=%s, NameShort=%s, NameLong=%s, Favorite=%s, Type=%d, Audio desc.=%s",
-                     i, jkkRadio->jkkRadioStations[nvsStationCount].uri,
-                     jkkRadio->jkkRadioStations[nvsStationCount].nameShort,
-                     jkkRadio->jkkRadioStations[nvsStationCount].nameLong,
-                     jkkRadio->jkkRadioStations[nvsStationCount].is_favorite ? "true" : "false",
-                     jkkRadio->jkkRadioStations[nvsStationCount].type,
-                     jkkRadio->jkkRadioStations[nvsStationCount].audioDes);
-                nvsStationCount++;
-            } else {
-                continue; // No more stations found
-            }
+        jkkRadio->jkkRadioStations = nvsStations;
+        for(int i = 0; i < nvsStationCount; i++) {
+            ESP_LOGD(TAG, "Station from NVS %d: NameShort=%s, Favorite=%s, Type=%d, Audio desc.=%s",
+                 i, jkkRadio->jkkRadioStations[i].nameShort,
+                 jkkRadio->jkkRadioStations[i].is_favorite ? "true" : "false",
+                 jkkRadio->jkkRadioStations[i].type,
+                 jkkRadio->jkkRadioStations[i].audioDes);
         }
-        
         jkkRadio->station_count = nvsStationCount;
     }
+    int64_t tNvs = esp_timer_get_time();
 
     fptr = fopen("/sdcard/stations.txt", "r");
     if (fptr == NULL) {
@@ -333,38 +380,42 @@ esp_err_t JkkRadioStationSdRead(JkkRadio_t *jkkRadio) {
 #endif
         return ESP_OK;
     }
-
-    char lineStr[512];
-
-    while(fgets(lineStr, sizeof(lineStr), fptr)) {
-        if (lineStr[0] == '#' || lineStr[0] == '\n') continue; // Skip comments and empty lines
-        sdStationCount++;
-    }
-    ESP_LOGI(TAG, "Found %d stations in /sdcard/stations.txt", sdStationCount);
-    rewind(fptr); // Reset file pointer to the beginning
-    if(sdStationCount == 0) {
-        ESP_LOGW(TAG, "No stations found in /sdcard/stations.txt");
+    JkkRadioSdFileSig_t sig;
+    if (JkkRadioSdFileUnchanged("/sdcard/stations.txt", JKK_RADIO_NVS_SDSIG_STATIONS, &sig) && nvsStationCount > 0) {
         fclose(fptr);
-        JkkRadioStationEmbeddedRead(jkkRadio, stations_start);
-        return ESP_ERR_NOT_FOUND;
-    }
-    else if (sdStationCount > JKK_RADIO_MAX_STATIONS) {
-        ESP_LOGW(TAG, "Too many stations (%d) in /sdcard/stations.txt, limiting to JKK_RADIO_MAX_STATIONS", sdStationCount);
-        sdStationCount = JKK_RADIO_MAX_STATIONS; // Limit to JKK_RADIO_MAX_STATIONS stations
-    }
-    if( nvsStationCount < sdStationCount) {
-        
-        jkkRadio->jkkRadioStations = heap_caps_realloc(jkkRadio->jkkRadioStations, sdStationCount * sizeof(JkkRadioStations_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (jkkRadio->jkkRadioStations == NULL) {
-            ESP_LOGE(TAG, "Memory reallocation failed for jkkRadio->jkkRadioStations");
-            fclose(fptr);
-            return ESP_ERR_NO_MEM;
-        }
+        ESP_LOGI(TAG, "/sdcard/stations.txt unchanged, %d stations from NVS in %lld us, %lu NVS writes",
+                 nvsStationCount, esp_timer_get_time() - t0, (unsigned long)(JkkStationStoreWrites() + sdSyncWrites - writes));
+#if defined(CONFIG_JKK_RADIO_USING_I2C_LCD) 
+        JkkLcdReloadRoller(jkkRadio);
+#endif
+        return ESP_OK;
     }
-    
+
+    char lineStr[512];
+    int capacity = nvsStationCount;
     int index = 0;
-    while(fgets(lineStr, sizeof(lineStr), fptr)) {
+    sig.hash = JKK_RADIO_SDSIG_HASH_INIT; // Also when unchanged but NVS has no stations
+    while(JkkRadioSdFileGets(lineStr, sizeof(lineStr), fptr, &sig)) {
         if (lineStr[0] == '#' || lineStr[0] == '\n') continue; // Skip comments and empty lines
+        if (index >= JKK_RADIO_MAX_STATIONS) {
+            ESP_LOGW(TAG, "Too many stations in /sdcard/stations.txt, limiting to %d", JKK_RADIO_MAX_STATIONS);
+            JkkRadioSdFileHashRest(fptr, &sig);
+            break;
+        }
+        if (index >= capacity) {
+            // One pass over the file, array grows in steps instead of counting lines first
+            int newCapacity = capacity ? capacity * 2 : 16;
+            if (newCapacity > JKK_RADIO_MAX_STATIONS) newCapacity = JKK_RADIO_MAX_STATIONS;
+            JkkRadioStations_t *grown = heap_caps_realloc(jkkRadio->jkkRadioStations, newCapacity * sizeof(JkkRadioStations_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (grown == NULL) {
+                ESP_LOGE(TAG, "Memory reallocation failed for jkkRadio->jkkRadioStations");
+                fclose(fptr);
+                return ESP_ERR_NO_MEM;
+            }
+            memset(&grown[capacity], 0, (newCapacity - capacity) * sizeof(JkkRadioStations_t));
+            jkkRadio->jkkRadioStations = grown;
+            capacity = newCapacity;
+        }
         char *uri = strtok(lineStr, ";\n");
         char *nameShort = strtok(NULL, ";\n");
         char *nameLong = strtok(NULL, ";\n");
@@ -373,23 +424,26 @@ esp_err_t JkkRadioStationSdRead(JkkRadio_t *jkkRadio) {
         char *audioDes = strtok(NULL, ";\n");
         
         if (uri) {
-            char key[16] = {0};
-            sprintf(key, JKK_RADIO_NVS_STATION_KEY, index);
-            
-            if(jkkRadio->jkkRadioStations[index].addFrom != JKK_RADIO_ADD_FROM_WEB && (strcmp(uri, jkkRadio->jkkRadioStations[index].uri) || (nameShort && strcmp(nameShort, jkkRadio->jkkRadioStations[index].nameShort)) || (nameLong && strcmp(nameLong, jkkRadio->jkkRadioStations[index].nameLong)) || jkkRadio->jkkRadioStations[index].is_favorite != (is_favorite && strcmp(is_favorite, "1") == 0))) {
-
-                strncpy(jkkRadio->jkkRadioStations[index].uri, uri, sizeof(jkkRadio->jkkRadioStations[index].uri) - 1);
+            // uri and nameLong are compared by hash, their text stays in NVS until used
+            bool uriChanged = JkkStationStoreHash(uri, JKK_RADIO_STATION_URI_LEN - 1) != jkkRadio->jkkRadioStations[index].uriHash;
+            bool nameLongChanged = nameLong && JkkStationStoreHash(nameLong, JKK_RADIO_STATION_NAME_LEN - 1) != jkkRadio->jkkRadioStations[index].nameHash;
+            if(jkkRadio->jkkRadioStations[index].addFrom != JKK_RADIO_ADD_FROM_WEB && jkkRadio->jkkRadioStations[index].addFrom != JKK_RADIO_ADD_FROM_IMPORT && (uriChanged || (nameShort && strcmp(nameShort, jkkRadio->jkkRadioStations[index].nameShort)) || nameLongChanged || jkkRadio->jkkRadioStations[index].is_favorite != (is_favorite && strcmp(is_favorite, "1") == 0))) {
+
+                if(uriChanged) {
+                    memset(&jkkRadio->jkkRadioStations[index].fmt, 0, sizeof(JkkRadioStreamFmt_t)); // New stream, cached format no longer valid
+                    jkkRadio->jkkRadioStations[index].stalls = 0;
+                }
+                if(JkkStationStoreSetCold(&jkkRadio->jkkRadioStations[index], uri, nameLong) != ESP_OK) {
+                    ESP_LOGE(TAG, "Memory allocation failed for station %d", index);
+                    fclose(fptr);
+                    return ESP_ERR_NO_MEM;
+                }
 
                 if (nameShort) {
                     strncpy(jkkRadio->jkkRadioStations[index].nameShort, nameShort, sizeof(jkkRadio->jkkRadioStations[index].nameShort) - 1);
                 } else {
                     jkkRadio->jkkRadioStations[index].nameShort[0] = '\0'; // Default to empty if not provided
                 }
-                if(nameLong) {
-                    strncpy(jkkRadio->jkkRadioStations[index].nameLong, nameLong, sizeof(jkkRadio->jkkRadioStations[index].nameLong) - 1);
-                } else {
-                    jkkRadio->jkkRadioStations[index].nameLong[0] = '\0'; // Default to empty if not provided
-                }
                 if(is_favorite) {
                     jkkRadio->jkkRadioStations[index].is_favorite = (strcmp(is_favorite, "1") == 0);
                 } else {
@@ -407,50 +461,55 @@ esp_err_t JkkRadioStationSdRead(JkkRadio_t *jkkRadio) {
                     jkkRadio->jkkRadioStations[index].audioDes[0] = '\0'; // Default to empty if not provided
                 }
                 jkkRadio->jkkRadioStations[index].addFrom = JKK_RADIO_ADD_FROM_SD; // Mark as added from SD card
-                JkkNvsBlobSet(key, JKK_RADIO_NVS_NAMESPACE, &jkkRadio->jkkRadioStations[index], sizeof(JkkRadioStations_t)); // Save each station to NVS
+                dirty |= JKK_STORE_CHUNK_BIT(&jkkRadio->jkkRadioStations[index]); // 0 for new station, it gets its record in save
                 ESP_LOGI(TAG, "Updated station %d from file: URI=%s, NameShort=%s, NameLong=%s, Favorite=%s, Type=%d, Audio desc.=%s",
-                         index,
-                         jkkRadio->jkkRadioStations[index].uri,
+                         index, uri,
                          jkkRadio->jkkRadioStations[index].nameShort,
-                         jkkRadio->jkkRadioStations[index].nameLong,
+                         nameLong ? nameLong : "",
                          jkkRadio->jkkRadioStations[index].is_favorite ? "true" : "false",
                          jkkRadio->jkkRadioStations[index].type,
                          jkkRadio->jkkRadioStations[index].audioDes);
             }
             index++;
-            if (index >= sdStationCount) {
-                ESP_LOGI(TAG, "Reached end of station list(%d), stopping reading from file", sdStationCount);
-                break; // Stop reading if we reach the maximum count
-            }
         }
     }
+    sdStationCount = index;
+    int64_t tSd = esp_timer_get_time();
+    if(sdStationCount == 0) {
+        ESP_LOGW(TAG, "No stations found in /sdcard/stations.txt");
+        fclose(fptr);
+        JkkRadioStationEmbeddedRead(jkkRadio, stations_start);
+        return ESP_ERR_NOT_FOUND;
+    }
     if(index < nvsStationCount) {
-        // If there are more stations in NVS than in the file, remove the extra ones
+        // If there are more stations in NVS than in the file, keep only the ones added from web or import (they keep their NVS records)
         for(int i = index; i < nvsStationCount; i++) {
-            char key[16] = {0};
-            sprintf(key, JKK_RADIO_NVS_STATION_KEY, i);
-            ESP_LOGI(TAG, "Removing station %d from NVS: %s", i, key);
-            if(jkkRadio->jkkRadioStations[index].nameShort[0] != '\0' && jkkRadio->jkkRadioStations[index].uri[0] != '\0') {
-                if(jkkRadio->jkkRadioStations[index].addFrom != JKK_RADIO_ADD_FROM_WEB){
-                    JkkNvsErase(key, JKK_RADIO_NVS_NAMESPACE);
-                }
-                else {
-                    index++;
+            if((jkkRadio->jkkRadioStations[i].addFrom == JKK_RADIO_ADD_FROM_WEB || jkkRadio->jkkRadioStations[i].addFrom == JKK_RADIO_ADD_FROM_IMPORT) && jkkRadio->jkkRadioStations[i].uriHash != JkkStationStoreHash("", 0)) {
+                if(i != index) {
+                    jkkRadio->jkkRadioStations[index] = jkkRadio->jkkRadioStations[i];
+                    jkkRadio->jkkRadioStations[i].cold = NULL; // Moved
                 }
+                index++;
+            } else {
+                ESP_LOGI(TAG, "Removing station %d from NVS: %s", i, jkkRadio->jkkRadioStations[i].nameShort);
+                JkkStationStoreDropCold(&jkkRadio->jkkRadioStations[i]);
             }
         }
     }
+    if(dirty || index != nvsStationCount) { // New, removed or moved stations change only the order
+        JkkStationStoreSaveChanged(jkkRadio->jkkRadioStations, index, dirty);
+    }
 
     fclose(fptr);
-    ESP_LOGI(TAG, "Loaded %d stations from /sdcard/stations.txt", index);
+    JkkRadioSdFileSigSave(JKK_RADIO_NVS_SDSIG_STATIONS, &sig);
+    ESP_LOGI(TAG, "Loaded %d stations (%d in file, %d in NVS) in %lld us: NVS %lld us, file %lld us, save %lld us, %lu NVS writes",
+             index, sdStationCount, nvsStationCount, esp_timer_get_time() - t0, tNvs - t0, tSd - tNvs, esp_timer_get_time() - tSd,
+             (unsigned long)(JkkStationStoreWrites() + sdSyncWrites - writes));
 
-    ESP_LOGI(TAG, "Loaded stations:");
     for (int i = 0; i < index; i++) {
-        ESP_LOGI(TAG, "Station %d: URI=%s, NameShort=%s, NameLong=%s, Favorite=%s, Type=%d, Audio desc.=%s",
+        ESP_LOGD(TAG, "Station %d: NameShort=%s, Favorite=%s, Type=%d, Audio desc.=%s",
                  i,
-                 jkkRadio->jkkRadioStations[i].uri,
                  jkkRadio->jkkRadioStations[i].nameShort,
-                 jkkRadio->jkkRadioStations[i].nameLong,
                  jkkRadio->jkkRadioStations[i].is_favorite ? "true" : "false",
                  jkkRadio->jkkRadioStations[i].type,
                  jkkRadio->jkkRadioStations[i].audioDes);   
@@ -467,7 +526,7 @@ static int JkkRadioEqNvsCount(void){
     nvs_type_t type = NVS_TYPE_ANY;
     int eqCount = 0;
 
-    esp_err_t ret = nvs_open(JKK_RADIO_NVS_EQ_NAMESPACE, NVS_READONLY, &nvsHandle);
+    esp_err_t ret = JkkNvsOpen(JKK_RADIO_NVS_EQ_NAMESPACE, NVS_READONLY, &nvsHandle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!\n", esp_err_to_name(ret));
         return 0;
@@ -483,7 +542,6 @@ static int JkkRadioEqNvsCount(void){
         }
     }
 
-    nvs_close(nvsHandle);
     ESP_LOGI(TAG, "Found %d equalizers in NVS", eqCount);
     return eqCount;
 }
@@ -531,10 +589,21 @@ esp_err_t JkkRadioEqSdRead(JkkRadio_t *jkkRadio) {
 #endif
         return ESP_OK;
     }
+    uint32_t writes = sdSyncWrites;
+    JkkRadioSdFileSig_t sig;
+    if (JkkRadioSdFileUnchanged("/sdcard/eq.txt", JKK_RADIO_NVS_SDSIG_EQ, &sig) && nvsEqCount > 0) {
+        fclose(fptr);
+        ESP_LOGI(TAG, "/sdcard/eq.txt unchanged, %d equalizers from NVS, %lu NVS writes", nvsEqCount, (unsigned long)(sdSyncWrites - writes));
+#if defined(CONFIG_JKK_RADIO_USING_I2C_LCD) 
+        JkkLcdReloadRoller(jkkRadio);
+#endif
+        return ESP_OK;
+    }
 
     char lineStr[128];
 
-    while(fgets(lineStr, sizeof(lineStr), fptr)) {
+    sig.hash = JKK_RADIO_SDSIG_HASH_INIT; // Also when unchanged but NVS has no equalizers
+    while(JkkRadioSdFileGets(lineStr, sizeof(lineStr), fptr, &sig)) { // Counting pass hashes the whole file
         if (lineStr[0] == '#' || lineStr[0] == '\n') continue; // Skip comments and empty lines
         sdEqCount++;
     }
@@ -565,6 +634,8 @@ esp_err_t JkkRadioEqSdRead(JkkRadio_t *jkkRadio) {
     }
     
     int index = 0;
+    JkkNvsTx_t tx; // All changed equalizers in one commit
+    JkkNvsTxBegin(&tx, JKK_RADIO_NVS_EQ_NAMESPACE);
     while(fgets(lineStr, sizeof(lineStr), fptr)) {
         if (lineStr[0] == '#' || lineStr[0] == '\n') continue; // Skip comments and empty lines
         char *name = strtok(lineStr, ";,");
@@ -589,7 +660,8 @@ esp_err_t JkkRadioEqSdRead(JkkRadio_t *jkkRadio) {
                     jkkRadio->eqPresets[index].gain[i] = gains[i];
                 }
                 
-                JkkNvsBlobSet(key, JKK_RADIO_NVS_EQ_NAMESPACE, &jkkRadio->eqPresets[index], sizeof(JkkRadioEqualizer_t)); // Save each updated eq to NVS
+                JkkNvsTxBlobSet(&tx, key, &jkkRadio->eqPresets[index], sizeof(JkkRadioEqualizer_t)); // Save each updated eq to NVS
+                sdSyncWrites++;
                 ESP_LOGI(TAG, "Updated equalizers %d from file: name=%s",
                          index,
                          jkkRadio->eqPresets[index].name);
@@ -607,11 +679,14 @@ esp_err_t JkkRadioEqSdRead(JkkRadio_t *jkkRadio) {
             char key[16] = {0};
             sprintf(key, JKK_RADIO_NVS_EQUALIZER_KEY, i);
             ESP_LOGI(TAG, "Removing eq %d from NVS: %s", i, key);
-            JkkNvsErase(key, JKK_RADIO_NVS_EQ_NAMESPACE);
+            JkkNvsTxErase(&tx, key);
+            sdSyncWrites++;
         }
     }
+    JkkNvsTxCommit(&tx);
     fclose(fptr);
-    ESP_LOGI(TAG, "Loaded %d stations from /sdcard/eq.txt", index);
+    JkkRadioSdFileSigSave(JKK_RADIO_NVS_SDSIG_EQ, &sig);
+    ESP_LOGI(TAG, "Loaded %d equalizers from /sdcard/eq.txt, %lu NVS writes", index, (unsigned long)(sdSyncWrites - writes));
 
     ESP_LOGI(TAG, "Loaded equalizers:");
     for (int i = 0; i < index; i++) {
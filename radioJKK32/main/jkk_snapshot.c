@@ -0,0 +1,251 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Settings snapshot with A/B slots in NVS
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+
+#include "jkk_radio.h"
+#include "jkk_nvs.h"
+#include "jkk_mqtt.h"
+#include "jkk_snapshot.h"
+
+static const char *TAG = "JKK_SNAP";
+
+#define JKK_SNAPSHOT_BLOB_SIZE (sizeof(JkkSnapshotHeader_t) + sizeof(JkkSnapshot_t))
+
+static JkkSnapshot_t snapshot = {.mqttEnabled = true};
+static uint32_t snapshotSeq = 0;
+static int snapshotSlot = 1; // Slot holding current snapshot, next save goes to the other one
+static bool snapshotStored = false; // Current snapshot is in NVS
+static bool snapshotEraseOld = false; // Settings of older firmware are erased with next commit
+static SemaphoreHandle_t snapshotLock = NULL; // Saved from timer, event and web tasks
+
+static void JkkSnapshotLock(void) {
+    if (snapshotLock == NULL) {
+        snapshotLock = xSemaphoreCreateMutex(); // First call comes from boot (JkkSnapshotLoad)
+    }
+    xSemaphoreTake(snapshotLock, portMAX_DELAY);
+}
+
+static void JkkSnapshotUnlock(void) {
+    xSemaphoreGive(snapshotLock);
+}
+
+static uint32_t JkkSnapshotCrc(const JkkSnapshotHeader_t *hdr, const uint8_t *data, size_t len) {
+    JkkSnapshotHeader_t tmp = *hdr;
+    tmp.crc = 0;
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&tmp, sizeof(tmp));
+    return esp_rom_crc32_le(crc, data, len);
+}
+
+static void JkkSnapshotTerminate(JkkSnapshot_t *snap) {
+    snap->wifiSSID[sizeof(snap->wifiSSID) - 1] = '\0';
+    snap->wifiPassword[sizeof(snap->wifiPassword) - 1] = '\0';
+    snap->mqttBroker[sizeof(snap->mqttBroker) - 1] = '\0';
+    snap->mqttUser[sizeof(snap->mqttUser) - 1] = '\0';
+    snap->mqttPass[sizeof(snap->mqttPass) - 1] = '\0';
+}
+
+static esp_err_t JkkSnapshotReadSlot(int slot, JkkSnapshotHeader_t *hdr, JkkSnapshot_t *snap) {
+    uint8_t local[JKK_SNAPSHOT_BLOB_SIZE];
+    uint8_t *buf = local;
+    size_t len = 0;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    sprintf(key, JKK_SNAPSHOT_KEY, slot);
+    esp_err_t ret = JkkNvsBlobGet(key, JKK_RADIO_NVS_NAMESPACE, NULL, &len); // Length only
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (len < sizeof(JkkSnapshotHeader_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (len > sizeof(local)) { // Newer firmware, fields added at the end (CRC covers all of them)
+        buf = malloc(len);
+        if (buf == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    ret = JkkNvsBlobGet(key, JKK_RADIO_NVS_NAMESPACE, buf, &len);
+    if (ret == ESP_OK) {
+        memcpy(hdr, buf, sizeof(JkkSnapshotHeader_t));
+        if (hdr->magic != JKK_SNAPSHOT_MAGIC || hdr->slot != slot || hdr->length != len - sizeof(JkkSnapshotHeader_t)) {
+            ret = ESP_ERR_INVALID_VERSION;
+        } else if (JkkSnapshotCrc(hdr, buf + sizeof(JkkSnapshotHeader_t), hdr->length) != hdr->crc) {
+            ret = ESP_ERR_INVALID_CRC;
+        } else {
+            // Older version: new fields stay 0, newer version: unknown fields are skipped
+            memset(snap, 0, sizeof(JkkSnapshot_t));
+            memcpy(snap, buf + sizeof(JkkSnapshotHeader_t), MIN(hdr->length, sizeof(JkkSnapshot_t)));
+            JkkSnapshotTerminate(snap);
+        }
+    }
+    if (buf != local) {
+        free(buf);
+    }
+    return ret;
+}
+
+/* Keys of firmware without snapshot */
+static const char *const snapshotOldKeys[] = {
+    "stateStEq", "wifi_ssid", "wifi_password",
+    JKK_MQTT_NVS_KEY_ENABLED, JKK_MQTT_NVS_KEY_BROKER, JKK_MQTT_NVS_KEY_USER, JKK_MQTT_NVS_KEY_PASS,
+};
+
+/* Call locked */
+static esp_err_t JkkSnapshotWrite(const JkkSnapshot_t *snap) {
+    if (snapshotStored && memcmp(snap, &snapshot, sizeof(JkkSnapshot_t)) == 0) {
+        return ESP_OK; // Nothing changed
+    }
+    uint8_t buf[JKK_SNAPSHOT_BLOB_SIZE];
+    int slot = snapshotSlot ^ 1; // Newest snapshot is not touched
+    JkkSnapshotHeader_t hdr = {
+        .magic = JKK_SNAPSHOT_MAGIC,
+        .version = JKK_SNAPSHOT_VERSION,
+        .slot = slot,
+        .seq = snapshotSeq + 1,
+        .length = sizeof(JkkSnapshot_t),
+    };
+    memcpy(buf + sizeof(JkkSnapshotHeader_t), snap, sizeof(JkkSnapshot_t));
+    hdr.crc = JkkSnapshotCrc(&hdr, buf + sizeof(JkkSnapshotHeader_t), sizeof(JkkSnapshot_t));
+    memcpy(buf, &hdr, sizeof(JkkSnapshotHeader_t));
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    sprintf(key, JKK_SNAPSHOT_KEY, slot);
+    JkkNvsTx_t tx;
+    JkkNvsTxBegin(&tx, JKK_RADIO_NVS_NAMESPACE);
+    JkkNvsTxBlobSet(&tx, key, buf, sizeof(buf));
+    if (snapshotEraseOld) { // After the blob: if its write fails the old keys stay for next boot
+        for (int i = 0; i < sizeof(snapshotOldKeys) / sizeof(snapshotOldKeys[0]); i++) {
+            JkkNvsTxErase(&tx, snapshotOldKeys[i]);
+        }
+    }
+    esp_err_t ret = JkkNvsTxCommit(&tx);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Saving snapshot %lu failed (%s)", (unsigned long)hdr.seq, esp_err_to_name(ret));
+        return ret;
+    }
+    if (snapshotEraseOld) {
+        snapshotEraseOld = false;
+        ESP_LOGI(TAG, "Settings of older firmware erased");
+    }
+    snapshot = *snap;
+    snapshotSeq = hdr.seq;
+    snapshotSlot = slot;
+    snapshotStored = true;
+    ESP_LOGD(TAG, "Snapshot %lu saved in slot %d", (unsigned long)hdr.seq, slot);
+    return ESP_OK;
+}
+
+/* Settings of firmware without snapshot, each in own key */
+static void JkkSnapshotReadOld(JkkSnapshot_t *snap) {
+    memset(snap, 0, sizeof(JkkSnapshot_t));
+    uint64_t val = 0;
+    if (JkkNvs64_get("stateStEq", JKK_RADIO_NVS_NAMESPACE, &val) == ESP_OK) {
+        snap->state = val;
+        snap->stateValid = true;
+    }
+    val = 1;
+    JkkNvs64_get(JKK_MQTT_NVS_KEY_ENABLED, JKK_RADIO_NVS_NAMESPACE, &val);
+    snap->mqttEnabled = (val != 0);
+    size_t len = sizeof(snap->wifiSSID);
+    JkkNvsBlobGet("wifi_ssid", JKK_RADIO_NVS_NAMESPACE, snap->wifiSSID, &len);
+    len = sizeof(snap->wifiPassword);
+    JkkNvsBlobGet("wifi_password", JKK_RADIO_NVS_NAMESPACE, snap->wifiPassword, &len);
+    len = sizeof(snap->mqttBroker);
+    JkkNvsBlobGet(JKK_MQTT_NVS_KEY_BROKER, JKK_RADIO_NVS_NAMESPACE, snap->mqttBroker, &len);
+    len = sizeof(snap->mqttUser);
+    JkkNvsBlobGet(JKK_MQTT_NVS_KEY_USER, JKK_RADIO_NVS_NAMESPACE, snap->mqttUser, &len);
+    len = sizeof(snap->mqttPass);
+    JkkNvsBlobGet(JKK_MQTT_NVS_KEY_PASS, JKK_RADIO_NVS_NAMESPACE, snap->mqttPass, &len);
+    JkkSnapshotTerminate(snap);
+}
+
+esp_err_t JkkSnapshotLoad(void) {
+    JkkSnapshotHeader_t hdr[2];
+    JkkSnapshot_t snap[2];
+    int best = -1;
+    JkkSnapshotLock();
+    for (int slot = 0; slot < 2; slot++) {
+        esp_err_t ret = JkkSnapshotReadSlot(slot, &hdr[slot], &snap[slot]);
+        if (ret != ESP_OK) {
+            if (ret != ESP_ERR_NVS_NOT_FOUND) ESP_LOGW(TAG, "Snapshot slot %d not valid (%s)", slot, esp_err_to_name(ret)); // Power cut during its save
+            continue;
+        }
+        if (best < 0 || hdr[slot].seq > hdr[best].seq) {
+            best = slot;
+        }
+    }
+    if (best >= 0) {
+        snapshot = snap[best];
+        snapshotSeq = hdr[best].seq;
+        snapshotSlot = best;
+        snapshotStored = true;
+        snapshotEraseOld = false; // Erased by the commit of this snapshot
+        JkkSnapshotUnlock();
+        ESP_LOGI(TAG, "Snapshot %lu from slot %d", (unsigned long)snapshotSeq, best);
+        return ESP_OK;
+    }
+    JkkSnapshot_t old;
+    JkkSnapshotReadOld(&old);
+    snapshot = old;
+    snapshotStored = false;
+    snapshotEraseOld = true; // Until a snapshot commit succeeds the old keys are converted again at boot
+    JkkSnapshotWrite(&old); // Not stored yet, written even if equal
+    JkkSnapshotUnlock();
+    ESP_LOGW(TAG, "No snapshot, settings of older firmware converted");
+    return ESP_ERR_NOT_FOUND;
+}
+
+void JkkSnapshotGet(JkkSnapshot_t *snap) {
+    JkkSnapshotLock();
+    *snap = snapshot;
+    JkkSnapshotUnlock();
+}
+
+esp_err_t JkkSnapshotSave(const JkkSnapshot_t *snap) {
+    JkkSnapshotLock();
+    esp_err_t ret = JkkSnapshotWrite(snap);
+    JkkSnapshotUnlock();
+    return ret;
+}
+
+esp_err_t JkkSnapshotSetState(uint64_t state) {
+    JkkSnapshotLock();
+    JkkSnapshot_t snap = snapshot;
+    snap.state = state;
+    snap.stateValid = true;
+    esp_err_t ret = JkkSnapshotWrite(&snap);
+    JkkSnapshotUnlock();
+    return ret;
+}
+
+esp_err_t JkkSnapshotSetWifi(const char *ssid, const char *pass) {
+    JkkSnapshotLock();
+    JkkSnapshot_t snap = snapshot;
+    strlcpy(snap.wifiSSID, ssid ? ssid : "", sizeof(snap.wifiSSID));
+    strlcpy(snap.wifiPassword, pass ? pass : "", sizeof(snap.wifiPassword));
+    esp_err_t ret = JkkSnapshotWrite(&snap);
+    JkkSnapshotUnlock();
+    return ret;
+}
+
+esp_err_t JkkSnapshotSetMqtt(bool enabled, const char *broker, const char *user, const char *pass) {
+    JkkSnapshotLock();
+    JkkSnapshot_t snap = snapshot;
+    snap.mqttEnabled = enabled;
+    strlcpy(snap.mqttBroker, broker ? broker : "", sizeof(snap.mqttBroker));
+    strlcpy(snap.mqttUser, user ? user : "", sizeof(snap.mqttUser));
+    strlcpy(snap.mqttPass, pass ? pass : "", sizeof(snap.mqttPass));
+    esp_err_t ret = JkkSnapshotWrite(&snap);
+    JkkSnapshotUnlock();
+    return ret;
+}
@@ -0,0 +1,96 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Settings snapshot with A/B slots in NVS
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*  Player state, WiFi and MQTT settings are kept together in one versioned blob. Two slots ("snap0", "snap1")
+    are written in turn, each save goes to the slot not holding the newest snapshot, with one blob set and one
+    commit. Each slot has sequence number and CRC: at boot the valid slot with higher sequence is used, so a
+    power cut during save leaves the previous snapshot. Stations are not here, they have own store.
+    Settings of older firmware (stateStEq, wifi_ssid, wifi_password, mqtt_* keys) are read once, when there is
+    no valid slot, and are erased in the commit of the first snapshot. A slot written by newer firmware (longer
+    data, fields are only added at the end) is read up to the fields known here. */
+
+#define JKK_SNAPSHOT_VERSION (1)
+#define JKK_SNAPSHOT_KEY "snap%d" // Slot 0 and 1
+#define JKK_SNAPSHOT_MAGIC (0x4A4B) // "JK"
+
+typedef struct JkkSnapshot_s {
+    uint64_t state; // Station, equalizer, volume and playing (JkkRadioDataToSave_t)
+    bool stateValid; // false - state never saved, defaults are used
+    char wifiSSID[32];
+    char wifiPassword[64];
+    bool mqttEnabled;
+    char mqttBroker[80];
+    char mqttUser[33];
+    char mqttPass[65];
+} __attribute__((packed)) JkkSnapshot_t; // No padding: compared and CRC-ed as bytes
+
+typedef struct JkkSnapshotHeader_s {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t slot;
+    uint32_t seq; // Higher is newer
+    uint16_t length; // Of data after header, shorter data of older version is filled with zeros
+    uint16_t reserved;
+    uint32_t crc; // CRC32 of header (with crc 0) and data
+} JkkSnapshotHeader_t;
+
+/**
+ * @brief Load snapshot from NVS (or settings of older firmware), call once at boot before other functions
+ * @return ESP_OK if snapshot was read, ESP_ERR_NOT_FOUND if defaults or older settings are used
+ */
+esp_err_t JkkSnapshotLoad(void);
+
+/**
+ * @brief Copy of current snapshot
+ * @param snap Output
+ */
+void JkkSnapshotGet(JkkSnapshot_t *snap);
+
+/**
+ * @brief Save snapshot (nothing is written if it did not change)
+ * @param snap New snapshot
+ * @return ESP_OK on success
+ */
+esp_err_t JkkSnapshotSave(const JkkSnapshot_t *snap);
+
+/**
+ * @brief Save player state
+ * @param state JkkRadioDataToSave_t as 64 bit value
+ * @return ESP_OK on success
+ */
+esp_err_t JkkSnapshotSetState(uint64_t state);
+
+/**
+ * @brief Save WiFi credentials
+ * @param ssid WiFi SSID
+ * @param pass WiFi password
+ * @return ESP_OK on success
+ */
+esp_err_t JkkSnapshotSetWifi(const char *ssid, const char *pass);
+
+/**
+ * @brief Save MQTT settings
+ * @param enabled MQTT enabled
+ * @param broker Broker address ("" - mDNS discovery)
+ * @param user User name
+ * @param pass Password
+ * @return ESP_OK on success
+ */
+esp_err_t JkkSnapshotSetMqtt(bool enabled, const char *broker, const char *user, const char *pass);
+
+#ifdef __cplusplus
+}
+#endif
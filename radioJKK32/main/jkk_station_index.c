@@ -0,0 +1,285 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Station name index: exact long name lookup and search
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "jkk_station_store.h"
+#include "jkk_station_index.h"
+
+static const char *TAG = "JKK_INDEX";
+
+#define JKK_INDEX_GRAM_WORDS (JKK_INDEX_GRAM_BITS / 64)
+#define JKK_INDEX_TABLE_MIN (16)
+
+typedef struct JkkIndexGrams_s {
+    uint64_t bits[JKK_INDEX_GRAM_WORDS];
+} JkkIndexGrams_t;
+
+typedef struct JkkIndex_s {
+    JkkIndexGrams_t *grams; // One per station
+    uint16_t *table; // Station index + 1, 0 - empty slot
+    int tableSize; // Power of 2
+    int count; // Indexed stations
+    int cap; // Size of grams
+    bool valid;
+} JkkIndex_t;
+
+static JkkIndex_t idx = {0};
+static SemaphoreHandle_t indexLock = NULL; // Used from main, web and MQTT tasks
+
+static void JkkStationIndexLock(void) {
+    if (indexLock == NULL) {
+        indexLock = xSemaphoreCreateMutex(); // First call comes from boot (SD read), before other tasks search
+    }
+    xSemaphoreTake(indexLock, portMAX_DELAY);
+}
+
+static void JkkStationIndexUnlock(void) {
+    xSemaphoreGive(indexLock);
+}
+
+static inline uint8_t JkkIndexFold(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+/* Bytes of UTF-8 letters (>= 0x80) are part of words */
+static inline bool JkkIndexWordChar(uint8_t c) {
+    return c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/* Two bits per key, a common gram sharing one bit with the query does not make a candidate */
+static inline void JkkIndexSetBit(JkkIndexGrams_t *g, uint32_t key) {
+    uint32_t h = key * 2654435761u;
+    uint32_t bit1 = h % JKK_INDEX_GRAM_BITS;
+    uint32_t bit2 = (h >> 16) % JKK_INDEX_GRAM_BITS;
+    g->bits[bit1 / 64] |= 1ULL << (bit1 % 64);
+    g->bits[bit2 / 64] |= 1ULL << (bit2 % 64);
+}
+
+#define JKK_INDEX_KEY_TRI(a, b, c) (((uint32_t)(a) << 16) | ((uint32_t)(b) << 8) | (c))
+#define JKK_INDEX_KEY_WORD1(a) (0x1000000u | (a))
+#define JKK_INDEX_KEY_WORD2(a, b) (0x2000000u | ((uint32_t)(a) << 8) | (b))
+
+static void JkkIndexAddText(JkkIndexGrams_t *g, const char *txt) {
+    const uint8_t *t = (const uint8_t *)txt;
+    for (int i = 0; t[i]; i++) {
+        uint8_t a = JkkIndexFold(t[i]);
+        uint8_t b = t[i + 1] ? JkkIndexFold(t[i + 1]) : 0;
+        if (b && t[i + 2]) {
+            JkkIndexSetBit(g, JKK_INDEX_KEY_TRI(a, b, JkkIndexFold(t[i + 2])));
+        }
+        if (JkkIndexWordChar(a) && (i == 0 || !JkkIndexWordChar(t[i - 1]))) {
+            JkkIndexSetBit(g, JKK_INDEX_KEY_WORD1(a));
+            if (b) JkkIndexSetBit(g, JKK_INDEX_KEY_WORD2(a, b));
+        }
+    }
+}
+
+static void JkkIndexQueryGrams(JkkIndexGrams_t *g, const uint8_t *q, size_t len) {
+    memset(g, 0, sizeof(JkkIndexGrams_t));
+    if (len == 1) {
+        JkkIndexSetBit(g, JKK_INDEX_KEY_WORD1(q[0]));
+    } else if (len == 2) {
+        JkkIndexSetBit(g, JKK_INDEX_KEY_WORD2(q[0], q[1]));
+    } else {
+        for (size_t i = 0; i + 2 < len; i++) {
+            JkkIndexSetBit(g, JKK_INDEX_KEY_TRI(q[i], q[i + 1], q[i + 2]));
+        }
+    }
+}
+
+/* Folded query q: any part of name, or beginning of word for 1-2 letters */
+static bool JkkIndexTextMatch(const char *txt, const uint8_t *q, size_t len) {
+    const uint8_t *t = (const uint8_t *)txt;
+    for (size_t i = 0; t[i]; i++) {
+        if (len < 3 && (!JkkIndexWordChar(t[i]) || (i > 0 && JkkIndexWordChar(t[i - 1])))) continue;
+        size_t k = 0;
+        while (k < len && t[i + k] && JkkIndexFold(t[i + k]) == q[k]) k++;
+        if (k == len) return true;
+    }
+    return false;
+}
+
+static void JkkIndexStation(JkkRadioStations_t *stations, int count, int id) {
+    JkkIndexGrams_t *g = &idx.grams[id];
+    memset(g, 0, sizeof(JkkIndexGrams_t));
+    JkkIndexAddText(g, stations[id].nameShort);
+    char nameLong[JKK_RADIO_STATION_NAME_LEN];
+    if (JkkStationStoreNameLong(stations, count, id, nameLong, sizeof(nameLong))) JkkIndexAddText(g, nameLong);
+}
+
+static bool JkkIndexReserve(int count) {
+    if (count <= idx.cap) {
+        return true;
+    }
+    int cap = idx.cap ? idx.cap : 16;
+    while (cap < count) cap *= 2;
+    JkkIndexGrams_t *grams = heap_caps_realloc(idx.grams, cap * sizeof(JkkIndexGrams_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (grams == NULL) {
+        return false;
+    }
+    idx.grams = grams;
+    idx.cap = cap;
+    return true;
+}
+
+/* Only hot nameHash is used, cheap enough to do after every change */
+static bool JkkIndexTableBuild(JkkRadioStations_t *stations, int count) {
+    int size = JKK_INDEX_TABLE_MIN;
+    while (size < count * 2) size *= 2;
+    if (size != idx.tableSize) {
+        free(idx.table);
+        idx.table = heap_caps_malloc(size * sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        idx.tableSize = idx.table ? size : 0;
+        if (idx.table == NULL) {
+            return false;
+        }
+    }
+    memset(idx.table, 0, size * sizeof(uint16_t));
+    // Ascending order, so the lowest of stations with equal names is met first on lookup
+    for (int i = 0; i < count; i++) {
+        uint32_t slot = stations[i].nameHash & (size - 1);
+        while (idx.table[slot]) slot = (slot + 1) & (size - 1);
+        idx.table[slot] = i + 1;
+    }
+    return true;
+}
+
+static bool JkkIndexBuild(JkkRadioStations_t *stations, int count) {
+    int64_t t0 = esp_timer_get_time();
+    idx.valid = false;
+    if (!JkkIndexReserve(count) || !JkkIndexTableBuild(stations, count)) {
+        ESP_LOGE(TAG, "No memory for index of %d stations", count);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        JkkIndexStation(stations, count, i);
+    }
+    idx.count = count;
+    idx.valid = true;
+    ESP_LOGI(TAG, "Indexed %d stations in %lld us", count, esp_timer_get_time() - t0);
+    return true;
+}
+
+static bool JkkIndexReady(JkkRadioStations_t *stations, int count) {
+    if (idx.valid && idx.count == count) {
+        return true;
+    }
+    return JkkIndexBuild(stations, count);
+}
+
+void JkkStationIndexInvalidate(void) {
+    JkkStationIndexLock();
+    idx.valid = false;
+    JkkStationIndexUnlock();
+}
+
+void JkkStationIndexUpdate(JkkRadioStations_t *stations, int count, int id) {
+    JkkStationIndexLock();
+    if (idx.valid && id >= 0 && id < count && count <= idx.count + 1 && JkkIndexReserve(count)) {
+        JkkIndexStation(stations, count, id);
+        idx.count = count;
+        idx.valid = JkkIndexTableBuild(stations, count);
+    } else {
+        idx.valid = false;
+    }
+    JkkStationIndexUnlock();
+}
+
+void JkkStationIndexMove(JkkRadioStations_t *stations, int count, int oldIndex, int newIndex) {
+    JkkStationIndexLock();
+    if (idx.valid && idx.count == count && oldIndex >= 0 && oldIndex < count && newIndex >= 0 && newIndex < count) {
+        JkkIndexGrams_t moved = idx.grams[oldIndex];
+        if (oldIndex < newIndex) {
+            memmove(&idx.grams[oldIndex], &idx.grams[oldIndex + 1], (newIndex - oldIndex) * sizeof(JkkIndexGrams_t));
+        } else {
+            memmove(&idx.grams[newIndex + 1], &idx.grams[newIndex], (oldIndex - newIndex) * sizeof(JkkIndexGrams_t));
+        }
+        idx.grams[newIndex] = moved;
+        idx.valid = JkkIndexTableBuild(stations, count);
+    } else {
+        idx.valid = false;
+    }
+    JkkStationIndexUnlock();
+}
+
+void JkkStationIndexRemove(JkkRadioStations_t *stations, int count, int id) {
+    JkkStationIndexLock();
+    if (idx.valid && idx.count == count + 1 && id >= 0 && id <= count) {
+        memmove(&idx.grams[id], &idx.grams[id + 1], (count - id) * sizeof(JkkIndexGrams_t));
+        idx.count = count;
+        idx.valid = JkkIndexTableBuild(stations, count);
+    } else {
+        idx.valid = false;
+    }
+    JkkStationIndexUnlock();
+}
+
+int JkkStationIndexFind(JkkRadioStations_t *stations, int count, const char *name) {
+    if (name == NULL || stations == NULL || count <= 0) {
+        return -1;
+    }
+    int found = -1;
+    uint32_t hash = JkkStationStoreHash(name, JKK_RADIO_STATION_NAME_LEN - 1);
+    char nameLong[JKK_RADIO_STATION_NAME_LEN];
+    JkkStationIndexLock();
+    if (JkkIndexReady(stations, count)) {
+        uint32_t mask = idx.tableSize - 1;
+        for (uint32_t slot = hash & mask; idx.table[slot]; slot = (slot + 1) & mask) {
+            int id = idx.table[slot] - 1;
+            if (stations[id].nameHash != hash) continue;
+            if (JkkStationStoreNameLong(stations, count, id, nameLong, sizeof(nameLong)) && strncmp(nameLong, name, JKK_RADIO_STATION_NAME_LEN - 1) == 0) {
+                found = id;
+                break;
+            }
+        }
+    }
+    JkkStationIndexUnlock();
+    return found;
+}
+
+int JkkStationIndexSearch(JkkRadioStations_t *stations, int count, const char *query, int *ids, int max) {
+    if (query == NULL || ids == NULL || stations == NULL || count <= 0) {
+        return 0;
+    }
+    uint8_t q[JKK_RADIO_STATION_NAME_LEN];
+    size_t len = 0;
+    for (; query[len] && len < sizeof(q) - 1; len++) {
+        q[len] = JkkIndexFold(query[len]);
+    }
+    q[len] = '\0';
+    if (len == 0) {
+        return 0;
+    }
+    JkkIndexGrams_t want;
+    JkkIndexQueryGrams(&want, q, len);
+
+    int n = 0;
+    char nameLong[JKK_RADIO_STATION_NAME_LEN];
+    JkkStationIndexLock();
+    if (JkkIndexReady(stations, count)) {
+        for (int i = 0; i < count && n < max; i++) {
+            const JkkIndexGrams_t *g = &idx.grams[i];
+            bool maybe = true;
+            for (int w = 0; w < JKK_INDEX_GRAM_WORDS && maybe; w++) {
+                maybe = (g->bits[w] & want.bits[w]) == want.bits[w];
+            }
+            if (!maybe) continue;
+            // Candidates only: long name may have to be read from NVS
+            if (JkkIndexTextMatch(stations[i].nameShort, q, len) ||
+                (JkkStationStoreNameLong(stations, count, i, nameLong, sizeof(nameLong)) && JkkIndexTextMatch(nameLong, q, len))) {
+                ids[n++] = i;
+            }
+        }
+    }
+    JkkStationIndexUnlock();
+    return n;
+}
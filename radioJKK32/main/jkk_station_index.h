@@ -0,0 +1,78 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Station name index: exact long name lookup and search
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#include "jkk_radio.h"
+
+/*  Exact names: open addressing table of station numbers keyed by nameHash (hot part, no text is read to build it).
+    Search: per station bit set (JKK_INDEX_GRAM_BITS, two bits per gram) of trigrams of short and long name, plus first one and two
+    letters of each word. Only stations having all bits of the query are compared with text (long name read on demand).
+    ASCII letters are compared without case. Queries of 1-2 letters match beginning of words, longer ones any part of name.
+    Index is built on first use and then updated station by station. */
+
+#define JKK_INDEX_GRAM_BITS (512)
+#define JKK_INDEX_SEARCH_MAX (50) // Results of one search
+
+/**
+ * @brief Drop index, whole station list was replaced (rebuilt on next use)
+ */
+void JkkStationIndexInvalidate(void);
+
+/**
+ * @brief Index station added or edited
+ * @param stations Array of stations
+ * @param count Number of stations (with added one)
+ * @param id Station index
+ */
+void JkkStationIndexUpdate(JkkRadioStations_t *stations, int count, int id);
+
+/**
+ * @brief Follow station move (after it was moved in array)
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @param oldIndex Old place
+ * @param newIndex New place
+ */
+void JkkStationIndexMove(JkkRadioStations_t *stations, int count, int oldIndex, int newIndex);
+
+/**
+ * @brief Remove station (after it was removed from array)
+ * @param stations Array of stations
+ * @param count Number of stations (without removed one)
+ * @param id Removed station index
+ */
+void JkkStationIndexRemove(JkkRadioStations_t *stations, int count, int id);
+
+/**
+ * @brief Find station by exact long name
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @param name Long name
+ * @return Lowest station index with this name, -1 if not found
+ */
+int JkkStationIndexFind(JkkRadioStations_t *stations, int count, const char *name);
+
+/**
+ * @brief Search stations by part of short or long name
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @param query Text to search
+ * @param ids Output station indexes, ascending
+ * @param max Size of ids
+ * @return Number of stations written to ids
+ */
+int JkkStationIndexSearch(JkkRadioStations_t *stations, int count, const char *query, int *ids, int max);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,711 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Packed station records in NVS
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "nvs.h"
+
+#include "jkk_nvs.h"
+#include "jkk_station_store.h"
+
+static const char *TAG = "JKK_STORE";
+
+#define JKK_STORE_LEGACY_KEY "station%03X" // One full station blob per key (before packed records)
+#define JKK_STORE_LEGACY_MAX (50)
+#define JKK_STORE_MAX_CHUNKS ((JKK_RADIO_MAX_STATIONS + JKK_STORE_PER_CHUNK - 1) / JKK_STORE_PER_CHUNK)
+
+#define JKK_STORE_ID_CHUNK(id) (((id) - 1) / JKK_STORE_PER_CHUNK)
+#define JKK_STORE_CHUNK_ID(c, k) ((c) * JKK_STORE_PER_CHUNK + (k) + 1)
+
+_Static_assert(JKK_STORE_MAX_CHUNKS <= 64, "Chunk bitmap is 64 bits");
+
+enum {
+    JKK_STORE_TXT_URI = 0,
+    JKK_STORE_TXT_SHORT,
+    JKK_STORE_TXT_LONG,
+    JKK_STORE_TXT_DES,
+    JKK_STORE_TXT_NR,
+};
+
+typedef struct JkkStoreRec_s {
+    uint8_t flags;
+    uint8_t type;
+    uint8_t addFrom;
+    JkkRadioStreamFmt_t fmt;
+    const uint8_t *txt[JKK_STORE_TXT_NR]; // Not terminated, inside record
+    uint8_t txtLen[JKK_STORE_TXT_NR];
+} JkkStoreRec_t;
+
+/* Layout of station blob before packed records */
+typedef struct JkkStoreLegacyStation_s {
+    char uri[256];
+    char nameShort[32];
+    char nameLong[128];
+    char audioDes[16];
+    bool is_favorite;
+    int type;
+    int addFrom;
+    JkkRadioStreamFmt_t fmt;
+} JkkStoreLegacyStation_t;
+
+static SemaphoreHandle_t storeLock = NULL; // Cold parts are loaded from web and MQTT tasks too
+static uint32_t storeWrites = 0; // nvs_set/erase calls since boot
+
+static void JkkStationStoreLock(void) {
+    if (storeLock == NULL) {
+        storeLock = xSemaphoreCreateMutex(); // First call comes from boot, before other tasks use stations
+    }
+    xSemaphoreTake(storeLock, portMAX_DELAY);
+}
+
+static void JkkStationStoreUnlock(void) {
+    xSemaphoreGive(storeLock);
+}
+
+static uint32_t JkkStationStoreHashN(const char *txt, size_t len) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)txt[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t JkkStationStoreHash(const char *txt, size_t max) {
+    return txt ? JkkStationStoreHashN(txt, strnlen(txt, max)) : JkkStationStoreHashN("", 0);
+}
+
+static char *JkkStationStoreColdDup(const char *uri, size_t uriLen, const char *nameLong, size_t nameLen) {
+    char *cold = heap_caps_malloc(uriLen + nameLen + 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (cold) {
+        memcpy(cold, uri, uriLen);
+        cold[uriLen] = '\0';
+        memcpy(cold + uriLen + 1, nameLong, nameLen);
+        cold[uriLen + 1 + nameLen] = '\0';
+    }
+    return cold;
+}
+
+static const char *JkkStationStoreColdName(const char *cold) {
+    return cold + strlen(cold) + 1;
+}
+
+static esp_err_t JkkStationStoreColdSet(JkkRadioStations_t *st, const char *uri, const char *nameLong) {
+    if (uri == NULL) uri = "";
+    if (nameLong == NULL) nameLong = "";
+    size_t uriLen = strnlen(uri, JKK_RADIO_STATION_URI_LEN - 1);
+    size_t nameLen = strnlen(nameLong, JKK_RADIO_STATION_NAME_LEN - 1);
+    char *cold = JkkStationStoreColdDup(uri, uriLen, nameLong, nameLen);
+    if (cold == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    free(st->cold);
+    st->cold = cold;
+    st->uriHash = JkkStationStoreHashN(uri, uriLen);
+    st->nameHash = JkkStationStoreHashN(nameLong, nameLen);
+    return ESP_OK;
+}
+
+esp_err_t JkkStationStoreSetCold(JkkRadioStations_t *st, const char *uri, const char *nameLong) {
+    JkkStationStoreLock(); // Old cold part may be copied out by another task right now
+    esp_err_t ret = JkkStationStoreColdSet(st, uri, nameLong);
+    JkkStationStoreUnlock();
+    return ret;
+}
+
+void JkkStationStoreDropCold(JkkRadioStations_t *st) {
+    JkkStationStoreLock();
+    free(st->cold);
+    st->cold = NULL;
+    JkkStationStoreUnlock();
+}
+
+size_t JkkStationStorePack(const JkkRadioStations_t *st, const char *uri, const char *nameLong, uint8_t *buf, size_t size) {
+    const char *txt[JKK_STORE_TXT_NR] = {uri ? uri : "", st->nameShort, nameLong ? nameLong : "", st->audioDes};
+    const size_t txtMax[JKK_STORE_TXT_NR] = {JKK_RADIO_STATION_URI_LEN - 1, sizeof(st->nameShort) - 1, JKK_RADIO_STATION_NAME_LEN - 1, sizeof(st->audioDes) - 1};
+    size_t txtLen[JKK_STORE_TXT_NR];
+    size_t len = JKK_STORE_REC_FIXED;
+
+    for (int i = 0; i < JKK_STORE_TXT_NR; i++) {
+        txtLen[i] = strnlen(txt[i], txtMax[i]);
+        len += 1 + txtLen[i];
+    }
+    if (len > size) {
+        return 0;
+    }
+    buf[0] = len & 0xFF;
+    buf[1] = len >> 8;
+    buf[2] = st->is_favorite ? 0x01 : 0x00;
+    buf[3] = st->type;
+    buf[4] = st->addFrom;
+    buf[5] = st->fmt.sample_rate & 0xFF;
+    buf[6] = (st->fmt.sample_rate >> 8) & 0xFF;
+    buf[7] = (st->fmt.sample_rate >> 16) & 0xFF;
+    buf[8] = (st->fmt.sample_rate >> 24) & 0xFF;
+    buf[9] = st->fmt.channels;
+    buf[10] = st->fmt.bits;
+    buf[11] = st->fmt.codec;
+
+    uint8_t *p = buf + JKK_STORE_REC_FIXED;
+    for (int i = 0; i < JKK_STORE_TXT_NR; i++) {
+        *p++ = txtLen[i];
+        memcpy(p, txt[i], txtLen[i]);
+        p += txtLen[i];
+    }
+    return len;
+}
+
+static size_t JkkStationStoreParse(const uint8_t *buf, size_t len, JkkStoreRec_t *rec) {
+    if (len < JKK_STORE_REC_FIXED) {
+        return 0;
+    }
+    size_t recLen = buf[0] | (buf[1] << 8);
+    if (recLen < JKK_STORE_REC_FIXED || recLen > len) {
+        return 0;
+    }
+    memset(rec, 0, sizeof(JkkStoreRec_t));
+    rec->flags = buf[2];
+    rec->type = buf[3];
+    rec->addFrom = buf[4];
+    rec->fmt.sample_rate = buf[5] | (buf[6] << 8) | (buf[7] << 16) | ((uint32_t)buf[8] << 24);
+    rec->fmt.channels = buf[9];
+    rec->fmt.bits = buf[10];
+    rec->fmt.codec = buf[11];
+
+    const uint8_t *p = buf + JKK_STORE_REC_FIXED;
+    const uint8_t *end = buf + recLen;
+    for (int i = 0; i < JKK_STORE_TXT_NR; i++) {
+        if (p >= end) {
+            return 0;
+        }
+        rec->txtLen[i] = *p++;
+        if (p + rec->txtLen[i] > end) {
+            return 0;
+        }
+        rec->txt[i] = p;
+        p += rec->txtLen[i];
+    }
+    return recLen; // Fields of newer versions (after texts) are skipped
+}
+
+size_t JkkStationStoreUnpack(const uint8_t *buf, size_t len, JkkRadioStations_t *st) {
+    JkkStoreRec_t rec;
+    size_t recLen = JkkStationStoreParse(buf, len, &rec);
+    if (recLen == 0) {
+        return 0;
+    }
+    memset(st, 0, sizeof(JkkRadioStations_t));
+    st->is_favorite = rec.flags & 0x01;
+    st->type = rec.type;
+    st->addFrom = rec.addFrom;
+    st->fmt = rec.fmt;
+    memcpy(st->nameShort, rec.txt[JKK_STORE_TXT_SHORT], rec.txtLen[JKK_STORE_TXT_SHORT] < sizeof(st->nameShort) ? rec.txtLen[JKK_STORE_TXT_SHORT] : sizeof(st->nameShort) - 1);
+    memcpy(st->audioDes, rec.txt[JKK_STORE_TXT_DES], rec.txtLen[JKK_STORE_TXT_DES] < sizeof(st->audioDes) ? rec.txtLen[JKK_STORE_TXT_DES] : sizeof(st->audioDes) - 1);
+    st->uriHash = JkkStationStoreHashN((const char *)rec.txt[JKK_STORE_TXT_URI], rec.txtLen[JKK_STORE_TXT_URI]);
+    st->nameHash = JkkStationStoreHashN((const char *)rec.txt[JKK_STORE_TXT_LONG], rec.txtLen[JKK_STORE_TXT_LONG]);
+    return recLen; // Cold part stays NULL, read on demand
+}
+
+static esp_err_t JkkStationStoreReadChunk(nvs_handle_t nvsHandle, int c, uint8_t *chunk, size_t *len) {
+    char key[16] = {0};
+    sprintf(key, JKK_STORE_CHUNK_KEY, c);
+    *len = JKK_STORE_CHUNK_MAX;
+    esp_err_t ret = nvs_get_blob(nvsHandle, key, chunk, len);
+    if (ret == ESP_OK && (*len < 2 || chunk[0] != JKK_STORE_VERSION)) {
+        ret = ESP_ERR_INVALID_VERSION;
+    }
+    return ret;
+}
+
+/* List position of every storeId (-1 none), stations may be in any order */
+static int16_t *JkkStationStorePosMap(const JkkRadioStations_t *stations, int count) {
+    int16_t *pos = heap_caps_malloc((JKK_RADIO_MAX_STATIONS + 1) * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (pos == NULL) {
+        return NULL;
+    }
+    memset(pos, 0xFF, (JKK_RADIO_MAX_STATIONS + 1) * sizeof(int16_t));
+    for (int i = 0; i < count; i++) {
+        if (stations[i].storeId != 0 && stations[i].storeId <= JKK_RADIO_MAX_STATIONS) {
+            pos[stations[i].storeId] = i;
+        }
+    }
+    return pos;
+}
+
+/* Cold part is read from station's own record, stations keep it when they move in list.
+   Returns bit mask of chunk slots filled now. */
+static uint32_t JkkStationStoreColdFromChunk(nvs_handle_t nvsHandle, JkkRadioStations_t *stations, const int16_t *pos, int c, uint8_t *chunk) {
+    bool missing = false;
+    for (int k = 0; k < JKK_STORE_PER_CHUNK; k++) {
+        int id = JKK_STORE_CHUNK_ID(c, k);
+        if (id <= JKK_RADIO_MAX_STATIONS && pos[id] >= 0 && stations[pos[id]].cold == NULL) missing = true;
+    }
+    size_t len = 0;
+    if (!missing || JkkStationStoreReadChunk(nvsHandle, c, chunk, &len) != ESP_OK) {
+        return 0;
+    }
+    uint32_t filled = 0;
+    size_t off = 2;
+    for (int k = 0; k < chunk[1] && k < JKK_STORE_PER_CHUNK; k++) {
+        JkkStoreRec_t rec;
+        size_t used = JkkStationStoreParse(chunk + off, len - off, &rec);
+        if (used == 0) {
+            break;
+        }
+        off += used;
+        int id = JKK_STORE_CHUNK_ID(c, k);
+        if (id > JKK_RADIO_MAX_STATIONS || pos[id] < 0) continue; // Free record
+        JkkRadioStations_t *st = &stations[pos[id]];
+        if (st->cold == NULL) {
+            st->cold = JkkStationStoreColdDup((const char *)rec.txt[JKK_STORE_TXT_URI], rec.txtLen[JKK_STORE_TXT_URI],
+                                              (const char *)rec.txt[JKK_STORE_TXT_LONG], rec.txtLen[JKK_STORE_TXT_LONG]);
+            if (st->cold) filled |= 1u << k;
+        }
+    }
+    return filled;
+}
+
+/* Stations without storeId (new, or a copy with id of another one) get lowest free ids. Returns chunks of given ids. */
+static uint64_t JkkStationStoreAssignIds(JkkRadioStations_t *stations, int count) {
+    uint64_t used[(JKK_RADIO_MAX_STATIONS + 1 + 63) / 64] = {0};
+    for (int i = 0; i < count; i++) {
+        uint16_t id = stations[i].storeId;
+        if (id == 0 || id > JKK_RADIO_MAX_STATIONS || (used[id / 64] & (1ULL << (id % 64)))) {
+            stations[i].storeId = 0;
+        } else {
+            used[id / 64] |= 1ULL << (id % 64);
+        }
+    }
+    uint64_t chunkMask = 0;
+    uint16_t next = 1;
+    for (int i = 0; i < count; i++) {
+        if (stations[i].storeId != 0) continue;
+        while (used[next / 64] & (1ULL << (next % 64))) next++;
+        used[next / 64] |= 1ULL << (next % 64);
+        stations[i].storeId = next;
+        chunkMask |= 1ULL << JKK_STORE_ID_CHUNK(next);
+    }
+    return chunkMask;
+}
+
+/* Stored order: "stpk_ord", or record order of stores with "stpk_cnt" only. Returns number of ids, -1 if nothing is stored. */
+static int JkkStationStoreReadOrder(nvs_handle_t nvsHandle, uint16_t *order, bool *legacy) {
+    size_t len = JKK_RADIO_MAX_STATIONS * sizeof(uint16_t);
+    *legacy = false;
+    if (nvs_get_blob(nvsHandle, JKK_STORE_ORDER_KEY, order, &len) == ESP_OK) {
+        return len / sizeof(uint16_t);
+    }
+    uint16_t stored = 0;
+    if (nvs_get_u16(nvsHandle, JKK_STORE_COUNT_KEY, &stored) != ESP_OK) {
+        return -1;
+    }
+    *legacy = true;
+    if (stored > JKK_RADIO_MAX_STATIONS) stored = JKK_RADIO_MAX_STATIONS;
+    for (int i = 0; i < stored; i++) {
+        order[i] = i + 1;
+    }
+    return stored;
+}
+
+static int JkkStationStoreChunksUsed(const uint16_t *ids, int n) {
+    int chunks = 0;
+    for (int i = 0; i < n; i++) {
+        if (ids[i] != 0 && ids[i] <= JKK_RADIO_MAX_STATIONS && JKK_STORE_ID_CHUNK(ids[i]) + 1 > chunks) {
+            chunks = JKK_STORE_ID_CHUNK(ids[i]) + 1;
+        }
+    }
+    return chunks;
+}
+
+static esp_err_t JkkStationStoreWrite(nvs_handle_t nvsHandle, JkkRadioStations_t *stations, int count, uint64_t chunkMask) {
+    chunkMask |= JkkStationStoreAssignIds(stations, count);
+
+    uint16_t *order = heap_caps_malloc(2 * JKK_RADIO_MAX_STATIONS * sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *chunk = heap_caps_malloc(JKK_STORE_CHUNK_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    int16_t *pos = JkkStationStorePosMap(stations, count);
+    if (order == NULL || chunk == NULL || pos == NULL) {
+        free(order);
+        free(chunk);
+        free(pos);
+        return ESP_ERR_NO_MEM;
+    }
+    uint16_t *oldOrder = order + JKK_RADIO_MAX_STATIONS;
+    bool legacy = false;
+    int oldCount = JkkStationStoreReadOrder(nvsHandle, oldOrder, &legacy);
+    int oldChunks = oldCount > 0 ? JkkStationStoreChunksUsed(oldOrder, oldCount) : 0;
+    for (int i = 0; i < count; i++) {
+        order[i] = stations[i].storeId;
+    }
+    int chunks = JkkStationStoreChunksUsed(order, count);
+
+    esp_err_t ret = ESP_OK;
+    char key[16] = {0};
+    for (int c = 0; c < chunks && ret == ESP_OK; c++) {
+        if (!(chunkMask & (1ULL << c))) continue;
+        uint32_t loaded = JkkStationStoreColdFromChunk(nvsHandle, stations, pos, c, chunk);
+        int n = 0;
+        for (int k = 0; k < JKK_STORE_PER_CHUNK; k++) {
+            int id = JKK_STORE_CHUNK_ID(c, k);
+            if (id > JKK_RADIO_MAX_STATIONS || pos[id] < 0) continue;
+            n = k + 1;
+            if (stations[pos[id]].cold == NULL) ret = ESP_ERR_NOT_FOUND; // Old record not readable, packing would empty its uri and name
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Chunk %d not written, its stations can not be read", c);
+        } else if (n > 0) { // n == 0: all its stations deleted, nothing points to it
+            size_t len = 2;
+            for (int k = 0; k < n; k++) {
+                static const JkkRadioStations_t freeRec = {0}; // Record of deleted station
+                int i = pos[JKK_STORE_CHUNK_ID(c, k)];
+                const JkkRadioStations_t *st = i >= 0 ? &stations[i] : &freeRec;
+                len += JkkStationStorePack(st, st->cold, st->cold ? JkkStationStoreColdName(st->cold) : NULL, chunk + len, JKK_STORE_CHUNK_MAX - len);
+            }
+            chunk[0] = JKK_STORE_VERSION;
+            chunk[1] = n;
+            sprintf(key, JKK_STORE_CHUNK_KEY, c);
+            ret = nvs_set_blob(nvsHandle, key, chunk, len);
+            storeWrites++;
+            JkkNvsAccount(key, len, JKK_NVS_BLOB_ENTRIES(len));
+        }
+        for (int k = 0; k < JKK_STORE_PER_CHUNK; k++) {
+            if (loaded & (1u << k)) {
+                // Loaded only to be written back, nobody holds it yet
+                JkkRadioStations_t *st = &stations[pos[JKK_STORE_CHUNK_ID(c, k)]];
+                free(st->cold);
+                st->cold = NULL;
+            }
+        }
+    }
+    free(chunk);
+    free(pos);
+
+    if (ret == ESP_OK && (legacy || oldCount != count || memcmp(order, oldOrder, count * sizeof(uint16_t)))) {
+        ret = count ? nvs_set_blob(nvsHandle, JKK_STORE_ORDER_KEY, order, count * sizeof(uint16_t)) : nvs_erase_key(nvsHandle, JKK_STORE_ORDER_KEY);
+        storeWrites++;
+        JkkNvsAccount(JKK_STORE_ORDER_KEY, count * sizeof(uint16_t), count ? JKK_NVS_BLOB_ENTRIES(count * sizeof(uint16_t)) : 0);
+        if (ret == ESP_ERR_NVS_NOT_FOUND) ret = ESP_OK;
+    }
+    free(order);
+    if (ret == ESP_OK && legacy) {
+        nvs_erase_key(nvsHandle, JKK_STORE_COUNT_KEY); // Order is kept in "stpk_ord" now
+        storeWrites++;
+        JkkNvsAccount(JKK_STORE_COUNT_KEY, 0, 0);
+    }
+    for (int c = chunks; ret == ESP_OK && c < oldChunks; c++) {
+        sprintf(key, JKK_STORE_CHUNK_KEY, c);
+        nvs_erase_key(nvsHandle, key);
+        storeWrites++;
+        JkkNvsAccount(key, 0, 0);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvsHandle);
+        JkkNvsAccountCommit();
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Saving stations failed (%s)", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+/* One iterator pass instead of probing every possible key */
+static int JkkStationStoreScan(uint64_t *chunks, uint64_t *legacy) {
+    nvs_iterator_t it = NULL;
+    int entries = 0;
+    *chunks = 0;
+    *legacy = 0;
+
+    esp_err_t ret = nvs_entry_find(NVS_DEFAULT_PART_NAME, JKK_RADIO_NVS_NAMESPACE, NVS_TYPE_BLOB, &it);
+    while (ret == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        if (strncmp(info.key, "stpk", 4) == 0 && strcmp(info.key, JKK_STORE_ORDER_KEY) != 0) {
+            unsigned long c = strtoul(info.key + 4, NULL, 16);
+            if (c < JKK_STORE_MAX_CHUNKS) *chunks |= 1ULL << c;
+        } else if (strncmp(info.key, "station", 7) == 0) {
+            unsigned long i = strtoul(info.key + 7, NULL, 16);
+            if (i < JKK_STORE_LEGACY_MAX) *legacy |= 1ULL << i;
+        }
+        entries++;
+        ret = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    return entries;
+}
+
+static esp_err_t JkkStationStoreMigrate(nvs_handle_t nvsHandle, uint64_t legacy, JkkRadioStations_t **stations, int *count) {
+    JkkRadioStations_t *st = heap_caps_calloc(JKK_STORE_LEGACY_MAX, sizeof(JkkRadioStations_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    JkkStoreLegacyStation_t *old = heap_caps_malloc(sizeof(JkkStoreLegacyStation_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (st == NULL || old == NULL) {
+        free(st);
+        free(old);
+        return ESP_ERR_NO_MEM;
+    }
+    char key[16] = {0};
+    int n = 0;
+    for (int i = 0; i < JKK_STORE_LEGACY_MAX; i++) {
+        if (!(legacy & (1ULL << i))) continue;
+        sprintf(key, JKK_STORE_LEGACY_KEY, i);
+        memset(old, 0, sizeof(JkkStoreLegacyStation_t));
+        size_t len = sizeof(JkkStoreLegacyStation_t); // Blobs saved before fmt was added are shorter, fmt stays zero
+        if (nvs_get_blob(nvsHandle, key, old, &len) != ESP_OK) continue;
+        old->nameShort[sizeof(old->nameShort) - 1] = '\0';
+        old->audioDes[sizeof(old->audioDes) - 1] = '\0';
+        strcpy(st[n].nameShort, old->nameShort);
+        strcpy(st[n].audioDes, old->audioDes);
+        st[n].is_favorite = old->is_favorite;
+        st[n].type = old->type;
+        st[n].addFrom = old->addFrom;
+        st[n].fmt = old->fmt;
+        if (JkkStationStoreColdSet(&st[n], old->uri, old->nameLong) == ESP_OK) {
+            n++;
+        }
+    }
+    free(old);
+    if (n == 0) {
+        free(st);
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t ret = JkkStationStoreWrite(nvsHandle, st, n, ~0ULL);
+    if (ret == ESP_OK) {
+        for (int i = 0; i < JKK_STORE_LEGACY_MAX; i++) {
+            if (!(legacy & (1ULL << i))) continue;
+            sprintf(key, JKK_STORE_LEGACY_KEY, i);
+            nvs_erase_key(nvsHandle, key);
+            JkkNvsAccount(key, 0, 0);
+        }
+        nvs_commit(nvsHandle);
+        JkkNvsAccountCommit();
+        ESP_LOGW(TAG, "Converted %d stations to packed records", n);
+    }
+    *stations = st;
+    *count = n;
+    return ESP_OK; // Stations are usable even if conversion failed, it is repeated on next boot
+}
+
+esp_err_t JkkStationStoreLoad(JkkRadioStations_t **stations, int *count) {
+    int64_t t0 = esp_timer_get_time();
+    nvs_handle_t nvsHandle;
+    *stations = NULL;
+    *count = 0;
+
+    JkkStationStoreLock();
+    esp_err_t ret = JkkNvsOpen(JKK_RADIO_NVS_NAMESPACE, NVS_READWRITE, &nvsHandle);
+    if (ret != ESP_OK) {
+        JkkStationStoreUnlock();
+        ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!", esp_err_to_name(ret));
+        return ret;
+    }
+    uint64_t chunks, legacy;
+    int entries = JkkStationStoreScan(&chunks, &legacy);
+    int64_t tScan = esp_timer_get_time();
+
+    uint16_t *order = heap_caps_malloc(JKK_RADIO_MAX_STATIONS * sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (order == NULL) {
+        JkkStationStoreUnlock();
+        return ESP_ERR_NO_MEM;
+    }
+    bool legacyCount = false;
+    int stored = JkkStationStoreReadOrder(nvsHandle, order, &legacyCount);
+    if (stored < 0) {
+        free(order);
+        ret = legacy ? JkkStationStoreMigrate(nvsHandle, legacy, stations, count) : ESP_ERR_NOT_FOUND;
+        JkkStationStoreUnlock();
+        return ret;
+    }
+    JkkRadioStations_t *st = stored ? heap_caps_calloc(stored, sizeof(JkkRadioStations_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : NULL;
+    uint8_t *chunk = heap_caps_malloc(JKK_STORE_CHUNK_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    int16_t *pos = heap_caps_malloc((JKK_RADIO_MAX_STATIONS + 1) * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (st == NULL || chunk == NULL || pos == NULL) {
+        free(order);
+        free(st);
+        free(chunk);
+        free(pos);
+        JkkStationStoreUnlock();
+        return stored ? ESP_ERR_NO_MEM : ESP_ERR_NOT_FOUND;
+    }
+    memset(pos, 0xFF, (JKK_RADIO_MAX_STATIONS + 1) * sizeof(int16_t));
+    uint64_t needed = 0;
+    for (int i = 0; i < stored; i++) {
+        if (order[i] != 0 && order[i] <= JKK_RADIO_MAX_STATIONS && pos[order[i]] < 0) {
+            pos[order[i]] = i;
+            needed |= 1ULL << JKK_STORE_ID_CHUNK(order[i]);
+        }
+    }
+    free(order);
+
+    // Every needed chunk is read once, its records go to their places in list
+    int chunksRead = 0;
+    for (int c = 0; c < JKK_STORE_MAX_CHUNKS; c++) {
+        size_t len = 0;
+        if (!(needed & (1ULL << c))) continue;
+        if (!(chunks & (1ULL << c)) || JkkStationStoreReadChunk(nvsHandle, c, chunk, &len) != ESP_OK) {
+            ESP_LOGE(TAG, "Chunk %d missing or unknown version", c);
+            continue;
+        }
+        chunksRead++;
+        size_t off = 2;
+        for (int k = 0; k < chunk[1] && k < JKK_STORE_PER_CHUNK; k++) {
+            JkkRadioStations_t rec;
+            size_t used = JkkStationStoreUnpack(chunk + off, len - off, &rec);
+            if (used == 0) {
+                ESP_LOGE(TAG, "Broken record %d in chunk %d", k, c);
+                break;
+            }
+            off += used;
+            int id = JKK_STORE_CHUNK_ID(c, k);
+            if (id <= JKK_RADIO_MAX_STATIONS && pos[id] >= 0) {
+                st[pos[id]] = rec;
+                st[pos[id]].storeId = id;
+            }
+        }
+    }
+    free(chunk);
+    free(pos);
+    JkkStationStoreUnlock();
+
+    // Stations whose record could not be read are dropped, order is corrected on next save
+    int n = 0;
+    for (int i = 0; i < stored; i++) {
+        if (st[i].storeId != 0) st[n++] = st[i];
+    }
+    if (n == 0) {
+        free(st);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (n < stored) {
+        ESP_LOGW(TAG, "Only %d of %d stations loaded", n, stored);
+    }
+    *stations = st;
+    *count = n;
+    ESP_LOGI(TAG, "Loaded %d stations from %d chunks%s in %lld us (scan of %d entries %lld us)", n, chunksRead,
+             legacyCount ? " (record order)" : "", esp_timer_get_time() - t0, entries, tScan - t0);
+    return ESP_OK;
+}
+
+static esp_err_t JkkStationStoreColdLoad(JkkRadioStations_t *stations, int count, int first, int last) {
+    esp_err_t ret = ESP_OK;
+    uint64_t missing = 0;
+    for (int i = first; i <= last; i++) {
+        if (stations[i].cold == NULL && stations[i].storeId != 0 && stations[i].storeId <= JKK_RADIO_MAX_STATIONS) {
+            missing |= 1ULL << JKK_STORE_ID_CHUNK(stations[i].storeId);
+        }
+    }
+    if (missing) {
+        nvs_handle_t nvsHandle;
+        uint8_t *chunk = heap_caps_malloc(JKK_STORE_CHUNK_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        int16_t *pos = JkkStationStorePosMap(stations, count);
+        ret = (chunk && pos) ? JkkNvsOpen(JKK_RADIO_NVS_NAMESPACE, NVS_READONLY, &nvsHandle) : ESP_ERR_NO_MEM;
+        if (ret == ESP_OK) {
+            for (int c = 0; c < JKK_STORE_MAX_CHUNKS; c++) {
+                if (missing & (1ULL << c)) JkkStationStoreColdFromChunk(nvsHandle, stations, pos, c, chunk);
+            }
+        }
+        free(chunk);
+        free(pos);
+    }
+    for (int i = first; i <= last && ret == ESP_OK; i++) {
+        if (stations[i].cold == NULL) ret = ESP_ERR_NOT_FOUND;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Can not load stations %d..%d (%s)", first, last, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+esp_err_t JkkStationStoreLoadCold(JkkRadioStations_t *stations, int count, int first, int last) {
+    if (stations == NULL || first < 0 || last >= count || first > last) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    JkkStationStoreLock();
+    esp_err_t ret = JkkStationStoreColdLoad(stations, count, first, last);
+    JkkStationStoreUnlock();
+    return ret;
+}
+
+/* Copy is made under lock: cold part may be replaced or freed by another task as soon as it is released */
+static char *JkkStationStoreColdCopy(JkkRadioStations_t *stations, int count, int id, bool name, char *buf, size_t len) {
+    if (stations == NULL || id < 0 || id >= count || buf == NULL || len == 0) {
+        return NULL;
+    }
+    JkkStationStoreLock();
+    if (stations[id].cold == NULL) {
+        JkkStationStoreColdLoad(stations, count, id, id);
+    }
+    const char *cold = stations[id].cold;
+    strlcpy(buf, cold ? (name ? JkkStationStoreColdName(cold) : cold) : "", len);
+    JkkStationStoreUnlock();
+    return buf;
+}
+
+char *JkkStationStoreUri(JkkRadioStations_t *stations, int count, int id, char *buf, size_t len) {
+    return JkkStationStoreColdCopy(stations, count, id, false, buf, len);
+}
+
+char *JkkStationStoreNameLong(JkkRadioStations_t *stations, int count, int id, char *buf, size_t len) {
+    return JkkStationStoreColdCopy(stations, count, id, true, buf, len);
+}
+
+void JkkStationStoreFree(JkkRadioStations_t *stations, int count) {
+    if (stations == NULL) {
+        return;
+    }
+    JkkStationStoreLock();
+    for (int i = 0; i < count; i++) {
+        free(stations[i].cold);
+    }
+    free(stations);
+    JkkStationStoreUnlock();
+}
+
+static esp_err_t JkkStationStoreSave(JkkRadioStations_t *stations, int count, uint64_t chunkMask) {
+    if (count < 0 || (stations == NULL && count > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (count > JKK_RADIO_MAX_STATIONS) count = JKK_RADIO_MAX_STATIONS;
+
+    int64_t t0 = esp_timer_get_time();
+    nvs_handle_t nvsHandle;
+    JkkStationStoreLock();
+    esp_err_t ret = JkkNvsOpen(JKK_RADIO_NVS_NAMESPACE, NVS_READWRITE, &nvsHandle);
+    if (ret != ESP_OK) {
+        JkkStationStoreUnlock();
+        ESP_LOGE(TAG, "Error (%s) opening NVS nvsHandle!", esp_err_to_name(ret));
+        return ret;
+    }
+    uint32_t writes = storeWrites;
+    ret = JkkStationStoreWrite(nvsHandle, stations, count, chunkMask);
+    writes = storeWrites - writes;
+    JkkStationStoreUnlock();
+    ESP_LOGI(TAG, "Saved %d stations (%lu NVS writes) in %lld us", count, (unsigned long)writes, esp_timer_get_time() - t0);
+    return ret;
+}
+
+esp_err_t JkkStationStoreSaveOrder(JkkRadioStations_t *stations, int count) {
+    return JkkStationStoreSave(stations, count, 0);
+}
+
+esp_err_t JkkStationStoreSaveChanged(JkkRadioStations_t *stations, int count, uint64_t chunkMask) {
+    return JkkStationStoreSave(stations, count, chunkMask);
+}
+
+uint32_t JkkStationStoreWrites(void) {
+    return storeWrites;
+}
+
+esp_err_t JkkStationStoreSaveAll(JkkRadioStations_t *stations, int count) {
+    return JkkStationStoreSave(stations, count, ~0ULL);
+}
+
+esp_err_t JkkStationStoreSaveOne(JkkRadioStations_t *stations, int count, int id) {
+    if (id < 0 || id >= count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return JkkStationStoreSave(stations, count, JKK_STORE_CHUNK_BIT(&stations[id])); // New station gets its id and chunk in save
+}
@@ -0,0 +1,175 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Packed station records in NVS
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#include "jkk_radio.h"
+
+/*  Stations are kept in blobs "stpk%03X", JKK_STORE_PER_CHUNK records each. Record of station with storeId n is number
+    (n - 1) % JKK_STORE_PER_CHUNK in chunk (n - 1) / JKK_STORE_PER_CHUNK and stays there when station moves in list.
+    List order is blob "stpk_ord": storeIds (u16) in list order. Reorder and delete write only this blob, record of
+    deleted station stays until its chunk is written again (then it is an empty record, its id is given to next new station).
+    Stores without "stpk_ord" (number of stations in "stpk_cnt", u16) are read in record order and converted on first save.
+    Chunk: version (u8), count (u8), records.
+    Record: length (u16, whole record), flags (u8, bit 0 favorite), type (u8), addFrom (u8), sample rate (u32),
+    channels, bits, codec (u8), then uri, nameShort, nameLong, audioDes as length (u8) + text without '\0'.
+    Readers skip bytes after the known fields up to record length, so new fields can be added at the end.
+    Only hot part of stations is read at boot, uri and nameLong are read from their chunk on first use. They are
+    set, freed and copied out only under store lock, callers never keep a pointer to them.
+    Chunk is rewritten only when cold parts of all its stations are in RAM or could be read from it, otherwise
+    save returns ESP_ERR_NOT_FOUND and the stored chunk stays as it is. */
+
+#define JKK_STORE_VERSION (1)
+#define JKK_STORE_PER_CHUNK (8)
+#define JKK_STORE_CHUNK_KEY "stpk%03X"
+#define JKK_STORE_COUNT_KEY "stpk_cnt" // Before "stpk_ord"
+#define JKK_STORE_ORDER_KEY "stpk_ord"
+#define JKK_STORE_REC_FIXED (12) // Record length without texts
+#define JKK_STORE_REC_MAX (JKK_STORE_REC_FIXED + 4 + 255 + 31 + 127 + 15)
+#define JKK_STORE_CHUNK_MAX (2 + JKK_STORE_PER_CHUNK * JKK_STORE_REC_MAX)
+#define JKK_STORE_CHUNK_BIT(st) ((st)->storeId ? 1ULL << (((st)->storeId - 1) / JKK_STORE_PER_CHUNK) : 0) // Chunk of station in mask for JkkStationStoreSaveChanged
+
+/**
+ * @brief Pack one station into record
+ * @param st Station (hot part)
+ * @param uri URI of station
+ * @param nameLong Long name of station
+ * @param buf Output buffer
+ * @param size Size of buffer
+ * @return Record length, 0 if buffer is too small
+ */
+size_t JkkStationStorePack(const JkkRadioStations_t *st, const char *uri, const char *nameLong, uint8_t *buf, size_t size);
+
+/**
+ * @brief Unpack hot part of one record, cold part (uri, nameLong) is left for JkkStationStoreLoadCold
+ * @param buf Record
+ * @param len Bytes available in buffer
+ * @param st Output station (cleared first)
+ * @return Record length (bytes consumed), 0 if record is broken
+ */
+size_t JkkStationStoreUnpack(const uint8_t *buf, size_t len, JkkRadioStations_t *st);
+
+/**
+ * @brief Hash of station text, as kept in uriHash and nameHash
+ * @param txt Text
+ * @param max Maximum length taken (stored texts are cut to field size)
+ * @return Hash
+ */
+uint32_t JkkStationStoreHash(const char *txt, size_t max);
+
+/**
+ * @brief Set cold part of station (copy of texts) and its hashes
+ * @param st Station
+ * @param uri URI (NULL - empty)
+ * @param nameLong Long name (NULL - empty)
+ * @return ESP_OK on success, ESP_ERR_NO_MEM on failure
+ */
+esp_err_t JkkStationStoreSetCold(JkkRadioStations_t *st, const char *uri, const char *nameLong);
+
+/**
+ * @brief Free cold part of station (saved station, read from NVS again when needed)
+ * @param st Station
+ */
+void JkkStationStoreDropCold(JkkRadioStations_t *st);
+
+/**
+ * @brief Read cold parts of stations from NVS (whole chunks, neighbours are loaded too)
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @param first First station
+ * @param last Last station
+ * @return ESP_OK when all stations in range have cold part
+ */
+esp_err_t JkkStationStoreLoadCold(JkkRadioStations_t *stations, int count, int first, int last);
+
+/**
+ * @brief Copy URI of station, read from NVS on first use
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @param id Station index
+ * @param buf Output, "" if URI can not be read
+ * @param len Size of buf (JKK_RADIO_STATION_URI_LEN for whole URI)
+ * @return buf, NULL for wrong index
+ */
+char *JkkStationStoreUri(JkkRadioStations_t *stations, int count, int id, char *buf, size_t len);
+
+/**
+ * @brief Copy long name of station, read from NVS on first use
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @param id Station index
+ * @param buf Output, "" if name can not be read
+ * @param len Size of buf (JKK_RADIO_STATION_NAME_LEN for whole name)
+ * @return buf, NULL for wrong index
+ */
+char *JkkStationStoreNameLong(JkkRadioStations_t *stations, int count, int id, char *buf, size_t len);
+
+/**
+ * @brief Free station array with cold parts
+ * @param stations Array of stations
+ * @param count Number of stations
+ */
+void JkkStationStoreFree(JkkRadioStations_t *stations, int count);
+
+/**
+ * @brief Load all stations, stations in old layout (one blob per station) are converted on first boot
+ * @param stations Output array allocated in PSRAM (free with JkkStationStoreFree), NULL if no stations
+ * @param count Output number of stations
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if nothing is stored, other error code on failure
+ */
+esp_err_t JkkStationStoreLoad(JkkRadioStations_t **stations, int *count);
+
+/**
+ * @brief Save only list order (after reorder or delete), stations not stored yet are written too
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkStationStoreSaveOrder(JkkRadioStations_t *stations, int count);
+
+/**
+ * @brief Save all stations
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkStationStoreSaveAll(JkkRadioStations_t *stations, int count);
+
+/**
+ * @brief Save chunks marked in mask (JKK_STORE_CHUNK_BIT of changed stations), remove chunks no longer used
+ * Stations not stored yet get free storeId and their chunks are written too. Order is written only when it differs from stored one.
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @param chunkMask Chunks to write
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkStationStoreSaveChanged(JkkRadioStations_t *stations, int count, uint64_t chunkMask);
+
+/**
+ * @brief Get number of NVS writes (set and erase) done by station store since boot
+ * @return Write count
+ */
+uint32_t JkkStationStoreWrites(void);
+
+/**
+ * @brief Save only the chunk holding station id
+ * @param stations Array of stations
+ * @param count Number of stations
+ * @param id Changed station
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkStationStoreSaveOne(JkkRadioStations_t *stations, int count, int id);
+
+#ifdef __cplusplus
+}
+#endif
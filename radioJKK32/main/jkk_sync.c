@@ -0,0 +1,397 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Multi-room synchronised playback (leader / follower)
+ *
+ * Leader takes decoded PCM from raw split output and sends it in UDP blocks to
+ * every subscribed follower. Each block carries the time (leader wall clock,
+ * SNTP disciplined) when its first frame leaves the leader's own I2S.
+ * Follower keeps the offset to leader clock (NTP like exchange over LAN, on top
+ * of SNTP), holds the blocks and writes them to its raw input so they are heard
+ * at the same time. Remaining error (clock drift) is removed by slipping or
+ * repeating single frames.
+*/
+
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include "audio_element.h"
+#include "raw_stream.h"
+#include "ringbuf.h"
+
+#include "jkk_radio.h"
+#include "jkk_audio_main.h"
+#include "jkk_sync.h"
+#include "jkk_sync_time.h"
+
+static const char *TAG = "JKK_SYNC";
+
+#ifndef CONFIG_JKK_RADIO_SYNC_PORT
+#define CONFIG_JKK_RADIO_SYNC_PORT (5075)
+#endif
+#ifndef CONFIG_JKK_RADIO_SYNC_LEADER_HOST
+#define CONFIG_JKK_RADIO_SYNC_LEADER_HOST "192.168.1.2"
+#endif
+
+#define JKK_SYNC_PAYLOAD (1152) // Whole frames for 1/2 ch and 16/24/32 bits
+#define JKK_SYNC_MAX_FOLLOWERS (4)
+#define JKK_SYNC_FOLLOWER_TIMEOUT_US (3 * 1000 * 1000)
+#define JKK_SYNC_TIME_REQ_PERIOD_US (500 * 1000)
+#define JKK_SYNC_POOL (96) // About 0.6 s of 44.1 kHz stereo held by follower
+#define JKK_SYNC_STATS_PERIOD_US (10 * 1000 * 1000)
+
+typedef struct JkkSyncPkt_s {
+    JkkSyncHdr_t hdr;
+    uint8_t data[JKK_SYNC_PAYLOAD];
+} JkkSyncPkt_t;
+
+typedef struct JkkSyncFollowerAddr_s {
+    struct sockaddr_in addr;
+    int64_t lastSeen;
+} JkkSyncFollowerAddr_t;
+
+typedef struct JkkSync_s {
+    int sock;
+    audio_element_handle_t el; // Leader: split, follower: raw input
+    ringbuf_handle_t tap;
+    volatile int rate;
+    volatile int channels;
+    volatile int bits;
+    uint32_t seq;
+    JkkSyncFollowerAddr_t followers[JKK_SYNC_MAX_FOLLOWERS];
+    portMUX_TYPE mux; // Leader: followers, follower: off (64-bit offset is not written in one store)
+    // Follower
+    struct sockaddr_in leader;
+    JkkSyncPkt_t *pool;
+    JkkSyncPkt_t scratch; // Receives time replies (and drops audio) when pool is exhausted
+    QueueHandle_t freeQ;
+    QueueHandle_t readyQ;
+    JkkSyncOffset_t off;
+    JkkSyncPlay_t play;
+    uint32_t lost;
+} JkkSync_t;
+
+static EXT_RAM_BSS_ATTR JkkSync_t jkkSync;
+
+static int64_t JkkSyncNowUs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static bool JkkSyncClockValid(void) {
+    return time(NULL) > EPOCH_TIMESTAMP; // SNTP synced at least once
+}
+
+static int JkkSyncSocket(uint16_t port) {
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        return -1;
+    }
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "Failed to bind port %d: errno %d", port, errno);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/* ── Leader ─────────────────────────────────────────────── */
+
+static void JkkSyncLeaderTimeTask(void *arg) {
+    JkkSyncHdr_t req;
+    struct sockaddr_in from;
+    while (1) {
+        socklen_t fromLen = sizeof(from);
+        int r = recvfrom(jkkSync.sock, &req, sizeof(req), 0, (struct sockaddr *)&from, &fromLen);
+        int64_t t2 = JkkSyncNowUs();
+        if (r != sizeof(req) || req.magic != JKK_SYNC_MAGIC || req.type != JKK_SYNC_PKT_TIME_REQ) {
+            continue;
+        }
+        req.type = JKK_SYNC_PKT_TIME_REPLY;
+        req.t2 = t2;
+        req.t3 = JkkSyncNowUs();
+        sendto(jkkSync.sock, &req, sizeof(req), 0, (struct sockaddr *)&from, fromLen);
+
+        // Every request also keeps the follower subscribed
+        int freeSlot = -1;
+        bool known = false;
+        portENTER_CRITICAL(&jkkSync.mux);
+        for (int i = 0; i < JKK_SYNC_MAX_FOLLOWERS; i++) {
+            JkkSyncFollowerAddr_t *f = &jkkSync.followers[i];
+            if (f->lastSeen && f->addr.sin_addr.s_addr == from.sin_addr.s_addr && f->addr.sin_port == from.sin_port) {
+                f->lastSeen = t2;
+                known = true;
+                break;
+            }
+            if (freeSlot < 0 && (f->lastSeen == 0 || t2 - f->lastSeen > JKK_SYNC_FOLLOWER_TIMEOUT_US)) {
+                freeSlot = i;
+            }
+        }
+        if (!known && freeSlot >= 0) {
+            jkkSync.followers[freeSlot].addr = from;
+            jkkSync.followers[freeSlot].lastSeen = t2;
+        }
+        portEXIT_CRITICAL(&jkkSync.mux);
+        if (!known) {
+            char ip[16];
+            inet_ntoa_r(from.sin_addr, ip, sizeof(ip));
+            ESP_LOGI(TAG, "Follower %s %s", ip, freeSlot >= 0 ? "subscribed" : "rejected, no free slot");
+        }
+    }
+}
+
+static void JkkSyncLeaderTask(void *arg) {
+    JkkSyncPkt_t *pkt = heap_caps_calloc(1, sizeof(JkkSyncPkt_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    int filled = 0;
+    int sendSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (pkt == NULL || sendSock < 0) {
+        ESP_LOGE(TAG, "Leader task init failed");
+        vTaskDelete(NULL);
+        return;
+    }
+    pkt->hdr.magic = JKK_SYNC_MAGIC;
+    pkt->hdr.type = JKK_SYNC_PKT_AUDIO;
+
+    while (1) {
+        int r = rb_read(jkkSync.tap, (char *)pkt->data + filled, JKK_SYNC_PAYLOAD - filled, pdMS_TO_TICKS(100));
+        if (r == RB_DONE || r == RB_ABORT) {
+            rb_reset(jkkSync.tap); // Pipeline stopped or station changed, start from new data
+            filled = 0;
+            continue;
+        }
+        if (r <= 0) continue;
+        filled += r;
+        if (filled < JKK_SYNC_PAYLOAD) continue;
+        filled = 0;
+
+        int rate = jkkSync.rate;
+        int ch = jkkSync.channels;
+        int bits = jkkSync.bits;
+        int lat = JkkAudioMainBufferedUs(false);
+        if (rate <= 0 || lat < 0 || !JkkSyncClockValid()) continue;
+
+        int64_t bytesPerSec = (int64_t)rate * JkkSyncFrameBytes(ch, bits);
+        int64_t behind = rb_bytes_filled(jkkSync.tap) + JKK_SYNC_PAYLOAD;
+        pkt->hdr.t1 = JkkSyncPlayTime(JkkSyncNowUs(), lat, behind, bytesPerSec);
+        pkt->hdr.seq = jkkSync.seq++;
+        pkt->hdr.sample_rate = rate;
+        pkt->hdr.channels = ch;
+        pkt->hdr.bits = bits;
+        pkt->hdr.len = JKK_SYNC_PAYLOAD;
+
+        int64_t now = JkkSyncNowUs();
+        for (int i = 0; i < JKK_SYNC_MAX_FOLLOWERS; i++) {
+            struct sockaddr_in to;
+            bool active;
+            portENTER_CRITICAL(&jkkSync.mux);
+            active = jkkSync.followers[i].lastSeen && now - jkkSync.followers[i].lastSeen < JKK_SYNC_FOLLOWER_TIMEOUT_US;
+            to = jkkSync.followers[i].addr;
+            portEXIT_CRITICAL(&jkkSync.mux);
+            if (active) {
+                sendto(sendSock, pkt, sizeof(JkkSyncHdr_t) + JKK_SYNC_PAYLOAD, MSG_DONTWAIT, (struct sockaddr *)&to, sizeof(to));
+            }
+        }
+    }
+}
+
+esp_err_t JkkSyncLeaderStart(audio_element_handle_t split, int splitOut) {
+    if (split == NULL) {
+        ESP_LOGE(TAG, "Raw split element is not initialized");
+        return ESP_ERR_INVALID_ARG;
+    }
+    portMUX_INITIALIZE(&jkkSync.mux);
+    jkkSync.el = split;
+    jkkSync.tap = rb_create(8 * 1024, 1);
+    if (jkkSync.tap == NULL) {
+        ESP_LOGE(TAG, "Failed to create tap ring buffer");
+        return ESP_ERR_NO_MEM;
+    }
+    audio_element_set_multi_output_ringbuf(split, jkkSync.tap, splitOut);
+
+    jkkSync.sock = JkkSyncSocket(CONFIG_JKK_RADIO_SYNC_PORT);
+    if (jkkSync.sock < 0) {
+        return ESP_FAIL;
+    }
+    xTaskCreatePinnedToCore(JkkSyncLeaderTimeTask, "syncTime", 3 * 1024, NULL, 10, NULL, 0);
+    xTaskCreatePinnedToCore(JkkSyncLeaderTask, "syncLead", 3 * 1024, NULL, 8, NULL, 0);
+    ESP_LOGI(TAG, "Multi-room leader on port %d", CONFIG_JKK_RADIO_SYNC_PORT);
+    return ESP_OK;
+}
+
+void JkkSyncSetFormat(int rate, int ch, int bits) {
+    jkkSync.rate = rate;
+    jkkSync.channels = ch;
+    jkkSync.bits = bits;
+}
+
+/* ── Follower ───────────────────────────────────────────── */
+
+static void JkkSyncFollowerRxTask(void *arg) {
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 100 * 1000 };
+    setsockopt(jkkSync.sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int64_t lastReq = 0;
+    uint8_t idx = 0;
+    bool haveIdx = false;
+
+    while (1) {
+        int64_t now = JkkSyncNowUs();
+        if (now - lastReq > JKK_SYNC_TIME_REQ_PERIOD_US) {
+            lastReq = now;
+            JkkSyncHdr_t req = {
+                .magic = JKK_SYNC_MAGIC,
+                .type = JKK_SYNC_PKT_TIME_REQ,
+                .t1 = JkkSyncNowUs(),
+            };
+            sendto(jkkSync.sock, &req, sizeof(req), 0, (struct sockaddr *)&jkkSync.leader, sizeof(jkkSync.leader));
+        }
+
+        if (!haveIdx) {
+            haveIdx = xQueueReceive(jkkSync.freeQ, &idx, 0) == pdTRUE;
+            if (!haveIdx) {
+                // Player is not taking blocks (pipeline stopped), reuse the oldest one
+                haveIdx = xQueueReceive(jkkSync.readyQ, &idx, 0) == pdTRUE;
+                if (haveIdx) jkkSync.lost++;
+            }
+        }
+        JkkSyncPkt_t *pkt = haveIdx ? &jkkSync.pool[idx] : &jkkSync.scratch;
+        int r = recv(jkkSync.sock, pkt, sizeof(JkkSyncPkt_t), 0);
+        int64_t t4 = JkkSyncNowUs();
+        if (r < (int)sizeof(JkkSyncHdr_t) || pkt->hdr.magic != JKK_SYNC_MAGIC) continue;
+
+        if (pkt->hdr.type == JKK_SYNC_PKT_TIME_REPLY) {
+            portENTER_CRITICAL(&jkkSync.mux);
+            JkkSyncOffsetUpdate(&jkkSync.off, &pkt->hdr, t4);
+            portEXIT_CRITICAL(&jkkSync.mux);
+        } else if (pkt->hdr.type == JKK_SYNC_PKT_AUDIO && haveIdx && pkt->hdr.len == r - (int)sizeof(JkkSyncHdr_t)) {
+            xQueueSend(jkkSync.readyQ, &idx, 0);
+            haveIdx = false;
+        }
+    }
+}
+
+static int64_t JkkSyncOutNow(void *ctx) {
+    return JkkSyncNowUs();
+}
+
+static int JkkSyncOutLatency(void *ctx) {
+    return JkkAudioMainBufferedUs(true);
+}
+
+static void JkkSyncOutWrite(void *ctx, const uint8_t *data, int len) {
+    raw_stream_write(jkkSync.el, (char *)data, len);
+}
+
+static void JkkSyncFollowerPlayTask(void *arg) {
+    uint8_t idx;
+    uint32_t expected = 0;
+    bool expectedValid = false;
+    int rate = 0, ch = 0, bits = 0;
+    int64_t statsTime = 0;
+    JkkSyncPlay_t *play = &jkkSync.play;
+    play->out = (JkkSyncOut_t){ .now = JkkSyncOutNow, .latency = JkkSyncOutLatency, .write = JkkSyncOutWrite };
+
+    while (1) {
+        if (xQueueReceive(jkkSync.readyQ, &idx, pdMS_TO_TICKS(500)) != pdTRUE) {
+            expectedValid = false; // Leader stopped
+            play->running = false;
+            continue;
+        }
+        JkkSyncPkt_t *pkt = &jkkSync.pool[idx];
+        JkkSyncHdr_t *hdr = &pkt->hdr;
+
+        if (hdr->sample_rate != rate || hdr->channels != ch || hdr->bits != bits) {
+            rate = hdr->sample_rate;
+            ch = hdr->channels;
+            bits = hdr->bits;
+            ESP_LOGI(TAG, "Leader format %d Hz, %d ch, %d bits", rate, ch, bits);
+            JkkRadioSendMessageToMain(JkkSyncFormatPack(rate, ch, bits), JKK_RADIO_CMD_SYNC_FORMAT);
+            play->slip = (JkkSyncSlip_t){0};
+            play->running = false; // Output chain is set again
+        }
+        if (expectedValid && hdr->seq != expected) {
+            if ((int32_t)(hdr->seq - expected) < 0) { // Old or duplicated block
+                xQueueSend(jkkSync.freeQ, &idx, 0);
+                continue;
+            }
+            jkkSync.lost += hdr->seq - expected;
+        }
+        expected = hdr->seq + 1;
+        expectedValid = true;
+
+        portENTER_CRITICAL(&jkkSync.mux);
+        bool offValid = jkkSync.off.valid;
+        int64_t offsetUs = jkkSync.off.offsetUs;
+        portEXIT_CRITICAL(&jkkSync.mux);
+        if (offValid || JkkSyncClockValid()) {
+            JkkSyncPlayBlock(play, hdr, pkt->data, offsetUs);
+        }
+        xQueueSend(jkkSync.freeQ, &idx, 0);
+
+        int64_t now = JkkSyncNowUs();
+        if (now - statsTime > JKK_SYNC_STATS_PERIOD_US) {
+            statsTime = now;
+            ESP_LOGI(TAG, "Skew %d us (max %d), offset %lld us, lost %lu, late %lu, early %lu, slipped %lu, repeated %lu, padded %lu",
+                     play->slip.errEma, play->errMax, offsetUs, (unsigned long)jkkSync.lost, (unsigned long)play->late,
+                     (unsigned long)play->early, (unsigned long)play->slips, (unsigned long)play->dups, (unsigned long)play->pads);
+            play->errMax = 0;
+        }
+    }
+}
+
+esp_err_t JkkSyncFollowerStart(audio_element_handle_t rawIn) {
+    if (rawIn == NULL) {
+        ESP_LOGE(TAG, "Raw input element is not initialized");
+        return ESP_ERR_INVALID_ARG;
+    }
+    portMUX_INITIALIZE(&jkkSync.mux);
+    jkkSync.el = rawIn;
+
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_DGRAM };
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(CONFIG_JKK_RADIO_SYNC_LEADER_HOST, NULL, &hints, &res) != 0 || res == NULL) {
+        ESP_LOGE(TAG, "Can not resolve leader %s", CONFIG_JKK_RADIO_SYNC_LEADER_HOST);
+        return ESP_ERR_NOT_FOUND;
+    }
+    memcpy(&jkkSync.leader, res->ai_addr, sizeof(jkkSync.leader));
+    jkkSync.leader.sin_port = htons(CONFIG_JKK_RADIO_SYNC_PORT);
+    freeaddrinfo(res);
+
+    jkkSync.pool = heap_caps_calloc(JKK_SYNC_POOL, sizeof(JkkSyncPkt_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    jkkSync.freeQ = xQueueCreate(JKK_SYNC_POOL, sizeof(uint8_t));
+    jkkSync.readyQ = xQueueCreate(JKK_SYNC_POOL, sizeof(uint8_t));
+    if (jkkSync.pool == NULL || jkkSync.freeQ == NULL || jkkSync.readyQ == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate follower buffers");
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint8_t i = 0; i < JKK_SYNC_POOL; i++) {
+        xQueueSend(jkkSync.freeQ, &i, 0);
+    }
+
+    jkkSync.sock = JkkSyncSocket(CONFIG_JKK_RADIO_SYNC_PORT);
+    if (jkkSync.sock < 0) {
+        return ESP_FAIL;
+    }
+    xTaskCreatePinnedToCore(JkkSyncFollowerRxTask, "syncRx", 3 * 1024, NULL, 10, NULL, 0);
+    xTaskCreatePinnedToCore(JkkSyncFollowerPlayTask, "syncPlay", 3 * 1024, NULL, 8, NULL, 0);
+    ESP_LOGI(TAG, "Multi-room follower of %s:%d", CONFIG_JKK_RADIO_SYNC_LEADER_HOST, CONFIG_JKK_RADIO_SYNC_PORT);
+    return ESP_OK;
+}
+
+int JkkSyncGetSkewUs(void) {
+    return jkkSync.play.slip.errEma;
+}
@@ -0,0 +1,87 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Multi-room synchronised playback (leader / follower)
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "audio_element.h"
+
+#define JKK_SYNC_MAGIC (0x534B4B4A) // "JKKS"
+
+typedef enum {
+    JKK_SYNC_PKT_AUDIO = 1, // Leader -> follower, PCM block with play-out time
+    JKK_SYNC_PKT_TIME_REQ, // Follower -> leader, subscribe and clock offset request
+    JKK_SYNC_PKT_TIME_REPLY, // Leader -> follower
+} jkk_sync_pkt_e;
+
+typedef struct __attribute__((packed)) JkkSyncHdr_s {
+    uint32_t magic;
+    uint8_t type; // jkk_sync_pkt_e
+    uint8_t channels;
+    uint8_t bits;
+    uint8_t reserved;
+    uint32_t seq;
+    uint32_t sample_rate;
+    int64_t t1; // Audio: play-out time of first frame (leader clock, us). Time: follower send time
+    int64_t t2; // Time reply: leader receive time
+    int64_t t3; // Time reply: leader send time
+    uint16_t len; // Payload length
+} JkkSyncHdr_t;
+
+/**
+ * @brief Start leader: PCM from raw split output is sent to subscribed followers
+ * @param split Raw split element of main pipeline
+ * @param splitOut Multi output index of split reserved for sync
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkSyncLeaderStart(audio_element_handle_t split, int splitOut);
+
+/**
+ * @brief Set PCM format produced by decoder (leader only)
+ * @param rate Sample rate
+ * @param ch Number of channels
+ * @param bits Bits per sample
+ */
+void JkkSyncSetFormat(int rate, int ch, int bits);
+
+/**
+ * @brief Start follower: PCM received from leader is written to raw input at scheduled time
+ * Format changes are sent to main task as JKK_RADIO_CMD_SYNC_FORMAT.
+ * @param rawIn Raw stream element at the beginning of main pipeline
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t JkkSyncFollowerStart(audio_element_handle_t rawIn);
+
+/**
+ * @brief Get smoothed play-out error against leader schedule (follower only)
+ * @return Error in microseconds, positive when late
+ */
+int JkkSyncGetSkewUs(void);
+
+/**
+ * @brief Pack format for JKK_RADIO_CMD_SYNC_FORMAT message
+ */
+static inline int JkkSyncFormatPack(int rate, int ch, int bits) {
+    return (rate & 0xFFFFF) | ((ch & 0xF) << 20) | ((bits & 0x3F) << 24);
+}
+
+/**
+ * @brief Unpack format from JKK_RADIO_CMD_SYNC_FORMAT message
+ */
+static inline void JkkSyncFormatUnpack(int packed, int *rate, int *ch, int *bits) {
+    *rate = packed & 0xFFFFF;
+    *ch = (packed >> 20) & 0xF;
+    *bits = (packed >> 24) & 0x3F;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,110 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Multi-room sync timing: clock offset, play-out time and slips (no sockets, runs on host too)
+*/
+
+#include <sys/param.h>
+
+#include "jkk_sync_time.h"
+
+#define JKK_SYNC_SILENCE_FRAMES (64)
+#define JKK_SYNC_MAX_FRAME_BYTES (8) // 2 ch, 32 bits
+
+static const uint8_t silence[JKK_SYNC_SILENCE_FRAMES * JKK_SYNC_MAX_FRAME_BYTES];
+
+int JkkSyncFrameBytes(int ch, int bits) {
+    return ch * (bits > 0 ? bits : 16) / 8;
+}
+
+bool JkkSyncOffsetUpdate(JkkSyncOffset_t *off, const JkkSyncHdr_t *reply, int64_t t4) {
+    int64_t delay = (t4 - reply->t1) - (reply->t3 - reply->t2);
+    int64_t offset = ((reply->t2 - reply->t1) + (reply->t3 - t4)) / 2;
+    if (delay < 0) return false;
+    off->delay[off->idx] = delay;
+    off->value[off->idx] = offset;
+    off->idx = (off->idx + 1) % JKK_SYNC_OFFSET_SAMPLES;
+
+    // Exchange with shortest round trip has the least asymmetric queuing
+    int best = -1;
+    for (int i = 0; i < JKK_SYNC_OFFSET_SAMPLES; i++) {
+        if (off->delay[i] > 0 && (best < 0 || off->delay[i] < off->delay[best])) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        off->offsetUs = off->value[best];
+        off->valid = true;
+    }
+    return true;
+}
+
+int64_t JkkSyncPlayTime(int64_t now, int latUs, int64_t behindBytes, int64_t bytesPerSec) {
+    return now + latUs - behindBytes * 1000000 / bytesPerSec;
+}
+
+int64_t JkkSyncPlayError(int64_t now, int latUs, int64_t t1, int64_t offsetUs) {
+    return now + latUs - (t1 - offsetUs);
+}
+
+int JkkSyncSlip(JkkSyncSlip_t *slip, int64_t err, int frames, int rate) {
+    slip->errEma += ((int)err - slip->errEma) >> JKK_SYNC_EMA_SHIFT;
+    int64_t blockUs = (int64_t)frames * 1000000 / rate;
+    int frameNs = 1000000000 / rate;
+    slip->owedNs += (int)(slip->errEma * blockUs / JKK_SYNC_SLIP_TC_MS); // us * us / ms
+    int skip = slip->owedNs / frameNs; // Whole frames, towards 0
+    skip = MAX(-JKK_SYNC_MAX_SLIP_FRAMES, MIN(skip, MIN(JKK_SYNC_MAX_SLIP_FRAMES, frames - 1)));
+    slip->owedNs -= skip * frameNs;
+    slip->owedNs = MAX(-frameNs, MIN(slip->owedNs, frameNs)); // Rest of large error is still in errEma
+    slip->errEma -= skip * frameNs / 1000; // Heard that much earlier now, smoothing lag does not repeat the correction
+    return skip;
+}
+
+static void JkkSyncPad(const JkkSyncOut_t *out, int64_t frames, int frameBytes) {
+    while (frames > 0) {
+        int n = MIN(frames, JKK_SYNC_SILENCE_FRAMES);
+        out->write(out->ctx, silence, n * frameBytes);
+        frames -= n;
+    }
+}
+
+jkk_sync_block_e JkkSyncPlayBlock(JkkSyncPlay_t *play, const JkkSyncHdr_t *hdr, const uint8_t *data, int64_t offsetUs) {
+    const JkkSyncOut_t *out = &play->out;
+    int frameBytes = JkkSyncFrameBytes(hdr->channels, hdr->bits);
+    int lat = out->latency(out->ctx);
+    if (frameBytes <= 0 || frameBytes > JKK_SYNC_MAX_FRAME_BYTES || hdr->sample_rate == 0 || lat < 0) {
+        return JKK_SYNC_BLOCK_NO_OUTPUT;
+    }
+    int64_t err = JkkSyncPlayError(out->now(out->ctx), lat, hdr->t1, offsetUs);
+    if (err < -JKK_SYNC_MAX_WAIT_US) {
+        play->early++;
+        return JKK_SYNC_BLOCK_EARLY;
+    }
+    if (err > JKK_SYNC_LATE_DROP_US) {
+        play->late++;
+        play->running = false; // Next block in time is placed again
+        return JKK_SYNC_BLOCK_LATE;
+    }
+    if (err < 0 && (!play->running || err < -JKK_SYNC_LATE_DROP_US)) {
+        int64_t pad = -err * hdr->sample_rate / 1000000;
+        JkkSyncPad(out, pad, frameBytes);
+        err += pad * 1000000 / hdr->sample_rate; // Less than a frame early
+        play->slip = (JkkSyncSlip_t){0}; // Error before is gone
+        play->pads++;
+    }
+    play->running = true;
+
+    play->errMax = MAX(play->errMax, (int)(err < 0 ? -err : err));
+    int frames = hdr->len / frameBytes;
+    int skip = JkkSyncSlip(&play->slip, err, frames, hdr->sample_rate);
+    if (skip > 0) {
+        play->slips += skip;
+    } else if (skip < 0) {
+        for (int i = 0; i < -skip; i++) {
+            out->write(out->ctx, data, frameBytes);
+        }
+        play->dups += -skip;
+        skip = 0;
+    }
+    out->write(out->ctx, data + skip * frameBytes, (frames - skip) * frameBytes);
+    return JKK_SYNC_BLOCK_PLAYED;
+}
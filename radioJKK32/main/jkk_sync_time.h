@@ -0,0 +1,125 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Multi-room sync timing: clock offset, play-out time and slips (no sockets, runs on host too)
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "jkk_sync.h"
+
+#define JKK_SYNC_OFFSET_SAMPLES (8) // Best (min delay) of last exchanges is used
+#define JKK_SYNC_LATE_DROP_US (30 * 1000) // Later than this - drop whole block
+#define JKK_SYNC_MAX_WAIT_US (2 * 1000 * 1000) // Earlier than this - clocks not agreed yet, drop block
+#define JKK_SYNC_SLIP_TC_MS (2000) // Error is corrected at error / this per second, drift keeps error of drift * this
+#define JKK_SYNC_MAX_SLIP_FRAMES (2) // Per block, inaudible
+#define JKK_SYNC_EMA_SHIFT (5) // Smoothing of measured error (1/32)
+
+typedef struct JkkSyncOffset_s {
+    int64_t delay[JKK_SYNC_OFFSET_SAMPLES]; // Round trip of exchange, 0 - empty
+    int64_t value[JKK_SYNC_OFFSET_SAMPLES];
+    int idx;
+    int64_t offsetUs; // Leader clock minus local clock
+    bool valid;
+} JkkSyncOffset_t;
+
+/* Where the follower plays blocks: raw input of main pipeline (firmware) or simulated DAC (host test) */
+typedef struct JkkSyncOut_s {
+    int64_t (*now)(void *ctx); // Local clock, us
+    int (*latency)(void *ctx); // Output chain latency of next written frame, us, < 0 - not known
+    void (*write)(void *ctx, const uint8_t *data, int len); // May block while output is full
+    void *ctx;
+} JkkSyncOut_t;
+
+typedef struct JkkSyncSlip_s {
+    int errEma; // Smoothed error, us
+    int owedNs; // Correction due, less than a frame
+} JkkSyncSlip_t;
+
+typedef struct JkkSyncPlay_s {
+    JkkSyncOut_t out;
+    bool running; // Clear on start and leader stop: next block is placed to the frame with silence before it
+    JkkSyncSlip_t slip;
+    int errMax; // Cleared by stats log
+    uint32_t late, early, slips, dups, pads;
+} JkkSyncPlay_t;
+
+typedef enum {
+    JKK_SYNC_BLOCK_PLAYED = 0,
+    JKK_SYNC_BLOCK_EARLY, // Dropped, clocks not agreed yet
+    JKK_SYNC_BLOCK_LATE, // Dropped
+    JKK_SYNC_BLOCK_NO_OUTPUT, // Output format or latency not known
+} jkk_sync_block_e;
+
+/**
+ * @brief Bytes of one PCM frame
+ * @param ch Number of channels
+ * @param bits Bits per sample (0 - 16)
+ */
+int JkkSyncFrameBytes(int ch, int bits);
+
+/**
+ * @brief Add time exchange to offset estimate
+ * @param off Offset state (zeroed before first use)
+ * @param reply Time reply: t1 follower send, t2 leader receive, t3 leader send
+ * @param t4 Local receive time of reply
+ * @return true if exchange was used (round trip not negative)
+ */
+bool JkkSyncOffsetUpdate(JkkSyncOffset_t *off, const JkkSyncHdr_t *reply, int64_t t4);
+
+/**
+ * @brief Leader play-out time of first frame of block just read from tap
+ * The newest byte in tap is also the newest one in output chain, heard after latUs.
+ * First byte of the block is (still in tap + block) bytes earlier.
+ * @param now Leader clock, us
+ * @param latUs Output chain latency of the newest byte
+ * @param behindBytes Bytes still in tap plus block length
+ * @param bytesPerSec PCM bytes per second
+ * @return Play-out time, leader clock
+ */
+int64_t JkkSyncPlayTime(int64_t now, int latUs, int64_t behindBytes, int64_t bytesPerSec);
+
+/**
+ * @brief Follower play-out error of block written now
+ * @param now Local clock, us
+ * @param latUs Output chain latency (with raw input)
+ * @param t1 Block play-out time, leader clock
+ * @param offsetUs Leader clock minus local clock
+ * @return Error in us, > 0 late, < 0 early
+ */
+int64_t JkkSyncPlayError(int64_t now, int latUs, int64_t t1, int64_t offsetUs);
+
+/**
+ * @brief Smooth error and decide frame slips for one block
+ * Buffer fill moves in element sized steps, so slips are decided on smoothed error. Frames are slipped
+ * at a rate proportional to it (no dead band holding the error at its edge), so mean error stays near 0.
+ * Slipped frames are taken off the smoothed error at once, smoothing lag does not overshoot.
+ * @param slip Slip state (zeroed before first use), updated
+ * @param err Error of this block
+ * @param frames Frames in block
+ * @param rate Sample rate
+ * @return Frames to skip (> 0) or to repeat (< 0)
+ */
+int JkkSyncSlip(JkkSyncSlip_t *slip, int64_t err, int frames, int rate);
+
+/**
+ * @brief Play one block at its time (follower play task body)
+ * Block more than JKK_SYNC_LATE_DROP_US early, or first one after start, gets silence before it to the frame,
+ * so measurement starts with the output holding it (output latency is not measured on empty output).
+ * Smaller errors are removed by slips. Output blocks the caller when full, there is no tick rounded wait.
+ * @param play Player state (out set, rest zeroed before first use)
+ * @param hdr Audio block header
+ * @param data hdr->len bytes of PCM
+ * @param offsetUs Leader clock minus local clock
+ * @return JKK_SYNC_BLOCK_PLAYED or reason why block was not played
+ */
+jkk_sync_block_e JkkSyncPlayBlock(JkkSyncPlay_t *play, const JkkSyncHdr_t *hdr, const uint8_t *data, int64_t offsetUs);
+
+#ifdef __cplusplus
+}
+#endif
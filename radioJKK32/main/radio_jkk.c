@@ -14,6 +14,7 @@
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_wifi.h"
@@ -67,8 +68,26 @@
 #include "jkk_audio_sdwrite.h"
 
 #include "jkk_nvs.h"
+#include "jkk_snapshot.h"
+#include "jkk_station_store.h"
+#include "jkk_station_index.h"
 #include "nvs.h"
 #include "jkk_settings.h"
+#if defined(CONFIG_JKK_RADIO_RESTREAM)
+#include "jkk_restream.h"
+#endif
+#if defined(CONFIG_JKK_RADIO_SYNC)
+#include "jkk_sync.h"
+#endif
+#if defined(CONFIG_JKK_RADIO_CATALOG)
+#include "jkk_catalog.h"
+#endif
+#if defined(CONFIG_JKK_RADIO_PROBE)
+#include "jkk_probe.h"
+#endif
+#if defined(CONFIG_JKK_RADIO_IMPORT)
+#include "jkk_import.h"
+#endif
 
 // #include "metadata_parser/jkk_metadata.h" 
 
@@ -106,10 +125,23 @@ const int WIFI_CONNECTED_EVENT = BIT0;
 static EventGroupHandle_t wifi_event_group;
 
 static EXT_RAM_BSS_ATTR JkkRadio_t jkkRadio = {0};
+static audio_element_info_t prev_music_info = {0}; // Format the output chain is currently configured for
 static bool fallback_ap_started = false;
 static int wifi_disconnect_count = 0;
 static QueueHandle_t save_wifi_cmd_queue = NULL;
 static bool using_menuconfig_wifi = false; // true when SSID/pass come from Kconfig defaults
+static SemaphoreHandle_t stationsLock = NULL; // Station array: changed by main and web worker tasks, exported by both
+
+static void JkkRadioStationsLock(void) {
+    if (stationsLock == NULL) {
+        stationsLock = xSemaphoreCreateMutex(); // First call comes from boot (SD read), before other tasks
+    }
+    xSemaphoreTake(stationsLock, portMAX_DELAY);
+}
+
+static void JkkRadioStationsUnlock(void) {
+    xSemaphoreGive(stationsLock);
+}
 
 // Custom event base for robust control messages (bypasses ADF queues)
 ESP_EVENT_DEFINE_BASE(JKK_EVT_BASE);
@@ -122,12 +154,7 @@ static void JkkApplyPendingWifiAndRestart(void) {
     char ssid[32] = {0};
     char pass[64] = {0};
     if (JkkWebGetPendingWifi(ssid, sizeof(ssid), pass, sizeof(pass))) {
-        if(strcmp(ssid, jkkRadio.wifiSSID)){
-            JkkNvsBlobSet("wifi_ssid", JKK_RADIO_NVS_NAMESPACE, ssid, strlen(ssid) + 1);
-        }
-        if(strcmp(pass, jkkRadio.wifiPassword)){
-            JkkNvsBlobSet("wifi_password", JKK_RADIO_NVS_NAMESPACE, pass, strlen(pass) + 1);
-        }
+        JkkSnapshotSetWifi(ssid, pass);
         strncpy(jkkRadio.wifiSSID, ssid, sizeof(jkkRadio.wifiSSID) - 1);
         strncpy(jkkRadio.wifiPassword, pass, sizeof(jkkRadio.wifiPassword) - 1);
         ESP_LOGI(TAG, "WiFi saved via event: %s", ssid);
@@ -228,6 +255,9 @@ static void initialize_sntp(void){
     esp_sntp_setservername(0, "tempus1.gum.gov.pl");
     esp_sntp_setservername(1, "0.europe.pool.ntp.org");
     esp_sntp_setservername(2, "pool.ntp.org");
+#if defined(CONFIG_JKK_RADIO_SYNC)
+    sntp_set_sync_interval(15 * 1000); // Multi-room devices have to keep their clocks close
+#endif
     esp_sntp_init();
     setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0", 1); 
 	tzset();
@@ -277,12 +307,7 @@ static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_
                          (const char *) wifi_sta_cfg->password);
                 
 
-                if(strcmp((const char *)wifi_sta_cfg->ssid, jkkRadio.wifiSSID)){
-                    JkkNvsBlobSet("wifi_ssid", JKK_RADIO_NVS_NAMESPACE, (const char *)wifi_sta_cfg->ssid, strlen((const char *)wifi_sta_cfg->ssid) + 1);
-                }
-                if(strcmp((const char *)wifi_sta_cfg->password, jkkRadio.wifiPassword)){
-                    JkkNvsBlobSet("wifi_password", JKK_RADIO_NVS_NAMESPACE, (const char *)wifi_sta_cfg->password, strlen((const char *)wifi_sta_cfg->password) + 1);
-                }
+                JkkSnapshotSetWifi((const char *)wifi_sta_cfg->ssid, (const char *)wifi_sta_cfg->password);
                 strcpy(jkkRadio.wifiSSID, (const char *)wifi_sta_cfg->ssid);
                 strcpy(jkkRadio.wifiPassword, (const char *)wifi_sta_cfg->password);
                 ESP_LOGI(TAG, "Read WiFi settings: SSID: %s, Password: %s", (const char *)wifi_sta_cfg->ssid, (const char *)wifi_sta_cfg->password);
@@ -413,9 +438,7 @@ static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_
                     const char *addr = (fields[1] && strlen(fields[1]) > 0) ? fields[1] : "";
                     const char *user = (fields[2] && strlen(fields[2]) > 0) ? fields[2] : "";
                     const char *pass = (fields[3] && strlen(fields[3]) > 0) ? fields[3] : "";
-                    JkkMqttSetEnabled(enabled);
-                    JkkMqttSetBrokerAddress(addr);
-                    JkkMqttSetCredentials(user, pass);
+                    JkkMqttSaveConfig(enabled, addr, user, pass);
                     ESP_LOGI(TAG, "MQTT config saved: enabled=%d, broker='%s', user='%s'", enabled, addr, user);
                     /* Reconnect with new settings (no restart needed) */
                     JkkMqttReconnect();
@@ -428,6 +451,87 @@ static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_
     }
 }
 
+// One line "uri;nameShort;nameLong;favorite;type[;audioDes]\n" as snprintf, 0 - station without URI
+static int JkkRadioExportLine(int i, char *buf, size_t len) {
+    const JkkRadioStations_t *station = &jkkRadio.jkkRadioStations[i];
+    char uri[JKK_RADIO_STATION_URI_LEN];
+    char nameLong[JKK_RADIO_STATION_NAME_LEN];
+    if (JkkRadioGetStationUri(i, uri, sizeof(uri)) == NULL || uri[0] == '\0') {
+        return 0;
+    }
+    return snprintf(buf, len, "%s;%s;%s;%d;%d%s%s\n",
+            uri,
+            station->nameShort,
+            JkkRadioGetStationName(i, nameLong, sizeof(nameLong)),
+            station->is_favorite ? 1 : 0,
+            station->type,
+            station->audioDes[0] ? ";" : "",
+            station->audioDes);
+}
+
+esp_err_t JkkRadioExportStationsCsv(JkkRadioExportWrite_t write, void *ctx, int *count) {
+    JkkRadioStationsLock();
+    if (!jkkRadio.jkkRadioStations || jkkRadio.station_count == 0) {
+        JkkRadioStationsUnlock();
+        ESP_LOGW(TAG, "No stations to export");
+        return ESP_ERR_INVALID_STATE;
+    }
+    char buf[JKK_RADIO_EXPORT_CHUNK];
+    
+    // Header with timestamp
+    time_t now;
+    struct tm timeinfo;
+    time(&now);
+    localtime_r(&now, &timeinfo);
+    size_t used = snprintf(buf, sizeof(buf), "# RadioJKK32 Station Export\n"
+            "# Generated: %04d-%02d-%02d %02d:%02d:%02d\n"
+            "# Total stations: %d\n"
+            "#\n"
+            "# URL;ShortName;LongName;Favorite;Type;Comment\n",
+            timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
+            timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec,
+            jkkRadio.station_count);
+    
+    int exported_count = 0;
+    esp_err_t ret = ESP_OK;
+    int i = 0;
+    bool more = true;
+    while (more && ret == ESP_OK) {
+        // Locked only while a chunk is rendered, slow client or SD card does not hold station changes
+        for (; i < jkkRadio.station_count; i++) {
+            size_t n = JkkRadioExportLine(i, buf + used, sizeof(buf) - used);
+            if (n == 0) {
+                continue; // Skip invalid stations
+            }
+            if (used + n >= sizeof(buf)) {
+                if (used > 0) {
+                    break; // Does not fit: write what is ready, render line again at start
+                }
+                n = sizeof(buf) - 1; // Cut by snprintf
+            }
+            used += n;
+            exported_count++;
+        }
+        more = i < jkkRadio.station_count;
+        JkkRadioStationsUnlock();
+        if (used > 0) {
+            ret = write(ctx, buf, used);
+            used = 0;
+        }
+        if (more && ret == ESP_OK) {
+            JkkRadioStationsLock();
+        }
+    }
+    if (count) {
+        *count = exported_count;
+    }
+    return ret;
+}
+
+static esp_err_t JkkRadioExportFileWrite(void *ctx, const char *data, size_t len) {
+    return fwrite(data, 1, len, (FILE *)ctx) == len ? ESP_OK : ESP_FAIL;
+}
+
 esp_err_t JkkRadioExportStations(const char *filename) {
     FILE *fptr;
     char filepath[64];
@@ -452,65 +556,18 @@ esp_err_t JkkRadioExportStations(const char *filename) {
         return ESP_ERR_NOT_FOUND;
     }
     
-    // Write header with timestamp
-    time_t now;
-    struct tm timeinfo;
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    
-    fprintf(fptr, "# RadioJKK32 Station Export\n");
-    fprintf(fptr, "# Generated: %04d-%02d-%02d %02d:%02d:%02d\n",
-            timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-            timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-    fprintf(fptr, "# Total stations: %d\n", jkkRadio.station_count);
-    fprintf(fptr, "#\n");
-    fprintf(fptr, "# URL;ShortName;LongName;Favorite;Type;Comment\n");
-    
     int exported_count = 0;
-    
-    // Write stations
-    for (int i = 0; i < jkkRadio.station_count; i++) {
-        const JkkRadioStations_t *station = &jkkRadio.jkkRadioStations[i];
-        
-        // Skip invalid stations
-        if (strlen(station->uri) == 0) {
-            continue;
-        }
-        
-        fprintf(fptr, "%s;%s;%s;%d;%d",
-                station->uri,
-                station->nameShort,
-                station->nameLong,
-                station->is_favorite ? 1 : 0,
-                station->type);
-        
-        if (strlen(station->audioDes) > 0) {
-            fprintf(fptr, ";%s", station->audioDes);
-        }
-        
-        fprintf(fptr, "\n");
-        exported_count++;
-    } 
+    esp_err_t ret = JkkRadioExportStationsCsv(JkkRadioExportFileWrite, fptr, &exported_count);
     fclose(fptr);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error writing %s", filepath);
+        return ret;
+    }
     
     ESP_LOGI(TAG, "Exported %d stations to %s", exported_count, filepath);
     return ESP_OK;
 }
 
-void JkkRadioEqListForWWW(void){
-    char *eqRollerOptions = NULL;
-
-    eqRollerOptions = heap_caps_calloc(jkkRadio.eq_count, 18, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    for (int i = 0; i < jkkRadio.eq_count; i++) {
-        char eqName[28] = {0};
-        snprintf(eqName, sizeof(eqName), "%d;%s", i, jkkRadio.eqPresets[i].name);
-        strncat(eqRollerOptions, eqName, 18);
-        if(i < jkkRadio.eq_count - 1) strcat(eqRollerOptions, "\n");
-    }
-    JkkRadioWwwUpdateEqList(eqRollerOptions);
-    free(eqRollerOptions);
-}
-
 void JkkRadioSetEqualizer(uint8_t eq) {
     if(eq >= jkkRadio.eq_count) {
         ESP_LOGE(TAG, "Invalid equalizer index: %d", eq);
@@ -536,12 +593,8 @@ void JkkRadioSetEqualizer(uint8_t eq) {
     JkkRadioWwwSetEqId(jkkRadio.current_eq);
 }
 
-static void JkkRadioAllStationsSave(void) {
-    for (int i = 0; i < jkkRadio.station_count; i++) {
-        char key[16] = {0};
-        sprintf(key, JKK_RADIO_NVS_STATION_KEY, i);
-        JkkNvsBlobSet(key, JKK_RADIO_NVS_NAMESPACE, &jkkRadio.jkkRadioStations[i], sizeof(JkkRadioStations_t));
-    }
+static void JkkRadioStationOrderSave(void) {
+    JkkStationStoreSaveOrder(jkkRadio.jkkRadioStations, jkkRadio.station_count);
 }
 
 esp_err_t JkkRadioReorderStation(int oldIndex, int newIndex) {
@@ -559,6 +612,8 @@ esp_err_t JkkRadioReorderStation(int oldIndex, int newIndex) {
         return ESP_OK;
     }
     
+    // Stations keep their NVS records (storeId), only the order is saved
+    JkkRadioStationsLock();
     JkkRadioStations_t tempStation;
     memcpy(&tempStation, &jkkRadio.jkkRadioStations[oldIndex], sizeof(JkkRadioStations_t));
 
@@ -573,6 +628,8 @@ esp_err_t JkkRadioReorderStation(int oldIndex, int newIndex) {
     }
     
     memcpy(&jkkRadio.jkkRadioStations[newIndex], &tempStation, sizeof(JkkRadioStations_t));
+    JkkStationIndexMove(jkkRadio.jkkRadioStations, jkkRadio.station_count, oldIndex, newIndex);
+    JkkRadioStationsUnlock();
     
     if (jkkRadio.current_station == oldIndex) {
         jkkRadio.current_station = newIndex;
@@ -600,10 +657,22 @@ esp_err_t JkkRadioReorderStation(int oldIndex, int newIndex) {
                jkkRadio.prev_station < oldIndex) {
         jkkRadio.prev_station++;
     }
+
+    if (jkkRadio.fmt_station == oldIndex) {
+        jkkRadio.fmt_station = newIndex;
+    } else if (oldIndex < newIndex && 
+               jkkRadio.fmt_station > oldIndex && 
+               jkkRadio.fmt_station <= newIndex) {
+        jkkRadio.fmt_station--;
+    } else if (oldIndex > newIndex && 
+               jkkRadio.fmt_station >= newIndex && 
+               jkkRadio.fmt_station < oldIndex) {
+        jkkRadio.fmt_station++;
+    }
     
-    jkkRadio.whatToDo |= JKK_RADIO_TO_SAVE_ALL_STATIONS;
+    jkkRadio.whatToDo |= JKK_RADIO_TO_SAVE_STATION_ORDER;
     
-    JkkRadioListForWWW();
+    JkkRadioWwwStationListChanged();
     JkkRadioWwwSetStationId(jkkRadio.current_station);
     
 #if defined(CONFIG_JKK_RADIO_USING_I2C_LCD)
@@ -632,9 +701,7 @@ static void JkkRadioOneStationErase(int id) {
         ESP_LOGE(TAG, "JkkRadioOneStationErase Invalid station ID: %d", id);
         return;
     }
-    char key[16] = {0};
-    sprintf(key, JKK_RADIO_NVS_STATION_KEY, id);
-    JkkNvsErase(key, JKK_RADIO_NVS_NAMESPACE);
+    JkkStationStoreSaveOrder(jkkRadio.jkkRadioStations, jkkRadio.station_count); // Record of deleted station is reused by next new one
 }
 
 void JkkRadioDeleteStation(uint16_t station){
@@ -649,6 +716,14 @@ void JkkRadioDeleteStation(uint16_t station){
         JkkRadioSetStation(jkkRadio.current_station);
     } 
     ESP_LOGI(TAG, "Removing station %d: %s", index, jkkRadio.jkkRadioStations[index].nameShort);
+    JkkRadioStationsLock();
+    JkkStationStoreDropCold(&jkkRadio.jkkRadioStations[index]);
+    if(jkkRadio.fmt_station == index) {
+        jkkRadio.fmt_station = -1;
+        jkkRadio.whatToDo &= ~JKK_RADIO_TO_SAVE_STATION_FMT;
+    } else if(jkkRadio.fmt_station > index) {
+        jkkRadio.fmt_station--;
+    }
     // Shift remaining stations down
     for(int i = index; i < jkkRadio.station_count - 1; i++) {
         jkkRadio.jkkRadioStations[i] = jkkRadio.jkkRadioStations[i + 1];
@@ -659,11 +734,14 @@ void JkkRadioDeleteStation(uint16_t station){
     if(!jkkRadio.jkkRadioStations) {
         ESP_LOGE(TAG, "Failed to reallocate memory for stations");
         jkkRadio.station_count = 0; 
+        JkkRadioStationsUnlock();
         return;
     } else {
         ESP_LOGI(TAG, "Station %d deleted successfully. New station count: %d", index, jkkRadio.station_count);
     }
-    JkkRadioListForWWW(); 
+    JkkStationIndexRemove(jkkRadio.jkkRadioStations, jkkRadio.station_count, index);
+    JkkRadioStationsUnlock();
+    JkkRadioWwwStationListChanged();
     JkkRadioSendMessageToMain(index, JKK_RADIO_CMD_ERASE_FROM_NVS_STATION);
     JkkRadioSaveTimerStart(JKK_RADIO_TO_SAVE_STATION_LIST);
     JkkMqttPublishState();
@@ -675,9 +753,120 @@ static void JkkRadioOneStationSave(int id) {
         ESP_LOGE(TAG, "JkkRadioOneStationSave Invalid station ID: %d", id);
         return;
     }
-    char key[16] = {0};
-    sprintf(key, JKK_RADIO_NVS_STATION_KEY, id);
-    JkkNvsBlobSet(key, JKK_RADIO_NVS_NAMESPACE, &jkkRadio.jkkRadioStations[id], sizeof(JkkRadioStations_t));
+    JkkStationStoreSaveOne(jkkRadio.jkkRadioStations, jkkRadio.station_count, id);
+}
+
+static bool JkkRadioApplyStreamFormat(int rate, int ch, int bits) {
+    if (rate <= 0 || ch <= 0 || bits <= 0) {
+        return false;
+    }
+    if ((prev_music_info.bits == bits) && 
+        (prev_music_info.sample_rates == rate) && 
+        (prev_music_info.channels == ch)) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Change sample_rates=%d, bits=%d, ch=%d", rate, bits, ch);
+
+    JkkAudioI2sSetClk(rate, bits, ch, true);
+    JkkAudioEqSetInfo(rate, ch);
+    JkkAudioSdWriteResChange(rate, ch, bits);
+#if defined(CONFIG_JKK_RADIO_USING_I2C_LCD)
+    volume_meter_update_format(jkkRadio.audioMain->vmeter, rate, ch, bits);
+#endif
+    prev_music_info.sample_rates = rate;
+    prev_music_info.channels = ch;
+    prev_music_info.bits = bits;
+    return true;
+}
+
+static void JkkRadioPreconfigureStation(int id) {
+    if (id < 0 || id >= jkkRadio.station_count) return;
+    JkkRadioStreamFmt_t *fmt = &jkkRadio.jkkRadioStations[id].fmt;
+    if (fmt->sample_rate == 0) {
+        ESP_LOGI(TAG, "No cached stream format for station %d", id);
+        return;
+    }
+    if (JkkRadioApplyStreamFormat(fmt->sample_rate, fmt->channels, fmt->bits)) {
+        ESP_LOGI(TAG, "Pipeline pre-configured from cache for station %d", id);
+    }
+}
+
+static void JkkRadioStationSaveLater(int id) {
+    if (jkkRadio.fmt_station >= 0 && jkkRadio.fmt_station != id) {
+        JkkRadioOneStationSave(jkkRadio.fmt_station); // Another station is still waiting, do not lose it
+    }
+    jkkRadio.fmt_station = id;
+    JkkRadioSaveTimerStart(JKK_RADIO_TO_SAVE_STATION_FMT); // Save after delay to limit NVS writes
+}
+
+static void JkkRadioStoreStreamFormat(int id, const audio_element_info_t *info) {
+    if (id < 0 || id >= jkkRadio.station_count) return;
+    JkkRadioStreamFmt_t *fmt = &jkkRadio.jkkRadioStations[id].fmt;
+    if (fmt->sample_rate == info->sample_rates && fmt->channels == info->channels && 
+        fmt->bits == info->bits && fmt->codec == info->codec_fmt) {
+        return;
+    }
+    fmt->sample_rate = info->sample_rates;
+    fmt->channels = info->channels;
+    fmt->bits = info->bits;
+    fmt->codec = info->codec_fmt;
+    JkkRadioStationSaveLater(id);
+}
+
+static const char *JkkRadioCodecName(int codec) {
+    switch (codec) {
+        case ESP_CODEC_TYPE_MP3: return "MP3";
+        case ESP_CODEC_TYPE_AAC: 
+        case ESP_CODEC_TYPE_M4A: 
+        case ESP_CODEC_TYPE_TSAAC: return "AAC";
+        case ESP_CODEC_TYPE_OGG: return "OGG";
+        case ESP_CODEC_TYPE_OPUS: return "OPUS";
+        case ESP_CODEC_TYPE_FLAC: return "FLAC";
+        case ESP_CODEC_TYPE_WAV: return "WAV";
+        case ESP_CODEC_TYPE_AMRNB: 
+        case ESP_CODEC_TYPE_AMRWB: return "AMR";
+        default: return "PCM";
+    }
+}
+
+#if defined(CONFIG_JKK_RADIO_USING_I2C_LCD)
+static void JkkRadioLcdStationName(void) {
+    int id = jkkRadio.current_station;
+    if (id < 0 || id >= jkkRadio.station_count) return;
+    JkkRadioStations_t *st = &jkkRadio.jkkRadioStations[id];
+    char nameLong[JKK_RADIO_STATION_NAME_LEN];
+    JkkRadioGetStationName(id, nameLong, sizeof(nameLong));
+    if (st->audioDes[0] == '\0') {
+        JkkLcdStationTxt(nameLong);
+        return;
+    }
+    char txt[JKK_RADIO_STATION_NAME_LEN + sizeof(st->audioDes) + 4];
+    snprintf(txt, sizeof(txt), "%s | %s", nameLong, st->audioDes);
+    JkkLcdStationTxt(txt);
+}
+#endif
+
+_Static_assert(sizeof(((JkkRadioStations_t *)0)->audioDes) == JKK_AUDIO_DES_LEN, "Audio description length");
+
+/* Called from main task poll, every few seconds while playing. New description is taken when two polls agree (VBR streams) */
+static void JkkRadioUpdateAudioDes(void) {
+    static JkkAudioDesState_t desState = {0};
+    int id = jkkRadio.current_station;
+    int kbps = JkkAudioMainInputKbps();
+    if (id < 0 || id >= jkkRadio.station_count || kbps <= 0 || !jkkRadio.is_playing) return;
+    JkkRadioStations_t *st = &jkkRadio.jkkRadioStations[id];
+    if (st->fmt.sample_rate == 0) return;
+
+    char was[sizeof(st->audioDes)];
+    strcpy(was, st->audioDes);
+    if (!JkkAudioDesUpdate(&desState, st->audioDes, JkkRadioCodecName(st->fmt.codec), kbps, st->fmt.sample_rate, st->fmt.channels)) return;
+
+    ESP_LOGI(TAG, "Station %d audio: %s (was: %s)", id, st->audioDes, was);
+    JkkRadioWwwUpdateAudioDes(st->audioDes);
+#if defined(CONFIG_JKK_RADIO_USING_I2C_LCD)
+    if (jkkRadio.statusStation == JKK_RADIO_STATUS_NORMAL) JkkRadioLcdStationName();
+#endif
+    JkkRadioStationSaveLater(id);
 }
 
 void JkkRadioEditStation(char *csvTxt){
@@ -689,7 +878,9 @@ void JkkRadioEditStation(char *csvTxt){
     char *is_favorite = strtok(NULL, ";\n");
     if(idtx) {
         int id = atoi(idtx);
+        JkkRadioStationsLock();
         if(id >= jkkRadio.station_count) {
+            JkkRadioStationsUnlock();
             ESP_LOGE(TAG, "JkkRadioEditStation Invalid station ID: %d", id);
             return;
         }
@@ -697,9 +888,11 @@ void JkkRadioEditStation(char *csvTxt){
             id = jkkRadio.station_count; 
             jkkRadio.jkkRadioStations = realloc(jkkRadio.jkkRadioStations, (jkkRadio.station_count + 1) * sizeof(JkkRadioStations_t));
             if(!jkkRadio.jkkRadioStations) {
+                JkkRadioStationsUnlock();
                 ESP_LOGE(TAG, "Failed to allocate memory for new station");
                 return;
             }
+            memset(&jkkRadio.jkkRadioStations[id], 0, sizeof(JkkRadioStations_t));
             jkkRadio.station_count++;
         }
         if(nameShort) {
@@ -707,15 +900,13 @@ void JkkRadioEditStation(char *csvTxt){
         } else {
             jkkRadio.jkkRadioStations[id].nameShort[0] = '\0'; 
         }
-        if(nameLong) {
-            strncpy(jkkRadio.jkkRadioStations[id].nameLong, nameLong, sizeof(jkkRadio.jkkRadioStations[id].nameLong) - 1);
-        } else {
-            jkkRadio.jkkRadioStations[id].nameLong[0] = '\0'; 
+        if(!uri || JkkStationStoreHash(uri, JKK_RADIO_STATION_URI_LEN - 1) != jkkRadio.jkkRadioStations[id].uriHash) {
+            memset(&jkkRadio.jkkRadioStations[id].fmt, 0, sizeof(JkkRadioStreamFmt_t)); // New stream, cached format no longer valid
         }
-        if(uri) {
-            strncpy(jkkRadio.jkkRadioStations[id].uri, uri, sizeof(jkkRadio.jkkRadioStations[id].uri) - 1);
-        } else {
-            jkkRadio.jkkRadioStations[id].uri[0] = '\0'; 
+        if(JkkStationStoreSetCold(&jkkRadio.jkkRadioStations[id], uri, nameLong) != ESP_OK) {
+            JkkRadioStationsUnlock();
+            ESP_LOGE(TAG, "Failed to allocate memory for station %d", id);
+            return;
         }
         if(is_favorite) {
             jkkRadio.jkkRadioStations[id].is_favorite = (strcmp(is_favorite, "1") == 0);
@@ -725,13 +916,15 @@ void JkkRadioEditStation(char *csvTxt){
         jkkRadio.jkkRadioStations[id].type = JKK_RADIO_UNKNOWN; 
         jkkRadio.jkkRadioStations[id].addFrom = JKK_RADIO_ADD_FROM_WEB; 
         jkkRadio.jkkRadioStations[id].audioDes[0] = '\0'; 
+        JkkStationIndexUpdate(jkkRadio.jkkRadioStations, jkkRadio.station_count, id);
+        JkkRadioStationsUnlock();
         
         ESP_LOGI(TAG, "Updated station %d: URI=%s, NameShort=%s, NameLong=%s",
                  id,
-                 jkkRadio.jkkRadioStations[id].uri, 
+                 uri ? uri : "", 
                  jkkRadio.jkkRadioStations[id].nameShort,
-                 jkkRadio.jkkRadioStations[id].nameLong);
-        JkkRadioListForWWW(); // Update the list for web server
+                 nameLong ? nameLong : "");
+        JkkRadioWwwStationListChanged(); // Web list is rebuilt on next request
         JkkRadioSendMessageToMain(id, JKK_RADIO_CMD_SAVE_TO_NVS_STATION);
         JkkRadioSaveTimerStart(JKK_RADIO_TO_SAVE_STATION_LIST);
         JkkMqttPublishState();
@@ -742,6 +935,10 @@ void JkkRadioEditStation(char *csvTxt){
     }
 }
 
+static void JkkRadioStreamStall_cb(jkk_audio_stall_e stall){
+    JkkRadioSendMessageToMain(stall, JKK_RADIO_CMD_STREAM_STALL);
+}
+
 static void JkkRadioUpdateVolume(void){
     audio_hal_enable_pa(jkkRadio.board_handle->audio_hal, true);
     if (jkkRadio.player_volume > 0 && JkkRadioIsPlaying()) {   
@@ -766,18 +963,12 @@ void JkkRadioSetVolume(uint8_t vol){
     JkkRadioUpdateVolume();
 }
 
-void JkkRadioListForWWW(void){
-    char *webOptions = NULL;
-
-    webOptions = heap_caps_calloc(jkkRadio.station_count, 128 + 256 + 32, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    for (int i = 0; i < jkkRadio.station_count; i++) {
-        char stationName[128 + 256 + 44] = {0};
-        snprintf(stationName, sizeof(stationName), "%d;%s;%s;%s", i, jkkRadio.jkkRadioStations[i].nameShort, jkkRadio.jkkRadioStations[i].nameLong, jkkRadio.jkkRadioStations[i].uri);
-        strncat(webOptions, stationName, 128 + 256 + 44);
-        if(i < jkkRadio.station_count - 1) strcat(webOptions, "\n");
-    }
-    JkkRadioWwwUpdateStationList(webOptions);
-    free(webOptions);
+int JkkRadioStationLineForWWW(int idx, char *buf, size_t len) {
+    if (idx < 0 || idx >= jkkRadio.station_count || !jkkRadio.jkkRadioStations) return -1;
+    char uri[JKK_RADIO_STATION_URI_LEN];
+    char nameLong[JKK_RADIO_STATION_NAME_LEN];
+    return snprintf(buf, len, "%d;%s;%s;%s", idx, jkkRadio.jkkRadioStations[idx].nameShort,
+                    JkkRadioGetStationName(idx, nameLong, sizeof(nameLong)), JkkRadioGetStationUri(idx, uri, sizeof(uri)));
 }
 
 esp_err_t JkkRadioSendMessageToMain(int mess, int command){
@@ -927,11 +1118,12 @@ static void JkkSdRecInfoWrite(time_t timeSet, const char *path, const char *file
     localtime_r(&timeSet, &timeinfo); 
     
     if(!end){
+        char nameLong[JKK_RADIO_STATION_NAME_LEN];
         snprintf(infoText, sizeof(infoText), "%s%s;%s;%s;%04d-%02d-%02d;%02d.%02d.%02d",
                 isExist ? "\n" : "# File path;Short name;Description;Start date;Start time;End date;End time\n#\n",
                 filePath,
                 jkkRadio.jkkRadioStations[jkkRadio.current_station].nameShort,
-                jkkRadio.jkkRadioStations[jkkRadio.current_station].nameLong,
+                JkkRadioGetStationName(jkkRadio.current_station, nameLong, sizeof(nameLong)),
                 timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday, timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
     }
     else {
@@ -996,8 +1188,26 @@ static void JkkChangeStation(audio_pipeline_handle_t pipeline, changeStation_e u
     JkkRadioSetStation(nextStation);
 }
 
+/* URI to play for station: with probing on, the fastest working mirror (station with the same long name) */
+static const char *JkkRadioPlayUri(int station, char *uri, size_t len) {
+#if defined(CONFIG_JKK_RADIO_PROBE)
+    int mirror = JkkProbeBestMirror(jkkRadio.jkkRadioStations, jkkRadio.station_count, station);
+    if (mirror != station) {
+        JkkRadioGetStationUri(mirror, uri, len);
+        ESP_LOGI(TAG, "Station %d played from mirror %d: %s", station, mirror, uri);
+        return uri;
+    }
+#endif
+    return JkkRadioGetStationUri(station, uri, len);
+}
+
 void JkkRadioSetStation(uint16_t station){
    
+#if defined(CONFIG_JKK_RADIO_SYNC_FOLLOWER)
+    ESP_LOGW(TAG, "Multi-room follower, station is chosen on leader");
+    return;
+#endif
+
     if(station > jkkRadio.station_count - 1) {
         ESP_LOGI(TAG, "No change in station, current station: %d", jkkRadio.current_station);
         return;
@@ -1051,8 +1261,12 @@ void JkkRadioSetStation(uint16_t station){
 
     ret = ESP_OK;
 
-    ESP_LOGI(TAG, "Station change - Name: %s, Url: %s", jkkRadio.jkkRadioStations[station].nameLong, jkkRadio.jkkRadioStations[station].uri);
-    ret |= JkkAudioSetUrl(jkkRadio.jkkRadioStations[station].uri, false);
+    char uri[JKK_RADIO_STATION_URI_LEN];
+    char nameLong[JKK_RADIO_STATION_NAME_LEN];
+    JkkRadioGetStationName(station, nameLong, sizeof(nameLong));
+    ESP_LOGI(TAG, "Station change - Name: %s, Url: %s", nameLong, JkkRadioGetStationUri(station, uri, sizeof(uri)));
+    ret |= JkkAudioSetUrl(JkkRadioPlayUri(station, uri, sizeof(uri)), false);
+    JkkRadioPreconfigureStation(station);
 
    // ret |= audio_pipeline_reset_ringbuffer(jkkRadio.audioMain->pipeline);
   //  ret |= audio_pipeline_reset_elements(jkkRadio.audioMain->pipeline);
@@ -1069,6 +1283,10 @@ void JkkRadioSetStation(uint16_t station){
             jkkRadio.current_station = station;
             JkkRadioSaveTimerStart(JKK_RADIO_TO_SAVE_CURRENT_STATION);
             JkkRadioWwwSetStationId(jkkRadio.current_station);
+            JkkRadioWwwUpdateAudioDes(jkkRadio.jkkRadioStations[station].audioDes);
+#if defined(CONFIG_JKK_RADIO_RESTREAM)
+            JkkRestreamSetName(nameLong);
+#endif
 #if defined(CONFIG_JKK_RADIO_USING_I2C_LCD) 
             JkkLcdStationTxt(">tuning<");
             if(JkkLcdRollerMode() == JKK_ROLLER_MODE_STATION_LIST) {
@@ -1082,7 +1300,7 @@ void JkkRadioSetStation(uint16_t station){
 
 static void SaveTimerHandle(TimerHandle_t xTimer){
     if(xTimer == NULL) return;
-    ESP_LOGI(TAG, "SaveTimerHandle");
+    ESP_LOGI(TAG, "SaveTimerHandle, timer task stack free %u", (unsigned)uxTaskGetStackHighWaterMark(NULL));
 
     if((jkkRadio.whatToDo & JKK_RADIO_TO_SAVE_CURRENT_STATION) > 0) {
         jkkRadio.statusStation = JKK_RADIO_STATUS_NORMAL;
@@ -1096,16 +1314,25 @@ static void SaveTimerHandle(TimerHandle_t xTimer){
             .current_volume = jkkRadio.player_volume,
             .is_playing = isPlaying,
         };
-        JkkNvs64_set("stateStEq", JKK_RADIO_NVS_NAMESPACE, toSave.all64);
+        JkkSnapshotSetState(toSave.all64); // Not written if not changed (station changed and back, volume up and down)
         jkkRadio.whatToDo &= ~(JKK_RADIO_TO_SAVE_CURRENT_STATION | JKK_RADIO_TO_SAVE_EQ | JKK_RADIO_TO_SAVE_VOLUME | JKK_RADIO_TO_SAVE_PLAY);
     }
-    if(jkkRadio.whatToDo & JKK_RADIO_TO_SAVE_STATION_LIST){
-        JkkRadioExportStations("stations.txt");
-        jkkRadio.whatToDo &= ~JKK_RADIO_TO_SAVE_STATION_LIST;
+    if((jkkRadio.whatToDo & JKK_RADIO_TO_SAVE_STATION_LIST) && JkkRadioSendMessageToMain(0, JKK_RADIO_CMD_EXPORT_STATIONS) == ESP_OK){
+        jkkRadio.whatToDo &= ~JKK_RADIO_TO_SAVE_STATION_LIST; // Chunk buffer, cold NVS reads and FATFS do not fit timer task stack
     }
-    if(jkkRadio.whatToDo & JKK_RADIO_TO_SAVE_ALL_STATIONS){
-        JkkRadioAllStationsSave();
-        jkkRadio.whatToDo &= ~JKK_RADIO_TO_SAVE_ALL_STATIONS;
+    if(jkkRadio.whatToDo & JKK_RADIO_TO_SAVE_STATION_ORDER){
+        JkkRadioStationOrderSave();
+        jkkRadio.whatToDo &= ~JKK_RADIO_TO_SAVE_STATION_ORDER;
+    }
+    if(jkkRadio.whatToDo & JKK_RADIO_TO_SAVE_STATION_FMT){
+        JkkRadioOneStationSave(jkkRadio.fmt_station);
+        jkkRadio.fmt_station = -1;
+        jkkRadio.whatToDo &= ~JKK_RADIO_TO_SAVE_STATION_FMT;
+    }
+    static uint32_t nvsWritesPublished = 0;
+    uint32_t nvsWrites = JkkNvsWriteCount();
+    if(nvsWrites != nvsWritesPublished && JkkRadioSendMessageToMain(0, JKK_RADIO_CMD_PUBLISH_NVS_STATS) == ESP_OK) {
+        nvsWritesPublished = nvsWrites; // Publish can block on MQTT client lock, timer task also runs stall watchdog
     }
     if(jkkRadio.whatToDo & JKK_RADIO_TO_SAVE_PROVISIONED){
         wifi_prov_mgr_deinit();
@@ -1119,6 +1346,7 @@ static void SaveTimerHandle(TimerHandle_t xTimer){
         JkkLcdPortOnOffLcd(false);
         jkkRadio.whatToDo &= ~JKK_RADIO_TO_DO_LCD_OFF;
         JkkMqttPublishState();
+        JkkRadioWwwStateChanged();
     }
     JkkLcdIpTxt("");
 #endif
@@ -1130,6 +1358,7 @@ void JkkRadioLcdOn(void) {
         jkkRadio.whatToDo &= ~JKK_RADIO_TO_DO_LCD_OFF;
     }
     JkkMqttPublishState();
+    JkkRadioWwwStateChanged();
 }
 #endif
 
@@ -1147,9 +1376,79 @@ int JkkRadioGetStationCount(void) {
     return jkkRadio.station_count;
 }
 
-const char *JkkRadioGetStationName(int idx) {
+const char *JkkRadioGetStationName(int idx, char *buf, size_t len) {
+    if (idx < 0 || idx >= jkkRadio.station_count || !jkkRadio.jkkRadioStations) return NULL;
+    return JkkStationStoreNameLong(jkkRadio.jkkRadioStations, jkkRadio.station_count, idx, buf, len);
+}
+
+const char *JkkRadioGetStationUri(int idx, char *buf, size_t len) {
     if (idx < 0 || idx >= jkkRadio.station_count || !jkkRadio.jkkRadioStations) return NULL;
-    return jkkRadio.jkkRadioStations[idx].nameLong;
+    return JkkStationStoreUri(jkkRadio.jkkRadioStations, jkkRadio.station_count, idx, buf, len);
+}
+
+int JkkRadioFindStationByName(const char *name) {
+    return JkkStationIndexFind(jkkRadio.jkkRadioStations, jkkRadio.station_count, name);
+}
+
+int JkkRadioSearchStations(const char *query, int *ids, int max) {
+    return JkkStationIndexSearch(jkkRadio.jkkRadioStations, jkkRadio.station_count, query, ids, max);
+}
+
+int JkkRadioGetStationStalls(int idx) {
+    if (idx < 0 || idx >= jkkRadio.station_count || !jkkRadio.jkkRadioStations) return 0;
+    return jkkRadio.jkkRadioStations[idx].stalls;
+}
+
+uint32_t JkkRadioGetStationUriHash(int idx) {
+    if (idx < 0 || idx >= jkkRadio.station_count || !jkkRadio.jkkRadioStations) return 0;
+    return jkkRadio.jkkRadioStations[idx].uriHash;
+}
+
+esp_err_t JkkRadioImportStations(JkkRadioStations_t *stations, int count, bool last) {
+    if (count > 0) {
+        JkkRadioStationsLock();
+        if (jkkRadio.station_count + count > JKK_RADIO_MAX_STATIONS) {
+            JkkRadioStationsUnlock();
+            return ESP_ERR_INVALID_SIZE;
+        }
+        JkkRadioStations_t *grown = heap_caps_realloc(jkkRadio.jkkRadioStations, (jkkRadio.station_count + count) * sizeof(JkkRadioStations_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (grown == NULL) {
+            JkkRadioStationsUnlock();
+            ESP_LOGE(TAG, "No memory for %d imported stations", count);
+            return ESP_ERR_NO_MEM;
+        }
+        int first = jkkRadio.station_count;
+        memcpy(&grown[first], stations, count * sizeof(JkkRadioStations_t));
+        jkkRadio.jkkRadioStations = grown;
+        jkkRadio.station_count += count;
+        if (JkkStationStoreSaveChanged(jkkRadio.jkkRadioStations, jkkRadio.station_count, 0) == ESP_OK) {
+            for (int i = first; i < jkkRadio.station_count; i++) {
+                JkkStationStoreDropCold(&jkkRadio.jkkRadioStations[i]); // Saved, read from NVS when needed
+            }
+        }
+        JkkRadioStationsUnlock();
+        JkkStationIndexInvalidate();
+        JkkRadioWwwStationListChanged();
+    }
+    if (last) {
+#if defined(CONFIG_JKK_RADIO_USING_I2C_LCD)
+        if (JkkLcdRollerMode() == JKK_ROLLER_MODE_STATION_LIST) {
+            char *lcdRollerOptions = heap_caps_calloc(jkkRadio.station_count, 10, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (lcdRollerOptions) {
+                for (int i = 0; i < jkkRadio.station_count; i++) {
+                    strncat(lcdRollerOptions, jkkRadio.jkkRadioStations[i].nameShort, 8);
+                    if (i < jkkRadio.station_count - 1) strcat(lcdRollerOptions, "\n");
+                }
+                JkkLcdSetRollerOptions(lcdRollerOptions, jkkRadio.current_station);
+                free(lcdRollerOptions);
+            }
+        }
+#endif
+        JkkRadioSaveTimerStart(JKK_RADIO_TO_SAVE_STATION_LIST);
+        JkkMqttPublishState();
+        JkkMqttPublishDiscovery();
+    }
+    return ESP_OK;
 }
 
 int JkkRadioGetEq(void) {
@@ -1212,10 +1511,11 @@ void JkkRadioPlay(void) {
 #if defined(CONFIG_JKK_RADIO_USING_I2C_LCD)
     if (JkkRadioIsPlaying()) {
         JkkRadioLcdOn();
-        JkkLcdStationTxt(jkkRadio.jkkRadioStations[jkkRadio.current_station].nameLong);
+        JkkRadioLcdStationName();
     }
 #endif
     JkkMqttPublishState();
+    JkkRadioWwwStateChanged();
 }
 
 void JkkRadioPause(void) {
@@ -1240,6 +1540,7 @@ void JkkRadioPause(void) {
     }
 #endif
     JkkMqttPublishState();
+    JkkRadioWwwStateChanged();
 }
 
 void JkkRadioStop(void) {
@@ -1263,6 +1564,7 @@ void JkkRadioStop(void) {
     JkkRadioSaveTimerStart(JKK_RADIO_TO_DO_LCD_OFF);
 #endif
     JkkMqttPublishState();
+    JkkRadioWwwStateChanged();
 }
 
 void JkkRadioTogglePlayPause(void) {
@@ -1364,6 +1666,7 @@ static void MainAppTask(void *arg){
         ESP_ERROR_CHECK(nvs_flash_erase());
         err = nvs_flash_init();
     }
+    JkkSnapshotLoad();
 
     ESP_ERROR_CHECK(esp_netif_init());
 
@@ -1373,6 +1676,7 @@ static void MainAppTask(void *arg){
 
     jkkRadio.current_station = 0;
     jkkRadio.current_eq = 0;
+    jkkRadio.fmt_station = -1;
 
     ESP_LOGI(TAG, "Start audio codec chip");
     jkkRadio.board_handle = audio_board_init();
@@ -1391,7 +1695,13 @@ static void MainAppTask(void *arg){
     JkkLcdUiInit(&jkkRadio);
 #endif
 
-    jkkRadio.audioMain = JkkAudioMain_init(3, 1, 1, 1); // in/out type: 3 - HTTP, 1 - I2S; processing type: 1 - EQUALIZER, 1 - RAW_SPLIT; split nr
+#if defined(CONFIG_JKK_RADIO_SYNC_FOLLOWER)
+    jkkRadio.audioMain = JkkAudioMain_init(JKK_AUDIO_IO_RAW, JKK_AUDIO_IO_I2S, JKK_AUDIO_PROC_EQUALIZER, 1); // PCM from multi-room leader
+#elif defined(CONFIG_JKK_RADIO_SYNC_LEADER)
+    jkkRadio.audioMain = JkkAudioMain_init(JKK_AUDIO_IO_HTTP, JKK_AUDIO_IO_I2S, JKK_AUDIO_PROC_EQUALIZER, 2); // second raw split output feeds multi-room followers
+#else
+    jkkRadio.audioMain = JkkAudioMain_init(JKK_AUDIO_IO_HTTP, JKK_AUDIO_IO_I2S, JKK_AUDIO_PROC_EQUALIZER, 1); // 1 raw split output: SD recording
+#endif
 
     jkkRadio.audioSdWrite = JkkAudioSdWrite_init(1, 22050, 2); // 1 - AAC, sample_rate, channels
 
@@ -1402,18 +1712,25 @@ static void MainAppTask(void *arg){
     audio_board_sdcard_init(jkkRadio.set, SD_MODE_1_LINE);
 
     JkkRadioSettingsRead(&jkkRadio);
+    JkkRadioStationsLock();
     JkkRadioStationSdRead(&jkkRadio);
+    JkkRadioStationsUnlock();
     JkkRadioEqSdRead(&jkkRadio);
+    JkkStationIndexInvalidate();
 
-    JkkRadioEqListForWWW();
-    JkkRadioListForWWW();
+    JkkRadioWwwEqListChanged();
+    JkkRadioWwwStationListChanged();
+#if defined(CONFIG_JKK_RADIO_CATALOG)
+    JkkCatalogInit(CONFIG_JKK_RADIO_CATALOG_PARTITION);
+#endif
 
     JkkRadioDataToSave_t toRead = {0};
 
     bool playAnything = false;
-    uint64_t _saved_state_tmp = 0; // avoid taking address of packed member
-    if(JkkNvs64_get("stateStEq", JKK_RADIO_NVS_NAMESPACE, &_saved_state_tmp) == ESP_OK){
-        toRead.all64 = _saved_state_tmp;
+    JkkSnapshot_t snap;
+    JkkSnapshotGet(&snap);
+    if(snap.stateValid){
+        toRead.all64 = snap.state;
         jkkRadio.current_eq = toRead.current_eq < jkkRadio.eq_count ? toRead.current_eq : 0;
         jkkRadio.prev_station = jkkRadio.current_station = toRead.current_station < jkkRadio.station_count ? toRead.current_station : 0;
         jkkRadio.player_volume = toRead.current_volume <= 100 ? toRead.current_volume : 10; // Volume should be in range 0-100
@@ -1526,7 +1843,7 @@ static void MainAppTask(void *arg){
 
     if(wifiRet == ESP_OK){
 #if defined(CONFIG_JKK_RADIO_USING_I2C_LCD) 
-        JkkLcdStationTxt(jkkRadio.jkkRadioStations[jkkRadio.current_station].nameLong);
+        JkkRadioLcdStationName();
 #endif
         JkkRadioWwwSetStationId(jkkRadio.current_station);
 
@@ -1553,18 +1870,45 @@ static void MainAppTask(void *arg){
     ringbuf_handle_t rb = audio_element_get_output_ringbuf(jkkRadio.audioSdWrite->raw_read);
     audio_element_set_multi_output_ringbuf(jkkRadio.audioMain->split, rb, 0);
 
+#if defined(CONFIG_JKK_RADIO_RESTREAM)
+    ESP_LOGI(TAG, "Start re-streaming of compressed input");
+    JkkRestreamInit(jkkRadio.audioMain->inSplit);
+#endif
+#if defined(CONFIG_JKK_RADIO_PROBE)
+    JkkProbeStart();
+#endif
+#if !defined(CONFIG_JKK_RADIO_SYNC_FOLLOWER)
+    JkkAudioMainStallWatchdogStart(CONFIG_JKK_RADIO_STALL_TIMEOUT_MS, JkkRadioStreamStall_cb);
+#endif
+#if defined(CONFIG_JKK_RADIO_SYNC_LEADER)
+    JkkSyncLeaderStart(jkkRadio.audioMain->split, 1);
+#elif defined(CONFIG_JKK_RADIO_SYNC_FOLLOWER)
+    JkkSyncFollowerStart(jkkRadio.audioMain->input);
+#endif
+
     esp_err_t ret = mkdir(SD_RECORDS_PATH, 0777);
     if (ret != 0 && errno != EEXIST) {
         ESP_LOGE(TAG, "Mkdir directory: %s, failed with errno: %d/%s", SD_RECORDS_PATH, errno, strerror(errno));
     }
     
+#if !defined(CONFIG_JKK_RADIO_SYNC_FOLLOWER)
     ESP_LOGI(TAG, "Set up  uri (http as http_stream, dec as decoder, and default output is i2s)");
-    JkkAudioSetUrl(jkkRadio.jkkRadioStations[jkkRadio.current_station].uri, false);
+    char playUri[JKK_RADIO_STATION_URI_LEN];
+    JkkAudioSetUrl(JkkRadioPlayUri(jkkRadio.current_station, playUri, sizeof(playUri)), false);
+    JkkRadioPreconfigureStation(jkkRadio.current_station);
+#endif
+#if defined(CONFIG_JKK_RADIO_RESTREAM)
+    char restreamName[JKK_RADIO_STATION_NAME_LEN];
+    JkkRestreamSetName(JkkRadioGetStationName(jkkRadio.current_station, restreamName, sizeof(restreamName)));
+#endif
     
-#if defined(CONFIG_JKK_RADIO_USING_I2C_LCD) 
-    JkkLcdStationTxt(jkkRadio.jkkRadioStations[jkkRadio.current_station].nameLong);
+#if defined(CONFIG_JKK_RADIO_USING_I2C_LCD) && defined(CONFIG_JKK_RADIO_SYNC_FOLLOWER)
+    JkkLcdStationTxt("Multi-room");
+#elif defined(CONFIG_JKK_RADIO_USING_I2C_LCD)
+    JkkRadioLcdStationName();
 #endif
     JkkRadioWwwSetStationId(jkkRadio.current_station);
+    JkkRadioWwwUpdateAudioDes(jkkRadio.jkkRadioStations[jkkRadio.current_station].audioDes);
     JkkRadioWwwSetEqId(jkkRadio.current_eq); 
 
     ESP_LOGI(TAG, "Set up  event listener");
@@ -1609,12 +1953,7 @@ static void MainAppTask(void *arg){
                     char ssid[32] = {0};
                     char pass[64] = {0};
                     if (JkkWebGetPendingWifi(ssid, sizeof(ssid), pass, sizeof(pass))) {
-                        if(strcmp(ssid, jkkRadio.wifiSSID)){
-                            JkkNvsBlobSet("wifi_ssid", JKK_RADIO_NVS_NAMESPACE, ssid, strlen(ssid) + 1);
-                        }
-                        if(strcmp(pass, jkkRadio.wifiPassword)){
-                            JkkNvsBlobSet("wifi_password", JKK_RADIO_NVS_NAMESPACE, pass, strlen(pass) + 1);
-                        }
+                        JkkSnapshotSetWifi(ssid, pass);
                         strncpy(jkkRadio.wifiSSID, ssid, sizeof(jkkRadio.wifiSSID) - 1);
                         strncpy(jkkRadio.wifiPassword, pass, sizeof(jkkRadio.wifiPassword) - 1);
                         ESP_LOGI(TAG, "WiFi saved via web (queue): %s", ssid);
@@ -1631,15 +1970,18 @@ static void MainAppTask(void *arg){
         if (ret != ESP_OK) {
             audio_element_state_t inState = audio_element_get_state(jkkRadio.audioMain->input);
             audio_element_state_t outState = audio_element_get_state(jkkRadio.audioMain->output);
-            audio_element_state_t decState = audio_element_get_state(jkkRadio.audioMain->decoder);
+            // Raw input (multi-room follower) has no decoder and no own task
+            audio_element_state_t decState = jkkRadio.audioMain->decoder ? audio_element_get_state(jkkRadio.audioMain->decoder) : AEL_STATE_RUNNING;
+            if(jkkRadio.audioMain->decoder == NULL) inState = AEL_STATE_RUNNING;
             audio_element_state_t vmState = audio_element_get_state(jkkRadio.audioMain->vmeter);
          //   ESP_LOGW(TAG, "[ Uncnow ] fatfs_wr state: %d, inState: %d", sdState, inState);
             jkkRadio.audioSdWrite->is_recording = JkkAudioSdWriteIsRecording();
             jkkRadio.is_playing = (inState == AEL_STATE_RUNNING && outState == AEL_STATE_RUNNING && decState == AEL_STATE_RUNNING && vmState == AEL_STATE_RUNNING);
+            JkkRadioUpdateAudioDes();
             if(jkkRadio.is_playing && (jkkRadio.statusStation == JKK_RADIO_STATUS_ERROR || jkkRadio.statusStation == JKK_RADIO_STATUS_CHANGING_STATION)){
 #if defined(CONFIG_JKK_RADIO_USING_I2C_LCD) 
                 if(jkkRadio.current_station >= 0 && jkkRadio.current_station < jkkRadio.station_count){
-                    JkkLcdStationTxt(jkkRadio.jkkRadioStations[jkkRadio.current_station].nameLong);
+                    JkkRadioLcdStationName();
                 }
 #endif
                 jkkRadio.statusStation = JKK_RADIO_STATUS_NORMAL;
@@ -1718,16 +2060,45 @@ static void MainAppTask(void *arg){
                 ESP_LOGW(TAG, "JKK_RADIO_CMD_PAUSE"); 
                 JkkRadioPause();
             }
+#if defined(CONFIG_JKK_RADIO_SYNC_FOLLOWER)
+            else if(msg.cmd == JKK_RADIO_CMD_SYNC_FORMAT){
+                int rate, ch, bits;
+                JkkSyncFormatUnpack((int)(intptr_t)msg.data, &rate, &ch, &bits);
+                bool reconfigured = JkkRadioApplyStreamFormat(rate, ch, bits);
+                ESP_LOGI(TAG, "Multi-room format %d Hz, %d ch, %d bits%s", rate, ch, bits, reconfigured ? " (reconfigured)" : "");
+                if (jkkRadio.player_volume > 0) {
+                    if (reconfigured) {
+                        vTaskDelay(pdMS_TO_TICKS(100));
+                    }
+                    audio_hal_enable_pa(jkkRadio.board_handle->audio_hal, true);
+                }
+            }
+#endif
+#if defined(CONFIG_JKK_RADIO_IMPORT)
+            else if(msg.cmd == JKK_RADIO_CMD_IMPORT_STEP){
+                JkkImportStep((int)(intptr_t)msg.data);
+            }
+#endif
+            else if(msg.cmd == JKK_RADIO_CMD_STREAM_STALL){
+                int st = jkkRadio.current_station;
+                if(st >= 0 && st < jkkRadio.station_count && jkkRadio.jkkRadioStations[st].stalls < UINT16_MAX) jkkRadio.jkkRadioStations[st].stalls++;
+                ESP_LOGW(TAG, "Stream stall (%s) on station %d, stalls: %d, reconnecting", 
+                         (int)(intptr_t)msg.data == JKK_AUDIO_STALL_INPUT ? "no data" : "no audio", st, JkkRadioGetStationStalls(st));
+                audio_hal_enable_pa(jkkRadio.board_handle->audio_hal, false); // Enabled again by music info
+                JkkAudioRestartStream();
+                JkkMqttPublishState(); // Stall count of current station
+            }
+            else if(msg.cmd == JKK_RADIO_CMD_PUBLISH_NVS_STATS){
+                JkkMqttPublishNvsStats();
+            }
+            else if(msg.cmd == JKK_RADIO_CMD_EXPORT_STATIONS){
+                JkkRadioExportStations("stations.txt");
+            }
             else if(msg.cmd == JKK_RADIO_CMD_SAVE_WIFI){
                 char ssid[32] = {0};
                 char pass[64] = {0};
                 if (JkkWebGetPendingWifi(ssid, sizeof(ssid), pass, sizeof(pass))) {
-                    if(strcmp(ssid, jkkRadio.wifiSSID)){
-                        JkkNvsBlobSet("wifi_ssid", JKK_RADIO_NVS_NAMESPACE, ssid, strlen(ssid) + 1);
-                    }
-                    if(strcmp(pass, jkkRadio.wifiPassword)){
-                        JkkNvsBlobSet("wifi_password", JKK_RADIO_NVS_NAMESPACE, pass, strlen(pass) + 1);
-                    }
+                    JkkSnapshotSetWifi(ssid, pass);
                     strncpy(jkkRadio.wifiSSID, ssid, sizeof(jkkRadio.wifiSSID) - 1);
                     strncpy(jkkRadio.wifiPassword, pass, sizeof(jkkRadio.wifiPassword) - 1);
                     ESP_LOGI(TAG, "WiFi saved via web: %s", ssid);
@@ -1754,10 +2125,13 @@ static void MainAppTask(void *arg){
 
         if (msg.source_type == PERIPH_ID_SDCARD && msg.cmd == AEL_MSG_CMD_FINISH) {  
             JkkRadioSettingsRead(&jkkRadio);
+            JkkRadioStationsLock(); // Web worker may be exporting or editing
             JkkRadioStationSdRead(&jkkRadio);
+            JkkRadioStationsUnlock();
             JkkRadioEqSdRead(&jkkRadio);
-            JkkRadioEqListForWWW();
-            JkkRadioListForWWW();
+            JkkStationIndexInvalidate();
+            JkkRadioWwwEqListChanged();
+            JkkRadioWwwStationListChanged();
             continue;
         }
 
@@ -1765,41 +2139,35 @@ static void MainAppTask(void *arg){
             && msg.source == (void *)jkkRadio.audioMain->decoder
             && msg.cmd == AEL_MSG_CMD_REPORT_MUSIC_INFO) {
 
-            static audio_element_info_t prev_music_info = {0};
             audio_element_info_t music_info = {0};
             audio_element_getinfo(jkkRadio.audioMain->decoder, &music_info);
 
             ESP_LOGI(TAG, "Receive music info from dec decoder, sample_rates=%d, bits=%d, ch=%d", 
                      music_info.sample_rates, music_info.bits, music_info.channels);
 
-            if ((prev_music_info.bits != music_info.bits) || 
-                (prev_music_info.sample_rates != music_info.sample_rates) || 
-                (prev_music_info.channels != music_info.channels)) {
-                
-                ESP_LOGI(TAG, "Change sample_rates=%d, bits=%d, ch=%d",  
-                         music_info.sample_rates, music_info.bits, music_info.channels);
-                
-                JkkAudioI2sSetClk(music_info.sample_rates, music_info.bits, music_info.channels, true);
-                JkkAudioEqSetInfo(music_info.sample_rates, music_info.channels);
-                JkkAudioSdWriteResChange(music_info.sample_rates, music_info.channels, music_info.bits);
-#if defined(CONFIG_JKK_RADIO_USING_I2C_LCD)
-                volume_meter_update_format(jkkRadio.audioMain->vmeter, music_info.sample_rates, 
-                                         music_info.channels, music_info.bits);
+            // Usually already applied in JkkRadioSetStation from the cached format, then nothing to do here
+            bool reconfigured = JkkRadioApplyStreamFormat(music_info.sample_rates, music_info.channels, music_info.bits);
+            JkkRadioStoreStreamFormat(jkkRadio.current_station, &music_info);
+#if defined(CONFIG_JKK_RADIO_RESTREAM)
+            JkkRestreamSetCodec(music_info.codec_fmt);
+#endif
+#if defined(CONFIG_JKK_RADIO_SYNC_LEADER)
+            JkkSyncSetFormat(music_info.sample_rates, music_info.channels, music_info.bits);
 #endif
-                memcpy(&prev_music_info, &music_info, sizeof(audio_element_info_t));
-            }
             
             if (jkkRadio.player_volume > 0) {
-                vTaskDelay(pdMS_TO_TICKS(100));
+                if (reconfigured) {
+                    vTaskDelay(pdMS_TO_TICKS(100)); // Let the output settle after clock change
+                }
                 if (JkkAudioIsPlaying()) {
                     audio_hal_enable_pa(jkkRadio.board_handle->audio_hal, true);
-                    ESP_LOGI(TAG, "PA amplifier enabled after music info");
+                    ESP_LOGI(TAG, "PA amplifier enabled after music info%s", reconfigured ? " (reconfigured)" : "");
                 }
             }
             
 #if defined(CONFIG_JKK_RADIO_USING_I2C_LCD)
             if(jkkRadio.statusStation == JKK_RADIO_STATUS_CHANGING_STATION){
-                JkkLcdStationTxt(jkkRadio.jkkRadioStations[jkkRadio.current_station].nameLong);
+                JkkRadioLcdStationName();
             }
 #endif
             JkkRadioWwwSetStationId(jkkRadio.current_station);
@@ -1809,8 +2177,9 @@ static void MainAppTask(void *arg){
 
         /* restart stream when the first jkkRadio.audioMain->pipeline element (http_stream_reader in this case) receives stop event (caused by reading errors) */
         if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *) jkkRadio.audioMain->input
-            && msg.cmd == AEL_MSG_CMD_REPORT_STATUS && (int)msg.data == AEL_STATUS_ERROR_OPEN) {
-            ESP_LOGW(TAG, "Restart stream");
+            && msg.cmd == AEL_MSG_CMD_REPORT_STATUS && ((int)msg.data == AEL_STATUS_ERROR_OPEN 
+            || (int)msg.data == AEL_STATUS_ERROR_INPUT || (int)msg.data == AEL_STATUS_ERROR_TIMEOUT)) {
+            ESP_LOGW(TAG, "Restart stream, input status: %d", (int)msg.data);
             JkkAudioRestartStream();
             continue;
         }
@@ -1864,7 +2233,7 @@ static void MainAppTask(void *arg){
                 }
                 else if(msg.cmd == PERIPH_BUTTON_LONG_PRESSED && (rollerMode == JKK_ROLLER_MODE_STATION_LIST || rollerMode == JKK_ROLLER_MODE_EQUALIZER_LIST)){
                     JkkLcdButtonSet(LV_KEY_ESC, 1);
-                    JkkLcdShowRoller(false, UINT8_MAX, JKK_ROLLER_MODE_HIDE);
+                    JkkLcdShowRoller(false, UINT16_MAX, JKK_ROLLER_MODE_HIDE);
                 }
 
                 ESP_LOGI(TAG, "[] get_input_mode_id");
@@ -2001,7 +2370,10 @@ static void MainAppTask(void *arg){
     JkkAudioMain_deinit();
     JkkAudioSdWrite_deinit();
     audio_board_deinit(jkkRadio.board_handle);
-    free(jkkRadio.jkkRadioStations);
+    JkkStationStoreFree(jkkRadio.jkkRadioStations, jkkRadio.station_count);
+#if defined(CONFIG_JKK_RADIO_CATALOG)
+    JkkCatalogDeinit();
+#endif
 
 }
 
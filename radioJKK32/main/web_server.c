@@ -4,14 +4,31 @@
 #include <string.h>
 #include <stdlib.h>
 #include "esp_heap_caps.h"
+#include "esp_app_desc.h"
+#include "esp_random.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
 #include "mdns.h"
 #include "lwip/apps/netbiosns.h"
 #include "web_server.h"
 #include "jkk_radio.h"
 #include "jkk_nvs.h"
 #include "jkk_mqtt.h"
+#include "jkk_json.h"
+#if defined(CONFIG_JKK_RADIO_RESTREAM)
+#include "jkk_restream.h"
+#endif
+#if defined(CONFIG_JKK_RADIO_CATALOG)
+#include "jkk_catalog.h"
+#endif
+#if defined(CONFIG_JKK_RADIO_IMPORT)
+#include "jkk_import.h"
+#endif
+#if defined(CONFIG_JKK_RADIO_PROBE)
+#include "jkk_probe.h"
+#endif
 #include "esp_event.h"
 
 ESP_EVENT_DECLARE_BASE(JKK_EVT_BASE);
@@ -30,41 +47,72 @@ static const char *TAG = "JKK_WEB";
 static bool webServerRunning = false;
 static EXT_RAM_BSS_ATTR httpd_handle_t server = NULL;
 
-static EXT_RAM_BSS_ATTR char station_list[(128 + 128 + 32) * JKK_RADIO_MAX_STATIONS] = "";
-static EXT_RAM_BSS_ATTR char eq_list[18 * JKK_RADIO_MAX_EQ_PRESETS] = "";
 static uint8_t volume = 10;
-static int8_t station_id = -1;
+static int16_t station_id = -1;
 static uint8_t eq_id = 0;
 static int8_t is_rec = 0;
+static char audio_des[16] = ""; // Codec and measured bitrate of current station
 static char wifi_ssid[32] = "";
 static char wifi_pass[64] = "";
 static bool wifi_pending = false;
 
 extern const uint8_t index_html_start[] asm("_binary_index_html_start");
 extern const uint8_t index_html_end[]   asm("_binary_index_html_end");
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start"); // Minified and gzipped at build (tools/jkk_web_pack.py)
+extern const uint8_t index_html_gz_end[]   asm("_binary_index_html_gz_end");
+
+static char index_etag[2][24] = {"", ""}; // Plain and gzip, from firmware build (page is embedded in it)
+static char index_cache[40] = "";
+
+// WebSocket /events: status and list versions pushed to page instead of polling
+#define JKK_WWW_EVENT_LEN (96)
+#define JKK_WWW_EVENT_CHECK_US (2000 * 1000) // Changes without setter (stream state, LCD timeout, audio description)
+static uint16_t station_list_ver = 1; // Also ETag of /station_list and /eq_list
+static uint16_t eq_list_ver = 1;
+static volatile bool events_queued = false;
+static volatile uint8_t events_clients = 0;
+static char events_last[2][JKK_WWW_EVENT_LEN] = {"", ""}; // Last sent status and list versions, httpd task only
+static esp_timer_handle_t events_timer = NULL;
+
+static void events_notify(void);
 
-void JkkRadioWwwSetStationId(int8_t id) {
+void JkkRadioWwwSetStationId(int16_t id) {
     station_id = id;
+    events_notify();
 }
 
-void JkkRadioWwwUpdateStationList(const char *list) {
-    strncpy(station_list, list, sizeof(station_list) - 1);
+void JkkRadioWwwStationListChanged(void) {
+    station_list_ver++;
+    events_notify();
 }
 
-void JkkRadioWwwUpdateEqList(const char *list) {
-    strncpy(eq_list, list, sizeof(eq_list) - 1);
+void JkkRadioWwwEqListChanged(void) {
+    eq_list_ver++;
+    events_notify();
 }
 
 void JkkRadioWwwSetEqId(uint8_t id) {
     eq_id = id;
+    events_notify();
 }
 
 void JkkRadioWwwUpdateVolume(uint8_t vol) {
     volume = vol;
+    events_notify();
 }
 
 void JkkRadioWwwUpdateRecording(int8_t rec) {
     is_rec = rec;
+    events_notify();
+}
+
+void JkkRadioWwwUpdateAudioDes(const char *des) {
+    strlcpy(audio_des, des ? des : "", sizeof(audio_des));
+    events_notify();
+}
+
+void JkkRadioWwwStateChanged(void) {
+    events_notify();
 }
 
 bool JkkWebGetPendingWifi(char *ssid, size_t ssid_len, char *pass, size_t pass_len) {
@@ -102,28 +150,129 @@ static void url_decode(char *dst, const char *src, size_t len) {
 }
 
 esp_err_t root_get_handler(httpd_req_t *req) {
-    httpd_resp_send(req, (const char *)index_html_start, index_html_end - index_html_start);
-    return ESP_OK;
+    if (index_etag[0][0] == '\0') {
+        char sha[17];
+        esp_app_get_elf_sha256(sha, sizeof(sha));
+        snprintf(index_etag[0], sizeof(index_etag[0]), "\"%s\"", sha);
+        snprintf(index_etag[1], sizeof(index_etag[1]), "\"%s-gz\"", sha);
+        snprintf(index_cache, sizeof(index_cache), "public, max-age=%d", CONFIG_JKK_RADIO_WEB_MAX_AGE);
+    }
+    char hdr[128];
+    esp_err_t ret = httpd_req_get_hdr_value_str(req, "Accept-Encoding", hdr, sizeof(hdr));
+    bool gzip = (ret == ESP_OK || ret == ESP_ERR_HTTPD_RESULT_TRUNC) && strstr(hdr, "gzip") != NULL;
+    const char *etag = index_etag[gzip];
+    httpd_resp_set_type(req, "text/html");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", index_cache);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    ret = httpd_req_get_hdr_value_str(req, "If-None-Match", hdr, sizeof(hdr));
+    if ((ret == ESP_OK || ret == ESP_ERR_HTTPD_RESULT_TRUNC) && strstr(hdr, etag) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified"); // Same firmware, browser has this page
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (gzip) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        return httpd_resp_send(req, (const char *)index_html_gz_start, index_html_gz_end - index_html_gz_start);
+    }
+    return httpd_resp_send(req, (const char *)index_html_start, index_html_end - index_html_start);
 }
 
-esp_err_t info_get_handler(httpd_req_t *req) {
-    char current_status[80] = {0};
-    snprintf(current_status, sizeof(current_status), "%d;%d;%d;%d;%d", volume, station_id, eq_id, JkkRadioIsPlaying() ? 1 : 0, is_rec);
-    httpd_resp_set_type(req, "text/plain");
-        
+static void status_text(char *buf, size_t len) {
     // Dodajemy status LCD jako szósty parametr (0=off, 1=on)
-    snprintf(current_status, sizeof(current_status), "%d;%d;%d;%d;%d;%d", volume, station_id, eq_id, JkkRadioIsPlaying() ? 1 : 0, is_rec,
+    snprintf(buf, len, "%d;%d;%d;%d;%d;%d;%s", volume, station_id, eq_id, JkkRadioIsPlaying() ? 1 : 0, is_rec,
 #ifdef CONFIG_JKK_RADIO_USING_I2C_LCD
-    JkkLcdPortGetLcdState() ? 1 : 0
+    JkkLcdPortGetLcdState() ? 1 : 0,
 #else
-    -1
+    -1,
 #endif
-    );
+    audio_des);
+}
+
+esp_err_t info_get_handler(httpd_req_t *req) {
+    char current_status[96] = {0};
+    status_text(current_status, sizeof(current_status));
     httpd_resp_set_type(req, "text/plain");
     httpd_resp_sendstr(req, current_status);
     return ESP_OK;
 }
 
+static void events_send(int fd, const char *msg) {
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)msg,
+        .len = strlen(msg),
+    };
+    httpd_ws_send_frame_async(server, fd, &frame);
+}
+
+// httpd task: "s:<status as /status>" and "l:<station list ver>;<eq list ver>", to all clients only if changed
+static void events_push(void *arg) {
+    int only = (int)(intptr_t)arg; // Socket of new client (gets both), -1 - all clients
+    if (only < 0) {
+        events_queued = false;
+    }
+    char msg[2][JKK_WWW_EVENT_LEN];
+    msg[0][0] = 's';
+    msg[0][1] = ':';
+    status_text(msg[0] + 2, sizeof(msg[0]) - 2);
+    snprintf(msg[1], sizeof(msg[1]), "l:%u;%u", station_list_ver, eq_list_ver);
+
+    int fds[16]; // config.max_open_sockets
+    size_t count = sizeof(fds) / sizeof(fds[0]);
+    if (httpd_get_client_list(server, &count, fds) != ESP_OK) {
+        return;
+    }
+    uint8_t clients = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (httpd_ws_get_fd_info(server, fds[i]) != HTTPD_WS_CLIENT_WEBSOCKET) {
+            continue;
+        }
+        clients++;
+        if (only >= 0 && fds[i] != only) {
+            continue;
+        }
+        for (int m = 0; m < 2; m++) {
+            if (only >= 0 || strcmp(msg[m], events_last[m]) != 0) {
+                events_send(fds[i], msg[m]);
+            }
+        }
+    }
+    events_clients = clients;
+    if (only < 0) {
+        memcpy(events_last, msg, sizeof(events_last));
+    }
+}
+
+// Any task: one push queued at a time, setters called in a burst give one message
+static void events_notify(void) {
+    if (!webServerRunning || events_queued) {
+        return;
+    }
+    events_queued = true;
+    if (httpd_queue_work(server, events_push, (void *)(intptr_t)-1) != ESP_OK) {
+        events_queued = false;
+    }
+}
+
+static void events_timer_cb(void *arg) {
+    if (events_clients > 0) {
+        events_notify();
+    }
+}
+
+static esp_err_t events_ws_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) { // Handshake done, send current state to new client
+        events_clients++;
+        httpd_queue_work(server, events_push, (void *)(intptr_t)httpd_req_to_sockfd(req));
+        return ESP_OK;
+    }
+    // Page sends nothing (pings and close are handled by httpd), read and drop data frames
+    uint8_t buf[32];
+    httpd_ws_frame_t frame = { .payload = buf };
+    return httpd_ws_recv_frame(req, &frame, sizeof(buf));
+}
+
 esp_err_t lcd_toggle_post_handler(httpd_req_t *req) {
     char buf[4] = {0};
     if (httpd_req_recv(req, buf, sizeof(buf)-1) <= 0) return ESP_FAIL;
@@ -137,6 +286,7 @@ esp_err_t lcd_toggle_post_handler(httpd_req_t *req) {
     else {
         new_state = JkkLcdPortOnOffLcd(false);
         JkkMqttPublishState();
+        events_notify();
     }
 #endif
     char resp[8];
@@ -145,16 +295,65 @@ esp_err_t lcd_toggle_post_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-esp_err_t station_list_get_handler(httpd_req_t *req) {
+#define JKK_WWW_LIST_CHUNK (1024) // Lines are formatted straight into it, sent when next line does not fit
+
+// ETag "<boot>-<kind><version>", boot part: versions start from 1 again after reset. true - client has it, 304 sent
+static bool list_not_modified(httpd_req_t *req, char kind, uint16_t ver, char *etag, size_t len) {
+    static uint32_t bootId = 0;
+    if (bootId == 0) {
+        bootId = esp_random() | 1;
+    }
+    snprintf(etag, len, "\"%08lx-%c%u\"", (unsigned long)bootId, kind, ver);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache"); // Browser asks every time, mostly for 304
+    char hdr[64];
+    esp_err_t ret = httpd_req_get_hdr_value_str(req, "If-None-Match", hdr, sizeof(hdr));
+    if ((ret == ESP_OK || ret == ESP_ERR_HTTPD_RESULT_TRUNC) && strstr(hdr, etag) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        return true;
+    }
+    return false;
+}
+
+static int eq_line(int idx, char *buf, size_t len) {
+    const char *name = JkkRadioGetEqName(idx);
+    if (name == NULL) return -1;
+    return snprintf(buf, len, "%d;%s", idx, name);
+}
+
+// Chunked body of count lines separated by new line, rendered from station / equalizer data on the fly
+static esp_err_t list_send(httpd_req_t *req, int (*line)(int idx, char *buf, size_t len), int count) {
+    char buf[JKK_WWW_LIST_CHUNK];
+    size_t used = 0;
     httpd_resp_set_type(req, "text/plain");
-    httpd_resp_sendstr(req, station_list);
-    return ESP_OK;
+    for (int i = 0; i < count; i++) {
+        size_t sep = i ? 1 : 0;
+        int n = line(i, buf + used + sep, sizeof(buf) - used - sep);
+        if (n < 0) continue; // List got shorter meanwhile
+        if (used + sep + n >= sizeof(buf) && used > 0) {
+            if (httpd_resp_send_chunk(req, buf, used) != ESP_OK) return ESP_FAIL;
+            used = 0;
+            n = line(i, buf + sep, sizeof(buf) - sep);
+            if (n < 0) continue;
+        }
+        if (sep) buf[used] = '\n';
+        used += sep + MIN((size_t)n, sizeof(buf) - used - sep - 1);
+    }
+    if (used > 0 && httpd_resp_send_chunk(req, buf, used) != ESP_OK) return ESP_FAIL;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t station_list_get_handler(httpd_req_t *req) {
+    char etag[24];
+    if (list_not_modified(req, 's', station_list_ver, etag, sizeof(etag))) return ESP_OK;
+    return list_send(req, JkkRadioStationLineForWWW, JkkRadioGetStationCount());
 }
 
 esp_err_t eq_list_get_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "text/plain");
-    httpd_resp_sendstr(req, eq_list);
-    return ESP_OK;
+    char etag[24];
+    if (list_not_modified(req, 'e', eq_list_ver, etag, sizeof(etag))) return ESP_OK;
+    return list_send(req, eq_line, JkkRadioGetEqCount());
 }
 
 esp_err_t volume_post_handler(httpd_req_t *req) {
@@ -169,14 +368,96 @@ esp_err_t volume_post_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+/*  httpd has one task: handlers waiting for SD or NVS (edit, delete, reorder, catalog add, backup) held all
+    other clients. They are done by a worker task now, in order of requests (one worker: radio functions
+    are not reentrant). Changes are answered 202 at once (result comes over /events), backup is an async
+    request streamed by the worker. Station change goes to main task queue, as from API and MQTT. */
+#define JKK_WWW_JOBS (8)
+
+typedef enum {
+    WWW_JOB_BACKUP,
+    WWW_JOB_DELETE,
+    WWW_JOB_EDIT,
+    WWW_JOB_REORDER,
+} www_job_type_t;
+
+typedef struct {
+    www_job_type_t type;
+    int arg; // Station
+    int arg2; // New index (reorder)
+    httpd_req_t *req; // Async copy of request (backup), completed by worker
+    char *text; // Station CSV line (edit), freed by worker
+} www_job_t;
+
+static QueueHandle_t www_jobs = NULL;
+
+static void stations_backup_send(httpd_req_t *req);
+
+static void www_worker_task(void *arg) {
+    www_job_t job;
+    while (1) {
+        if (xQueueReceive(www_jobs, &job, portMAX_DELAY) != pdTRUE) continue;
+        switch (job.type) {
+            case WWW_JOB_BACKUP:
+                stations_backup_send(job.req);
+                httpd_req_async_handler_complete(job.req);
+                break;
+            case WWW_JOB_DELETE:
+                JkkRadioDeleteStation(job.arg);
+                break;
+            case WWW_JOB_EDIT:
+                JkkRadioEditStation(job.text);
+                free(job.text);
+                break;
+            case WWW_JOB_REORDER:
+                if (JkkRadioReorderStation(job.arg, job.arg2) != ESP_OK) {
+                    ESP_LOGW(TAG, "Station %d not moved to %d", job.arg, job.arg2);
+                }
+                break;
+        }
+    }
+}
+
+// httpd task only (so free space checked before can not be taken meanwhile)
+static bool www_job_room(httpd_req_t *req) {
+    if (www_jobs && uxQueueSpacesAvailable(www_jobs) > 0) {
+        return true;
+    }
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_sendstr(req, "Busy");
+    return false;
+}
+
+static esp_err_t www_job_accepted(httpd_req_t *req, const www_job_t *job) {
+    xQueueSend(www_jobs, job, 0);
+    httpd_resp_set_status(req, "202 Accepted");
+    return httpd_resp_sendstr(req, "OK");
+}
+
+// Station CSV line copied to PSRAM for worker
+static esp_err_t www_job_edit(httpd_req_t *req, const char *lineStr) {
+    if (!www_job_room(req)) return ESP_OK;
+    www_job_t job = { .type = WWW_JOB_EDIT, .text = heap_caps_malloc(strlen(lineStr) + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) };
+    if (job.text == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory");
+        return ESP_FAIL;
+    }
+    strcpy(job.text, lineStr);
+    return www_job_accepted(req, &job);
+}
+
 esp_err_t station_select_post_handler(httpd_req_t *req) {
     int total_len = req->content_len;
-    char buf[8];
-    if (httpd_req_recv(req, buf, MIN(total_len, sizeof(buf))) <= 0) return ESP_FAIL;
+    char buf[8] = {0};
+    if (httpd_req_recv(req, buf, MIN(total_len, sizeof(buf) - 1)) <= 0) return ESP_FAIL;
     uint16_t station = atoi(buf);
     if(JkkAudioIsPlaying()){
-        JkkRadioSetStation(station);
-        httpd_resp_sendstr(req, "OK");
+        if (JkkRadioSendMessageToMain(station, JKK_RADIO_CMD_SET_STATION) != ESP_OK) {
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            return httpd_resp_sendstr(req, "Busy");
+        }
+        httpd_resp_set_status(req, "202 Accepted");
+        return httpd_resp_sendstr(req, "OK");
     }
     else {
         httpd_resp_sendstr(req, "Audio not playing");
@@ -187,21 +468,18 @@ esp_err_t station_select_post_handler(httpd_req_t *req) {
 esp_err_t station_delete_post_handler(httpd_req_t *req) {
     int total_len = req->content_len;
     char buf[8] = {0};
-    if (httpd_req_recv(req, buf, MIN(total_len, sizeof(buf))) <= 0) return ESP_FAIL;
-    uint16_t station = atoi(buf);
-    JkkRadioDeleteStation(station);
-    httpd_resp_sendstr(req, "OK");
-    return ESP_OK;
+    if (httpd_req_recv(req, buf, MIN(total_len, sizeof(buf) - 1)) <= 0) return ESP_FAIL;
+    if (!www_job_room(req)) return ESP_OK;
+    www_job_t job = { .type = WWW_JOB_DELETE, .arg = atoi(buf) };
+    return www_job_accepted(req, &job);
 }
 
 esp_err_t station_edit_post_handler(httpd_req_t *req) {
     int total_len = req->content_len;
     char lineStr[128 + 128 + 32] = {0};
-    if (httpd_req_recv(req, lineStr, MIN(total_len, sizeof(lineStr))) <= 0) return ESP_FAIL;
+    if (httpd_req_recv(req, lineStr, MIN(total_len, sizeof(lineStr) - 1)) <= 0) return ESP_FAIL;
     ESP_LOGI(TAG, "station_edit_post_handler %s", lineStr);
-    JkkRadioEditStation(lineStr);
-    httpd_resp_sendstr(req, "OK");
-    return ESP_OK;
+    return www_job_edit(req, lineStr);
 }
 
 esp_err_t station_reorder_post_handler(httpd_req_t *req) {
@@ -217,13 +495,9 @@ esp_err_t station_reorder_post_handler(httpd_req_t *req) {
         int oldIndex = atoi(oldIndex_str);
         int newIndex = atoi(newIndex_str);
         ESP_LOGI(TAG, "station_reorder_post_handler: moving station from %d to %d", oldIndex, newIndex);
-        
-        esp_err_t result = JkkRadioReorderStation(oldIndex, newIndex);
-        if (result == ESP_OK) {
-            httpd_resp_sendstr(req, "OK");
-        } else {
-            httpd_resp_sendstr(req, "ERROR");
-        }
+        if (!www_job_room(req)) return ESP_OK;
+        www_job_t job = { .type = WWW_JOB_REORDER, .arg = oldIndex, .arg2 = newIndex };
+        return www_job_accepted(req, &job);
     } else {
         ESP_LOGE(TAG, "Invalid reorder parameters");
         httpd_resp_sendstr(req, "ERROR");
@@ -243,39 +517,42 @@ esp_err_t eq_select_post_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-esp_err_t stations_backup_get_handler(httpd_req_t *req) {
-    ESP_LOGI(TAG, "stations_backup_get_handler called");
-    
+static esp_err_t backup_chunk_write(void *ctx, const char *data, size_t len) {
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+// Worker task, req is async copy
+static void stations_backup_send(httpd_req_t *req) {
     // Set headers for file download
     httpd_resp_set_type(req, "text/plain");
     httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"radiojkk_stations_file.csv\"");
     
-    // Create temporary export
-    esp_err_t ret = JkkRadioExportStations("stat_tmp.txt");
-    if (ret != ESP_OK) {
+    // Rendered from station data straight into chunks (no SD card needed)
+    int count = 0;
+    esp_err_t ret = JkkRadioExportStationsCsv(backup_chunk_write, req, &count);
+    if (ret == ESP_ERR_INVALID_STATE) {
         httpd_resp_sendstr(req, "Error creating backup");
-        return ESP_FAIL;
-    }
-    
-    // Read and send file
-    FILE *fptr = fopen("/sdcard/stat_tmp.txt", "r");
-    if (fptr == NULL) {
-        httpd_resp_sendstr(req, "Error reading backup file");
-        return ESP_FAIL;
+        return;
     }
-    
-    char buffer[512];
-    while (fgets(buffer, sizeof(buffer), fptr)) {
-        httpd_resp_sendstr_chunk(req, buffer);
+    if (ret != ESP_OK) {
+        return; // Client gone
     }
     
-    fclose(fptr);
-    remove("/sdcard/stat_tmp.txt"); // Clean up
-    
     // End response
     httpd_resp_send_chunk(req, NULL, 0);
     
-    ESP_LOGI(TAG, "Stations backup sent successfully");
+    ESP_LOGI(TAG, "Stations backup sent successfully (%d stations)", count);
+}
+
+esp_err_t stations_backup_get_handler(httpd_req_t *req) {
+    ESP_LOGI(TAG, "stations_backup_get_handler called");
+    if (!www_job_room(req)) return ESP_OK;
+    www_job_t job = { .type = WWW_JOB_BACKUP };
+    if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory");
+        return ESP_FAIL;
+    }
+    xQueueSend(www_jobs, &job, 0); // Response is sent by worker
     return ESP_OK;
 }
 
@@ -372,6 +649,7 @@ httpd_uri_t uri_rec_toggle = { .uri = "/rec_toggle", .method = HTTP_POST, .handl
 httpd_uri_t uri_wifi_save = { .uri = "/wifi_save", .method = HTTP_POST, .handler = wifi_save_post_handler };
 
 httpd_uri_t uri_lcd_toggle = { .uri = "/lcd_toggle", .method = HTTP_POST, .handler = lcd_toggle_post_handler };
+httpd_uri_t uri_events = { .uri = "/events", .method = HTTP_GET, .handler = events_ws_handler, .is_websocket = true };
 
 /* ── MQTT broker config endpoints ──────────────────────── */
 
@@ -469,9 +747,344 @@ static esp_err_t raminfo_get_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+#define JKK_WWW_SEARCH_MAX (50)
+
+/* GET /stations/search?q=text - lines "id;nameShort;nameLong;uri" of user stations with text in name, at most JKK_WWW_SEARCH_MAX */
+static esp_err_t station_search_get_handler(httpd_req_t *req) {
+    char query[96] = {0};
+    char qEnc[64] = {0};
+    char text[64] = {0};
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "q", qEnc, sizeof(qEnc)) == ESP_OK) {
+        url_decode(text, qEnc, strlen(qEnc));
+    }
+    int ids[JKK_WWW_SEARCH_MAX];
+    int count = JkkRadioSearchStations(text, ids, JKK_WWW_SEARCH_MAX);
+    char line[128 + 256 + 44 + 1];
+    httpd_resp_set_type(req, "text/plain");
+    for (int i = 0; i < count; i++) {
+        line[0] = '\n'; // Same format as /station_list
+        if (JkkRadioStationLineForWWW(ids[i], line + 1, sizeof(line) - 1) < 0) continue;
+        httpd_resp_sendstr_chunk(req, i ? line : line + 1);
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+httpd_uri_t uri_station_search = { .uri = "/stations/search", .method = HTTP_GET, .handler = station_search_get_handler };
+
+#if defined(CONFIG_JKK_RADIO_RESTREAM)
+/* Re-stream runs on its own port (long lived sockets would block httpd), redirect there */
+static esp_err_t listen_get_handler(httpd_req_t *req) {
+    char host[64] = {0};
+    if (httpd_req_get_hdr_value_str(req, "Host", host, sizeof(host)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No Host header");
+        return ESP_FAIL;
+    }
+    char *colon = strchr(host, ':');
+    if (colon) *colon = '\0';
+    char location[112];
+    snprintf(location, sizeof(location), "http://%s:%d" JKK_RESTREAM_PATH, host, CONFIG_JKK_RADIO_RESTREAM_PORT);
+    httpd_resp_set_status(req, "302 Found");
+    httpd_resp_set_hdr(req, "Location", location);
+    httpd_resp_send(req, NULL, 0);
+    return ESP_OK;
+}
+
+httpd_uri_t uri_listen = { .uri = JKK_RESTREAM_PATH, .method = HTTP_GET, .handler = listen_get_handler };
+#endif
+
+#if defined(CONFIG_JKK_RADIO_CATALOG)
+#define JKK_WWW_CATALOG_PAGE (50)
+
+/* GET /catalog?q=prefix&from=N - first line: number of matches, then up to JKK_WWW_CATALOG_PAGE lines "id;nameShort;nameLong;uri;audioDes" */
+static esp_err_t catalog_get_handler(httpd_req_t *req) {
+    char query[96] = {0};
+    char qEnc[64] = {0};
+    char prefix[64] = {0};
+    char fromTxt[8] = {0};
+    int from = 0;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "q", qEnc, sizeof(qEnc)) == ESP_OK) {
+            url_decode(prefix, qEnc, strlen(qEnc));
+        }
+        if (httpd_query_key_value(query, "from", fromTxt, sizeof(fromTxt)) == ESP_OK) {
+            from = MAX(atoi(fromTxt), 0);
+        }
+    }
+    int first = 0;
+    int count = JkkCatalogFind(prefix, &first);
+    char line[256 + 128 + 32 + 16 + 16];
+    snprintf(line, sizeof(line), "%d", count);
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_sendstr_chunk(req, line);
+    for (int pos = first + from; pos < first + count && pos < first + from + JKK_WWW_CATALOG_PAGE; pos++) {
+        JkkCatalogEntry_t entry;
+        int id = JkkCatalogSorted(pos);
+        if (JkkCatalogGet(id, &entry) != ESP_OK) break;
+        snprintf(line, sizeof(line), "\n%d;%s;%s;%s;%s", id, entry.nameShort, entry.nameLong, entry.uri, entry.audioDes);
+        httpd_resp_sendstr_chunk(req, line);
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+/* POST /catalog_add with catalog id - copies station to the user list (as added from web) */
+static esp_err_t catalog_add_post_handler(httpd_req_t *req) {
+    char buf[8] = {0};
+    if (httpd_req_recv(req, buf, MIN(req->content_len, sizeof(buf) - 1)) <= 0) return ESP_FAIL;
+    JkkCatalogEntry_t entry;
+    if (JkkCatalogGet(atoi(buf), &entry) != ESP_OK || entry.uri[0] == '\0') {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Wrong catalog id");
+        return ESP_FAIL;
+    }
+    // Same line as station editor sends, empty fields would be skipped by its parser
+    const char *nameShort = entry.nameShort[0] ? entry.nameShort : entry.nameLong;
+    const char *nameLong = entry.nameLong[0] ? entry.nameLong : entry.nameShort;
+    char lineStr[256 + 128 + 32 + 16];
+    snprintf(lineStr, sizeof(lineStr), "-1;%s;%s;%s;%d", nameShort[0] ? nameShort : "?", nameLong[0] ? nameLong : "?", entry.uri, entry.is_favorite ? 1 : 0);
+    ESP_LOGI(TAG, "catalog_add_post_handler %s", lineStr);
+    return www_job_edit(req, lineStr);
+}
+
+httpd_uri_t uri_catalog = { .uri = "/catalog", .method = HTTP_GET, .handler = catalog_get_handler };
+httpd_uri_t uri_catalog_add = { .uri = "/catalog_add", .method = HTTP_POST, .handler = catalog_add_post_handler };
+#endif
+
+#if defined(CONFIG_JKK_RADIO_IMPORT)
+/* POST /import with file name on SD card - import runs in its own task, progress at /import_status */
+static esp_err_t import_post_handler(httpd_req_t *req) {
+    char name[48] = {0};
+    if (req->content_len == 0 || req->content_len >= sizeof(name)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Wrong file name");
+        return ESP_FAIL;
+    }
+    if (httpd_req_recv(req, name, req->content_len) <= 0) return ESP_FAIL;
+    esp_err_t ret = JkkImportStart(name);
+    ESP_LOGI(TAG, "import_post_handler %s: %s", name, esp_err_to_name(ret));
+    switch (ret) {
+        case ESP_OK:
+            httpd_resp_sendstr(req, "OK");
+            return ESP_OK;
+        case ESP_ERR_INVALID_STATE:
+            httpd_resp_set_status(req, "409 Conflict");
+            httpd_resp_sendstr(req, "Import is running");
+            return ESP_OK;
+        case ESP_ERR_NOT_FOUND:
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No such file on SD card");
+            return ESP_FAIL;
+        case ESP_ERR_INVALID_ARG:
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Wrong file name");
+            return ESP_FAIL;
+        default:
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Import not started");
+            return ESP_FAIL;
+    }
+}
+
+static esp_err_t import_status_get_handler(httpd_req_t *req) {
+    char json[160];
+    JkkImportProgressJson(json, sizeof(json));
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json);
+    return ESP_OK;
+}
+
+httpd_uri_t uri_import = { .uri = "/import", .method = HTTP_POST, .handler = import_post_handler };
+httpd_uri_t uri_import_status = { .uri = "/import_status", .method = HTTP_GET, .handler = import_status_get_handler };
+#endif
+
+#if defined(CONFIG_JKK_RADIO_PROBE)
+/* GET /station_health - lines "id;state;dnsMs;connectMs;firstByteMs;kbps;probes;fails" of probed stations, state: ok, fail, dead */
+static esp_err_t station_health_get_handler(httpd_req_t *req) {
+    char line[96];
+    bool first = true;
+    httpd_resp_set_type(req, "text/plain");
+    int count = JkkRadioGetStationCount();
+    for (int i = 0; i < count; i++) {
+        line[0] = '\n';
+        if (JkkProbeLineForWWW(i, JkkRadioGetStationUriHash(i), line + 1, sizeof(line) - 1) <= 0) continue;
+        httpd_resp_sendstr_chunk(req, first ? line + 1 : line);
+        first = false;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+httpd_uri_t uri_station_health = { .uri = "/station_health", .method = HTTP_GET, .handler = station_health_get_handler };
+#endif
+
+/* GET /nvs_stats - NVS writes since boot (totals and per key), NVS entries and flash lifetime estimate as JSON */
+static esp_err_t nvs_stats_get_handler(httpd_req_t *req) {
+    size_t len = 256 + JKK_NVS_STAT_KEYS * 72;
+    char *json = malloc(len);
+    if (json == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory");
+        return ESP_FAIL;
+    }
+    JkkNvsStatsJson(json, len, true);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json);
+    free(json);
+    return ESP_OK;
+}
+
 httpd_uri_t uri_mqtt_save = { .uri = "/mqtt_save", .method = HTTP_POST, .handler = mqtt_save_post_handler };
 httpd_uri_t uri_mqtt_get  = { .uri = "/mqtt_status", .method = HTTP_GET, .handler = mqtt_get_handler };
 httpd_uri_t uri_raminfo   = { .uri = "/raminfo",     .method = HTTP_GET, .handler = raminfo_get_handler };
+httpd_uri_t uri_nvs_stats = { .uri = "/nvs_stats",   .method = HTTP_GET, .handler = nvs_stats_get_handler };
+
+/* ── JSON API v2 ───────────────────────────────────────── */
+
+// Buffers and tokens are on httpd task stack (4096)
+#define JKK_API_BODY_MAX (512)
+#define JKK_API_TOKENS (64) // JKK_API_COMMANDS one member objects in array take 49
+#define JKK_API_COMMANDS (16)
+
+/* GET /api/v2/state - whole status in one object, list versions change with /station_list and /eq_list ETags */
+static esp_err_t api_state_get_handler(httpd_req_t *req) {
+    char json[512];
+    JkkJsonW_t w;
+    JkkJsonWInit(&w, json, sizeof(json));
+    JkkJsonWObj(&w, NULL);
+    JkkJsonWInt(&w, "vol", volume);
+    JkkJsonWInt(&w, "station", station_id);
+    char station_name[JKK_RADIO_STATION_NAME_LEN];
+    JkkJsonWStr(&w, "station_name", JkkRadioGetStationName(station_id, station_name, sizeof(station_name)));
+    JkkJsonWInt(&w, "eq", eq_id);
+    JkkJsonWStr(&w, "eq_name", JkkRadioGetEqName(eq_id));
+    JkkJsonWBool(&w, "play", JkkRadioIsPlaying());
+    JkkJsonWInt(&w, "rec", is_rec);
+#ifdef CONFIG_JKK_RADIO_USING_I2C_LCD
+    JkkJsonWInt(&w, "lcd", JkkLcdPortGetLcdState() ? 1 : 0);
+#else
+    JkkJsonWInt(&w, "lcd", -1);
+#endif
+    JkkJsonWStr(&w, "audio", audio_des);
+    JkkJsonWInt(&w, "stations", JkkRadioGetStationCount());
+    JkkJsonWInt(&w, "station_list", station_list_ver);
+    JkkJsonWInt(&w, "eq_list", eq_list_ver);
+    JkkJsonWObjEnd(&w);
+    if (JkkJsonWDone(&w) < 0) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "State too long");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, json, w.pos);
+}
+
+// One command, same meaning as MQTT command topic. Returns result text for response
+static const char *api_command(const char *js, const JkkJsonTok_t *key, const JkkJsonTok_t *val) {
+    int v = 0;
+    if (JkkJsonStrEq(js, key, "vol")) {
+        if (!JkkJsonInt(js, val, &v) || v < 0 || v > 100) return "bad value";
+        JkkRadioSetVolume((uint8_t)v);
+    } else if (JkkJsonStrEq(js, key, "station")) {
+        if (!JkkJsonInt(js, val, &v) || v < 0 || v >= JkkRadioGetStationCount()) return "bad value";
+        JkkRadioSendMessageToMain(v, JKK_RADIO_CMD_SET_STATION);
+    } else if (JkkJsonStrEq(js, key, "eq")) {
+        if (!JkkJsonInt(js, val, &v) || v < 0 || v >= JkkRadioGetEqCount()) return "bad value";
+        JkkRadioSendMessageToMain(v, JKK_RADIO_CMD_SET_EQUALIZER);
+    } else if (JkkJsonStrEq(js, key, "play")) { // true/false or "play", "pause", "stop", "toggle"
+        int cmd = JkkJsonStrEq(js, val, "true") || JkkJsonStrEq(js, val, "play") ? JKK_RADIO_CMD_PLAY
+                : JkkJsonStrEq(js, val, "false") || JkkJsonStrEq(js, val, "pause") ? JKK_RADIO_CMD_PAUSE
+                : JkkJsonStrEq(js, val, "stop") ? JKK_RADIO_CMD_STOP
+                : JkkJsonStrEq(js, val, "toggle") ? JKK_RADIO_CMD_TOGGLE_PLAY_PAUSE : -1;
+        if (cmd < 0) return "bad value";
+        JkkRadioSendMessageToMain(0, cmd);
+    } else if (JkkJsonStrEq(js, key, "rec")) {
+        if (!JkkJsonInt(js, val, &v)) return "bad value";
+        if ((v != 0) != JkkRadioIsRecording()) {
+            JkkRadioToggleRecording();
+        }
+    } else if (JkkJsonStrEq(js, key, "lcd")) {
+        if (!JkkJsonInt(js, val, &v)) return "bad value";
+#ifdef CONFIG_JKK_RADIO_USING_I2C_LCD
+        bool is_on = JkkLcdPortGetLcdState();
+        if (v && !is_on) {
+            JkkRadioLcdOn();
+        } else if (!v && is_on) {
+            JkkLcdPortOnOffLcd(false);
+            JkkMqttPublishState();
+            events_notify();
+        }
+#else
+        return "no lcd";
+#endif
+    } else {
+        return "unknown command";
+    }
+    return "ok";
+}
+
+/* POST /api/v2/command - {"vol":30,"eq":2} or [{"station":5},{"play":"toggle"}], done in order.
+   Response {"results":["ok","bad value",...]}, one per command. Radio state changes come over /events or /api/v2/state */
+static esp_err_t api_command_post_handler(httpd_req_t *req) {
+    char body[JKK_API_BODY_MAX];
+    int total = req->content_len;
+    if (total <= 0 || total > (int)sizeof(body)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body empty or too long");
+        return ESP_FAIL;
+    }
+    for (int got = 0; got < total; ) {
+        int r = httpd_req_recv(req, body + got, total - got);
+        if (r == HTTPD_SOCK_ERR_TIMEOUT) continue;
+        if (r <= 0) return ESP_FAIL;
+        got += r;
+    }
+    JkkJsonTok_t tok[JKK_API_TOKENS];
+    int n = JkkJsonParse(body, total, tok, JKK_API_TOKENS);
+    if (n <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON or too many values");
+        return ESP_FAIL;
+    }
+    // Objects holding commands: the top one, or elements of top array
+    int objs[JKK_API_COMMANDS];
+    int objCount = 0;
+    int commands = 0;
+    if (tok[0].type == JKK_JSON_OBJ) {
+        objs[objCount++] = 0;
+        commands = tok[0].size;
+    } else if (tok[0].type == JKK_JSON_ARR) {
+        for (int i = 1; i < n && objCount < JKK_API_COMMANDS; i = JkkJsonSkip(tok, n, i)) {
+            if (tok[i].type != JKK_JSON_OBJ) {
+                objCount = 0;
+                break;
+            }
+            objs[objCount++] = i;
+            commands += tok[i].size;
+        }
+        if (objCount && tok[0].size > objCount) commands = JKK_API_COMMANDS + 1;
+    }
+    if (objCount == 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected JSON object or array of objects");
+        return ESP_FAIL;
+    }
+    if (commands > JKK_API_COMMANDS) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Too many commands");
+        return ESP_FAIL;
+    }
+
+    char json[24 * JKK_API_COMMANDS];
+    JkkJsonW_t w;
+    JkkJsonWInit(&w, json, sizeof(json));
+    JkkJsonWObj(&w, NULL);
+    JkkJsonWArr(&w, "results");
+    for (int o = 0; o < objCount; o++) {
+        int k = objs[o] + 1;
+        for (int m = 0; m < tok[objs[o]].size; m++) {
+            JkkJsonWStr(&w, NULL, api_command(body, &tok[k], &tok[k + 1]));
+            k = JkkJsonSkip(tok, n, k + 1);
+        }
+    }
+    JkkJsonWArrEnd(&w);
+    JkkJsonWObjEnd(&w);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, json); // Fits, results are short texts
+}
+
+httpd_uri_t uri_api_state   = { .uri = "/api/v2/state",   .method = HTTP_GET,  .handler = api_state_get_handler };
+httpd_uri_t uri_api_command = { .uri = "/api/v2/command", .method = HTTP_POST, .handler = api_command_post_handler };
 
 #define MDNS_INSTANCE "radio jkk web server"
 #define MDNS_HOST_NAME "RadioJKK"
@@ -502,10 +1115,15 @@ void start_web_server(void) {
     config.server_port = 80;
     config.core_id = 1; 
     config.max_open_sockets = 16;
-    config.max_uri_handlers = 20;
+    config.max_uri_handlers = 32;
     config.task_priority = tskIDLE_PRIORITY + 1;
     config.task_caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT; // MALLOC_CAP_SPIRAM // MALLOC_CAP_INTERNAL
 
+    if (www_jobs == NULL) {
+        www_jobs = xQueueCreate(JKK_WWW_JOBS, sizeof(www_job_t));
+        xTaskCreatePinnedToCore(www_worker_task, "www_work", 4 * 1024, NULL, tskIDLE_PRIORITY + 1, NULL, 0);
+    }
+
     if (httpd_start(&server, &config) == ESP_OK) {
         httpd_register_uri_handler(server, &uri_root);
         httpd_register_uri_handler(server, &uri_station_name);
@@ -523,20 +1141,50 @@ void start_web_server(void) {
         httpd_register_uri_handler(server, &uri_rec_toggle);
         httpd_register_uri_handler(server, &uri_wifi_save);
         httpd_register_uri_handler(server, &uri_lcd_toggle);
+        httpd_register_uri_handler(server, &uri_events);
         httpd_register_uri_handler(server, &uri_mqtt_save);
         httpd_register_uri_handler(server, &uri_mqtt_get);
         httpd_register_uri_handler(server, &uri_raminfo);
+        httpd_register_uri_handler(server, &uri_nvs_stats);
+        httpd_register_uri_handler(server, &uri_api_state);
+        httpd_register_uri_handler(server, &uri_api_command);
+        httpd_register_uri_handler(server, &uri_station_search);
+#if defined(CONFIG_JKK_RADIO_RESTREAM)
+        httpd_register_uri_handler(server, &uri_listen);
+#endif
+#if defined(CONFIG_JKK_RADIO_CATALOG)
+        httpd_register_uri_handler(server, &uri_catalog);
+        httpd_register_uri_handler(server, &uri_catalog_add);
+#endif
+#if defined(CONFIG_JKK_RADIO_IMPORT)
+        httpd_register_uri_handler(server, &uri_import);
+        httpd_register_uri_handler(server, &uri_import_status);
+#endif
+#if defined(CONFIG_JKK_RADIO_PROBE)
+        httpd_register_uri_handler(server, &uri_station_health);
+#endif
         ESP_LOGI(TAG, "Serwer WWW uruchomiony");
 
         initialise_mdns();
         webServerRunning = true;
+
+        if (events_timer == NULL) {
+            const esp_timer_create_args_t args = { .callback = events_timer_cb, .name = "www_events" };
+            esp_timer_create(&args, &events_timer);
+        }
+        esp_timer_start_periodic(events_timer, JKK_WWW_EVENT_CHECK_US);
     }
 }
 
 void stop_web_server(void) {
     if (server) {
+        esp_timer_stop(events_timer);
         httpd_stop(server);
         server = NULL;
+        events_queued = false;
+        events_clients = 0;
+        events_last[0][0] = '\0';
+        events_last[1][0] = '\0';
         ESP_LOGI(TAG, "Serwer WWW zatrzymany");
         webServerRunning = false;
     }
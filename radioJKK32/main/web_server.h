@@ -25,19 +25,17 @@ void stop_web_server(void);
  * @brief Update current station ID for web interface
  * @param id Current station ID (-1 for error state)
  */
-void JkkRadioWwwSetStationId(int8_t id);
+void JkkRadioWwwSetStationId(int16_t id);
 
 /**
- * @brief Update station list for web interface
- * @param stationList Formatted station list string
+ * @brief Mark station list as changed (new list version), it is rendered from station data on next request
  */
-void JkkRadioWwwUpdateStationList(const char *stationList);
+void JkkRadioWwwStationListChanged(void);
 
 /**
- * @brief Update equalizer list for web interface
- * @param list Formatted equalizer list string
+ * @brief Mark equalizer list as changed (new list version), it is rendered from presets on next request
  */
-void JkkRadioWwwUpdateEqList(const char *list);
+void JkkRadioWwwEqListChanged(void);
 
 /**
  * @brief Update volume level for web interface
@@ -57,6 +55,18 @@ void JkkRadioWwwSetEqId(uint8_t id);
  */
 void JkkRadioWwwUpdateRecording(int8_t rec);
 
+/**
+ * @brief Update audio description (codec, bitrate) of current station for web interface
+ * @param des Description, e.g. "AAC 128k 44k"
+ */
+void JkkRadioWwwUpdateAudioDes(const char *des);
+
+/**
+ * @brief Push current state to web pages connected to /events (play state, LCD)
+ * Setters above push by themselves, call it for changes without a setter.
+ */
+void JkkRadioWwwStateChanged(void);
+
 /**
  * @brief Retrieve and consume pending Wi-Fi credentials submitted via web form
  * Copies stored SSID/password into provided buffers if available.
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+# RadioJKK32 - Multifunction Internet Radio Player
+# Copyright (C) 2025 Jaromir Kopp (JKK)
+# Station catalog image builder and host lookup benchmark (format: main/jkk_catalog.h)
+#
+# python tools/jkk_catalog.py build catalog.csv catalog.bin   # catalog.bin in project directory is flashed by idf.py flash
+# python tools/jkk_catalog.py find catalog.bin "radio"
+# python tools/jkk_catalog.py synth 5000 big.csv && python tools/jkk_catalog.py build big.csv big.bin && python tools/jkk_catalog.py bench big.bin
+
+import argparse
+import mmap
+import random
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = b"JKKC"
+VERSION = 1
+HEADER = struct.Struct("<4sHHIIIIII")  # 32 bytes
+RECORD = struct.Struct("<IIIIBBH")  # 20 bytes
+MAX_COUNT = 0xFFFF
+PART_SIZE = 0xE0000  # "catalog" in partitions_radiojkk_catalog.csv
+
+# Field sizes of firmware, texts are cut to them (without '\0')
+URI_MAX, SHORT_MAX, LONG_MAX, DES_MAX = 255, 31, 127, 15
+
+
+def cut(text, limit):
+    data = text.encode("utf-8")[:limit]
+    return data.decode("utf-8", "ignore").encode("utf-8")  # Do not leave half of character
+
+
+def fold(name):
+    return name.lower()  # bytes.lower() changes ASCII letters only, as firmware does
+
+
+def read_csv(path):
+    stations = []
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            line = line.rstrip("\r\n")
+            if not line or line.startswith("#"):
+                continue
+            fields = line.split(";") + [""] * 6
+            uri = fields[0].strip()
+            if not uri:
+                continue
+            stations.append({
+                "uri": cut(uri, URI_MAX),
+                "short": cut(fields[1], SHORT_MAX),
+                "long": cut(fields[2], LONG_MAX),
+                "fav": fields[3].strip() == "1",
+                "type": int(fields[4]) if fields[4].strip().isdigit() else 0,
+                "des": cut(fields[5], DES_MAX),
+            })
+    return stations
+
+
+def build(stations):
+    if len(stations) > MAX_COUNT:
+        raise SystemExit(f"Too many stations: {len(stations)} (max {MAX_COUNT})")
+    strings = bytearray(b"\0")  # Offset 0 is empty text
+    offsets = {b"": 0}
+
+    def put(text):
+        if text not in offsets:
+            offsets[text] = len(strings)
+            strings.extend(text + b"\0")
+        return offsets[text]
+
+    records = bytearray()
+    for st in stations:
+        records += RECORD.pack(put(st["uri"]), put(st["short"]), put(st["long"]), put(st["des"]),
+                               st["type"] & 0xFF, 1 if st["fav"] else 0, 0)
+    order = sorted(range(len(stations)), key=lambda i: fold(stations[i]["long"] or stations[i]["short"]))
+    index = b"".join(struct.pack("<H", i) for i in order)
+
+    rec_off = HEADER.size
+    index_off = rec_off + len(records)
+    str_off = index_off + len(index)
+    body = bytes(records + index + strings)
+    header = HEADER.pack(MAGIC, VERSION, RECORD.size, len(stations), rec_off, index_off, str_off,
+                         len(strings), zlib.crc32(body) & 0xFFFFFFFF)
+    return header + body
+
+
+class Catalog:
+    def __init__(self, path):
+        self.file = open(path, "rb")
+        self.data = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, version, rec_size, self.count, self.rec_off, self.index_off, self.str_off,
+         self.str_size, crc) = HEADER.unpack_from(self.data, 0)
+        if magic != MAGIC or version != VERSION or rec_size != RECORD.size:
+            raise SystemExit(f"{path}: not a catalog version {VERSION}")
+        end = self.str_off + self.str_size
+        if zlib.crc32(self.data[HEADER.size:end]) & 0xFFFFFFFF != crc:
+            raise SystemExit(f"{path}: CRC error")
+
+    def text(self, off):
+        start = self.str_off + off
+        return self.data[start:self.data.find(b"\0", start)]
+
+    def entry(self, rec):
+        uri, short, long_, des, typ, flags, _ = RECORD.unpack_from(self.data, self.rec_off + rec * RECORD.size)
+        return self.text(uri), self.text(short), self.text(long_), self.text(des), typ, flags & 1
+
+    def sorted_id(self, pos):
+        return struct.unpack_from("<H", self.data, self.index_off + pos * 2)[0]
+
+    def sort_name(self, rec):
+        _, short, long_, _, _, _ = self.entry(rec)
+        return long_ or short
+
+    def find(self, prefix):
+        """Same binary search as JkkCatalogFind(), returns (first position, count)"""
+        prefix = fold(prefix)
+        n = len(prefix)
+        lo, hi = 0, self.count
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if fold(self.sort_name(self.sorted_id(mid))[:n]) < prefix:
+                lo = mid + 1
+            else:
+                hi = mid
+        start, hi = lo, self.count
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if fold(self.sort_name(self.sorted_id(mid))[:n]) <= prefix:
+                lo = mid + 1
+            else:
+                hi = mid
+        return start, lo - start
+
+
+def cmd_build(args):
+    stations = read_csv(args.csv)
+    image = build(stations)
+    if len(image) > args.size:
+        raise SystemExit(f"Catalog is {len(image)} bytes, partition has {args.size}")
+    with open(args.out, "wb") as f:
+        f.write(image)
+    print(f"{args.out}: {len(stations)} stations, {len(image)} bytes ({100 * len(image) // args.size}% of partition)")
+
+
+def cmd_find(args):
+    cat = Catalog(args.catalog)
+    first, count = cat.find(args.prefix.encode("utf-8"))
+    for pos in range(first, first + min(count, args.limit)):
+        rec = cat.sorted_id(pos)
+        uri, short, long_, des, typ, fav = cat.entry(rec)
+        print(f"{rec};{short.decode()};{long_.decode()};{uri.decode()};{des.decode()}")
+    print(f"{count} matches", file=sys.stderr)
+
+
+def cmd_bench(args):
+    cat = Catalog(args.catalog)
+    if cat.count == 0:
+        raise SystemExit("Empty catalog")
+    rnd = random.Random(1)
+    queries = []
+    for _ in range(args.queries):
+        name = cat.sort_name(rnd.randrange(cat.count))
+        queries.append(name[:rnd.randint(1, max(1, min(len(name), 8)))])
+    t0 = time.perf_counter()
+    found = 0
+    for q in queries:
+        found += cat.find(q)[1] > 0
+    dt = time.perf_counter() - t0
+    print(f"{cat.count} stations, {len(queries)} prefix lookups in {dt * 1000:.1f} ms, "
+          f"{dt * 1e6 / len(queries):.1f} us per lookup, {found} with matches")
+
+
+def cmd_synth(args):
+    rnd = random.Random(args.seed)
+    words = ["Radio", "FM", "Jazz", "Rock", "Classic", "News", "City", "Music", "Wave", "Polska",
+             "Kultura", "Dance", "Chill", "Talk", "Sport", "Metal", "Folk", "Pop", "Gold", "Beat"]
+    codecs = [("mp3", "MP3 128k"), ("aac", "AAC 64k"), ("ogg", "OGG 96k")]
+    with open(args.out, "w", encoding="utf-8") as f:
+        f.write("# Synthetic catalog for tests\n")
+        for i in range(args.count):
+            name = " ".join(rnd.sample(words, 3)) + f" {i}"
+            ext, des = rnd.choice(codecs)
+            f.write(f"http://stream{i % 97}.example.com:8000/{i}.{ext};S{i};{name};0;{rnd.randint(0, 7)};{des}\n")
+    print(f"{args.out}: {args.count} stations")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RadioJKK32 station catalog tool")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("build", help="build catalog image from CSV (stations.txt format)")
+    p.add_argument("csv")
+    p.add_argument("out")
+    p.add_argument("--size", type=lambda x: int(x, 0), default=PART_SIZE, help="partition size")
+    p.set_defaults(func=cmd_build)
+
+    p = sub.add_parser("find", help="list stations with name prefix")
+    p.add_argument("catalog")
+    p.add_argument("prefix")
+    p.add_argument("--limit", type=int, default=50)
+    p.set_defaults(func=cmd_find)
+
+    p = sub.add_parser("bench", help="measure prefix lookups on host")
+    p.add_argument("catalog")
+    p.add_argument("--queries", type=int, default=100000)
+    p.set_defaults(func=cmd_bench)
+
+    p = sub.add_parser("synth", help="write synthetic CSV with many stations")
+    p.add_argument("count", type=int)
+    p.add_argument("out")
+    p.add_argument("--seed", type=int, default=1)
+    p.set_defaults(func=cmd_synth)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
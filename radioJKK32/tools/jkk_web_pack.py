@@ -0,0 +1,346 @@
+#!/usr/bin/env python3
+# RadioJKK32 - Multifunction Internet Radio Player
+# Copyright (C) 2025 Jaromir Kopp (JKK)
+# Web page packer (minify + gzip, run by the build) and page load benchmark
+#
+# python tools/jkk_web_pack.py pack index.html index.html.gz
+# python tools/jkk_web_pack.py bench http://radiojkk.local/ --count 20
+# python tools/jkk_web_pack.py events http://radiojkk.local/ --count 20 --idle 30
+# python tools/jkk_web_pack.py api http://radiojkk.local/ --clients 4 --seconds 10
+# python tools/jkk_web_pack.py concurrency http://radiojkk.local/ --slow /backup_stations --clients 3 --seconds 10
+
+import argparse
+import base64
+import gzip
+import http.client
+import os
+import re
+import json
+import socket
+import struct
+import sys
+import threading
+import time
+import urllib.parse
+
+
+def minify(html):
+    """Conservative: keeps line breaks (JS without semicolons), drops indentation,
+    empty lines, HTML comments and whole-line // comments."""
+    html = re.sub(r"<!--.*?-->", "", html, flags=re.S)
+    lines = []
+    for line in html.splitlines():
+        line = line.strip()
+        if not line or line.startswith("// "):
+            continue
+        lines.append(line)
+    return "\n".join(lines) + "\n"
+
+
+def cmd_pack(args):
+    with open(args.html, encoding="utf-8") as f:
+        html = f.read()
+    small = minify(html).encode("utf-8")
+    packed = gzip.compress(small, compresslevel=9, mtime=0)  # mtime 0: same input, same image
+    with open(args.out, "wb") as f:
+        f.write(packed)
+    raw = len(html.encode("utf-8"))
+    print("jkk_web_pack: %s %d bytes, minified %d, gzip %d (%.0f%%)" % (args.html, raw, len(small), len(packed), 100.0 * len(packed) / raw))
+
+
+def fetch(url, headers):
+    u = urllib.parse.urlsplit(url)
+    conn = http.client.HTTPConnection(u.hostname, u.port or 80, timeout=10)
+    t0 = time.perf_counter()
+    conn.request("GET", u.path or "/", headers=headers)
+    resp = conn.getresponse()
+    first = time.perf_counter()
+    body = resp.read()
+    done = time.perf_counter()
+    wire = len(body) + sum(len(k) + len(v) + 4 for k, v in resp.getheaders())
+    conn.close()
+    return resp, wire, (first - t0) * 1000, (done - t0) * 1000
+
+
+def cmd_bench(args):
+    cases = [("plain", {"Accept-Encoding": "identity"}), ("gzip", {"Accept-Encoding": "gzip"})]
+    resp, _, _, _ = fetch(args.url, {"Accept-Encoding": "gzip"})
+    etag = resp.getheader("ETag")
+    if etag:
+        cases.append(("304", {"Accept-Encoding": "gzip", "If-None-Match": etag}))
+    print("ETag %s, Cache-Control %s" % (etag, resp.getheader("Cache-Control")))
+    for name, headers in cases:
+        wire = first = full = 0
+        status = None
+        for _ in range(args.count):
+            resp, w, f, d = fetch(args.url, headers)
+            status = resp.status
+            wire += w
+            first += f
+            full += d
+        n = args.count
+        # Page has no other resources: it is painted when the document is received
+        print("%-5s status %d, %6d bytes on wire, first byte %6.1f ms, document %6.1f ms" % (name, status, wire // n, first / n, full / n))
+
+
+class EventSocket:
+    """Minimal WebSocket client for /events (text frames from radio, nothing sent)"""
+
+    def __init__(self, url):
+        u = urllib.parse.urlsplit(url)
+        self.sock = socket.create_connection((u.hostname, u.port or 80), timeout=10)
+        key = base64.b64encode(os.urandom(16)).decode()
+        self.sock.sendall(("GET /events HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                           "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n" % (u.netloc, key)).encode())
+        head = b""
+        while b"\r\n\r\n" not in head:
+            data = self.sock.recv(1)
+            if not data:
+                raise ConnectionError("connection closed in handshake")
+            head += data
+        if b" 101 " not in head.split(b"\r\n", 1)[0]:
+            raise ConnectionError("no WebSocket: " + head.split(b"\r\n", 1)[0].decode(errors="replace"))
+
+    def _read(self, n):
+        data = b""
+        while len(data) < n:
+            part = self.sock.recv(n - len(data))
+            if not part:
+                raise ConnectionError("connection closed")
+            data += part
+        return data
+
+    def recv(self, timeout):
+        """Next text message or None after timeout"""
+        self.sock.settimeout(timeout)
+        try:
+            b0, b1 = self._read(2)
+        except socket.timeout:
+            return None
+        self.sock.settimeout(10)
+        n = b1 & 0x7F
+        if n == 126:
+            n = struct.unpack(">H", self._read(2))[0]
+        elif n == 127:
+            n = struct.unpack(">Q", self._read(8))[0]
+        payload = self._read(n)
+        if (b0 & 0x0F) == 0x8:
+            raise ConnectionError("closed by radio")
+        return payload.decode("utf-8", errors="replace") if (b0 & 0x0F) == 0x1 else self.recv(timeout)
+
+    def close(self):
+        self.sock.close()
+
+
+def post(url, path, body):
+    u = urllib.parse.urlsplit(url)
+    conn = http.client.HTTPConnection(u.hostname, u.port or 80, timeout=10)
+    conn.request("POST", path, body=body)
+    resp = conn.getresponse()
+    data = resp.read()
+    conn.close()
+    return resp.status, data
+
+
+def get(url, path):
+    u = urllib.parse.urlsplit(url)
+    conn = http.client.HTTPConnection(u.hostname, u.port or 80, timeout=10)
+    conn.request("GET", path)
+    resp = conn.getresponse()
+    data = resp.read()
+    conn.close()
+    return resp.status, data
+
+
+def load(name, clients, seconds, operation):
+    """Run operation (returns number of requests made) in clients threads for seconds, print rates"""
+    counts = [[0, 0, 0] for _ in range(clients)]  # operations, requests, errors
+    end = time.perf_counter() + seconds
+
+    def worker(c):
+        while time.perf_counter() < end:
+            try:
+                counts[c][1] += operation()
+                counts[c][0] += 1
+            except (OSError, http.client.HTTPException, ValueError):
+                counts[c][2] += 1
+
+    threads = [threading.Thread(target=worker, args=(c,)) for c in range(clients)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    ops, reqs, errs = (sum(c[i] for c in counts) for i in range(3))
+    print("%-28s %7.1f operations/s, %7.1f requests/s, %d errors" % (name, ops / seconds, reqs / seconds, errs))
+
+
+def cmd_events(args):
+    # Polling page before /events: /status every 2 s, station list every 15 s, equalizer list every 30 s
+    poll_per_min = 60 / 2 + 60 / 15 + 60 / 30
+    status = []
+    for _ in range(args.count):
+        resp, _, _, done = fetch(urllib.parse.urljoin(args.url, "/status"), {})
+        status.append(done)
+    rtt = sum(status) / len(status)
+    print("polling: %d requests/min per page, change seen after %.0f ms on average (%.0f max)" % (poll_per_min, 1000 + rtt, 2000 + rtt))
+
+    ws = EventSocket(args.url)
+    first = []
+    while True:
+        msg = ws.recv(2.0)
+        if msg is None:
+            break
+        first.append(msg)
+    vol = None
+    for msg in first:
+        if msg.startswith("s:"):
+            vol = int(msg[2:].split(";")[0])
+    print("events: %d messages on connect %s" % (len(first), first))
+    if vol is None:
+        print("no status on connect")
+        return 1
+    lat = []
+    for i in range(args.count):
+        vol = vol + 1 if vol < 50 else vol - 1  # Stay in range and change every time
+        t0 = time.perf_counter()
+        post(args.url, "/volume", str(vol))
+        while True:
+            msg = ws.recv(5.0)
+            if msg is None:
+                print("volume %d: no event" % vol)
+                break
+            if msg.startswith("s:") and int(msg[2:].split(";")[0]) == vol:
+                lat.append((time.perf_counter() - t0) * 1000)
+                break
+    if lat:
+        print("push: change seen after %.1f ms on average (%.1f max), POST included" % (sum(lat) / len(lat), max(lat)))
+    idle = 0
+    end = time.perf_counter() + args.idle
+    while time.perf_counter() < end:
+        if ws.recv(end - time.perf_counter()) is not None:
+            idle += 1
+    ws.close()
+    print("push: 0 requests/min per page, %d messages in %d s idle" % (idle, args.idle))
+
+
+def cmd_api(args):
+    status, data = get(args.url, "/api/v2/state")
+    if status != 200:
+        print("/api/v2/state: HTTP %d" % status)
+        return 1
+    state = json.loads(data)
+    print("state %s" % data.decode())
+    vol, station, eq = state["vol"], max(state["station"], 0), state["eq"]  # Set to current values: radio keeps playing as it was
+
+    def old_state():
+        status_, data_ = get(args.url, "/status")
+        if status_ != 200 or data_.count(b";") < 5:
+            raise ValueError("bad /status")
+        return 1
+
+    def new_state():
+        status_, data_ = get(args.url, "/api/v2/state")
+        if status_ != 200:
+            raise ValueError("bad /api/v2/state")
+        json.loads(data_)
+        return 1
+
+    def old_change():
+        for path, body in (("/volume", vol), ("/eq_select", eq), ("/station_select", station)):
+            if post(args.url, path, str(body))[0] != 200:
+                raise ValueError("bad " + path)
+        return 3
+
+    def new_change():
+        status_, data_ = post(args.url, "/api/v2/command", json.dumps([{"vol": vol}, {"eq": eq}, {"station": station}]))
+        if status_ != 200 or json.loads(data_)["results"] != ["ok", "ok", "ok"]:
+            raise ValueError("bad /api/v2/command " + data_.decode())
+        return 1
+
+    load("read state: /status", args.clients, args.seconds, old_state)
+    load("read state: /api/v2/state", args.clients, args.seconds, new_state)
+    load("vol+eq+station: 3 POSTs", args.clients, args.seconds, old_change)
+    load("vol+eq+station: 1 batch", args.clients, args.seconds, new_change)
+
+
+def cmd_concurrency(args):
+    """/status latency seen by one page while other clients call a slow endpoint"""
+
+    def slow():
+        if args.body is None:
+            return get(args.url, args.slow)[0]
+        return post(args.url, args.slow, args.body)[0]
+
+    def probe(name, clients):
+        stop = time.perf_counter() + args.seconds
+        done = [0] * clients
+        codes = set()
+
+        def worker(c):
+            while time.perf_counter() < stop:
+                try:
+                    codes.add(slow())
+                    done[c] += 1
+                except (OSError, http.client.HTTPException):
+                    codes.add("error")
+
+        threads = [threading.Thread(target=worker, args=(c,)) for c in range(clients)]
+        for t in threads:
+            t.start()
+        lat = []
+        while time.perf_counter() < stop:
+            t0 = time.perf_counter()
+            get(args.url, "/status")
+            lat.append((time.perf_counter() - t0) * 1000)
+            time.sleep(0.05)
+        for t in threads:
+            t.join()
+        lat.sort()
+        print("%-32s /status p50 %6.1f ms, p95 %6.1f ms, max %6.1f ms (%d requests); %s %.1f/s, HTTP %s" % (
+            name, lat[len(lat) // 2], lat[int(len(lat) * 0.95)], lat[-1], len(lat), args.slow, sum(done) / args.seconds,
+            ",".join(str(c) for c in sorted(codes, key=str)) or "-"))
+
+    probe("idle", 0)
+    probe("%d clients on %s" % (args.clients, args.slow), args.clients)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RadioJKK32 web page tool")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("pack", help="minify and gzip page for embedding")
+    p.add_argument("html")
+    p.add_argument("out")
+    p.set_defaults(func=cmd_pack)
+
+    p = sub.add_parser("bench", help="measure page load from radio (plain, gzip, 304)")
+    p.add_argument("url")
+    p.add_argument("--count", type=int, default=10)
+    p.set_defaults(func=cmd_bench)
+
+    p = sub.add_parser("events", help="measure /events push latency and idle traffic against /status polling")
+    p.add_argument("url")
+    p.add_argument("--count", type=int, default=10)
+    p.add_argument("--idle", type=int, default=30, help="seconds to count messages without changes")
+    p.set_defaults(func=cmd_events)
+
+    p = sub.add_parser("api", help="load test: text endpoints against JSON API v2 (state read, batched commands)")
+    p.add_argument("url")
+    p.add_argument("--clients", type=int, default=4)
+    p.add_argument("--seconds", type=int, default=10)
+    p.set_defaults(func=cmd_api)
+
+    p = sub.add_parser("concurrency", help="/status latency while a client pool calls a slow endpoint")
+    p.add_argument("url")
+    p.add_argument("--slow", default="/backup_stations", help="slow endpoint path")
+    p.add_argument("--body", help="POST this body to slow endpoint (GET without it)")
+    p.add_argument("--clients", type=int, default=3)
+    p.add_argument("--seconds", type=int, default=10)
+    p.set_defaults(func=cmd_concurrency)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,46 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: ADF types needed by radio headers (handles are opaque, nothing is called)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef enum {
+    ESP_CODEC_TYPE_UNKNOW = 0,
+    ESP_CODEC_TYPE_RAW,
+    ESP_CODEC_TYPE_WAV,
+    ESP_CODEC_TYPE_MP3,
+    ESP_CODEC_TYPE_AAC,
+    ESP_CODEC_TYPE_OPUS,
+    ESP_CODEC_TYPE_M4A,
+    ESP_CODEC_TYPE_TSAAC,
+    ESP_CODEC_TYPE_OGG,
+    ESP_CODEC_TYPE_FLAC,
+    ESP_CODEC_TYPE_AMRNB,
+    ESP_CODEC_TYPE_AMRWB,
+    ESP_CODEC_TYPE_PCM,
+} esp_codec_type_t;
+
+typedef struct audio_element *audio_element_handle_t;
+typedef struct audio_pipeline *audio_pipeline_handle_t;
+typedef struct audio_event_iface *audio_event_iface_handle_t;
+typedef struct esp_periph_sets *esp_periph_set_handle_t;
+typedef struct esp_periph *esp_periph_handle_t;
+typedef struct audio_board_handle *audio_board_handle_t;
+typedef struct display_service_impl *display_service_handle_t;
+typedef struct periph_service_impl *periph_service_handle_t;
+
+typedef struct {
+    int cmd;
+    void *data;
+    int data_len;
+    void *source;
+    int source_type;
+    bool need_free_data;
+} audio_event_iface_msg_t;
@@ -0,0 +1,11 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: audio_element.h (types are in audio_common.h), functions are given by the test
+*/
+
+#pragma once
+
+#include "audio_common.h"
+#include "ringbuf.h"
+
+esp_err_t audio_element_set_multi_output_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb, int index);
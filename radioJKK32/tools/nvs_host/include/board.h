@@ -0,0 +1,8 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: board.h (types are in audio_common.h)
+*/
+
+#pragma once
+
+#include "audio_common.h"
@@ -0,0 +1,21 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: ESP_LOGx to stderr, level from JkkHostLogLevel
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_err.h"
+
+typedef enum { ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, ESP_LOG_DEBUG, ESP_LOG_VERBOSE } esp_log_level_t;
+
+extern esp_log_level_t JkkHostLogLevel; // Default ESP_LOG_WARN
+
+#define JKK_HOST_LOG(level, letter, tag, fmt, ...) do { if (JkkHostLogLevel >= (level)) fprintf(stderr, letter " (%s) " fmt "\n", tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGE(tag, fmt, ...) JKK_HOST_LOG(ESP_LOG_ERROR, "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) JKK_HOST_LOG(ESP_LOG_WARN, "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) JKK_HOST_LOG(ESP_LOG_INFO, "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) JKK_HOST_LOG(ESP_LOG_DEBUG, "D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) JKK_HOST_LOG(ESP_LOG_VERBOSE, "V", tag, fmt, ##__VA_ARGS__)
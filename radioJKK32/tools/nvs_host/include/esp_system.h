@@ -0,0 +1,12 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: esp_system.h
+*/
+
+#pragma once
+
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+
+#define EXT_RAM_BSS_ATTR
+#define IRAM_ATTR
@@ -0,0 +1,10 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: esp_timer_get_time from CLOCK_MONOTONIC
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
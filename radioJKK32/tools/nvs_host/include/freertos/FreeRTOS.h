@@ -0,0 +1,36 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: FreeRTOS types used by radio headers
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *TimerHandle_t;
+typedef void *EventGroupHandle_t;
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS (1)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTICKS_TO_MS(t) ((uint32_t)(t))
+#define pdTRUE (1)
+#define pdFALSE (0)
+#define pdPASS (1)
+
+// Spinlock critical section as mutex
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZE(mux) pthread_mutex_init((mux), NULL)
+#define portENTER_CRITICAL(mux) pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux) pthread_mutex_unlock(mux)
+
+#define EXT_RAM_BSS_ATTR // esp_attr.h, no PSRAM
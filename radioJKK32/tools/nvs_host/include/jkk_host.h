@@ -0,0 +1,10 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: newlib functions missing in glibc (included with -include)
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+size_t strlcpy(char *dst, const char *src, size_t size);
@@ -0,0 +1,25 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: ADF byte ring buffer on pthread
+*/
+
+#pragma once
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#define RB_OK (0)
+#define RB_FAIL (-1)
+#define RB_DONE (-2)
+#define RB_ABORT (-3)
+#define RB_TIMEOUT (-4)
+
+typedef struct ringbuf *ringbuf_handle_t;
+
+ringbuf_handle_t rb_create(int block_size, int n_blocks);
+esp_err_t rb_destroy(ringbuf_handle_t rb);
+esp_err_t rb_reset(ringbuf_handle_t rb);
+int rb_read(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait); // What came within wait, RB_TIMEOUT if nothing
+int rb_write(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait);
+esp_err_t rb_done_write(ringbuf_handle_t rb);
+int rb_bytes_filled(ringbuf_handle_t rb);
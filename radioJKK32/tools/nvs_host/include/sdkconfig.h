@@ -0,0 +1,6 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: no menuconfig, modules use their defaults or -D from Makefile
+*/
+
+#pragma once
@@ -0,0 +1,257 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host test of stream stall, bitrate and audio description decisions (jkk_audio_monitor)
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "jkk_audio_monitor.h"
+
+/*  Usage: jkk_audio_monitor_test
+    Positions are fed as the watchdog timer does: one sample every timeout / 4 ticks (1 tick = 1 ms).
+    Covers no data after start (start allowance), data stopping mid-stream, decoder stopping while
+    data comes, late first data within start allowance, restart (positions back to 0) and the
+    allowance given to the reconnect after a stall.
+    Bitrate: stream with initial buffering burst and uneven chunks measured within 3% after the
+    window, reset on restart. Description: VBR jitter around a nominal rate keeps it, a change
+    is taken on the second agreeing poll, flapping between two rates does not change it.
+    Benchmark of the bitrate sample (called by the watchdog timer, 4 times per timeout).
+    Exit code is number of failed checks. */
+
+#define TIMEOUT_MS (2000)
+#define PERIOD (TIMEOUT_MS / 4)
+#define START_LIMIT (JKK_AUDIO_STALL_START_FACTOR * TIMEOUT_MS)
+
+static int failed = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failed++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static JkkAudioStallState_t st;
+static TickType_t now;
+static int64_t inPos, outPos;
+
+static void Start(void) {
+    memset(&st, 0, sizeof(st));
+    st.timeoutMs = TIMEOUT_MS;
+    now = 1000;
+    inPos = outPos = 0;
+    JkkAudioStallReset(&st, now);
+}
+
+/* Samples until stall or until ticks passed, input and output advance by given bytes per sample.
+   Returns stall and sets *at to its tick (or end tick). */
+static jkk_audio_stall_e Run(TickType_t ticks, int inStep, int outStep, TickType_t *at) {
+    for (TickType_t t = 0; t < ticks; t += PERIOD) {
+        now += PERIOD;
+        inPos += inStep;
+        outPos += outStep;
+        jkk_audio_stall_e stall = JkkAudioStallCheck(&st, inPos, outPos, now);
+        if (stall != JKK_AUDIO_STALL_NONE) {
+            if (at) *at = now;
+            return stall;
+        }
+    }
+    if (at) *at = now;
+    return JKK_AUDIO_STALL_NONE;
+}
+
+static void TestPlaying(void) {
+    Start();
+    CHECK(Run(60000, 4000, 16000, NULL) == JKK_AUDIO_STALL_NONE, "stall while playing");
+}
+
+static void TestNoData(void) {
+    Start();
+    TickType_t start = now, at;
+    jkk_audio_stall_e stall = Run(3 * START_LIMIT, 0, 0, &at);
+    CHECK(stall == JKK_AUDIO_STALL_INPUT, "no data: stall %d", stall);
+    CHECK(at - start > START_LIMIT && at - start <= START_LIMIT + PERIOD, "no data: stall after %u ms, allowance %d ms",
+          (unsigned)(at - start), START_LIMIT);
+    // Reconnect gets start allowance again
+    start = now;
+    stall = Run(3 * START_LIMIT, 0, 0, &at);
+    CHECK(stall == JKK_AUDIO_STALL_INPUT && at - start > START_LIMIT, "after stall: stall %d after %u ms",
+          stall, (unsigned)(at - start));
+}
+
+static void TestDataStops(void) {
+    Start();
+    CHECK(Run(10000, 4000, 16000, NULL) == JKK_AUDIO_STALL_NONE, "stall before data stopped");
+    TickType_t stop = now, at;
+    jkk_audio_stall_e stall = Run(3 * START_LIMIT, 0, 0, &at);
+    CHECK(stall == JKK_AUDIO_STALL_INPUT, "data stopped: stall %d", stall);
+    CHECK(at - stop > TIMEOUT_MS && at - stop <= TIMEOUT_MS + PERIOD, "data stopped: stall after %u ms, timeout %d ms",
+          (unsigned)(at - stop), TIMEOUT_MS);
+}
+
+static void TestDecoderStops(void) {
+    Start();
+    CHECK(Run(10000, 4000, 16000, NULL) == JKK_AUDIO_STALL_NONE, "stall before decoder stopped");
+    TickType_t stop = now, at;
+    jkk_audio_stall_e stall = Run(3 * START_LIMIT, 4000, 0, &at);
+    CHECK(stall == JKK_AUDIO_STALL_OUTPUT, "decoder stopped: stall %d", stall);
+    CHECK(at - stop > TIMEOUT_MS && at - stop <= TIMEOUT_MS + PERIOD, "decoder stopped: stall after %u ms", (unsigned)(at - stop));
+}
+
+// Slow connection: first bytes late but within allowance, decoder needs some samples to start
+static void TestLateStart(void) {
+    Start();
+    CHECK(Run(START_LIMIT - 2 * PERIOD, 0, 0, NULL) == JKK_AUDIO_STALL_NONE, "stall within start allowance");
+    CHECK(Run(TIMEOUT_MS - PERIOD, 4000, 0, NULL) == JKK_AUDIO_STALL_NONE, "decoder stall counted from start, not from first data");
+    CHECK(Run(60000, 4000, 16000, NULL) == JKK_AUDIO_STALL_NONE, "stall after late start");
+}
+
+static void TestRestart(void) {
+    Start();
+    CHECK(Run(10000, 4000, 16000, NULL) == JKK_AUDIO_STALL_NONE, "stall before restart");
+    // Station change: elements reset, new connection takes long
+    inPos = outPos = 0;
+    TickType_t start = now, at;
+    CHECK(JkkAudioStallCheck(&st, 0, 0, now) == JKK_AUDIO_STALL_NONE, "stall at restart");
+    jkk_audio_stall_e stall = Run(3 * START_LIMIT, 0, 0, &at);
+    CHECK(stall == JKK_AUDIO_STALL_INPUT && at - start > START_LIMIT, "restart: stall %d after %u ms, allowance %d ms",
+          stall, (unsigned)(at - start), START_LIMIT);
+    // Restart with data: only positions going back, no stall
+    Start();
+    CHECK(Run(10000, 4000, 16000, NULL) == JKK_AUDIO_STALL_NONE, "stall before second restart");
+    inPos = outPos = 0;
+    CHECK(Run(20000, 4000, 16000, NULL) == JKK_AUDIO_STALL_NONE, "stall after restart with data");
+}
+
+// Tick counter wraps on long uptime
+static void TestTickWrap(void) {
+    Start();
+    now = (TickType_t)0 - 5000;
+    JkkAudioStallReset(&st, now);
+    CHECK(Run(20000, 4000, 16000, NULL) == JKK_AUDIO_STALL_NONE, "stall across tick wrap");
+    TickType_t stop = now, at;
+    CHECK(Run(3 * START_LIMIT, 0, 0, &at) == JKK_AUDIO_STALL_INPUT && at - stop <= TIMEOUT_MS + PERIOD, "stall not detected across tick wrap");
+}
+
+/* Input position of stream at given bitrate, tick t (ms) after start: burst of prebuffer first,
+   then data in uneven chunks (TCP segments and ICY metadata) */
+#define BURST_MS (1500)
+#define BURST_FACTOR (6)
+
+static int64_t StreamPos(int kbps, TickType_t t) {
+    int64_t bytesPerMs = kbps / 8;
+    int64_t pos = (t < BURST_MS ? t : BURST_MS) * bytesPerMs * BURST_FACTOR;
+    if (t > BURST_MS) pos += (t - BURST_MS) * bytesPerMs;
+    return pos - pos % 1460;
+}
+
+static int RateRun(JkkAudioRateState_t *rate, int kbps, TickType_t start, int seconds, int *firstAt) {
+    int kb = -1;
+    if (firstAt) *firstAt = -1;
+    for (TickType_t t = 0; t <= (TickType_t)seconds * 1000; t += PERIOD) {
+        kb = JkkAudioRateSample(rate, StreamPos(kbps, t), start + t);
+        if (firstAt && *firstAt < 0 && kb >= 0) *firstAt = t;
+    }
+    return kb;
+}
+
+static void TestRate(void) {
+    JkkAudioRateState_t rate;
+    JkkAudioRateReset(&rate);
+    static const int rates[] = {32, 64, 128, 192, 320};
+    for (int i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        JkkAudioRateReset(&rate);
+        int firstAt;
+        int early = RateRun(&rate, rates[i], 1000, 4, &firstAt);
+        CHECK(firstAt >= (JKK_AUDIO_RATE_SLOTS / 2 - 1) * 1000, "%d kbps: first value after %d ms", rates[i], firstAt);
+        int kb = RateRun(&rate, rates[i], 1000, 15, NULL);
+        CHECK(abs(kb - rates[i]) * 100 <= rates[i] * 3, "%d kbps measured %d", rates[i], kb);
+        CHECK(JkkAudioNominalKbps(kb) == rates[i], "%d kbps: nominal of %d is %d", rates[i], kb, JkkAudioNominalKbps(kb));
+        printf("bitrate %3d kbps: %d kbps after 4 s (burst in window), %d kbps after 15 s\n", rates[i], early, kb);
+    }
+    // Restart: positions back to 0, old samples dropped
+    JkkAudioRateReset(&rate);
+    RateRun(&rate, 320, 1000, 15, NULL);
+    CHECK(JkkAudioRateSample(&rate, 0, 20000) == -1, "bitrate kept after restart");
+    int kb = RateRun(&rate, 64, 21000, 15, NULL);
+    CHECK(abs(kb - 64) <= 2, "bitrate after restart %d", kb);
+    // Tick wrap
+    JkkAudioRateReset(&rate);
+    kb = RateRun(&rate, 128, (TickType_t)0 - 5000, 15, NULL);
+    CHECK(abs(kb - 128) <= 4, "bitrate across tick wrap %d", kb);
+}
+
+static void TestNominal(void) {
+    CHECK(JkkAudioNominalKbps(131) == 128, "131 -> %d", JkkAudioNominalKbps(131));
+    CHECK(JkkAudioNominalKbps(121) == 128, "121 -> %d", JkkAudioNominalKbps(121));
+    CHECK(JkkAudioNominalKbps(140) == 140, "140 -> %d", JkkAudioNominalKbps(140));
+    CHECK(JkkAudioNominalKbps(1411) == 1411, "1411 -> %d", JkkAudioNominalKbps(1411));
+}
+
+static void TestDes(void) {
+    JkkAudioDesState_t ds = {0};
+    char des[JKK_AUDIO_DES_LEN] = "mp3 128k";
+    // VBR around 128: first poll only pending, then taken, then kept
+    CHECK(!JkkAudioDesUpdate(&ds, des, "MP3", 126, 44100, 2), "description taken on first poll");
+    CHECK(JkkAudioDesUpdate(&ds, des, "MP3", 131, 44100, 2) && strcmp(des, "MP3 128k 44k") == 0, "description not taken: %s", des);
+    int changes = 0;
+    for (int i = 0; i < 100; i++) {
+        changes += JkkAudioDesUpdate(&ds, des, "MP3", 122 + (i * 7) % 13, 44100, 2);
+    }
+    CHECK(changes == 0 && strcmp(des, "MP3 128k 44k") == 0, "VBR jitter changed description %d times: %s", changes, des);
+    // Flapping between two nominal rates: never two agreeing polls
+    for (int i = 0; i < 100; i++) {
+        changes += JkkAudioDesUpdate(&ds, des, "MP3", i % 2 ? 96 : 160, 44100, 2);
+    }
+    CHECK(changes == 0, "flapping rate changed description %d times", changes);
+    // Station change to mono AAC
+    JkkAudioDesUpdate(&ds, des, "AAC", 64, 22050, 1);
+    CHECK(JkkAudioDesUpdate(&ds, des, "AAC", 65, 22050, 1) && strcmp(des, "AAC 64k 22k M") == 0, "mono description: %s", des);
+    // Longest text fits
+    JkkAudioDesUpdate(&ds, des, "OPUS", 1411, 192000, 1);
+    JkkAudioDesUpdate(&ds, des, "OPUS", 1411, 192000, 1);
+    CHECK(strlen(des) < JKK_AUDIO_DES_LEN, "description too long");
+}
+
+static double NowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Timer callback cost: one sample per watchdog period, most of them skipped (less than 1 s since the last) */
+static void BenchRate(void) {
+    JkkAudioRateState_t rate;
+    JkkAudioRateReset(&rate);
+    int n = 4000000;
+    volatile int sink = 0;
+    double t0 = NowNs();
+    for (int i = 0; i < n; i++) {
+        sink += JkkAudioRateSample(&rate, (int64_t)i * 4000, (TickType_t)i * PERIOD);
+    }
+    double ns = (NowNs() - t0) / n;
+    JkkAudioDesState_t ds = {0};
+    char des[JKK_AUDIO_DES_LEN] = "";
+    t0 = NowNs();
+    for (int i = 0; i < n / 10; i++) {
+        sink += JkkAudioDesUpdate(&ds, des, "MP3", 128 + i % 3, 44100, 2);
+    }
+    double nsDes = (NowNs() - t0) / (n / 10);
+    printf("bench: bitrate sample %.1f ns, description poll %.1f ns (host)\n", ns, nsDes);
+    CHECK(ns < 1000, "bitrate sample %.1f ns", ns);
+    (void)sink;
+}
+
+int main(int argc, char **argv) {
+    TestPlaying();
+    TestNoData();
+    TestDataStops();
+    TestDecoderStops();
+    TestLateStart();
+    TestRestart();
+    TestTickWrap();
+    TestRate();
+    TestNominal();
+    TestDes();
+    BenchRate();
+    printf("%s (%d failed)\n", failed ? "FAILED" : "OK", failed);
+    return failed;
+}
@@ -0,0 +1,270 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host build: ESP-IDF, FreeRTOS and ADF functions used by storage, import and re-stream code
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "ringbuf.h"
+
+esp_log_level_t JkkHostLogLevel = ESP_LOG_WARN;
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+        case ESP_ERR_NVS_NOT_INITIALIZED: return "ESP_ERR_NVS_NOT_INITIALIZED";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_TYPE_MISMATCH: return "ESP_ERR_NVS_TYPE_MISMATCH";
+        case ESP_ERR_NVS_READ_ONLY: return "ESP_ERR_NVS_READ_ONLY";
+        case ESP_ERR_NVS_NOT_ENOUGH_SPACE: return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+        case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+        case ESP_ERR_NVS_KEY_TOO_LONG: return "ESP_ERR_NVS_KEY_TOO_LONG";
+        case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+        case ESP_ERR_NVS_VALUE_TOO_LONG: return "ESP_ERR_NVS_VALUE_TOO_LONG";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps) { return malloc(size); }
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) { return calloc(n, size); }
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps) { return realloc(ptr, size); }
+void heap_caps_free(void *ptr) { free(ptr); }
+size_t heap_caps_get_free_size(uint32_t caps) { return 4 * 1024 * 1024; }
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/* Mutex is a binary semaphore created full, give may come from another thread (as FreeRTOS binary semaphore) */
+typedef struct JkkHostSem_s {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int count;
+} JkkHostSem_t;
+
+static SemaphoreHandle_t JkkHostSemCreate(int count) {
+    JkkHostSem_t *s = malloc(sizeof(JkkHostSem_t));
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->count = count;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return JkkHostSemCreate(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return JkkHostSemCreate(0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait) {
+    JkkHostSem_t *s = sem;
+    pthread_mutex_lock(&s->lock);
+    while (s->count == 0) pthread_cond_wait(&s->cond, &s->lock); // Storage and import code waits with portMAX_DELAY only
+    s->count--;
+    pthread_mutex_unlock(&s->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    JkkHostSem_t *s = sem;
+    pthread_mutex_lock(&s->lock);
+    BaseType_t ret = s->count ? pdFALSE : pdTRUE;
+    s->count = 1;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    return ret;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    JkkHostSem_t *s = sem;
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s);
+}
+
+typedef struct JkkHostTask_s {
+    TaskFunction_t fn;
+    void *arg;
+} JkkHostTask_t;
+
+static void *JkkHostTaskRun(void *arg) {
+    JkkHostTask_t task = *(JkkHostTask_t *)arg;
+    free(arg);
+    task.fn(task.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core) {
+    JkkHostTask_t *task = malloc(sizeof(JkkHostTask_t));
+    pthread_t thread;
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&thread, NULL, JkkHostTaskRun, task) != 0) {
+        free(task);
+        return pdFALSE;
+    }
+    pthread_detach(thread);
+    if (handle) *handle = (TaskHandle_t)thread;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = {ticks / 1000, (ticks % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+/* ADF ring buffer: one byte FIFO, read returns what came within wait (as ADF when writer is done) */
+struct ringbuf {
+    pthread_mutex_t lock;
+    pthread_cond_t cond; // Data or space changed
+    char *buf;
+    int size;
+    int rd;
+    int filled;
+    bool done;
+};
+
+static void JkkHostDeadline(struct timespec *ts, TickType_t ticks) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (ticks % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+// false on timeout
+static bool JkkHostRbWait(ringbuf_handle_t rb, TickType_t ticks, const struct timespec *deadline) {
+    if (ticks == portMAX_DELAY) return pthread_cond_wait(&rb->cond, &rb->lock) == 0;
+    return pthread_cond_timedwait(&rb->cond, &rb->lock, deadline) == 0;
+}
+
+ringbuf_handle_t rb_create(int block_size, int n_blocks) {
+    ringbuf_handle_t rb = calloc(1, sizeof(struct ringbuf));
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&rb->lock, NULL);
+    pthread_cond_init(&rb->cond, &attr);
+    rb->size = block_size * n_blocks;
+    rb->buf = malloc(rb->size);
+    return rb;
+}
+
+esp_err_t rb_destroy(ringbuf_handle_t rb) {
+    pthread_mutex_destroy(&rb->lock);
+    pthread_cond_destroy(&rb->cond);
+    free(rb->buf);
+    free(rb);
+    return ESP_OK;
+}
+
+esp_err_t rb_reset(ringbuf_handle_t rb) {
+    pthread_mutex_lock(&rb->lock);
+    rb->rd = 0;
+    rb->filled = 0;
+    rb->done = false;
+    pthread_cond_broadcast(&rb->cond);
+    pthread_mutex_unlock(&rb->lock);
+    return ESP_OK;
+}
+
+esp_err_t rb_done_write(ringbuf_handle_t rb) {
+    pthread_mutex_lock(&rb->lock);
+    rb->done = true;
+    pthread_cond_broadcast(&rb->cond);
+    pthread_mutex_unlock(&rb->lock);
+    return ESP_OK;
+}
+
+int rb_bytes_filled(ringbuf_handle_t rb) {
+    pthread_mutex_lock(&rb->lock);
+    int filled = rb->filled;
+    pthread_mutex_unlock(&rb->lock);
+    return filled;
+}
+
+int rb_read(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait) {
+    struct timespec deadline;
+    JkkHostDeadline(&deadline, ticks_to_wait);
+    pthread_mutex_lock(&rb->lock);
+    while (rb->filled < len && !rb->done && JkkHostRbWait(rb, ticks_to_wait, &deadline));
+    int n = rb->filled < len ? rb->filled : len;
+    for (int i = 0; i < n; i++) {
+        buf[i] = rb->buf[(rb->rd + i) % rb->size];
+    }
+    rb->rd = (rb->rd + n) % rb->size;
+    rb->filled -= n;
+    bool done = rb->done;
+    pthread_cond_broadcast(&rb->cond);
+    pthread_mutex_unlock(&rb->lock);
+    if (n == 0) return done ? RB_DONE : RB_TIMEOUT;
+    return n;
+}
+
+int rb_write(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait) {
+    struct timespec deadline;
+    JkkHostDeadline(&deadline, ticks_to_wait);
+    int done = 0;
+    pthread_mutex_lock(&rb->lock);
+    while (done < len) {
+        int n = rb->size - rb->filled < len - done ? rb->size - rb->filled : len - done;
+        for (int i = 0; i < n; i++) {
+            rb->buf[(rb->rd + rb->filled + i) % rb->size] = buf[done + i];
+        }
+        rb->filled += n;
+        done += n;
+        pthread_cond_broadcast(&rb->cond);
+        if (done < len && !JkkHostRbWait(rb, ticks_to_wait, &deadline)) break;
+    }
+    pthread_mutex_unlock(&rb->lock);
+    return done ? done : RB_TIMEOUT;
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
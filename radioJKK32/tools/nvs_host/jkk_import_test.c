@@ -0,0 +1,379 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host run of station import (jkk_import with jkk_station_store) on NVS emulator
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+#include "jkk_radio.h"
+#include "jkk_station_store.h"
+#include "jkk_import.h"
+#include "jkk_nvs_host.h"
+
+/*  Usage: jkk_import_test [-n lines] [-m ceiling KB] [-v]
+    Imports generated CSV and JSON files through the real import task and station store. Station list of
+    radio_jkk.c is replaced by a copy of JkkRadioImportStations working on the test's list, main task by
+    the test's main thread serving JkkRadioSendMessageToMain. Checks that the list is read and changed on
+    main task only, counts of the import and that heap used by import does not grow with file size.
+    Linked with --wrap for malloc family (heap in use and peak) and fopen/stat (/sdcard/ in temp dir).
+    Exit code is number of failed checks. */
+
+#define SEEDED (20) // Stations on the list before import, their URIs are in the files too
+#define UNIQUE (400) // Different stations in CSV, rest of lines are duplicates or invalid
+
+static int failed = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failed++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+/* ── Heap in use ─────────────────────────────────────────── */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static long heapUsed = 0;
+static long heapPeak = 0;
+
+static void HeapAdd(long n) {
+    long used = __atomic_add_fetch(&heapUsed, n, __ATOMIC_RELAXED);
+    long peak = __atomic_load_n(&heapPeak, __ATOMIC_RELAXED);
+    while (used > peak && !__atomic_compare_exchange_n(&heapPeak, &peak, used, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void *__wrap_malloc(size_t size) {
+    void *p = __real_malloc(size);
+    if (p) HeapAdd(malloc_usable_size(p));
+    return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    void *p = __real_calloc(n, size);
+    if (p) HeapAdd(malloc_usable_size(p));
+    return p;
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    long old = ptr ? (long)malloc_usable_size(ptr) : 0;
+    void *p = __real_realloc(ptr, size);
+    if (p) HeapAdd((long)malloc_usable_size(p) - old);
+    else if (size == 0) HeapAdd(-old);
+    return p;
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr) HeapAdd(-(long)malloc_usable_size(ptr));
+    __real_free(ptr);
+}
+
+/* ── SD card ─────────────────────────────────────────────── */
+
+static char sdDir[64];
+
+static const char *SdPath(const char *path, char *buf, size_t len) {
+    if (strncmp(path, "/sdcard/", 8) != 0) return path;
+    snprintf(buf, len, "%s/%s", sdDir, path + 8);
+    return buf;
+}
+
+FILE *__real_fopen(const char *path, const char *mode);
+int __real_stat(const char *path, struct stat *st);
+
+FILE *__wrap_fopen(const char *path, const char *mode) {
+    char buf[128];
+    return __real_fopen(SdPath(path, buf, sizeof(buf)), mode);
+}
+
+int __wrap_stat(const char *path, struct stat *st) {
+    char buf[128];
+    return __real_stat(SdPath(path, buf, sizeof(buf)), st);
+}
+
+/* ── Main task and station list of radio_jkk.c ───────────── */
+
+static pthread_t mainThread;
+static JkkRadioStations_t *list = NULL;
+static int listCount = 0;
+static int offMain = 0; // List used outside main task
+static int mqttReports = 0;
+static int lastBatches = 0;
+
+static pthread_mutex_t msgLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t msgCond = PTHREAD_COND_INITIALIZER;
+static int msgStep = -1;
+
+static void OnMain(void) {
+    if (!pthread_equal(pthread_self(), mainThread)) __atomic_add_fetch(&offMain, 1, __ATOMIC_RELAXED);
+}
+
+esp_err_t JkkRadioSendMessageToMain(int mess, int command) {
+    if (command != JKK_RADIO_CMD_IMPORT_STEP) return ESP_FAIL;
+    pthread_mutex_lock(&msgLock);
+    msgStep = mess;
+    pthread_cond_signal(&msgCond);
+    pthread_mutex_unlock(&msgLock);
+    return ESP_OK;
+}
+
+int JkkRadioGetStationCount(void) {
+    OnMain();
+    return listCount;
+}
+
+uint32_t JkkRadioGetStationUriHash(int idx) {
+    OnMain();
+    return (idx >= 0 && idx < listCount) ? list[idx].uriHash : 0;
+}
+
+/* As in radio_jkk.c, without LCD, web and MQTT refresh */
+esp_err_t JkkRadioImportStations(JkkRadioStations_t *stations, int count, bool last) {
+    OnMain();
+    if (count > 0) {
+        if (listCount + count > JKK_RADIO_MAX_STATIONS) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        JkkRadioStations_t *grown = heap_caps_realloc(list, (listCount + count) * sizeof(JkkRadioStations_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (grown == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        int first = listCount;
+        memcpy(&grown[first], stations, count * sizeof(JkkRadioStations_t));
+        list = grown;
+        listCount += count;
+        if (JkkStationStoreSaveChanged(list, listCount, 0) == ESP_OK) {
+            for (int i = first; i < listCount; i++) {
+                JkkStationStoreDropCold(&list[i]);
+            }
+        }
+    }
+    lastBatches += last;
+    return ESP_OK;
+}
+
+void JkkMqttPublishImport(const char *json) {
+    mqttReports++;
+}
+
+/* Serve import steps until import ends */
+static void MainLoop(void) {
+    JkkImportProgress_t p;
+    do {
+        pthread_mutex_lock(&msgLock);
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 10 * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        if (msgStep < 0) pthread_cond_timedwait(&msgCond, &msgLock, &ts);
+        int step = msgStep;
+        msgStep = -1;
+        pthread_mutex_unlock(&msgLock);
+        if (step >= 0) JkkImportStep(step);
+        JkkImportGetProgress(&p);
+    } while (p.state == JKK_IMPORT_RUNNING);
+    usleep(20000); // Import task closes file and frees its context after last report
+}
+
+/* ── Test ────────────────────────────────────────────────── */
+
+static void Uri(char *buf, size_t len, int i, bool upper) {
+    snprintf(buf, len, upper ? "HTTP://STREAM%d.EXAMPLE.COM/live/%d.mp3" : "http://stream%d.example.com/live/%d.mp3", i % 13, i);
+}
+
+static void ListReset(void) {
+    JkkStationStoreFree(list, listCount);
+    list = NULL;
+    listCount = 0;
+    nvs_handle_t h;
+    nvs_open(JKK_RADIO_NVS_NAMESPACE, NVS_READWRITE, &h);
+    nvs_erase_all(h);
+    nvs_commit(h);
+    nvs_close(h);
+    list = heap_caps_calloc(SEEDED, sizeof(JkkRadioStations_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    char uri[JKK_RADIO_STATION_URI_LEN];
+    for (int i = 0; i < SEEDED; i++) {
+        Uri(uri, sizeof(uri), i * 7, false);
+        snprintf(list[i].nameShort, sizeof(list[i].nameShort), "Seed %d", i);
+        JkkStationStoreSetCold(&list[i], uri, "Seeded station");
+    }
+    listCount = SEEDED;
+    JkkStationStoreSaveAll(list, listCount);
+}
+
+/* Lines: UNIQUE different stations first, then duplicates (upper case scheme and host), invalid URIs and too long lines */
+static void CsvMake(const char *name, int lines, int *invalid, int *duplicates) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", sdDir, name);
+    FILE *f = __real_fopen(path, "w");
+    fprintf(f, "# uri;nameShort;nameLong;favorite;type;audioDes\n");
+    char uri[JKK_RADIO_STATION_URI_LEN];
+    *invalid = 0;
+    *duplicates = 0;
+    for (int i = 0; i < lines; i++) {
+        if (i < UNIQUE) {
+            Uri(uri, sizeof(uri), i, false);
+            fprintf(f, "%s;Radio %d;\"Radio station %d; long name\";%d;%d;MP3 128k\n", uri, i, i, i % 5 == 0, i % 8);
+            if (i % 7 == 0 && i / 7 < SEEDED) (*duplicates)++;
+        } else if (i % 10 == 0) {
+            fprintf(f, "ftp://files.example.com/%d.mp3;Not a stream\n", i);
+            (*invalid)++;
+        } else if (i % 1000 == 1) {
+            fprintf(f, "http://long.example.com/%d?", i);
+            for (int k = 0; k < JKK_IMPORT_LINE_MAX / 8; k++) fputs("pad=xyz&", f);
+            fputs(";Too long\n", f);
+            (*invalid)++;
+        } else {
+            Uri(uri, sizeof(uri), i % UNIQUE, true);
+            fprintf(f, "%s,Copy %d,Copy of station %d\n", uri, i, i % UNIQUE);
+            (*duplicates)++;
+        }
+    }
+    fclose(f);
+}
+
+/* radio-browser like export, every object a new station */
+static void JsonMake(const char *name, int objects) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", sdDir, name);
+    FILE *f = __real_fopen(path, "w");
+    fputs("[\n", f);
+    for (int i = 0; i < objects; i++) {
+        fprintf(f, "%s{\"changeuuid\":\"%08x\",\"name\":\"Station \\u017b %d\",\"url\":\"http://redirect.example.com/%d\","
+                "\"url_resolved\":\"https://Json%d.Example.com/stream/%d\",\"tags\":\"news,talk\",\"codec\":\"AAC\","
+                "\"bitrate\":64,\"geo\":{\"lat\":52.1,\"long\":21.0},\"languages\":[\"polish\",\"english\"]}\n",
+                i ? "," : "", i, i, i, i % 17, i);
+    }
+    fputs("]\n", f);
+    fclose(f);
+}
+
+static bool Import(const char *name, JkkImportProgress_t *p, long *peak, double *ms) {
+    long base = __atomic_load_n(&heapUsed, __ATOMIC_RELAXED);
+    __atomic_store_n(&heapPeak, base, __ATOMIC_RELAXED);
+    int64_t t0 = esp_timer_get_time();
+    if (JkkImportStart(name) != ESP_OK) {
+        return false;
+    }
+    MainLoop();
+    *ms = (esp_timer_get_time() - t0) / 1000.0;
+    *peak = __atomic_load_n(&heapPeak, __ATOMIC_RELAXED) - base;
+    JkkImportGetProgress(p);
+    return true;
+}
+
+/* Stations saved by import are read back after reboot */
+static void CheckStored(void) {
+    JkkNvsHostReboot();
+    JkkRadioStations_t *loaded = NULL;
+    int loadedCount = 0;
+    CHECK(JkkStationStoreLoad(&loaded, &loadedCount) == ESP_OK && loadedCount == listCount, "stored %d of %d stations", loadedCount, listCount);
+    char a[JKK_RADIO_STATION_URI_LEN], b[JKK_RADIO_STATION_URI_LEN];
+    for (int i = 0; i < loadedCount && i < listCount; i++) {
+        if (strcmp(JkkStationStoreUri(list, listCount, i, a, sizeof(a)), JkkStationStoreUri(loaded, loadedCount, i, b, sizeof(b))) != 0) {
+            CHECK(false, "station %d stored as %s, expected %s", i, b, a);
+            break;
+        }
+    }
+    JkkStationStoreFree(loaded, loadedCount);
+}
+
+static long TestCsv(int lines) {
+    int invalid, duplicates;
+    char name[32];
+    snprintf(name, sizeof(name), "list%d.csv", lines);
+    CsvMake(name, lines, &invalid, &duplicates);
+    ListReset();
+    mqttReports = 0;
+    lastBatches = 0;
+    JkkImportProgress_t p;
+    long peak = 0;
+    double ms = 0;
+    CHECK(Import(name, &p, &peak, &ms), "start of %s", name);
+    printf("csv %d lines: %.1f ms (%.2f us/line), heap peak +%ld bytes, %d added, %d duplicates, %d invalid, %d MQTT reports\n",
+           lines, ms, ms * 1000 / lines, peak, p.added, p.duplicates, p.invalid, mqttReports);
+    CHECK(p.state == JKK_IMPORT_DONE && !p.full, "%s state %d full %d", name, p.state, p.full);
+    CHECK(p.records == lines, "records %d of %d", p.records, lines);
+    CHECK(p.added == UNIQUE - SEEDED && listCount == UNIQUE, "added %d, list %d", p.added, listCount);
+    CHECK(p.duplicates == duplicates && p.invalid == invalid, "duplicates %d/%d invalid %d/%d", p.duplicates, duplicates, p.invalid, invalid);
+    CHECK(p.bytesRead == p.bytesTotal, "read %lu of %lu bytes", (unsigned long)p.bytesRead, (unsigned long)p.bytesTotal);
+    CHECK(lastBatches == 1, "last batch %d times", lastBatches);
+    char nameLong[JKK_RADIO_STATION_NAME_LEN];
+    CHECK(strcmp(JkkStationStoreNameLong(list, listCount, SEEDED, nameLong, sizeof(nameLong)), "Radio station 1; long name") == 0, "quoted field: %s", nameLong);
+    CheckStored();
+    return peak;
+}
+
+static void TestJsonFull(int objects) {
+    JsonMake("list.json", objects);
+    ListReset();
+    JkkImportProgress_t p;
+    long peak = 0;
+    double ms = 0;
+    CHECK(Import("list.json", &p, &peak, &ms), "start of list.json");
+    printf("json %d objects: %.1f ms, heap peak +%ld bytes, %d records, %d added, list full %d\n",
+           objects, ms, peak, p.records, p.added, p.full);
+    CHECK(p.state == JKK_IMPORT_DONE && p.full, "json state %d full %d", p.state, p.full);
+    CHECK(p.added == JKK_RADIO_MAX_STATIONS - SEEDED && listCount == JKK_RADIO_MAX_STATIONS, "added %d, list %d", p.added, listCount);
+    char uri[JKK_RADIO_STATION_URI_LEN], nameLong[JKK_RADIO_STATION_NAME_LEN];
+    JkkStationStoreUri(list, listCount, SEEDED + 1, uri, sizeof(uri));
+    JkkStationStoreNameLong(list, listCount, SEEDED + 1, nameLong, sizeof(nameLong));
+    CHECK(strcmp(uri, "https://json1.example.com/stream/1") == 0, "url_resolved: %s", uri);
+    CHECK(strcmp(nameLong, "Station \xC5\xBB 1") == 0 && strcmp(list[SEEDED + 1].audioDes, "AAC 64k") == 0 && list[SEEDED + 1].type == JKK_RADIO_NEWS,
+          "json fields: %s, %s, type %d", nameLong, list[SEEDED + 1].audioDes, list[SEEDED + 1].type);
+    CHECK(JkkImportStart("list.json") == ESP_OK, "second import");
+    MainLoop();
+    JkkImportGetProgress(&p);
+    CHECK(p.state == JKK_IMPORT_DONE && p.added == 0 && p.full, "import into full list: added %d", p.added);
+    CheckStored();
+}
+
+int main(int argc, char **argv) {
+    int lines = 50000;
+    long ceiling = 96 * 1024; // Import context, list of JKK_RADIO_MAX_STATIONS, store buffers
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:v")) != -1) {
+        switch (opt) {
+            case 'n': lines = atoi(optarg); break;
+            case 'm': ceiling = atol(optarg) * 1024; break;
+            case 'v': JkkHostLogLevel = ESP_LOG_DEBUG; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n lines] [-m ceiling KB] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    mainThread = pthread_self();
+    strcpy(sdDir, "/tmp/jkk_importXXXXXX");
+    if (mkdtemp(sdDir) == NULL || JkkNvsHostOpen(NULL, JKK_NVS_HOST_DEFAULT_PAGES) != ESP_OK) {
+        fprintf(stderr, "Can not prepare SD directory and NVS\n");
+        return 1;
+    }
+    long small = TestCsv(UNIQUE + 600);
+    long big = TestCsv(lines);
+    /* Station list and its NVS records are the same for both files, only the file grows */
+    CHECK(big <= small + 1024, "heap grows with file: %ld bytes for %d lines, %ld for %d", big, lines, small, UNIQUE + 600);
+    CHECK(big <= ceiling, "heap peak %ld over ceiling %ld", big, ceiling);
+    TestJsonFull(lines);
+    CHECK(offMain == 0, "station list used %d times outside main task", offMain);
+
+    JkkStationStoreFree(list, listCount);
+    JkkNvsHostClose();
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", sdDir);
+    system(cmd);
+    printf("%s (%d failed)\n", failed ? "FAILED" : "OK", failed);
+    return failed;
+}
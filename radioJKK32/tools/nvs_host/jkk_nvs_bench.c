@@ -0,0 +1,402 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host run of storage code (jkk_nvs, jkk_snapshot, jkk_station_store) on NVS emulator
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "jkk_radio.h"
+#include "jkk_nvs.h"
+#include "jkk_mqtt.h"
+#include "jkk_snapshot.h"
+#include "jkk_station_store.h"
+#include "jkk_nvs_host.h"
+
+/*  Usage: jkk_nvs_bench [-i image] [-p pages] [-s saves] [-c cuts] [-v]
+    Without -i flash image is in memory. Exit code is number of failed checks. */
+
+#define SAVES_PER_HOUR (60) // Save timer fires at most once per minute of use
+#define USE_HOURS_PER_DAY (8)
+
+static int failed = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failed++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static double Ms(int64_t t0) {
+    return (esp_timer_get_time() - t0) / 1000.0;
+}
+
+static void StationsMake(JkkRadioStations_t *st, int count, int seed) {
+    char uri[JKK_RADIO_STATION_URI_LEN];
+    char name[128];
+    memset(st, 0, count * sizeof(JkkRadioStations_t));
+    for (int i = 0; i < count; i++) {
+        snprintf(st[i].nameShort, sizeof(st[i].nameShort), "Radio %d/%d", i, seed);
+        strcpy(st[i].audioDes, "mp3 128k");
+        st[i].is_favorite = (i % 7) == 0;
+        st[i].type = i % 8;
+        st[i].addFrom = JKK_RADIO_ADD_FROM_WEB;
+        snprintf(uri, sizeof(uri), "http://stream%d.example.com:8000/live/radio_%d_%d.mp3", i % 13, i, seed);
+        snprintf(name, sizeof(name), "Long name of radio station number %d (%d)", i, seed);
+        JkkStationStoreSetCold(&st[i], uri, name);
+    }
+}
+
+static bool StationsSame(JkkRadioStations_t *a, int countA, JkkRadioStations_t *b, int countB) {
+    if (countA != countB) return false;
+    for (int i = 0; i < countA; i++) {
+        if (strcmp(a[i].nameShort, b[i].nameShort) != 0 || a[i].uriHash != b[i].uriHash || a[i].nameHash != b[i].nameHash) return false;
+        char uriA[JKK_RADIO_STATION_URI_LEN], uriB[JKK_RADIO_STATION_URI_LEN];
+        if (strcmp(JkkStationStoreUri(a, countA, i, uriA, sizeof(uriA)), JkkStationStoreUri(b, countB, i, uriB, sizeof(uriB))) != 0) return false;
+    }
+    return true;
+}
+
+static void Wear(const char *what) {
+    JkkNvsHostStats_t hs;
+    JkkNvsHostStatsGet(&hs);
+    printf("  %s: %llu bytes, %lu entries, %lu sets, %lu commits, %lu reclaims, page erases %lu..%lu\n", what,
+        (unsigned long long)hs.bytesWritten, (unsigned long)hs.entriesWritten, (unsigned long)hs.sets,
+        (unsigned long)hs.commits, (unsigned long)hs.reclaims, (unsigned long)hs.eraseMin, (unsigned long)hs.eraseMax);
+}
+
+/* Emulator against IDF behaviour used by storage code */
+static void TestSemantics(void) {
+    nvs_handle_t h;
+    uint8_t buf[64];
+    size_t len;
+    CHECK(nvs_open("nothere", NVS_READONLY, &h) == ESP_ERR_NVS_NOT_FOUND, "read only open of missing namespace");
+    CHECK(nvs_open("sem", NVS_READWRITE, &h) == ESP_OK, "open");
+    CHECK(nvs_set_blob(h, "b", "hello", 6) == ESP_OK, "set blob");
+    CHECK(nvs_get_blob(h, "b", NULL, &len) == ESP_OK && len == 6, "blob size");
+    len = 3;
+    CHECK(nvs_get_blob(h, "b", buf, &len) == ESP_ERR_NVS_INVALID_LENGTH, "short buffer");
+    len = sizeof(buf);
+    CHECK(nvs_get_blob(h, "b", buf, &len) == ESP_OK && strcmp((char *)buf, "hello") == 0, "get blob");
+    JkkNvsHostStatsReset();
+    nvs_set_blob(h, "b", "hello", 6);
+    JkkNvsHostStats_t hs;
+    JkkNvsHostStatsGet(&hs);
+    CHECK(hs.bytesWritten == 0, "same blob written again");
+    CHECK(nvs_set_u64(h, "n", 42) == ESP_OK && nvs_commit(h) == ESP_OK, "set u64");
+    uint64_t v = 0;
+    CHECK(nvs_get_u64(h, "n", &v) == ESP_OK && v == 42, "get u64");
+    uint16_t v16;
+    CHECK(nvs_get_u16(h, "n", &v16) == ESP_ERR_NVS_TYPE_MISMATCH, "type mismatch");
+    nvs_iterator_t it = NULL;
+    int blobs = 0;
+    for (esp_err_t ret = nvs_entry_find(NVS_DEFAULT_PART_NAME, "sem", NVS_TYPE_BLOB, &it); ret == ESP_OK; ret = nvs_entry_next(&it)) {
+        blobs++;
+    }
+    nvs_release_iterator(it);
+    CHECK(blobs == 1, "iterator found %d blobs", blobs);
+    JkkNvsHostReboot();
+    len = sizeof(buf);
+    CHECK(nvs_get_blob(h, "b", buf, &len) == ESP_OK && len == 6, "blob after reboot");
+    CHECK(nvs_erase_all(h) == ESP_OK && nvs_get_u64(h, "n", &v) == ESP_ERR_NVS_NOT_FOUND, "erase all");
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+static void BenchStations(int count) {
+    JkkRadioStations_t *st = calloc(count, sizeof(JkkRadioStations_t));
+    StationsMake(st, count, count);
+    JkkNvsHostStatsReset();
+    int64_t t0 = esp_timer_get_time();
+    CHECK(JkkStationStoreSaveAll(st, count) == ESP_OK, "save %d stations", count);
+    printf("stations %d: save all %.2f ms\n", count, Ms(t0));
+    Wear("save all");
+
+    JkkNvsHostReboot();
+    JkkRadioStations_t *loaded = NULL;
+    int loadedCount = 0;
+    t0 = esp_timer_get_time();
+    CHECK(JkkStationStoreLoad(&loaded, &loadedCount) == ESP_OK, "load %d stations", count);
+    double loadMs = Ms(t0);
+    t0 = esp_timer_get_time();
+    JkkStationStoreLoadCold(loaded, loadedCount, 0, loadedCount - 1);
+    printf("  load hot %.2f ms, all cold parts %.2f ms\n", loadMs, Ms(t0));
+    CHECK(StationsSame(st, count, loaded, loadedCount), "stations read back (%d of %d)", loadedCount, count);
+
+    JkkNvsHostStatsReset();
+    st[count / 2].is_favorite = !st[count / 2].is_favorite;
+    t0 = esp_timer_get_time();
+    CHECK(JkkStationStoreSaveOne(st, count, count / 2) == ESP_OK, "save one");
+    printf("  save one %.2f ms\n", Ms(t0));
+    Wear("save one");
+
+    JkkNvsHostStatsReset();
+    JkkRadioStations_t tmp = st[0];
+    memmove(&st[0], &st[1], (count - 1) * sizeof(JkkRadioStations_t));
+    st[count - 1] = tmp;
+    t0 = esp_timer_get_time();
+    CHECK(JkkStationStoreSaveOrder(st, count) == ESP_OK, "save order");
+    printf("  save order %.2f ms\n", Ms(t0));
+    Wear("save order");
+
+    JkkStationStoreFree(loaded, loadedCount);
+    JkkStationStoreFree(st, count);
+}
+
+/* Save timer: player state saved after each change */
+static void BenchSaveTimer(int saves) {
+    JkkNvsHostStatsReset();
+    uint32_t erases0 = 0, eraseMax0 = 0;
+    JkkNvsHostStats_t hs;
+    JkkNvsHostStatsGet(&hs);
+    erases0 = hs.eraseTotal;
+    eraseMax0 = hs.eraseMax;
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < saves; i++) {
+        JkkSnapshotSetState(0x10000ULL + i);
+    }
+    double ms = Ms(t0);
+    JkkNvsHostStatsGet(&hs);
+    printf("save timer: %d state saves %.2f ms (%.1f us each)\n", saves, ms, ms * 1000 / saves);
+    Wear("state saves");
+    uint32_t erases = hs.eraseTotal - erases0;
+    uint32_t worst = hs.eraseMax - eraseMax0;
+    if (worst) {
+        /* Pages with stations are not erased (no static wear levelling), the most worn page decides */
+        double savesToWear = (double)saves / worst * JKK_NVS_PAGE_CYCLES;
+        double years = savesToWear / (SAVES_PER_HOUR * USE_HOURS_PER_DAY * 365.0);
+        printf("  %.4f page erases per save, most worn page +%lu: wear out after %.3g saves, %.0f years at %d saves/h %d h/day\n",
+            (double)erases / saves, (unsigned long)worst, savesToWear, years, SAVES_PER_HOUR, USE_HOURS_PER_DAY);
+    }
+    JkkNvsStats_t ns;
+    JkkNvsStatsGet(&ns);
+    printf("  jkk_nvs accounting: %lu writes, %lu entries, %lu commits, %u/%u entries used\n", (unsigned long)ns.writes,
+        (unsigned long)ns.entries, (unsigned long)ns.commits, (unsigned)ns.usedEntries, (unsigned)ns.totalEntries);
+}
+
+/* MQTT settings go through snapshot (jkk_mqtt.c needs esp-mqtt and mDNS) */
+static void BenchMqtt(void) {
+    JkkNvsHostStatsReset();
+    char user[16];
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < 100; i++) {
+        snprintf(user, sizeof(user), "user%d", i);
+        CHECK(JkkSnapshotSetMqtt(true, "192.168.1.10:1883", user, "secret") == ESP_OK, "mqtt save");
+    }
+    printf("mqtt: 100 credential saves %.2f ms\n", Ms(t0));
+    Wear("mqtt saves");
+    JkkNvsHostReboot();
+    JkkSnapshotLoad();
+    JkkSnapshot_t snap;
+    JkkSnapshotGet(&snap);
+    CHECK(strcmp(snap.mqttUser, "user99") == 0 && strcmp(snap.mqttBroker, "192.168.1.10:1883") == 0, "mqtt after reboot: %s", snap.mqttUser);
+}
+
+static void TestFailedCommit(void) {
+    JkkSnapshotSetState(1000);
+    JkkNvsHostFailCommit(1);
+    CHECK(JkkSnapshotSetState(1001) != ESP_OK, "failed commit not reported");
+    JkkSnapshot_t snap;
+    JkkSnapshotGet(&snap);
+    CHECK(snap.state == 1000, "state in RAM after failed commit %llu", (unsigned long long)snap.state);
+    CHECK(JkkSnapshotSetState(1002) == ESP_OK, "save after failed commit");
+    JkkNvsHostReboot();
+    JkkSnapshotLoad();
+    JkkSnapshotGet(&snap);
+    CHECK(snap.state == 1002, "state after failed commit and reboot %llu", (unsigned long long)snap.state);
+    printf("failed commit: reported, next save ok\n");
+}
+
+/* Slot written by newer firmware: longer data with fields unknown here, CRC over all of it */
+static void TestNewerSnapshot(void) {
+    JkkSnapshot_t snap;
+    JkkSnapshotGet(&snap);
+    uint8_t buf[sizeof(JkkSnapshotHeader_t) + sizeof(JkkSnapshot_t) + 40];
+    JkkSnapshotHeader_t hdr = {.magic = JKK_SNAPSHOT_MAGIC, .version = JKK_SNAPSHOT_VERSION + 1, .slot = 0,
+        .seq = 0x7FFFFFFF, .length = sizeof(buf) - sizeof(JkkSnapshotHeader_t)};
+    snap.state = 4242;
+    memcpy(buf + sizeof(hdr), &snap, sizeof(snap));
+    memset(buf + sizeof(hdr) + sizeof(snap), 0xA5, sizeof(buf) - sizeof(hdr) - sizeof(snap));
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&hdr, sizeof(hdr));
+    hdr.crc = esp_rom_crc32_le(crc, buf + sizeof(hdr), hdr.length);
+    memcpy(buf, &hdr, sizeof(hdr));
+    nvs_handle_t h;
+    nvs_open(JKK_RADIO_NVS_NAMESPACE, NVS_READWRITE, &h);
+    nvs_set_blob(h, "snap0", buf, sizeof(buf));
+    nvs_commit(h);
+    nvs_close(h);
+    JkkNvsHostReboot();
+    CHECK(JkkSnapshotLoad() == ESP_OK, "newer snapshot not loaded");
+    JkkSnapshot_t loaded;
+    JkkSnapshotGet(&loaded);
+    CHECK(memcmp(&loaded, &snap, sizeof(snap)) == 0, "newer snapshot: state %llu", (unsigned long long)loaded.state);
+    CHECK(JkkSnapshotSetState(4243) == ESP_OK, "save after newer snapshot");
+    JkkNvsHostReboot();
+    JkkSnapshotLoad();
+    JkkSnapshotGet(&loaded);
+    CHECK(loaded.state == 4243, "state after newer snapshot and save %llu", (unsigned long long)loaded.state);
+    printf("newer snapshot: %u bytes of data read, unknown %u skipped\n", (unsigned)hdr.length,
+        (unsigned)(hdr.length - sizeof(JkkSnapshot_t)));
+}
+
+static bool OldKeysPresent(nvs_handle_t h) {
+    uint64_t val;
+    size_t len = 0;
+    return nvs_get_u64(h, "stateStEq", &val) == ESP_OK || nvs_get_u64(h, JKK_MQTT_NVS_KEY_ENABLED, &val) == ESP_OK
+        || nvs_get_blob(h, "wifi_ssid", NULL, &len) == ESP_OK || nvs_get_blob(h, "wifi_password", NULL, &len) == ESP_OK
+        || nvs_get_blob(h, JKK_MQTT_NVS_KEY_BROKER, NULL, &len) == ESP_OK || nvs_get_blob(h, JKK_MQTT_NVS_KEY_USER, NULL, &len) == ESP_OK
+        || nvs_get_blob(h, JKK_MQTT_NVS_KEY_PASS, NULL, &len) == ESP_OK;
+}
+
+/* Update from firmware without snapshot: old keys converted, erased with first snapshot, kept if its write is cut */
+static void TestOldSettings(void) {
+    nvs_handle_t h;
+    nvs_open(JKK_RADIO_NVS_NAMESPACE, NVS_READWRITE, &h);
+    nvs_erase_key(h, "snap0");
+    nvs_erase_key(h, "snap1");
+    nvs_set_u64(h, "stateStEq", 777);
+    nvs_set_u64(h, JKK_MQTT_NVS_KEY_ENABLED, 0);
+    nvs_set_blob(h, "wifi_ssid", "OldNet", 7);
+    nvs_set_blob(h, "wifi_password", "OldPass", 8);
+    nvs_set_blob(h, JKK_MQTT_NVS_KEY_BROKER, "10.0.0.1:1883", 14);
+    nvs_set_blob(h, JKK_MQTT_NVS_KEY_USER, "old", 4);
+    nvs_set_blob(h, JKK_MQTT_NVS_KEY_PASS, "oldpass", 8);
+    nvs_commit(h);
+    JkkNvsHostReboot();
+    esp_log_level_t level = JkkHostLogLevel;
+    JkkHostLogLevel = ESP_LOG_NONE;
+    JkkNvsHostPowerLossAfter(100); // Within snapshot blob
+    CHECK(JkkSnapshotLoad() == ESP_ERR_NOT_FOUND, "old settings: snapshot found");
+    JkkHostLogLevel = level;
+    JkkNvsHostReboot();
+    CHECK(OldKeysPresent(h), "old keys erased by cut snapshot write");
+    CHECK(JkkSnapshotLoad() == ESP_ERR_NOT_FOUND, "old settings after cut write: snapshot found");
+    CHECK(!OldKeysPresent(h), "old keys not erased with first snapshot");
+    JkkNvsHostReboot();
+    CHECK(JkkSnapshotLoad() == ESP_OK, "converted snapshot not loaded");
+    JkkSnapshot_t snap;
+    JkkSnapshotGet(&snap);
+    CHECK(snap.stateValid && snap.state == 777 && !snap.mqttEnabled && strcmp(snap.wifiSSID, "OldNet") == 0
+        && strcmp(snap.wifiPassword, "OldPass") == 0 && strcmp(snap.mqttBroker, "10.0.0.1:1883") == 0
+        && strcmp(snap.mqttUser, "old") == 0 && strcmp(snap.mqttPass, "oldpass") == 0, "converted settings differ");
+    nvs_close(h);
+    printf("old settings: converted, erased with first snapshot, kept after cut write\n");
+}
+
+/* Save of station whose chunk can not be read must not write its neighbours back without uri and name */
+static void TestUnreadableChunk(void) {
+    int count = 20;
+    JkkRadioStations_t *st = calloc(count, sizeof(JkkRadioStations_t));
+    StationsMake(st, count, 3);
+    CHECK(JkkStationStoreSaveAll(st, count) == ESP_OK, "save stations");
+    JkkNvsHostReboot();
+    JkkRadioStations_t *loaded = NULL;
+    int loadedCount = 0;
+    CHECK(JkkStationStoreLoad(&loaded, &loadedCount) == ESP_OK && loadedCount == count, "load stations");
+
+    nvs_handle_t h;
+    uint8_t bad[4] = {JKK_STORE_VERSION + 1, 0, 0, 0}; // Chunk of unknown (newer) version
+    nvs_open(JKK_RADIO_NVS_NAMESPACE, NVS_READWRITE, &h);
+    nvs_set_blob(h, "stpk000", bad, sizeof(bad));
+    nvs_commit(h);
+    loaded[1].is_favorite = !loaded[1].is_favorite;
+    esp_log_level_t level = JkkHostLogLevel;
+    JkkHostLogLevel = ESP_LOG_NONE;
+    CHECK(JkkStationStoreSaveOne(loaded, loadedCount, 1) == ESP_ERR_NOT_FOUND, "save with unreadable chunk not reported");
+    JkkHostLogLevel = level;
+    uint8_t buf[8];
+    size_t len = sizeof(buf);
+    CHECK(nvs_get_blob(h, "stpk000", buf, &len) == ESP_OK && len == sizeof(bad) && buf[0] == bad[0], "unreadable chunk overwritten");
+    nvs_erase_key(h, "stpk000");
+    nvs_commit(h);
+    nvs_close(h);
+    CHECK(JkkStationStoreSaveAll(st, count) == ESP_OK, "save after test");
+    printf("unreadable chunk: save refused, chunk kept\n");
+    JkkStationStoreFree(loaded, loadedCount);
+    JkkStationStoreFree(st, count);
+}
+
+/* Power cut at random byte of state save, stations must survive page reclaim */
+static void TestPowerLoss(int cuts) {
+    int count = 100;
+    JkkRadioStations_t *st = calloc(count, sizeof(JkkRadioStations_t));
+    StationsMake(st, count, 7);
+    JkkStationStoreSaveAll(st, count);
+    JkkSnapshotSetState(1);
+    JkkSnapshotSetState(2); // Both slots written
+    uint64_t state = 2;
+    int oldOnes = 0, newOnes = 0, broken = 0, lost = 0;
+    esp_log_level_t level = JkkHostLogLevel;
+    JkkHostLogLevel = ESP_LOG_NONE; // Each cut save logs its error
+    for (int i = 0; i < cuts; i++) {
+        JkkNvsHostPowerLossAfter(rand() % (i % 2 ? 600 : 6000)); // Within one save or within page reclaim
+        JkkSnapshotSetState(state + 1);
+        lost += JkkNvsHostPowerLost();
+        JkkNvsHostReboot();
+        JkkSnapshotLoad();
+        JkkSnapshot_t snap;
+        JkkSnapshotGet(&snap);
+        if (snap.state == state + 1) {
+            newOnes++;
+            state++;
+        } else if (snap.state == state) {
+            oldOnes++;
+        } else {
+            broken++;
+        }
+    }
+    JkkHostLogLevel = level;
+    JkkRadioStations_t *loaded = NULL;
+    int loadedCount = 0;
+    JkkStationStoreLoad(&loaded, &loadedCount);
+    CHECK(StationsSame(st, count, loaded, loadedCount), "stations after power cuts (%d of %d)", loadedCount, count);
+    CHECK(broken == 0, "%d broken snapshots", broken);
+    printf("power loss: %d saves, %d cut: old %d, new %d, broken %d\n", cuts, lost, oldOnes, newOnes, broken);
+    Wear("power loss");
+    JkkStationStoreFree(loaded, loadedCount);
+    JkkStationStoreFree(st, count);
+}
+
+int main(int argc, char **argv) {
+    const char *image = NULL;
+    int pages = JKK_NVS_HOST_DEFAULT_PAGES;
+    int saves = 20000;
+    int cuts = 5000;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:p:s:c:v")) != -1) {
+        switch (opt) {
+            case 'i': image = optarg; break;
+            case 'p': pages = atoi(optarg); break;
+            case 's': saves = atoi(optarg); break;
+            case 'c': cuts = atoi(optarg); break;
+            case 'v': JkkHostLogLevel = ESP_LOG_DEBUG; break;
+            default:
+                fprintf(stderr, "Usage: %s [-i image] [-p pages] [-s saves] [-c cuts] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    srand(1);
+    if (JkkNvsHostOpen(image, pages) != ESP_OK) {
+        fprintf(stderr, "Can not open flash image\n");
+        return 1;
+    }
+    printf("NVS emulator: %d pages%s%s\n", pages, image ? ", image " : "", image ? image : "");
+    TestSemantics();
+    JkkSnapshotLoad();
+    BenchStations(100);
+    BenchStations(JKK_RADIO_MAX_STATIONS);
+    BenchSaveTimer(saves);
+    BenchMqtt();
+    TestFailedCommit();
+    TestNewerSnapshot();
+    TestOldSettings();
+    TestUnreadableChunk();
+    TestPowerLoss(cuts);
+    JkkNvsHostClose();
+    printf("%s (%d failed)\n", failed ? "FAILED" : "OK", failed);
+    return failed;
+}
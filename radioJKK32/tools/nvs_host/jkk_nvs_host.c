@@ -0,0 +1,872 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host (Linux) NVS emulator for jkk_nvs and storage code
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "jkk_nvs_host.h"
+
+#define PAGE_BITMAP (32) // Offset of entry state bitmap in page
+#define PAGE_DATA (64) // Offset of first entry
+#define ENTRY_SIZE (32)
+#define HANDLES_MAX (32)
+#define NS_MAX (254)
+
+#define PAGE_EMPTY (0xFFFFFFFFu)
+#define PAGE_ACTIVE (0xFFFFFFFEu)
+#define PAGE_FULL (0xFFFFFFFCu)
+#define PAGE_FREEING (0xFFFFFFF8u)
+
+#define ENTRY_EMPTY (3)
+#define ENTRY_WRITTEN (2)
+#define ENTRY_ERASED (0)
+
+#define TYPE_BLOB_DATA (0x42)
+#define TYPE_BLOB_IDX (0x48)
+#define VERSION_CHUNKS (128) // Blob data chunk index: version 0 - 0..127, version 1 - 128..255
+
+typedef struct __attribute__((packed)) Item_s {
+    uint8_t ns; // 0 - namespace names
+    uint8_t type;
+    uint8_t span; // Entries of item with data
+    uint8_t chunk; // Blob data: chunk index, others 0xFF
+    uint32_t crc; // Of item without crc
+    char key[16];
+    union {
+        uint8_t raw[8];
+        uint64_t u64;
+        struct __attribute__((packed)) { uint16_t size; uint16_t reserved; uint32_t dataCrc; } blob; // Blob data chunk
+        struct __attribute__((packed)) { uint32_t size; uint8_t chunkCount; uint8_t chunkStart; uint16_t reserved; } idx; // Blob index
+    };
+} Item_t;
+
+typedef struct __attribute__((packed)) PageHeader_s {
+    uint32_t state;
+    uint32_t seq;
+    uint8_t reserved[24];
+} PageHeader_t;
+
+typedef struct Live_s { // Item in flash
+    int page;
+    int entry;
+    uint8_t ns;
+    uint8_t type;
+    uint8_t span;
+    uint8_t chunk;
+    char key[16];
+} Live_t;
+
+typedef struct Page_s {
+    uint32_t state;
+    uint32_t seq;
+    int next; // First free entry
+    int erased; // Erased entries
+} Page_t;
+
+typedef struct Handle_s {
+    uint8_t ns;
+    bool readOnly;
+    bool used;
+} Handle_t;
+
+struct nvs_opaque_iterator_t {
+    uint8_t ns;
+    nvs_type_t type;
+    int pos; // In live table
+    char nsName[16];
+};
+
+static struct {
+    uint8_t *flash;
+    size_t size;
+    int fd;
+    int pages;
+    Page_t *page;
+    uint32_t *erases;
+    Live_t *live;
+    int liveCount;
+    int liveCap;
+    int active; // Active page, -1 - none
+    uint32_t seq;
+    Handle_t handles[HANDLES_MAX];
+    bool powerLost;
+    long powerBudget; // < 0 - no power loss
+    int failCommit;
+    JkkNvsHostStats_t stats;
+} nvs = { .fd = -1, .active = -1, .powerBudget = -1 };
+
+/* ── Flash ───────────────────────────────────────────────── */
+
+static bool FlashWrite(size_t off, const void *src, size_t len) {
+    if (nvs.powerLost) return false;
+    if (nvs.powerBudget >= 0 && (long)len > nvs.powerBudget) {
+        len = nvs.powerBudget; // Cut in the middle of write
+        nvs.powerLost = true;
+    }
+    const uint8_t *s = src;
+    for (size_t i = 0; i < len; i++) {
+        nvs.flash[off + i] &= s[i]; // NOR flash: program only clears bits
+    }
+    nvs.stats.bytesWritten += len;
+    if (nvs.powerBudget >= 0) nvs.powerBudget -= len;
+    return !nvs.powerLost;
+}
+
+static bool FlashErasePage(int p) {
+    if (nvs.powerLost) return false;
+    if (nvs.powerBudget == 0) {
+        nvs.powerLost = true;
+        return false;
+    }
+    memset(nvs.flash + (size_t)p * JKK_NVS_HOST_PAGE_SIZE, 0xFF, JKK_NVS_HOST_PAGE_SIZE);
+    nvs.erases[p]++;
+    return true;
+}
+
+static uint8_t *EntryPtr(int p, int e) {
+    return nvs.flash + (size_t)p * JKK_NVS_HOST_PAGE_SIZE + PAGE_DATA + e * ENTRY_SIZE;
+}
+
+static int EntryState(int p, int e) {
+    uint8_t b = nvs.flash[(size_t)p * JKK_NVS_HOST_PAGE_SIZE + PAGE_BITMAP + e / 4];
+    return (b >> ((e % 4) * 2)) & 3;
+}
+
+static bool EntrySetState(int p, int e, int state) {
+    uint8_t b = (uint8_t)~(((~state) & 3) << ((e % 4) * 2));
+    return FlashWrite((size_t)p * JKK_NVS_HOST_PAGE_SIZE + PAGE_BITMAP + e / 4, &b, 1);
+}
+
+static bool PageSetState(int p, uint32_t state) {
+    nvs.page[p].state = state;
+    return FlashWrite((size_t)p * JKK_NVS_HOST_PAGE_SIZE, &state, sizeof(state));
+}
+
+static uint32_t ItemCrc(const Item_t *item) {
+    Item_t tmp = *item;
+    tmp.crc = 0;
+    return esp_rom_crc32_le(0, (const uint8_t *)&tmp, sizeof(tmp));
+}
+
+/* ── Item table ──────────────────────────────────────────── */
+
+static int LiveFind(uint8_t ns, const char *key, int typeA, int typeB) {
+    for (int i = 0; i < nvs.liveCount; i++) {
+        Live_t *l = &nvs.live[i];
+        if (l->ns == ns && (l->type == typeA || l->type == typeB) && strncmp(l->key, key, 16) == 0) return i;
+    }
+    return -1;
+}
+
+static int LiveFindBlobData(uint8_t ns, const char *key, uint8_t chunk) {
+    for (int i = 0; i < nvs.liveCount; i++) {
+        Live_t *l = &nvs.live[i];
+        if (l->ns == ns && l->type == TYPE_BLOB_DATA && l->chunk == chunk && strncmp(l->key, key, 16) == 0) return i;
+    }
+    return -1;
+}
+
+static void LiveAdd(int p, int e, const Item_t *item) {
+    if (nvs.liveCount == nvs.liveCap) {
+        nvs.liveCap = nvs.liveCap ? nvs.liveCap * 2 : 256;
+        nvs.live = realloc(nvs.live, nvs.liveCap * sizeof(Live_t));
+    }
+    Live_t *l = &nvs.live[nvs.liveCount++];
+    l->page = p;
+    l->entry = e;
+    l->ns = item->ns;
+    l->type = item->type;
+    l->span = item->span;
+    l->chunk = item->chunk;
+    memcpy(l->key, item->key, 16);
+}
+
+static void LiveRemove(int i) {
+    nvs.live[i] = nvs.live[--nvs.liveCount];
+}
+
+/* Mark entries of item erased and drop it from table */
+static bool ItemErase(int i) {
+    Live_t l = nvs.live[i];
+    LiveRemove(i);
+    for (int k = 0; k < l.span; k++) {
+        if (!EntrySetState(l.page, l.entry + k, ENTRY_ERASED)) return false;
+    }
+    nvs.page[l.page].erased += l.span;
+    return true;
+}
+
+/* ── Pages ───────────────────────────────────────────────── */
+
+static int PagesEmpty(void) {
+    int n = 0;
+    for (int p = 0; p < nvs.pages; p++) {
+        if (nvs.page[p].state == PAGE_EMPTY) n++;
+    }
+    return n;
+}
+
+static int PageTakeEmpty(void) {
+    for (int p = 0; p < nvs.pages; p++) {
+        if (nvs.page[p].state != PAGE_EMPTY) continue;
+        nvs.page[p].seq = ++nvs.seq;
+        PageHeader_t hdr;
+        memset(&hdr, 0xFF, sizeof(hdr));
+        hdr.state = PAGE_ACTIVE;
+        hdr.seq = nvs.page[p].seq;
+        if (!FlashWrite((size_t)p * JKK_NVS_HOST_PAGE_SIZE, &hdr, sizeof(hdr))) return -1;
+        nvs.page[p].state = PAGE_ACTIVE;
+        nvs.page[p].next = 0;
+        nvs.page[p].erased = 0;
+        return p;
+    }
+    return -1;
+}
+
+static bool ItemWriteAt(int p, const Item_t *item, const void *data, size_t len);
+
+static int PageLive(int p) {
+    return nvs.page[p].next - nvs.page[p].erased;
+}
+
+/* Move live items of full page with least of them to reserved (empty) page, erase it */
+static esp_err_t PageReclaim(int from) {
+    if (from < 0) {
+        for (int p = 0; p < nvs.pages; p++) {
+            if (nvs.page[p].state == PAGE_FULL && (from < 0 || PageLive(p) < PageLive(from))) from = p;
+        }
+        if (from < 0 || PageLive(from) == JKK_NVS_HOST_PAGE_ENTRIES) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        if (!PageSetState(from, PAGE_FREEING)) return ESP_FAIL;
+    }
+    if (nvs.active >= 0 && JKK_NVS_HOST_PAGE_ENTRIES - nvs.page[nvs.active].next < PageLive(from)) {
+        if (!PageSetState(nvs.active, PAGE_FULL)) return ESP_FAIL; // Copies go to a fresh page
+        nvs.active = -1;
+    }
+    if (nvs.active < 0 || nvs.page[nvs.active].state != PAGE_ACTIVE) {
+        nvs.active = PageTakeEmpty();
+        if (nvs.active < 0) return nvs.powerLost ? ESP_FAIL : ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    for (int i = 0; i < nvs.liveCount;) {
+        Live_t l = nvs.live[i];
+        if (l.page != from) {
+            i++;
+            continue;
+        }
+        Item_t item;
+        memcpy(&item, EntryPtr(l.page, l.entry), sizeof(item));
+        if (!ItemWriteAt(nvs.active, &item, EntryPtr(l.page, l.entry + 1), (l.span - 1) * ENTRY_SIZE)) return ESP_FAIL;
+        LiveRemove(i); // Copy is added at the end of table
+    }
+    if (!FlashErasePage(from)) return ESP_FAIL;
+    nvs.page[from] = (Page_t){ .state = PAGE_EMPTY };
+    nvs.stats.reclaims++;
+    return ESP_OK;
+}
+
+/* Active page with span free entries, full pages are closed and reclaimed as needed (one page stays empty) */
+static esp_err_t PageAlloc(int span) {
+    for (int tries = 0; tries <= 2 * nvs.pages; tries++) {
+        if (nvs.active >= 0 && JKK_NVS_HOST_PAGE_ENTRIES - nvs.page[nvs.active].next >= span) return ESP_OK;
+        if (nvs.active >= 0) {
+            if (!PageSetState(nvs.active, PAGE_FULL)) return ESP_FAIL;
+            nvs.active = -1;
+        }
+        if (PagesEmpty() > 1) {
+            nvs.active = PageTakeEmpty();
+            if (nvs.active < 0) return ESP_FAIL;
+            continue;
+        }
+        esp_err_t ret = PageReclaim(-1); // Takes the reserved page as active and frees another one
+        if (ret != ESP_OK) return ret;
+    }
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+}
+
+/* Entries first, state bits after them, first entry last: item is valid only when all of it is written */
+static bool ItemWriteAt(int p, const Item_t *item, const void *data, size_t len) {
+    int e = nvs.page[p].next;
+    nvs.page[p].next += item->span;
+    if (!FlashWrite(EntryPtr(p, e) - nvs.flash, item, sizeof(Item_t))) return false;
+    if (len && !FlashWrite(EntryPtr(p, e + 1) - nvs.flash, data, len)) return false;
+    for (int k = item->span - 1; k >= 0; k--) {
+        if (!EntrySetState(p, e + k, ENTRY_WRITTEN)) return false;
+    }
+    nvs.stats.entriesWritten += item->span;
+    LiveAdd(p, e, item);
+    return true;
+}
+
+static esp_err_t ItemWrite(Item_t *item, const void *data, size_t len) {
+    item->span = 1 + (len + ENTRY_SIZE - 1) / ENTRY_SIZE;
+    item->crc = ItemCrc(item);
+    esp_err_t ret = PageAlloc(item->span);
+    if (ret != ESP_OK) return ret;
+    return ItemWriteAt(nvs.active, item, data, len) ? ESP_OK : ESP_FAIL;
+}
+
+static void ItemInit(Item_t *item, uint8_t ns, uint8_t type, const char *key) {
+    memset(item, 0xFF, sizeof(*item));
+    item->ns = ns;
+    item->type = type;
+    item->chunk = 0xFF;
+    memset(item->key, 0, sizeof(item->key));
+    strncpy(item->key, key, sizeof(item->key) - 1);
+}
+
+/* ── Blobs ───────────────────────────────────────────────── */
+
+static bool BlobIndex(uint8_t ns, const char *key, int *idx, Item_t *ix) {
+    *idx = LiveFind(ns, key, TYPE_BLOB_IDX, TYPE_BLOB_IDX);
+    if (*idx < 0) return false;
+    memcpy(ix, EntryPtr(nvs.live[*idx].page, nvs.live[*idx].entry), sizeof(*ix));
+    return true;
+}
+
+/* Copy chunks in order, buf NULL - only check all of them are there */
+static bool BlobRead(uint8_t ns, const char *key, const Item_t *ix, uint8_t *buf) {
+    size_t pos = 0;
+    for (int c = 0; c < ix->idx.chunkCount; c++) {
+        int i = LiveFindBlobData(ns, key, ix->idx.chunkStart + c);
+        if (i < 0) return false;
+        Item_t data;
+        memcpy(&data, EntryPtr(nvs.live[i].page, nvs.live[i].entry), sizeof(data));
+        if (pos + data.blob.size > ix->idx.size) return false;
+        if (buf) memcpy(buf + pos, EntryPtr(nvs.live[i].page, nvs.live[i].entry + 1), data.blob.size);
+        pos += data.blob.size;
+    }
+    return pos == ix->idx.size;
+}
+
+/* Erase chunks of one version of blob */
+static bool BlobEraseVersion(uint8_t ns, const char *key, uint8_t chunkStart) {
+    for (int i = 0; i < nvs.liveCount; i++) {
+        Live_t *l = &nvs.live[i];
+        if (l->ns != ns || l->type != TYPE_BLOB_DATA || l->chunk < chunkStart || l->chunk >= chunkStart + VERSION_CHUNKS || strncmp(l->key, key, 16) != 0) continue;
+        if (!ItemErase(i)) return false;
+        i = -1; // Table changed
+    }
+    return true;
+}
+
+/* ── Load (nvs_flash_init) ───────────────────────────────── */
+
+static int PageOrder(const void *a, const void *b) {
+    const Page_t *pa = &nvs.page[*(const int *)a], *pb = &nvs.page[*(const int *)b];
+    return pa->seq < pb->seq ? -1 : pa->seq > pb->seq;
+}
+
+static bool EntryBlank(int p, int e) {
+    const uint8_t *d = EntryPtr(p, e);
+    for (int i = 0; i < ENTRY_SIZE; i++) {
+        if (d[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static esp_err_t Load(void) {
+    nvs.liveCount = 0;
+    nvs.active = -1;
+    nvs.seq = 0;
+    int order[nvs.pages];
+    int n = 0;
+    int freeing = -1;
+    for (int p = 0; p < nvs.pages; p++) {
+        PageHeader_t hdr;
+        memcpy(&hdr, nvs.flash + (size_t)p * JKK_NVS_HOST_PAGE_SIZE, sizeof(hdr));
+        nvs.page[p] = (Page_t){ .state = hdr.state, .seq = hdr.seq };
+        if (hdr.state == PAGE_EMPTY) continue;
+        if (hdr.state != PAGE_ACTIVE && hdr.state != PAGE_FULL && hdr.state != PAGE_FREEING) {
+            FlashErasePage(p); // Header torn while page was taken
+            nvs.page[p] = (Page_t){ .state = PAGE_EMPTY };
+            continue;
+        }
+        if (hdr.seq > nvs.seq) nvs.seq = hdr.seq;
+        if (hdr.state == PAGE_FREEING) freeing = p;
+        order[n++] = p;
+    }
+    qsort(order, n, sizeof(int), PageOrder);
+    for (int k = 0; k < n; k++) {
+        int p = order[k];
+        Page_t *pg = &nvs.page[p];
+        for (int e = 0; e < JKK_NVS_HOST_PAGE_ENTRIES;) {
+            int state = EntryState(p, e);
+            if (state == ENTRY_EMPTY) {
+                if (!EntryBlank(p, e)) {
+                    EntrySetState(p, e, ENTRY_ERASED); // Written without state: power lost during write
+                    pg->erased++;
+                    pg->next = e + 1;
+                }
+                e++;
+                continue;
+            }
+            pg->next = e + 1;
+            if (state == ENTRY_ERASED) {
+                pg->erased++;
+                e++;
+                continue;
+            }
+            Item_t item;
+            memcpy(&item, EntryPtr(p, e), sizeof(item));
+            bool ok = item.span >= 1 && e + item.span <= JKK_NVS_HOST_PAGE_ENTRIES && ItemCrc(&item) == item.crc;
+            if (ok && item.type == TYPE_BLOB_DATA) {
+                ok = esp_rom_crc32_le(0, EntryPtr(p, e + 1), item.blob.size) == item.blob.dataCrc;
+            }
+            if (!ok) {
+                EntrySetState(p, e, ENTRY_ERASED);
+                pg->erased++;
+                e++;
+                continue;
+            }
+            /* Newer page or later entry wins, older copy is erased (power lost between write and erase) */
+            int old = item.type == TYPE_BLOB_DATA ? LiveFindBlobData(item.ns, item.key, item.chunk) : LiveFind(item.ns, item.key, item.type, item.type);
+            if (old >= 0) {
+                if (nvs.page[nvs.live[old].page].state != PAGE_FREEING || p == freeing) ItemErase(old);
+                else LiveRemove(old); // Freeing page is erased below
+            }
+            LiveAdd(p, e, &item);
+            pg->next = e + item.span;
+            e += item.span;
+        }
+        if (pg->state == PAGE_ACTIVE) {
+            if (nvs.active >= 0) PageSetState(nvs.active, PAGE_FULL);
+            nvs.active = p;
+        }
+    }
+    /* Index with missing chunk: blob write was cut before all data was there */
+    for (int i = 0; i < nvs.liveCount;) {
+        Live_t *l = &nvs.live[i];
+        Item_t ix;
+        if (l->type == TYPE_BLOB_IDX) {
+            memcpy(&ix, EntryPtr(l->page, l->entry), sizeof(ix));
+            if (!BlobRead(l->ns, l->key, &ix, NULL)) {
+                ItemErase(i);
+                continue;
+            }
+        }
+        i++;
+    }
+    /* Chunks not in current index: rest of interrupted blob write or overwrite */
+    for (int i = 0; i < nvs.liveCount;) {
+        Live_t *l = &nvs.live[i];
+        if (l->type == TYPE_BLOB_DATA) {
+            int idx;
+            Item_t ix;
+            if (!BlobIndex(l->ns, l->key, &idx, &ix) || l->chunk < ix.idx.chunkStart || l->chunk >= ix.idx.chunkStart + ix.idx.chunkCount) {
+                ItemErase(i);
+                continue;
+            }
+        }
+        i++;
+    }
+    if (freeing >= 0) {
+        if (PageReclaim(freeing) != ESP_OK) return ESP_FAIL; // Power lost while page was reclaimed
+    }
+    if (nvs.active < 0 && PagesEmpty() > 1) {
+        nvs.active = PageTakeEmpty();
+    }
+    return nvs.powerLost ? ESP_FAIL : ESP_OK;
+}
+
+/* ── Host control ────────────────────────────────────────── */
+
+esp_err_t JkkNvsHostOpen(const char *path, int pages) {
+    JkkNvsHostClose();
+    if (pages < 2) return ESP_ERR_INVALID_ARG;
+    nvs.pages = pages;
+    nvs.size = (size_t)pages * JKK_NVS_HOST_PAGE_SIZE;
+    if (path) {
+        nvs.fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (nvs.fd < 0) return ESP_FAIL;
+        struct stat st;
+        fstat(nvs.fd, &st);
+        bool fresh = (size_t)st.st_size != nvs.size;
+        if (fresh && ftruncate(nvs.fd, nvs.size) != 0) return ESP_FAIL;
+        nvs.flash = mmap(NULL, nvs.size, PROT_READ | PROT_WRITE, MAP_SHARED, nvs.fd, 0);
+        if (nvs.flash == MAP_FAILED) return ESP_FAIL;
+        if (fresh) memset(nvs.flash, 0xFF, nvs.size);
+    } else {
+        nvs.flash = mmap(NULL, nvs.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (nvs.flash == MAP_FAILED) return ESP_FAIL;
+        memset(nvs.flash, 0xFF, nvs.size);
+    }
+    memset(nvs.handles, 0, sizeof(nvs.handles));
+    nvs.page = calloc(pages, sizeof(Page_t));
+    nvs.erases = calloc(pages, sizeof(uint32_t));
+    memset(&nvs.stats, 0, sizeof(nvs.stats));
+    nvs.powerLost = false;
+    nvs.powerBudget = -1;
+    nvs.failCommit = 0;
+    return Load();
+}
+
+void JkkNvsHostClose(void) {
+    if (nvs.flash) {
+        if (nvs.fd >= 0) msync(nvs.flash, nvs.size, MS_SYNC);
+        munmap(nvs.flash, nvs.size);
+    }
+    if (nvs.fd >= 0) close(nvs.fd);
+    free(nvs.page);
+    free(nvs.erases);
+    free(nvs.live);
+    memset(&nvs, 0, sizeof(nvs));
+    nvs.fd = -1;
+    nvs.active = -1;
+    nvs.powerBudget = -1;
+}
+
+esp_err_t JkkNvsHostReboot(void) {
+    nvs.powerLost = false;
+    nvs.powerBudget = -1;
+    nvs.failCommit = 0;
+    return Load();
+}
+
+void JkkNvsHostFailCommit(int n) {
+    nvs.failCommit = n;
+}
+
+void JkkNvsHostPowerLossAfter(long bytes) {
+    nvs.powerBudget = bytes;
+}
+
+bool JkkNvsHostPowerLost(void) {
+    return nvs.powerLost;
+}
+
+void JkkNvsHostStatsGet(JkkNvsHostStats_t *stats) {
+    *stats = nvs.stats;
+    stats->pages = nvs.pages;
+    stats->eraseMin = UINT32_MAX;
+    for (int p = 0; p < nvs.pages; p++) {
+        if (nvs.erases[p] < stats->eraseMin) stats->eraseMin = nvs.erases[p];
+        if (nvs.erases[p] > stats->eraseMax) stats->eraseMax = nvs.erases[p];
+        stats->eraseTotal += nvs.erases[p];
+    }
+}
+
+void JkkNvsHostStatsReset(void) {
+    memset(&nvs.stats, 0, sizeof(nvs.stats));
+}
+
+uint32_t JkkNvsHostPageErases(int page) {
+    return page >= 0 && page < nvs.pages ? nvs.erases[page] : 0;
+}
+
+/* ── nvs_flash.h ─────────────────────────────────────────── */
+
+esp_err_t nvs_flash_init(void) {
+    if (nvs.flash) return ESP_OK;
+    return JkkNvsHostOpen(NULL, JKK_NVS_HOST_DEFAULT_PAGES);
+}
+
+esp_err_t nvs_flash_erase(void) {
+    if (nvs.flash == NULL) return ESP_ERR_NVS_NOT_INITIALIZED;
+    for (int p = 0; p < nvs.pages; p++) {
+        if (!FlashErasePage(p)) return ESP_FAIL;
+    }
+    return Load();
+}
+
+/* ── nvs.h ───────────────────────────────────────────────── */
+
+static Handle_t *HandleGet(nvs_handle_t handle) {
+    if (handle == 0 || handle > HANDLES_MAX || !nvs.handles[handle - 1].used) return NULL;
+    return &nvs.handles[handle - 1];
+}
+
+static int NamespaceFind(const char *name) {
+    int i = LiveFind(0, name, NVS_TYPE_U8, NVS_TYPE_U8);
+    if (i < 0) return -1;
+    Item_t item;
+    memcpy(&item, EntryPtr(nvs.live[i].page, nvs.live[i].entry), sizeof(item));
+    return item.raw[0];
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    if (nvs.flash == NULL) return ESP_ERR_NVS_NOT_INITIALIZED;
+    if (nvs.powerLost) return ESP_FAIL;
+    if (strlen(name) >= NVS_KEY_NAME_MAX_SIZE) return ESP_ERR_NVS_KEY_TOO_LONG;
+    nvs.stats.opens++;
+    int ns = NamespaceFind(name);
+    if (ns < 0) {
+        if (open_mode == NVS_READONLY) return ESP_ERR_NVS_NOT_FOUND;
+        bool used[NS_MAX + 1] = {0};
+        for (int i = 0; i < nvs.liveCount; i++) used[nvs.live[i].ns] = true;
+        for (int i = 0; i < nvs.liveCount; i++) {
+            if (nvs.live[i].ns != 0) continue;
+            Item_t item;
+            memcpy(&item, EntryPtr(nvs.live[i].page, nvs.live[i].entry), sizeof(item));
+            used[item.raw[0]] = true;
+        }
+        for (ns = 1; ns <= NS_MAX && used[ns]; ns++);
+        if (ns > NS_MAX) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        Item_t item;
+        ItemInit(&item, 0, NVS_TYPE_U8, name);
+        item.raw[0] = ns;
+        esp_err_t ret = ItemWrite(&item, NULL, 0);
+        if (ret != ESP_OK) return ret;
+    }
+    for (int h = 0; h < HANDLES_MAX; h++) {
+        if (nvs.handles[h].used) continue;
+        nvs.handles[h] = (Handle_t){ .ns = ns, .readOnly = open_mode == NVS_READONLY, .used = true };
+        *out_handle = h + 1;
+        return ESP_OK;
+    }
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    Handle_t *h = HandleGet(handle);
+    if (h) h->used = false;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    if (HandleGet(handle) == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (nvs.powerLost) return ESP_FAIL;
+    nvs.stats.commits++;
+    if (nvs.failCommit > 0 && --nvs.failCommit == 0) return ESP_FAIL;
+    if (nvs.fd >= 0) msync(nvs.flash, nvs.size, MS_ASYNC);
+    return ESP_OK; // Items are in flash since set
+}
+
+static esp_err_t SetCheck(nvs_handle_t handle, const char *key, Handle_t **h) {
+    *h = HandleGet(handle);
+    if (*h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (nvs.powerLost) return ESP_FAIL;
+    if ((*h)->readOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (key == NULL || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) return ESP_ERR_NVS_KEY_TOO_LONG;
+    nvs.stats.sets++;
+    return ESP_OK;
+}
+
+static esp_err_t SetPrimitive(nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t size) {
+    Handle_t *h;
+    esp_err_t ret = SetCheck(handle, key, &h);
+    if (ret != ESP_OK) return ret;
+    Item_t item;
+    ItemInit(&item, h->ns, type, key);
+    memcpy(item.raw, value, size);
+    int old = LiveFind(h->ns, key, type, type);
+    if (old >= 0 && memcmp(EntryPtr(nvs.live[old].page, nvs.live[old].entry) + offsetof(Item_t, raw), item.raw, sizeof(item.raw)) == 0) {
+        return ESP_OK; // Same value, nothing written
+    }
+    ret = ItemWrite(&item, NULL, 0);
+    if (ret != ESP_OK) return ret;
+    old = LiveFind(h->ns, key, type, type); // Table changed
+    if (old >= 0 && old != nvs.liveCount - 1) {
+        if (!ItemErase(old)) return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t GetPrimitive(nvs_handle_t handle, const char *key, nvs_type_t type, void *value, size_t size) {
+    Handle_t *h = HandleGet(handle);
+    if (h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (nvs.powerLost) return ESP_FAIL;
+    int i = LiveFind(h->ns, key, type, type);
+    if (i < 0) {
+        return LiveFind(h->ns, key, -1, -1) < 0 && nvs_find_key(handle, key, NULL) == ESP_OK ? ESP_ERR_NVS_TYPE_MISMATCH : ESP_ERR_NVS_NOT_FOUND;
+    }
+    memcpy(value, EntryPtr(nvs.live[i].page, nvs.live[i].entry) + offsetof(Item_t, raw), size);
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value) { return SetPrimitive(handle, key, NVS_TYPE_U8, &value, sizeof(value)); }
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value) { return SetPrimitive(handle, key, NVS_TYPE_U16, &value, sizeof(value)); }
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) { return SetPrimitive(handle, key, NVS_TYPE_U32, &value, sizeof(value)); }
+esp_err_t nvs_set_u64(nvs_handle_t handle, const char *key, uint64_t value) { return SetPrimitive(handle, key, NVS_TYPE_U64, &value, sizeof(value)); }
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value) { return GetPrimitive(handle, key, NVS_TYPE_U8, out_value, sizeof(*out_value)); }
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *out_value) { return GetPrimitive(handle, key, NVS_TYPE_U16, out_value, sizeof(*out_value)); }
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value) { return GetPrimitive(handle, key, NVS_TYPE_U32, out_value, sizeof(*out_value)); }
+esp_err_t nvs_get_u64(nvs_handle_t handle, const char *key, uint64_t *out_value) { return GetPrimitive(handle, key, NVS_TYPE_U64, out_value, sizeof(*out_value)); }
+
+/* Data in chunks filling the active page and next ones (as IDF blob version 2), index written after them */
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    Handle_t *h;
+    esp_err_t ret = SetCheck(handle, key, &h);
+    if (ret != ESP_OK) return ret;
+    if (length > (size_t)(nvs.pages / 2 - 1) * (JKK_NVS_HOST_PAGE_ENTRIES - 1) * ENTRY_SIZE) return ESP_ERR_NVS_VALUE_TOO_LONG;
+    int oldIdx;
+    Item_t ix;
+    uint8_t start = 0;
+    if (BlobIndex(h->ns, key, &oldIdx, &ix)) {
+        uint8_t *cur = malloc(ix.idx.size + 1);
+        bool same = ix.idx.size == length && BlobRead(h->ns, key, &ix, cur) && memcmp(cur, value, length) == 0;
+        free(cur);
+        if (same) return ESP_OK; // Same data, nothing written
+        start = ix.idx.chunkStart ^ VERSION_CHUNKS;
+    }
+    if (!BlobEraseVersion(h->ns, key, start)) return ESP_FAIL; // Chunks of set that failed before its index was written
+    const uint8_t *src = value;
+    size_t left = length;
+    int count = 0;
+    do {
+        if (count == VERSION_CHUNKS) return ESP_ERR_NVS_VALUE_TOO_LONG;
+        int need = 1 + (left + ENTRY_SIZE - 1) / ENTRY_SIZE;
+        ret = PageAlloc(need < 2 ? need : 2);
+        if (ret != ESP_OK) return ret;
+        size_t room = (JKK_NVS_HOST_PAGE_ENTRIES - nvs.page[nvs.active].next - 1) * ENTRY_SIZE;
+        size_t len = left < room ? left : room;
+        Item_t item;
+        ItemInit(&item, h->ns, TYPE_BLOB_DATA, key);
+        item.chunk = start + count;
+        item.blob.size = len;
+        item.blob.reserved = 0xFFFF;
+        item.blob.dataCrc = esp_rom_crc32_le(0, src, len);
+        ret = ItemWrite(&item, src, len);
+        if (ret != ESP_OK) return ret;
+        src += len;
+        left -= len;
+        count++;
+    } while (left > 0);
+    Item_t item;
+    ItemInit(&item, h->ns, TYPE_BLOB_IDX, key);
+    item.idx.size = length;
+    item.idx.chunkCount = count;
+    item.idx.chunkStart = start;
+    item.idx.reserved = 0xFFFF;
+    ret = ItemWrite(&item, NULL, 0);
+    if (ret != ESP_OK) return ret;
+    Live_t newIdx = nvs.live[nvs.liveCount - 1];
+    /* Old version after new one is complete */
+    for (int i = 0; i < nvs.liveCount; i++) {
+        Live_t *l = &nvs.live[i];
+        if (l->ns != h->ns || l->type != TYPE_BLOB_IDX || strncmp(l->key, key, 16) != 0 || (l->page == newIdx.page && l->entry == newIdx.entry)) continue;
+        if (!ItemErase(i)) return ESP_FAIL;
+        i = -1;
+    }
+    return BlobEraseVersion(h->ns, key, start ^ VERSION_CHUNKS) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    Handle_t *h = HandleGet(handle);
+    if (h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (nvs.powerLost) return ESP_FAIL;
+    int idx;
+    Item_t ix;
+    if (!BlobIndex(h->ns, key, &idx, &ix)) return ESP_ERR_NVS_NOT_FOUND;
+    if (out_value == NULL) {
+        *length = ix.idx.size;
+        return ESP_OK;
+    }
+    if (*length < ix.idx.size) {
+        *length = ix.idx.size;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    *length = ix.idx.size;
+    return BlobRead(h->ns, key, &ix, out_value) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_find_key(nvs_handle_t handle, const char *key, nvs_type_t *out_type) {
+    Handle_t *h = HandleGet(handle);
+    if (h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+    for (int i = 0; i < nvs.liveCount; i++) {
+        Live_t *l = &nvs.live[i];
+        if (l->ns != h->ns || l->type == TYPE_BLOB_DATA || strncmp(l->key, key, 16) != 0) continue;
+        if (out_type) *out_type = l->type == TYPE_BLOB_IDX ? NVS_TYPE_BLOB : (nvs_type_t)l->type;
+        return ESP_OK;
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    Handle_t *h;
+    esp_err_t ret = SetCheck(handle, key, &h);
+    if (ret != ESP_OK) return ret;
+    bool found = false;
+    for (int i = 0; i < nvs.liveCount; i++) {
+        Live_t *l = &nvs.live[i];
+        if (l->ns != h->ns || strncmp(l->key, key, 16) != 0) continue;
+        if (!ItemErase(i)) return ESP_FAIL;
+        found = true;
+        i = -1;
+    }
+    return found ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    Handle_t *h = HandleGet(handle);
+    if (h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (nvs.powerLost) return ESP_FAIL;
+    if (h->readOnly) return ESP_ERR_NVS_READ_ONLY;
+    for (int i = 0; i < nvs.liveCount; i++) {
+        if (nvs.live[i].ns != h->ns) continue;
+        if (!ItemErase(i)) return ESP_FAIL;
+        i = -1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_stats(const char *part_name, nvs_stats_t *nvs_stats) {
+    if (nvs.flash == NULL) return ESP_ERR_NVS_NOT_INITIALIZED;
+    memset(nvs_stats, 0, sizeof(*nvs_stats));
+    nvs_stats->total_entries = (size_t)nvs.pages * JKK_NVS_HOST_PAGE_ENTRIES;
+    for (int p = 0; p < nvs.pages; p++) {
+        Page_t *pg = &nvs.page[p];
+        int unused = pg->state == PAGE_EMPTY ? JKK_NVS_HOST_PAGE_ENTRIES : JKK_NVS_HOST_PAGE_ENTRIES - pg->next;
+        nvs_stats->free_entries += unused + (pg->state == PAGE_EMPTY ? 0 : pg->erased);
+        nvs_stats->used_entries += pg->state == PAGE_EMPTY ? 0 : pg->next - pg->erased;
+    }
+    nvs_stats->available_entries = nvs_stats->free_entries > JKK_NVS_HOST_PAGE_ENTRIES ? nvs_stats->free_entries - JKK_NVS_HOST_PAGE_ENTRIES : 0;
+    for (int i = 0; i < nvs.liveCount; i++) {
+        if (nvs.live[i].ns == 0) nvs_stats->namespace_count++;
+    }
+    return ESP_OK;
+}
+
+/* Iterator: items of namespace in table order (blob is reported once, by its index) */
+static bool IteratorMatch(nvs_iterator_t it) {
+    Live_t *l = &nvs.live[it->pos];
+    if (l->ns != it->ns || l->type == TYPE_BLOB_DATA) return false;
+    nvs_type_t type = l->type == TYPE_BLOB_IDX ? NVS_TYPE_BLOB : (nvs_type_t)l->type;
+    return it->type == NVS_TYPE_ANY || it->type == type;
+}
+
+esp_err_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type, nvs_iterator_t *output_iterator) {
+    *output_iterator = NULL;
+    if (nvs.flash == NULL) return ESP_ERR_NVS_NOT_INITIALIZED;
+    int ns = namespace_name ? NamespaceFind(namespace_name) : -1;
+    if (ns < 0) return ESP_ERR_NVS_NOT_FOUND;
+    nvs_iterator_t it = calloc(1, sizeof(struct nvs_opaque_iterator_t));
+    it->ns = ns;
+    it->type = type;
+    it->pos = -1;
+    strncpy(it->nsName, namespace_name, sizeof(it->nsName) - 1);
+    *output_iterator = it;
+    return nvs_entry_next(output_iterator);
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t *iterator) {
+    nvs_iterator_t it = *iterator;
+    if (it == NULL) return ESP_ERR_INVALID_ARG;
+    for (it->pos++; it->pos < nvs.liveCount; it->pos++) {
+        if (IteratorMatch(it)) return ESP_OK;
+    }
+    free(it);
+    *iterator = NULL;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t iterator, nvs_entry_info_t *out_info) {
+    if (iterator == NULL || iterator->pos >= nvs.liveCount) return ESP_ERR_INVALID_ARG;
+    Live_t *l = &nvs.live[iterator->pos];
+    memset(out_info, 0, sizeof(*out_info));
+    memcpy(out_info->namespace_name, iterator->nsName, sizeof(out_info->namespace_name) - 1);
+    memcpy(out_info->key, l->key, sizeof(out_info->key) - 1);
+    out_info->type = l->type == TYPE_BLOB_IDX ? NVS_TYPE_BLOB : (nvs_type_t)l->type;
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator) {
+    free(iterator);
+}
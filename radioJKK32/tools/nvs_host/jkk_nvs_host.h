@@ -0,0 +1,101 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host (Linux) NVS emulator for jkk_nvs and storage code
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*  Implements the nvs.h / nvs_flash.h API used by jkk_nvs.c, jkk_snapshot.c and jkk_station_store.c, so they
+    are compiled for Linux without changes. Flash image is a file (or memory) mapped with mmap, laid out like
+    ESP-IDF NVS: 4 KB pages with header, entry state bitmap and 126 entries of 32 bytes. Writes only clear bits
+    (NOR flash). Items are appended to the active page, old versions are marked erased, a full set of pages is
+    reclaimed by moving live items of the page with fewest of them to the reserved page and erasing it. Blobs are
+    data chunks (filling the active page, then next ones) + index item written last. Writing the value already
+    stored writes nothing, as IDF.
+    After power loss (JkkNvsHostPowerLossAfter) every call fails until JkkNvsHostReboot, which reads the image
+    again like nvs_flash_init: torn entries are dropped, interrupted page reclaim is finished. */
+
+#define JKK_NVS_HOST_PAGE_SIZE (4096)
+#define JKK_NVS_HOST_PAGE_ENTRIES (126)
+#define JKK_NVS_HOST_DEFAULT_PAGES (22) // 0x16000 "nvs" partition of partitions_radiojkk.csv
+
+typedef struct JkkNvsHostStats_s {
+    uint32_t pages;
+    uint32_t eraseMin; // Page erases, least worn page
+    uint32_t eraseMax;
+    uint32_t eraseTotal;
+    uint32_t reclaims; // Pages reclaimed (live items moved, page erased)
+    uint64_t bytesWritten; // Flash bytes programmed (entries and state bits)
+    uint32_t entriesWritten;
+    uint32_t sets; // Set calls, also those writing nothing
+    uint32_t commits;
+    uint32_t opens;
+} JkkNvsHostStats_t;
+
+/**
+ * @brief Map flash image (created erased if missing or size differs) and read it like nvs_flash_init
+ * @param path Image file, NULL - memory only
+ * @param pages Number of 4 KB pages (at least 2)
+ * @return ESP_OK on success
+ */
+esp_err_t JkkNvsHostOpen(const char *path, int pages);
+
+/**
+ * @brief Unmap flash image (file keeps the data)
+ */
+void JkkNvsHostClose(void);
+
+/**
+ * @brief Forget item table and read the image again, as after reset (open handles stay valid: jkk_nvs keeps them cached)
+ * @return ESP_OK on success
+ */
+esp_err_t JkkNvsHostReboot(void);
+
+/**
+ * @brief Make one of next commits fail
+ * @param n 1 - next commit fails, 2 - the one after it, 0 - off
+ */
+void JkkNvsHostFailCommit(int n);
+
+/**
+ * @brief Lose power after given number of programmed flash bytes (write in progress is cut at that byte)
+ * @param bytes Bytes still written, < 0 - off
+ */
+void JkkNvsHostPowerLossAfter(long bytes);
+
+/**
+ * @brief Power was lost, calls fail until JkkNvsHostReboot
+ * @return true if power is lost
+ */
+bool JkkNvsHostPowerLost(void);
+
+/**
+ * @brief Get counters since JkkNvsHostOpen (or JkkNvsHostStatsReset)
+ * @param stats Output
+ */
+void JkkNvsHostStatsGet(JkkNvsHostStats_t *stats);
+
+/**
+ * @brief Reset write and call counters (page erase counts are kept, they are wear)
+ */
+void JkkNvsHostStatsReset(void);
+
+/**
+ * @brief Erase count of page
+ * @param page Page index
+ * @return Erases since image was created (kept in memory only)
+ */
+uint32_t JkkNvsHostPageErases(int page);
+
+#ifdef __cplusplus
+}
+#endif
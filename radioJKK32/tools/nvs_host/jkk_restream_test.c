@@ -0,0 +1,343 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host run of re-streamer (jkk_restream) on loopback: CPU cost per client and tap stalls
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <poll.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "ringbuf.h"
+#include "audio_element.h"
+
+#include "jkk_restream.h"
+
+/*  Usage: jkk_restream_test [-r rate KB/s] [-t seconds per step] [-v]
+    Producer thread writes the tap (as raw split does) at stream rate and measures how long its writes
+    block: the tap is 16 KB, so a re-stream task stopped for more than tap time stalls the input pipeline.
+    Steps: 404 and /stats replies, CPU time of the re-stream task with 0, 1, 4 and 8 streaming clients
+    (per client cost is the difference to 0 clients), 503 above client limit, then idle and slow
+    (byte by byte) requests while clients are streaming: tap must not stall, slow request must get
+    the stream and idle one must be closed after request timeout.
+    Exit code is number of failed checks. */
+
+#define PORT CONFIG_JKK_RADIO_RESTREAM_PORT
+#define MAX_CLIENTS (8) // CONFIG_JKK_RADIO_RESTREAM_MAX_CLIENTS default
+#define STALL_MAX_MS (100) // Longest tap write block allowed
+#define REQUEST_TIMEOUT_MS (3000) // JKK_RESTREAM_REQUEST_TIMEOUT_US
+
+static int failed = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failed++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static int rateKBs = 40; // 320 kbps stream
+static int stepSec = 2;
+
+static ringbuf_handle_t tap = NULL;
+
+esp_err_t audio_element_set_multi_output_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb, int index) {
+    tap = rb;
+    return ESP_OK;
+}
+
+/* ── CPU time of re-stream task ──────────────────────────── */
+
+BaseType_t __real_xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core);
+
+static TaskFunction_t taskFn = NULL;
+static clockid_t taskClock;
+static volatile bool taskClockSet = false;
+
+static void TaskStart(void *arg) {
+    pthread_getcpuclockid(pthread_self(), &taskClock);
+    taskClockSet = true;
+    taskFn(arg);
+}
+
+BaseType_t __wrap_xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core) {
+    taskFn = fn;
+    return __real_xTaskCreatePinnedToCore(TaskStart, name, stack, arg, prio, handle, core);
+}
+
+static int64_t TaskCpuUs(void) {
+    struct timespec ts;
+    clock_gettime(taskClock, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* ── Producer (raw split) ────────────────────────────────── */
+
+static volatile bool producing = true;
+static volatile long produced = 0;
+static volatile int64_t stallMaxUs = 0; // Longest write block since reset
+
+static void *Producer(void *arg) {
+    char chunk[1024];
+    memset(chunk, 0x55, sizeof(chunk));
+    int64_t start = esp_timer_get_time();
+    long sent = 0;
+    while (producing) {
+        int64_t t = esp_timer_get_time();
+        rb_write(tap, chunk, sizeof(chunk), portMAX_DELAY);
+        int64_t blocked = esp_timer_get_time() - t;
+        if (blocked > stallMaxUs) stallMaxUs = blocked;
+        sent += sizeof(chunk);
+        produced = sent;
+        int64_t due = start + sent * 1000 / rateKBs; // us when next chunk is due
+        int64_t now = esp_timer_get_time();
+        if (due > now) usleep(due - now);
+    }
+    return NULL;
+}
+
+/* ── Clients ─────────────────────────────────────────────── */
+
+static int Connect(void) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(PORT), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(sock);
+        return -1;
+    }
+    struct timeval tv = { .tv_sec = 5, .tv_usec = 0 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return sock;
+}
+
+// Reads reply until headers end (body start stays in buf), returns length or -1
+static int ReadReply(int sock, char *buf, int len) {
+    int n = 0;
+    while (n < len - 1) {
+        int r = recv(sock, buf + n, len - 1 - n, 0);
+        if (r <= 0) break;
+        n += r;
+        buf[n] = '\0';
+        if (strstr(buf, "\r\n\r\n")) return n;
+    }
+    buf[n] = '\0';
+    return n ? n : -1;
+}
+
+static int Request(const char *path, char *buf, int len) {
+    int sock = Connect();
+    if (sock < 0) return -1;
+    char req[128];
+    int n = snprintf(req, sizeof(req), "GET %s HTTP/1.0\r\nHost: radio\r\n\r\n", path);
+    send(sock, req, n, 0);
+    n = 0;
+    int r;
+    while (n < len - 1 && (r = recv(sock, buf + n, len - 1 - n, 0)) > 0) n += r; // Until server closes
+    buf[n] = '\0';
+    close(sock);
+    return n;
+}
+
+typedef struct {
+    int sock;
+    volatile long bytes;
+} Listener_t;
+
+static Listener_t listeners[MAX_CLIENTS + 1];
+static pthread_t readerThread;
+static volatile bool reading = false;
+
+static bool Listen(Listener_t *l) {
+    l->bytes = 0;
+    l->sock = Connect();
+    if (l->sock < 0) return false;
+    const char req[] = "GET " JKK_RESTREAM_PATH " HTTP/1.0\r\n\r\n";
+    send(l->sock, req, sizeof(req) - 1, 0);
+    char buf[512];
+    if (ReadReply(l->sock, buf, sizeof(buf)) < 0 || strncmp(buf, "HTTP/1.0 200", 12) != 0) {
+        close(l->sock);
+        l->sock = -1;
+        return false;
+    }
+    l->bytes = strlen(strstr(buf, "\r\n\r\n") + 4);
+    return true;
+}
+
+// One thread reads all listeners, as fast as data comes
+static void *Reader(void *arg) {
+    char buf[8192];
+    while (reading) {
+        struct pollfd fds[MAX_CLIENTS + 1];
+        for (int i = 0; i <= MAX_CLIENTS; i++) {
+            fds[i].fd = listeners[i].sock;
+            fds[i].events = POLLIN;
+        }
+        if (poll(fds, MAX_CLIENTS + 1, 20) <= 0) continue;
+        for (int i = 0; i <= MAX_CLIENTS; i++) {
+            if (fds[i].fd < 0 || !(fds[i].revents & POLLIN)) continue;
+            int r = recv(fds[i].fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (r > 0) listeners[i].bytes += r;
+        }
+    }
+    return NULL;
+}
+
+static void ReaderStart(void) {
+    reading = true;
+    pthread_create(&readerThread, NULL, Reader, NULL);
+}
+
+static void ReaderStop(void) {
+    reading = false;
+    pthread_join(readerThread, NULL);
+}
+
+static void CloseAll(void) {
+    for (int i = 0; i <= MAX_CLIENTS; i++) {
+        if (listeners[i].sock >= 0) close(listeners[i].sock);
+        listeners[i].sock = -1;
+    }
+    usleep(100 * 1000); // Server sees disconnects
+}
+
+/* ── Steps ───────────────────────────────────────────────── */
+
+static void TestReplies(void) {
+    char buf[2048];
+    CHECK(Request("/nothing", buf, sizeof(buf)) > 0 && strstr(buf, " 404 "), "unknown path: %s", buf);
+    CHECK(Request(JKK_RESTREAM_STATS_PATH, buf, sizeof(buf)) > 0 && strstr(buf, " 200 ") && strstr(buf, "\nclients;0\n"), "stats: %s", buf);
+    // Station name with line breaks must not add header lines
+    JkkRestreamSetName("Evil\r\nX-Injected: 1\r\n\r\n");
+    int sock = Connect();
+    const char req[] = "GET " JKK_RESTREAM_PATH " HTTP/1.0\r\n\r\n";
+    send(sock, req, sizeof(req) - 1, 0);
+    CHECK(ReadReply(sock, buf, sizeof(buf)) > 0 && strstr(buf, "\r\nicy-name: Evil  X-Injected: 1    \r\nConnection: close\r\n\r\n")
+          && !strstr(buf, "\nX-Injected"), "station name in header: %s", buf);
+    close(sock);
+    JkkRestreamSetName("Host test");
+    usleep(200 * 1000); // Server sees the close
+}
+
+static int64_t idleCpuPerSec = 0;
+
+// CPU time of re-stream task per second with n streaming clients
+static void TestClients(int n) {
+    int ok = 0;
+    for (int i = 0; i < n; i++) ok += Listen(&listeners[i]);
+    CHECK(ok == n, "%d of %d clients connected", ok, n);
+    ReaderStart();
+    usleep(300 * 1000); // Prebuffer sent
+    long bytes0[MAX_CLIENTS];
+    for (int i = 0; i < n; i++) bytes0[i] = listeners[i].bytes;
+    long produced0 = produced;
+    int64_t cpu0 = TaskCpuUs();
+    int64_t t0 = esp_timer_get_time();
+    sleep(stepSec);
+    int64_t cpu = TaskCpuUs() - cpu0;
+    int64_t t = esp_timer_get_time() - t0;
+    long made = produced - produced0;
+    int64_t perSec = cpu * 1000000 / t;
+    if (n == 0) idleCpuPerSec = perSec;
+    printf("%d clients: re-stream task %lld us/s", n, perSec);
+    if (n) printf(", per client %lld us/s", (perSec - idleCpuPerSec) / n);
+    printf("\n");
+    for (int i = 0; i < n; i++) {
+        long got = listeners[i].bytes - bytes0[i];
+        CHECK(got > made * 8 / 10, "client %d got %ld of %ld B", i, got, made);
+    }
+    if (n == MAX_CLIENTS) {
+        char buf[512];
+        CHECK(Request(JKK_RESTREAM_PATH, buf, sizeof(buf)) > 0 && strstr(buf, " 503 "), "client above limit: %s", buf);
+        CHECK(Request(JKK_RESTREAM_STATS_PATH, buf, sizeof(buf)) > 0 && strstr(buf, "\nclients;8\n"), "stats with full list: %s", buf);
+    }
+    ReaderStop();
+    CloseAll();
+}
+
+static void *SlowRequest(void *arg) {
+    Listener_t *l = arg;
+    const char req[] = "GET " JKK_RESTREAM_PATH " HTTP/1.0\r\n\r\n";
+    for (size_t i = 0; i < sizeof(req) - 1 && l->sock >= 0; i++) {
+        send(l->sock, req + i, 1, 0);
+        usleep(40 * 1000);
+    }
+    return NULL;
+}
+
+// Connections which do not send request (or send it slowly) must not stop the tap
+static void TestSlowRequests(void) {
+    for (int i = 0; i < 2; i++) CHECK(Listen(&listeners[i]), "client %d not connected", i);
+    int idle[2];
+    for (int i = 0; i < 2; i++) idle[i] = Connect();
+    listeners[2].sock = Connect();
+    listeners[2].bytes = 0;
+    pthread_t slow;
+    pthread_create(&slow, NULL, SlowRequest, &listeners[2]);
+    stallMaxUs = 0;
+    long bytes0 = listeners[0].bytes;
+    long produced0 = produced;
+    ReaderStart();
+    sleep(stepSec);
+    pthread_join(slow, NULL);
+    printf("idle and slow requests: longest tap write %lld ms\n", stallMaxUs / 1000);
+    CHECK(stallMaxUs < STALL_MAX_MS * 1000, "tap stalled for %lld ms", stallMaxUs / 1000);
+    CHECK(listeners[0].bytes - bytes0 > (produced - produced0) * 8 / 10, "client got %ld of %ld B",
+          listeners[0].bytes - bytes0, produced - produced0);
+    usleep(300 * 1000);
+    CHECK(listeners[2].bytes > 0, "slow request got no stream");
+    ReaderStop();
+
+    usleep(REQUEST_TIMEOUT_MS * 1000);
+    for (int i = 0; i < 2; i++) {
+        char c;
+        struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+        setsockopt(idle[i], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        CHECK(recv(idle[i], &c, 1, 0) == 0, "idle connection %d not closed after request timeout", i);
+        close(idle[i]);
+    }
+    CloseAll();
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "r:t:v")) != -1) {
+        switch (opt) {
+            case 'r': rateKBs = atoi(optarg); break;
+            case 't': stepSec = atoi(optarg); break;
+            case 'v': JkkHostLogLevel = ESP_LOG_DEBUG; break;
+            default:
+                fprintf(stderr, "Usage: %s [-r rate KB/s] [-t seconds per step] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN); // lwIP does not raise it, server sees EPIPE
+    for (int i = 0; i <= MAX_CLIENTS; i++) listeners[i].sock = -1;
+
+    static int splitDummy;
+    if (JkkRestreamInit((audio_element_handle_t)&splitDummy) != ESP_OK) {
+        printf("FAIL re-stream init (port %d busy?)\n", PORT);
+        return 1;
+    }
+    JkkRestreamSetCodec(ESP_CODEC_TYPE_MP3);
+    JkkRestreamSetName("Host test");
+    while (!taskClockSet) usleep(1000);
+    pthread_t producer;
+    pthread_create(&producer, NULL, Producer, NULL);
+    printf("Stream %d KB/s, %d s per step\n", rateKBs, stepSec);
+
+    TestReplies();
+    TestClients(0);
+    TestClients(1);
+    TestClients(4);
+    TestClients(MAX_CLIENTS);
+    TestSlowRequests();
+
+    producing = false;
+    pthread_join(producer, NULL);
+    printf("%s (%d failed)\n", failed ? "FAILED" : "OK", failed);
+    return failed;
+}
@@ -0,0 +1,421 @@
+/* RadioJKK32 - Multifunction Internet Radio Player
+ * Copyright (C) 2025 Jaromir Kopp (JKK)
+ * Host run of multi-room sync timing (jkk_sync_time) with simulated nodes on UDP loopback
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "lwip/sockets.h"
+
+#include "jkk_sync.h"
+#include "jkk_sync_time.h"
+
+/*  Usage: jkk_sync_test [-t seconds] [-v]
+    One leader and three followers run as threads, each with its own clock: offset (SNTP error) and
+    drift (ppm) against the host clock. Time exchanges and audio blocks go over UDP loopback, every
+    packet is held back by a random delay (mostly short, sometimes a few ms, different each way).
+    Leader reads blocks from a simulated tap and stamps them with JkkSyncPlayTime, every PCM frame
+    carries its number. Followers keep the offset with JkkSyncOffsetUpdate and play blocks with
+    JkkSyncPlayBlock (body of JkkSyncFollowerPlayTask) into a simulated DAC running on their own clock.
+    Skew is the difference of true (host) times when a frame is heard on the leader and on a follower,
+    taken from the frame numbers written to the DAC after warm-up (offset window filled, error of the
+    first exchanges corrected). Slips minus repeats must follow the follower drift and mean skew must
+    stay near 0.
+    Exit code is number of failed checks. */
+
+#define PORT (15075) // Leader time port, followers on next ports
+#define FOLLOWERS (3)
+#define RATE (44100)
+#define CHANNELS (2)
+#define BITS (16)
+#define LEADER_LAT_US (300 * 1000) // Leader output chain latency
+#define TIME_REQ_PERIOD_US (500 * 1000) // JKK_SYNC_TIME_REQ_PERIOD_US
+#define WARMUP_US (JKK_SYNC_OFFSET_SAMPLES * TIME_REQ_PERIOD_US + 2 * JKK_SYNC_SLIP_TC_MS * 1000) // Offset window filled, start error slipped away
+#define SKEW_MAX_US (1000) // Allowed skew after warm-up
+#define SKEW_MEAN_US (400) // Mean skew after warm-up: drift lag of slips plus offset estimate error
+#define NET_SLIP_FRAMES (14) // Slips minus repeats after warm-up against drift: offset estimate moves (~300 us)
+
+static int failed = 0;
+static bool verbose = false;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failed++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+/* ── Clocks ──────────────────────────────────────────────── */
+
+typedef struct {
+    int64_t offUs; // Against host clock at start
+    double ppm;
+} Clock_t;
+
+static int64_t hostStart;
+
+static int64_t HostUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t ClockNow(const Clock_t *c) {
+    int64_t h = HostUs();
+    return h + c->offUs + (int64_t)((h - hostStart) * c->ppm / 1e6);
+}
+
+// Host time when clock shows local
+static double ClockHost(const Clock_t *c, int64_t local) {
+    return hostStart + (local - c->offUs - hostStart) / (1 + c->ppm / 1e6);
+}
+
+// Network: mostly short, sometimes queued for a few ms
+static void NetDelay(unsigned *seed) {
+    int r = rand_r(seed) % 100;
+    usleep(r < 80 ? rand_r(seed) % 300 : 2000 + rand_r(seed) % 6000);
+}
+
+static int UdpSocket(int port) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(sock);
+        return -1;
+    }
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 100 * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return sock;
+}
+
+static struct sockaddr_in Addr(int port) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    return addr;
+}
+
+/* ── Leader ──────────────────────────────────────────────── */
+
+#define FRAME_BYTES (CHANNELS * BITS / 8)
+#define BLOCK_BYTES (1152) // JKK_SYNC_PAYLOAD
+#define BLOCK_FRAMES (BLOCK_BYTES / FRAME_BYTES)
+
+static volatile bool running = true;
+static Clock_t leaderClock = { 0, 0 };
+static int leaderSock = -1;
+static int64_t playStart; // Leader clock time of frame 0
+static int64_t playTimeErrMax = 0; // JkkSyncPlayTime against true play-out of the simulated DAC
+
+static int64_t LeaderPlay(int64_t frame) {
+    return playStart + frame * 1000000 / RATE;
+}
+
+static void *LeaderTimeTask(void *arg) {
+    unsigned seed = 1;
+    JkkSyncHdr_t req;
+    struct sockaddr_in from;
+    while (running) {
+        socklen_t fromLen = sizeof(from);
+        int r = recvfrom(leaderSock, &req, sizeof(req), 0, (struct sockaddr *)&from, &fromLen);
+        int64_t t2 = ClockNow(&leaderClock);
+        if (r != sizeof(req) || req.type != JKK_SYNC_PKT_TIME_REQ) continue;
+        req.type = JKK_SYNC_PKT_TIME_REPLY;
+        req.t2 = t2;
+        req.t3 = ClockNow(&leaderClock);
+        NetDelay(&seed);
+        sendto(leaderSock, &req, sizeof(req), 0, (struct sockaddr *)&from, fromLen);
+    }
+    return NULL;
+}
+
+// Blocks are read from tap with some bytes left behind, as JkkSyncLeaderTask does
+static void *LeaderAudioTask(void *arg) {
+    unsigned seed = 2;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    static uint8_t pkt[sizeof(JkkSyncHdr_t) + BLOCK_BYTES];
+    JkkSyncHdr_t *hdr = (JkkSyncHdr_t *)pkt;
+    hdr->magic = JKK_SYNC_MAGIC;
+    hdr->type = JKK_SYNC_PKT_AUDIO;
+    hdr->sample_rate = RATE;
+    hdr->channels = CHANNELS;
+    hdr->bits = BITS;
+    hdr->len = BLOCK_BYTES;
+    for (uint32_t b = 0; running; b++) {
+        int inTap = rand_r(&seed) % (4 * BLOCK_FRAMES); // Frames after this block, still in tap
+        int64_t newest = (int64_t)(b + 1) * BLOCK_FRAMES + inTap;
+        while (ClockNow(&leaderClock) < LeaderPlay(newest) - LEADER_LAT_US) usleep(500);
+        int64_t now = ClockNow(&leaderClock);
+        int lat = (int)(LeaderPlay(newest) - now); // JkkAudioMainBufferedUs
+        hdr->t1 = JkkSyncPlayTime(now, lat, (int64_t)(BLOCK_FRAMES + inTap) * FRAME_BYTES, (int64_t)RATE * FRAME_BYTES);
+        hdr->seq = b;
+        for (int i = 0; i < BLOCK_FRAMES; i++) {
+            uint32_t frame = b * BLOCK_FRAMES + i + 1; // 0 - silence
+            memcpy(pkt + sizeof(JkkSyncHdr_t) + i * FRAME_BYTES, &frame, FRAME_BYTES);
+        }
+        int64_t err = llabs(hdr->t1 - LeaderPlay((int64_t)b * BLOCK_FRAMES));
+        if (err > playTimeErrMax) playTimeErrMax = err;
+        for (int f = 0; f < FOLLOWERS; f++) {
+            struct sockaddr_in to = Addr(PORT + 1 + f);
+            sendto(sock, pkt, sizeof(pkt), 0, (struct sockaddr *)&to, sizeof(to));
+        }
+    }
+    close(sock);
+    return NULL;
+}
+
+/* ── Followers ───────────────────────────────────────────── */
+
+#define QUEUE (128)
+#define PKT_BYTES (sizeof(JkkSyncHdr_t) + BLOCK_BYTES)
+
+/* Simulated DAC takes frames at RATE of follower clock from its start: frames written ahead of
+   its position are the buffered latency, a DAC which ran out plays silence and continues from its position. */
+typedef struct {
+    int64_t start;
+    int64_t written; // Frames written since start (including silence of underruns)
+} Dac_t;
+
+typedef struct {
+    int id;
+    Clock_t clock;
+    int sock;
+    pthread_mutex_t lock; // As sync mux in firmware: offset and queue
+    pthread_cond_t cond;
+    JkkSyncOffset_t off;
+    uint8_t pkt[QUEUE][PKT_BYTES];
+    int head, count;
+    Dac_t dac;
+    JkkSyncPlay_t play;
+    // Results
+    int64_t warmAt; // Host time of warm-up end, corrections are counted from it
+    int netAtWarm; // Slips minus repeats then
+    long samples;
+    double skewSum;
+    double skewAbsSum;
+    double skewMax;
+    uint32_t drops;
+} Follower_t;
+
+static Follower_t followers[FOLLOWERS] = {
+    { .clock = { 37000, 40 } }, // SNTP 37 ms off, fast crystal
+    { .clock = { -12000, -30 } },
+    { .clock = { 250000, 5 } }, // SNTP not synced yet
+};
+
+static void *FollowerRxTask(void *arg) {
+    Follower_t *f = arg;
+    unsigned seed = 10 + f->id;
+    uint8_t buf[PKT_BYTES];
+    JkkSyncHdr_t *hdr = (JkkSyncHdr_t *)buf;
+    struct sockaddr_in leader = Addr(PORT);
+    int64_t lastReq = 0;
+    while (running) {
+        int64_t now = ClockNow(&f->clock);
+        if (now - lastReq > TIME_REQ_PERIOD_US) {
+            lastReq = now;
+            JkkSyncHdr_t req = { .magic = JKK_SYNC_MAGIC, .type = JKK_SYNC_PKT_TIME_REQ, .t1 = ClockNow(&f->clock) };
+            NetDelay(&seed);
+            sendto(f->sock, &req, sizeof(req), 0, (struct sockaddr *)&leader, sizeof(leader));
+        }
+        int r = recv(f->sock, buf, sizeof(buf), 0);
+        int64_t t4 = ClockNow(&f->clock);
+        if (r < (int)sizeof(JkkSyncHdr_t) || hdr->magic != JKK_SYNC_MAGIC) continue;
+        pthread_mutex_lock(&f->lock);
+        if (hdr->type == JKK_SYNC_PKT_TIME_REPLY) {
+            JkkSyncOffsetUpdate(&f->off, hdr, t4);
+        } else if (hdr->type == JKK_SYNC_PKT_AUDIO && r == (int)PKT_BYTES) {
+            if (f->count < QUEUE) {
+                memcpy(f->pkt[(f->head + f->count++) % QUEUE], buf, PKT_BYTES);
+                pthread_cond_signal(&f->cond);
+            } else {
+                f->drops++;
+            }
+        }
+        pthread_mutex_unlock(&f->lock);
+    }
+    return NULL;
+}
+
+static int64_t DacPos(const Dac_t *dac, int64_t now) {
+    int64_t pos = (now - dac->start) * RATE / 1000000;
+    return dac->written < pos ? pos : dac->written; // Underrun
+}
+
+static int64_t OutNow(void *ctx) {
+    Follower_t *f = ctx;
+    return ClockNow(&f->clock);
+}
+
+static int OutLatency(void *ctx) {
+    Follower_t *f = ctx;
+    int64_t now = ClockNow(&f->clock);
+    f->dac.written = DacPos(&f->dac, now);
+    return (int)((f->dac.written - (now - f->dac.start) * RATE / 1000000) * 1000000 / RATE);
+}
+
+// Frame numbers tell which leader frame is heard at DAC position written
+static void OutWrite(void *ctx, const uint8_t *data, int len) {
+    Follower_t *f = ctx;
+    f->dac.written = DacPos(&f->dac, ClockNow(&f->clock));
+    uint32_t frame;
+    memcpy(&frame, data, sizeof(frame));
+    int64_t heardLocal = f->dac.start + f->dac.written * 1000000 / RATE;
+    if (frame != 0 && HostUs() > hostStart + WARMUP_US) {
+        double skew = ClockHost(&f->clock, heardLocal) - ClockHost(&leaderClock, LeaderPlay(frame - 1));
+        f->samples++;
+        f->skewSum += skew;
+        f->skewAbsSum += fabs(skew);
+        if (fabs(skew) > f->skewMax) f->skewMax = fabs(skew);
+    }
+    f->dac.written += len / FRAME_BYTES;
+}
+
+// Loop of JkkSyncFollowerPlayTask without format and sequence checks (leader does not change them)
+static void *FollowerPlayTask(void *arg) {
+    Follower_t *f = arg;
+    uint8_t pkt[PKT_BYTES];
+    f->dac = (Dac_t){ .start = ClockNow(&f->clock), .written = 0 };
+    f->play.out = (JkkSyncOut_t){ .now = OutNow, .latency = OutLatency, .write = OutWrite, .ctx = f };
+    while (running) {
+        pthread_mutex_lock(&f->lock);
+        while (f->count == 0 && running) pthread_cond_wait(&f->cond, &f->lock);
+        if (!running) {
+            pthread_mutex_unlock(&f->lock);
+            break;
+        }
+        memcpy(pkt, f->pkt[f->head], PKT_BYTES);
+        f->head = (f->head + 1) % QUEUE;
+        f->count--;
+        bool valid = f->off.valid;
+        int64_t offsetUs = f->off.offsetUs;
+        pthread_mutex_unlock(&f->lock);
+        if (f->warmAt == 0 && HostUs() > hostStart + WARMUP_US) {
+            f->warmAt = HostUs();
+            f->netAtWarm = (int)f->play.slips - (int)f->play.dups;
+        }
+        if (valid) {
+            JkkSyncPlayBlock(&f->play, (JkkSyncHdr_t *)pkt, pkt + sizeof(JkkSyncHdr_t), offsetUs);
+        }
+    }
+    return NULL;
+}
+
+/* ── Steps ───────────────────────────────────────────────── */
+
+static void TestOffset(void) {
+    JkkSyncOffset_t off = {0};
+    // Follower 5000 us behind leader, 200 us each way
+    JkkSyncHdr_t reply = { .t1 = 1000000, .t2 = 1000000 + 5000 + 200, .t3 = 1000000 + 5000 + 300 };
+    CHECK(JkkSyncOffsetUpdate(&off, &reply, 1000000 + 300 + 200) && off.valid && off.offsetUs == 5000, "symmetric exchange: %lld", off.offsetUs);
+    // Long queuing on the way back only: not used while shorter exchange is in window
+    reply = (JkkSyncHdr_t){ .t1 = 2000000, .t2 = 2000000 + 5000 + 200, .t3 = 2000000 + 5000 + 300 };
+    JkkSyncOffsetUpdate(&off, &reply, 2000000 + 300 + 8000);
+    CHECK(off.offsetUs == 5000, "asymmetric exchange used: %lld", off.offsetUs);
+    reply = (JkkSyncHdr_t){ .t1 = 3000000, .t2 = 3000000 + 100, .t3 = 3000000 + 5000 };
+    CHECK(!JkkSyncOffsetUpdate(&off, &reply, 3000000 + 10), "negative round trip accepted");
+}
+
+// Closed loop: slips change the error of next blocks, drift adds to it
+static double SlipLoop(JkkSyncSlip_t *slip, double err, double ppm, int blocks, int *net, int *reversed) {
+    *net = 0;
+    *reversed = 0;
+    for (int i = 0; i < blocks; i++) {
+        int skip = JkkSyncSlip(slip, (int64_t)err, BLOCK_FRAMES, RATE);
+        if (skip != 0 && (skip > 0) != (err > 0)) (*reversed)++;
+        *net += skip;
+        err -= skip * 1e6 / RATE;
+        err -= ppm * BLOCK_FRAMES / RATE; // Fast follower clock plays early
+    }
+    return err;
+}
+
+static void TestSlip(void) {
+    JkkSyncSlip_t slip = {0};
+    CHECK(JkkSyncSlip(&slip, 500, BLOCK_FRAMES, RATE) == 0, "slip on first block");
+    int blocks = 10 * RATE / BLOCK_FRAMES; // 10 s
+    int net, reversed;
+    slip = (JkkSyncSlip_t){0};
+    double err = SlipLoop(&slip, 3000, 0, blocks, &net, &reversed);
+    CHECK(fabs(err) <= 100 && net > 0 && reversed == 0, "late 3000 us: %.0f us left, %d slipped, %d reversed", err, net, reversed);
+    slip = (JkkSyncSlip_t){0};
+    err = SlipLoop(&slip, -3000, 0, blocks, &net, &reversed);
+    CHECK(fabs(err) <= 100 && net < 0 && reversed == 0, "early 3000 us: %.0f us left, %d slipped, %d reversed", err, net, reversed);
+    // Drift is followed with error of drift * JKK_SYNC_SLIP_TC_MS, not held at a dead band edge
+    slip = (JkkSyncSlip_t){0};
+    err = SlipLoop(&slip, 0, 100, blocks, &net, &reversed);
+    double lag = -100.0 * JKK_SYNC_SLIP_TC_MS / 1000;
+    CHECK(fabs(err - lag) <= 2e6 / RATE, "100 ppm: error %.0f us, expected %.0f us", err, lag);
+    CHECK(abs(net + 100 * 10 * RATE / 1000000) <= 10, "100 ppm: %d slipped", net);
+}
+
+int main(int argc, char **argv) {
+    int seconds = 20; // Drift of followers 1 and 2 over the run after warm-up is more than NET_SLIP_FRAMES
+    int opt;
+    while ((opt = getopt(argc, argv, "t:v")) != -1) {
+        switch (opt) {
+            case 't': seconds = atoi(optarg); break;
+            case 'v': verbose = true; break;
+            default:
+                fprintf(stderr, "Usage: %s [-t seconds] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    TestOffset();
+    TestSlip();
+
+    hostStart = HostUs();
+    leaderSock = UdpSocket(PORT);
+    CHECK(leaderSock >= 0, "leader port %d busy", PORT);
+    for (int i = 0; i < FOLLOWERS; i++) {
+        followers[i].id = i;
+        followers[i].sock = UdpSocket(PORT + 1 + i);
+        CHECK(followers[i].sock >= 0, "follower port %d busy", PORT + 1 + i);
+        pthread_mutex_init(&followers[i].lock, NULL);
+        pthread_cond_init(&followers[i].cond, NULL);
+    }
+    if (failed) return failed;
+    playStart = ClockNow(&leaderClock) + LEADER_LAT_US;
+
+    pthread_t threads[2 + 2 * FOLLOWERS];
+    pthread_create(&threads[0], NULL, LeaderTimeTask, NULL);
+    pthread_create(&threads[1], NULL, LeaderAudioTask, NULL);
+    for (int i = 0; i < FOLLOWERS; i++) {
+        pthread_create(&threads[2 + 2 * i], NULL, FollowerRxTask, &followers[i]);
+        pthread_create(&threads[3 + 2 * i], NULL, FollowerPlayTask, &followers[i]);
+    }
+    sleep(seconds);
+    running = false;
+    for (int i = 0; i < FOLLOWERS; i++) {
+        pthread_mutex_lock(&followers[i].lock);
+        pthread_cond_signal(&followers[i].cond);
+        pthread_mutex_unlock(&followers[i].lock);
+    }
+    for (int i = 0; i < 2 + 2 * FOLLOWERS; i++) pthread_join(threads[i], NULL);
+
+    printf("Leader play time error max %lld us\n", playTimeErrMax);
+    CHECK(playTimeErrMax <= 2, "leader play time off by %lld us", playTimeErrMax);
+    int64_t endAt = HostUs();
+    printf("node  clock           offset err  skew mean  |skew| mean  |skew| max  net slips  expected  late  early  pads\n");
+    for (int i = 0; i < FOLLOWERS; i++) {
+        Follower_t *f = &followers[i];
+        // True offset now: leader clock minus follower clock at the same host time
+        int64_t trueOff = ClockNow(&leaderClock) - ClockNow(&f->clock);
+        double mean = f->samples ? f->skewSum / f->samples : 0;
+        double absMean = f->samples ? f->skewAbsSum / f->samples : 0;
+        // Fast follower DAC plays ppm more frames than leader in the same time, they are repeated
+        int net = (int)f->play.slips - (int)f->play.dups - f->netAtWarm;
+        double expected = -f->clock.ppm * (endAt - f->warmAt) / 1e6 * RATE / 1e6;
+        printf("%d  %+7lld us %+4.0f ppm  %+8lld us  %+7.0f us  %8.0f us  %7.0f us  %+9d  %+8.0f  %4u  %5u  %4u\n", i + 1,
+               f->clock.offUs, f->clock.ppm, f->off.offsetUs - trueOff, mean, absMean, f->skewMax,
+               net, expected, f->play.late, f->play.early, f->play.pads);
+        CHECK(f->samples > 0, "follower %d played nothing after warm-up", i + 1);
+        CHECK(f->skewMax <= SKEW_MAX_US, "follower %d skew max %.0f us", i + 1, f->skewMax);
+        CHECK(fabs(mean) <= SKEW_MEAN_US, "follower %d skew mean %.0f us", i + 1, mean);
+        CHECK(fabs(net - expected) <= NET_SLIP_FRAMES, "follower %d net slips %d, expected %.0f", i + 1, net, expected);
+        CHECK(fabs(expected) <= NET_SLIP_FRAMES || net * expected > 0, "follower %d corrects the wrong way: %d, expected %.0f",
+              i + 1, net, expected);
+        if (verbose) printf("   %ld samples, %u dropped at queue, %u slips, %u repeats\n", f->samples, f->drops, f->play.slips, f->play.dups);
+    }
+    printf("%s (%d failed)\n", failed ? "FAILED" : "OK", failed);
+    return failed;
+}